@@ -196,6 +196,9 @@ MainWindow::~MainWindow()
     delete m_modelTabWidget;
     delete m_timelineTabWidget;
     delete m_boneUIDelegate;
+    /* デコーダがエンコーダのリングバッファに書き込まないように先に止める */
+    stopAudioDecoder();
+    delete m_audioDecoder;
     delete m_videoEncoder;
     delete m_player;
     delete m_menuBar;
@@ -1580,10 +1583,7 @@ void MainWindow::invokeVideoEncoder()
         int width = m_exportingVideoDialog->sceneWidth();
         int height = m_exportingVideoDialog->sceneHeight();
         /* 終了するまで待つ */
-        if (m_audioDecoder && !m_audioDecoder->isFinished()) {
-            m_audioDecoder->stop();
-            m_audioDecoder->wait();
-        }
+        stopAudioDecoder();
         if (m_videoEncoder && !m_videoEncoder->isFinished()) {
             m_videoEncoder->stop();
             m_videoEncoder->wait();
@@ -1606,7 +1606,8 @@ void MainWindow::invokeVideoEncoder()
                                           m_exportingVideoDialog->videoBitrate(),
                                           bitRate,
                                           sampleRate);
-        connect(m_audioDecoder, SIGNAL(audioDidDecode(QByteArray)), m_videoEncoder, SLOT(enqueueAudioBuffer(QByteArray)));
+        /* 音声はシグナルを経由せずリングバッファに直接書き込む (エンコーダが追いつくまでデコーダは待機する) */
+        m_audioDecoder->setRingBuffer(m_videoEncoder->audioBuffer());
         connect(this, SIGNAL(sceneDidRendered(QImage)), m_videoEncoder, SLOT(enqueueImage(QImage)));
         m_sceneWidget->setPreferredFPS(sceneFPS);
         const QString &exportingFormat = tr("Exporting frame %1 of %2...");
@@ -1670,12 +1671,22 @@ void MainWindow::invokeVideoEncoder()
             progress->setLabelText(encodingFormat.arg(size).arg(remain));
             qApp->processEvents(QEventLoop::ExcludeUserInputEvents);
         }
-        m_audioDecoder->stop();
+        stopAudioDecoder();
         m_videoEncoder->stop();
         restoreWindowState(state);
     }
 }
 
+void MainWindow::stopAudioDecoder()
+{
+    /* リングバッファを持つエンコーダより先にデコーダを止めて待機し、リングバッファを切り離す */
+    if (m_audioDecoder) {
+        m_audioDecoder->stop();
+        m_audioDecoder->wait();
+        m_audioDecoder->setRingBuffer(0);
+    }
+}
+
 void MainWindow::saveWindowStateAndResize(const QSize &videoSize, WindowState &state)
 {
     SceneLoader *loader = m_sceneWidget->sceneLoader();
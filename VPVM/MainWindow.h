@@ -160,6 +160,7 @@ private:
     void updateWindowTitle();
     void saveWindowStateAndResize(const QSize &videoSize, WindowState &state);
     void restoreWindowState(const WindowState &state);
+    void stopAudioDecoder();
 
     vpvl2::IEncoding *m_encoding;
     vpvl2::Factory *m_factory;
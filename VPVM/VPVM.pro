@@ -211,6 +211,7 @@ SOURCES += main.cc \
     video/AudioDecoder.cc \
     video/AVCommon.cc \
     video/AudioPlayer.cc \
+    video/AudioRingBuffer.cc \
     dialogs/RenderOrderDialog.cc \
     widgets/SceneLightWidget.cc \
     widgets/ModelSettingWidget.cc \
@@ -260,6 +261,7 @@ HEADERS  += \
     video/AudioDecoder.h \
     video/AVCommon.h \
     video/AudioPlayer.h \
+    video/AudioRingBuffer.h \
     dialogs/RenderOrderDialog.h \
     widgets/SceneLightWidget.h \
     widgets/ModelSettingWidget.h \
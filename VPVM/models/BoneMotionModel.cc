@@ -393,8 +393,8 @@ public:
           m_newState(scene, model)
     {
         m_oldState.copyFrom(state);
-        /* 前と後の全てのボーンの情報を保存しておく */
-        m_newState.save();
+        /* 前と後のボーンの情報を保存しておく。後の情報は前の情報で変化したものに限る */
+        m_newState.saveDiff(m_oldState);
         setText(QApplication::tr("Set bones of %1").arg(internal::toQStringFromModel(model)));
     }
 
@@ -279,8 +279,8 @@ public:
           m_newState(scene, model)
     {
         m_oldState.copyFrom(oldState);
-        /* 前と後の全ての頂点モーフの情報を保存しておく */
-        m_newState.save();
+        /* 前と後の頂点モーフの情報を保存しておく。後の情報は前の情報で変化したものに限る */
+        m_newState.saveDiff(m_oldState);
         setText(QApplication::tr("Set morphs of %1").arg(internal::toQStringFromModel(model)));
     }
     virtual ~SetMorphCommand() {
@@ -636,15 +636,18 @@ void MorphMotionModel::setWeight(IMorph::WeightPrecision &value)
 void MorphMotionModel::setWeight(const IMorph::WeightPrecision &value, IMorph *morph)
 {
     if (morph) {
-        /* 一度頂点がリセットされるので、頂点モーフのみ更新を行う */
+        /* 一度頂点と材質モーフの寄与がリセットされるので、ボーンモーフ以外のモーフを更新し直す */
         m_model->resetVertices();
         Array<IMorph *> morphs;
         m_model->getMorphs(morphs);
         const int nmorphs = morphs.count();
         for (int i = 0; i < nmorphs; i++) {
             IMorph *m = morphs[i];
-            /* 頂点モーフでかつ変更するモーフ以外を更新するようにする */
-            if (morph != m && morph->type() == IMorph::kVertex)
+            /*
+             * 変更するモーフ以外を更新するようにする。ボーンモーフはリセットされず、
+             * 親を持つモーフはグループモーフから更新されるため対象外とする
+             */
+            if (morph != m && m->type() != IMorph::kBone && !m->hasParent())
                 m->setWeight(m->weight());
         }
         morph->setWeight(value);
@@ -55,76 +55,41 @@ PMDMotionModel::State::~State()
 
 void PMDMotionModel::State::restore() const
 {
-    m_model->resetVertices();
-    foreach (const Bone &bone, m_bones) {
-        IBone *b = bone.first;
-        const Transform &tr = bone.second;
-        b->setPosition(tr.first);
-        b->setRotation(tr.second);
-    }
-    foreach (const Morph &morph, m_morphs) {
-        IMorph *m = morph.first;
-        m->setWeight(morph.second);
-    }
-    m_scene->updateModel(m_model);
+    /* 変化したボーンとモーフのみ書き戻し、何も変化しなければモデルの更新を省略する */
+    if (m_model->restorePose(m_pose) > 0)
+        m_scene->updateModel(m_model);
 }
 
 void PMDMotionModel::State::save()
 {
-    Array<IBone *> bones;
-    m_model->getBones(bones);
-    m_bones.clear();
-    const int nbones = bones.count();
-    for (int i = 0; i < nbones; i++) {
-        IBone *bone = bones[i];
-        Transform tr(bone->position(), bone->rotation());
-        m_bones.append(Bone(bone, tr));
-    }
-    Array<IMorph *> morphs;
-    m_model->getMorphs(morphs);
-    m_morphs.clear();
-    const int nmorphs = morphs.count();
-    for (int i = 0; i < nmorphs; i++) {
-        IMorph *morph = morphs[i];
-        const Scalar &weight = morph->weight();
-        if (!morph->hasParent())
-            m_morphs.append(Morph(morph, weight));
-    }
+    m_model->savePose(m_pose);
+}
+
+void PMDMotionModel::State::saveDiff(const State &base)
+{
+    /* base で変化したボーンとモーフの現在の値のみを保存する (やり直し用の状態を小さくするため) */
+    Pose pose;
+    m_model->savePose(pose);
+    pose.diff(base.m_pose, m_pose);
 }
 
 bool PMDMotionModel::State::compact()
 {
-    QMutableListIterator<Bone> bones(m_bones);
-    while (bones.hasNext()) {
-        bones.next();
-        const Bone &value = bones.value();
-        const IBone *bone = value.first;
-        const Transform &transform = value.second;
-        if (bone->position() == transform.first && bone->rotation() == transform.second)
-            bones.remove();
-    }
-    QMutableListIterator<Morph> morphs(m_morphs);
-    while (morphs.hasNext()) {
-        morphs.next();
-        const Morph &value = morphs.value();
-        const IMorph *morph = value.first;
-        const Scalar &weight = value.second;
-        if (btFuzzyZero(morph->weight() - weight))
-            morphs.remove();
-    }
-    return m_bones.size() > 0 || m_morphs.size() > 0;
+    Array<IBone *> bones;
+    Array<IMorph *> morphs;
+    m_model->getBones(bones);
+    m_model->getMorphs(morphs);
+    return m_pose.compact(bones, morphs);
 }
 
 void PMDMotionModel::State::discard()
 {
-    m_bones.clear();
-    m_morphs.clear();
+    m_pose.clear();
 }
 
 void PMDMotionModel::State::copyFrom(const State &value)
 {
-    m_bones = value.m_bones;
-    m_morphs = value.m_morphs;
+    m_pose.copy(value.m_pose);
     m_model = value.m_model;
 }
 
@@ -42,6 +42,7 @@
 #include <QtCore/QString>
 #include <QtGui/QAbstractItemView>
 #include <vpvl2/Common.h>
+#include <vpvl2/Pose.h>
 
 namespace vpvl2 {
 class IBone;
@@ -66,6 +67,7 @@ public:
         ~State();
         void restore() const;
         void save();
+        void saveDiff(const State &base);
         bool compact();
         void discard();
         void copyFrom(const State &value);
@@ -74,13 +76,9 @@ public:
         vpvl2::IModel *model() const { return m_model; }
         void setModel(vpvl2::IModel *value) { m_model = value; }
     private:
-        typedef QPair<vpvl2::Vector3, vpvl2::Quaternion> Transform;
-        typedef QPair<vpvl2::IBone *, Transform> Bone;
-        typedef QPair<vpvl2::IMorph *, vpvl2::Scalar> Morph;
         const vpvl2::Scene *m_scene;
         vpvl2::IModel *m_model;
-        QList<Bone> m_bones;
-        QList<Morph> m_morphs;
+        vpvl2::Pose m_pose;
         Q_DISABLE_COPY(State)
     };
 
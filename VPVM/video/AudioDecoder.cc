@@ -35,6 +35,7 @@
 /* ----------------------------------------------------------------- */
 
 #include "AudioDecoder.h"
+#include "AudioRingBuffer.h"
 #include "AVCommon.h"
 
 #include <QtCore/QtCore>
@@ -67,7 +68,8 @@ void UICloseAudio(AVFormatContext *formatContext, AVCodecContext *audioContext)
 }
 
 AudioDecoder::AudioDecoder()
-    : m_running(true)
+    : m_ringBuffer(0),
+      m_running(true)
 {
 }
 
@@ -103,6 +105,11 @@ void AudioDecoder::setFilename(const QString &filename)
     m_filename = filename;
 }
 
+void AudioDecoder::setRingBuffer(AudioRingBuffer *value)
+{
+    m_ringBuffer = value;
+}
+
 void AudioDecoder::stop()
 {
     m_running = false;
@@ -144,5 +151,25 @@ void AudioDecoder::run()
 
 void AudioDecoder::decodeBuffer(const QByteArray &bytes, float /* position */, int /* channels */)
 {
-    emit audioDidDecode(bytes);
+    if (m_ringBuffer)
+        writeRingBuffer(bytes);
+    else
+        emit audioDidDecode(bytes);
+}
+
+void AudioDecoder::writeRingBuffer(const QByteArray &bytes)
+{
+    /*
+     * リングバッファが一杯の場合は読み込み側が消費するまで待つ (バッファを際限なく伸ばさない)。
+     * 待っている間はオーバーランとせず、停止により書き込めずに捨てた分だけを計上する
+     */
+    const char *data = bytes.constData();
+    int offset = 0, size = bytes.size();
+    while (m_running) {
+        offset += m_ringBuffer->tryWrite(data + offset, size - offset);
+        if (offset >= size)
+            break;
+        msleep(1);
+    }
+    m_ringBuffer->discard(size - offset);
 }
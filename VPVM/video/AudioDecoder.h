@@ -39,6 +39,8 @@
 
 #include <QtCore/QtCore>
 
+class AudioRingBuffer;
+
 class AudioDecoder : public QThread
 {
     Q_OBJECT
@@ -49,11 +51,13 @@ public:
 
     bool canOpen() const;
     void setFilename(const QString &filename);
+    void setRingBuffer(AudioRingBuffer *value);
     void stop();
 
 protected:
     virtual void run();
     virtual void decodeBuffer(const QByteArray &bytes, float position, int channels);
+    void writeRingBuffer(const QByteArray &bytes);
 
 signals:
     void audioDidDecode(const QByteArray &bytes);
@@ -62,6 +66,7 @@ signals:
 
 private:
     QString m_filename;
+    AudioRingBuffer *m_ringBuffer;
     volatile bool m_running;
 
     Q_DISABLE_COPY(AudioDecoder)
@@ -36,11 +36,22 @@
 
 #include "AudioPlayer.h"
 
+namespace {
+
+/* 44.1kHz/16bit/2ch で約0.2秒分。大きくすると再生位置の通知が実際の再生より先行する */
+static const int kRingBufferCapacity = 32768;
+static const int kBytesPerFrame = 2 * sizeof(int16_t);
+static const float kBytesPerSecond = 44100.0f * kBytesPerFrame;
+
+}
+
 AudioPlayer::AudioPlayer()
     : AudioDecoder(),
+      m_ringBuffer(kRingBufferCapacity),
       m_stream(0),
       m_position(0)
 {
+    setRingBuffer(&m_ringBuffer);
 }
 
 AudioPlayer::~AudioPlayer()
@@ -66,7 +77,10 @@ bool AudioPlayer::initalize()
         qDebug() << "sampleRate:" << info->defaultSampleRate;
         qDebug() << "defaultLowInputLatency:" << info->defaultLowInputLatency;
         qDebug() << "defualtLowOutputLatency:" << info->defaultLowOutputLatency;
-        PaError err = Pa_OpenStream(&m_stream, 0, &parameters, 44100.0, 1024, paClipOff, 0, 0);
+        m_ringBuffer.reset();
+        m_position = 0;
+        PaError err = Pa_OpenStream(&m_stream, 0, &parameters, 44100.0, 1024, paClipOff,
+                                    &AudioPlayer::playAudioCallback, &m_ringBuffer);
         if (err == paNoError) {
             return true;
         }
@@ -91,12 +105,30 @@ void AudioPlayer::run()
 {
     Pa_StartStream(m_stream);
     AudioDecoder::run();
+    if (m_ringBuffer.underrunCount() > 0 || m_ringBuffer.overrunCount() > 0) {
+        qDebug("audio underrun: %d times (%lld bytes), overrun: %d times",
+               m_ringBuffer.underrunCount(), m_ringBuffer.underrunBytes(), m_ringBuffer.overrunCount());
+    }
+}
+
+void AudioPlayer::decodeBuffer(const QByteArray &bytes, float position, int /* channels */)
+{
+    writeRingBuffer(bytes);
+    /* リングバッファに残っている分はまだ再生されていないので、その分だけ位置を戻して通知する */
+    float played = qMax(position - m_ringBuffer.size() / kBytesPerSecond, 0.0f);
+    emit positionDidAdvance(played - m_position);
+    m_position = played;
 }
 
-void AudioPlayer::decodeBuffer(const QByteArray &bytes, float position, int channels)
+int AudioPlayer::playAudioCallback(const void * /* input */,
+                                   void *output,
+                                   unsigned long frameCount,
+                                   const PaStreamCallbackTimeInfo * /* timeInfo */,
+                                   PaStreamCallbackFlags /* statusFlags */,
+                                   void *userData)
 {
-    int size = bytes.length() / (channels * sizeof(int16_t));
-    Pa_WriteStream(m_stream, bytes.constData(), size);
-    emit positionDidAdvance(position - m_position);
-    m_position = position;
+    /* オーディオスレッドから呼ばれるため、ロックやメモリ確保を伴う処理を行ってはいけない */
+    AudioRingBuffer *ringBuffer = static_cast<AudioRingBuffer *>(userData);
+    ringBuffer->readOrSilence(static_cast<char *>(output), int(frameCount * kBytesPerFrame));
+    return paContinue;
 }
@@ -38,6 +38,7 @@
 #define AUDIOPLAYER_H
 
 #include "AudioDecoder.h"
+#include "AudioRingBuffer.h"
 
 #include <portaudio.h>
 
@@ -60,6 +61,14 @@ signals:
     void positionDidAdvance(float diff);
 
 private:
+    static int playAudioCallback(const void *input,
+                                 void *output,
+                                 unsigned long frameCount,
+                                 const PaStreamCallbackTimeInfo *timeInfo,
+                                 PaStreamCallbackFlags statusFlags,
+                                 void *userData);
+
+    AudioRingBuffer m_ringBuffer;
     PaStream *m_stream;
     float m_position;
 
@@ -0,0 +1,143 @@
+/* ----------------------------------------------------------------- */
+/*                                                                   */
+/*  Copyright (c) 2010-2012  hkrn                                    */
+/*                                                                   */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/* - Redistributions of source code must retain the above copyright  */
+/*   notice, this list of conditions and the following disclaimer.   */
+/* - Redistributions in binary form must reproduce the above         */
+/*   copyright notice, this list of conditions and the following     */
+/*   disclaimer in the documentation and/or other materials provided */
+/*   with the distribution.                                          */
+/* - Neither the name of the MMDAI project team nor the names of     */
+/*   its contributors may be used to endorse or promote products     */
+/*   derived from this software without specific prior written       */
+/*   permission.                                                     */
+/*                                                                   */
+/* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND            */
+/* CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,       */
+/* INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF          */
+/* MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE          */
+/* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS */
+/* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,          */
+/* EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED   */
+/* TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,     */
+/* DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON */
+/* ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,   */
+/* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY    */
+/* OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE           */
+/* POSSIBILITY OF SUCH DAMAGE.                                       */
+/* ----------------------------------------------------------------- */
+
+#include "AudioRingBuffer.h"
+
+namespace {
+
+static int UIRoundUpPowerOfTwo(int value)
+{
+    int n = 1;
+    while (n < value)
+        n <<= 1;
+    return n;
+}
+
+}
+
+AudioRingBuffer::AudioRingBuffer(int capacity)
+    : m_data(new char[UIRoundUpPowerOfTwo(capacity)]),
+      m_capacity(UIRoundUpPowerOfTwo(capacity)),
+      m_mask(m_capacity - 1),
+      m_writeIndex(0),
+      m_readIndex(0),
+      m_overrunCount(0),
+      m_underrunCount(0),
+      m_overrunBytes(0),
+      m_underrunBytes(0)
+{
+}
+
+AudioRingBuffer::~AudioRingBuffer()
+{
+}
+
+int AudioRingBuffer::write(const char *data, int size)
+{
+    /* 書き込めなかった分は捨てられるのでオーバーランとして計上する */
+    const int length = tryWrite(data, size);
+    discard(size - length);
+    return length;
+}
+
+int AudioRingBuffer::tryWrite(const char *data, int size)
+{
+    /* 添字は単調増加させ、容量が2の冪であることを利用してマスクで位置を求める (差分は符号なしで計算して桁あふれに対応) */
+    const uint writeIndex = uint(int(m_writeIndex));
+    const uint readIndex = uint(loadAcquire(m_readIndex));
+    const int available = m_capacity - int(writeIndex - readIndex);
+    const int length = qMin(size, available);
+    const int offset = int(writeIndex & m_mask);
+    const int first = qMin(length, m_capacity - offset);
+    memcpy(m_data.data() + offset, data, first);
+    memcpy(m_data.data(), data + first, length - first);
+    m_writeIndex.fetchAndStoreRelease(int(writeIndex + length));
+    return length;
+}
+
+void AudioRingBuffer::discard(int size)
+{
+    if (size > 0) {
+        m_overrunCount.ref();
+        m_overrunBytes += size;
+    }
+}
+
+int AudioRingBuffer::read(char *data, int size)
+{
+    const uint readIndex = uint(int(m_readIndex));
+    const uint writeIndex = uint(loadAcquire(m_writeIndex));
+    const int length = qMin(size, int(writeIndex - readIndex));
+    const int offset = int(readIndex & m_mask);
+    const int first = qMin(length, m_capacity - offset);
+    memcpy(data, m_data.data() + offset, first);
+    memcpy(data + first, m_data.data(), length - first);
+    m_readIndex.fetchAndStoreRelease(int(readIndex + length));
+    if (length < size) {
+        m_underrunCount.ref();
+        m_underrunBytes += size - length;
+    }
+    return length;
+}
+
+int AudioRingBuffer::readOrSilence(char *data, int size)
+{
+    /* 足りない分は無音で埋める (オーディオのコールバックは必ず要求量を満たさなければならないため) */
+    const int length = read(data, size);
+    memset(data + length, 0, size - length);
+    return length;
+}
+
+void AudioRingBuffer::reset()
+{
+    /* 読み書きどちらのスレッドも動いていない時にのみ呼び出すこと */
+    m_writeIndex = 0;
+    m_readIndex = 0;
+    m_overrunCount = 0;
+    m_underrunCount = 0;
+    m_overrunBytes = 0;
+    m_underrunBytes = 0;
+}
+
+int AudioRingBuffer::size() const
+{
+    return int(uint(loadAcquire(m_writeIndex)) - uint(loadAcquire(m_readIndex)));
+}
+
+int AudioRingBuffer::loadAcquire(const QAtomicInt &value)
+{
+    return const_cast<QAtomicInt &>(value).fetchAndAddAcquire(0);
+}
@@ -0,0 +1,86 @@
+/* ----------------------------------------------------------------- */
+/*                                                                   */
+/*  Copyright (c) 2010-2012  hkrn                                    */
+/*                                                                   */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/* - Redistributions of source code must retain the above copyright  */
+/*   notice, this list of conditions and the following disclaimer.   */
+/* - Redistributions in binary form must reproduce the above         */
+/*   copyright notice, this list of conditions and the following     */
+/*   disclaimer in the documentation and/or other materials provided */
+/*   with the distribution.                                          */
+/* - Neither the name of the MMDAI project team nor the names of     */
+/*   its contributors may be used to endorse or promote products     */
+/*   derived from this software without specific prior written       */
+/*   permission.                                                     */
+/*                                                                   */
+/* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND            */
+/* CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,       */
+/* INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF          */
+/* MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE          */
+/* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS */
+/* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,          */
+/* EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED   */
+/* TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,     */
+/* DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON */
+/* ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,   */
+/* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY    */
+/* OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE           */
+/* POSSIBILITY OF SUCH DAMAGE.                                       */
+/* ----------------------------------------------------------------- */
+
+#ifndef AUDIORINGBUFFER_H
+#define AUDIORINGBUFFER_H
+
+#include <QtCore/QtCore>
+
+/**
+ * PCM サンプルを受け渡すための固定長のロックフリーなリングバッファです。
+ *
+ * 書き込みはひとつのスレッド (AudioDecoder) から、読み込みはひとつのスレッド
+ * (VideoEncoder あるいは PortAudio のコールバック) からのみ行うことを前提としています。
+ * 書き込めずに捨てた場合はオーバーラン、要求量に満たなかった場合はアンダーランとして計上します。
+ * 空きを待って再試行する書き込み側は tryWrite を使い、最終的に捨てた分だけを discard で計上します。
+ */
+class AudioRingBuffer
+{
+public:
+    explicit AudioRingBuffer(int capacity);
+    ~AudioRingBuffer();
+
+    int write(const char *data, int size);
+    int tryWrite(const char *data, int size);
+    void discard(int size);
+    int read(char *data, int size);
+    int readOrSilence(char *data, int size);
+    void reset();
+
+    int size() const;
+    int capacity() const { return m_capacity; }
+    int overrunCount() const { return m_overrunCount; }
+    int underrunCount() const { return m_underrunCount; }
+    qint64 overrunBytes() const { return m_overrunBytes; }
+    qint64 underrunBytes() const { return m_underrunBytes; }
+
+private:
+    static int loadAcquire(const QAtomicInt &value);
+
+    QScopedArrayPointer<char> m_data;
+    const int m_capacity;
+    const int m_mask;
+    QAtomicInt m_writeIndex;
+    QAtomicInt m_readIndex;
+    QAtomicInt m_overrunCount;
+    QAtomicInt m_underrunCount;
+    volatile qint64 m_overrunBytes;
+    volatile qint64 m_underrunBytes;
+
+    Q_DISABLE_COPY(AudioRingBuffer)
+};
+
+#endif // AUDIORINGBUFFER_H
@@ -64,6 +64,12 @@ static int UIAVCodecLockCallback(void ** /* mutex */, AVLockOp op)
     }
 }
 
+static int UIAudioBufferCapacity(int sampleRate)
+{
+    /* 16bit ステレオで4秒分 (最低でも1MB) を確保する。音声フレーム1つ分より小さいと取り出せなくなるので注意 */
+    return qMax(sampleRate * 2 * int(sizeof(int16_t)) * 4, 1 << 20);
+}
+
 }
 
 bool VideoEncoder::isSupported()
@@ -88,6 +94,7 @@ VideoEncoder::VideoEncoder(const QString &filename,
                            QObject *parent)
     : QThread(parent),
       m_filename(filename),
+      m_audioBuffer(UIAudioBufferCapacity(audioSampleRate)),
       m_size(size),
       m_fps(fps),
       m_videoBitrate(videoBitrate),
@@ -113,10 +120,7 @@ int VideoEncoder::sizeOfVideoQueue() const
 
 int VideoEncoder::sizeOfAudioBuffer() const
 {
-    m_audioBufferMutex.lock();
-    int size = m_audioBuffer.size();
-    m_audioBufferMutex.unlock();
-    return size;
+    return m_audioBuffer.size();
 }
 
 void VideoEncoder::stop()
@@ -162,6 +166,9 @@ void VideoEncoder::run()
                     * audioCodec->channels
                     * av_get_bytes_per_sample(audioCodec->sample_fmt);
             encodedAudioFrameBuffer.reset(new uint8_t[encodedAudioFrameBufferSize]);
+            if (encodedAudioFrameBufferSize >= m_audioBuffer.capacity())
+                qWarning("audio frame size (%d) exceeds the audio ring buffer (%d)",
+                         encodedAudioFrameBufferSize, m_audioBuffer.capacity());
         }
         int width = m_size.width(), height = m_size.height();
         int encodedVideoFrameBufferSize = width * height * 4;
@@ -183,7 +190,8 @@ void VideoEncoder::run()
         avformat_write_header(videoFormatContext, 0);
         bool remainQueue = true;
         QImage image;
-        QByteArray bytes;
+        /* 音声フレームの取り出し先は一度だけ確保して使い回す */
+        QByteArray bytes(encodedAudioFrameBufferSize, 0);
         /* stop() で m_running が false になるが、キューが全て空になるまで終了しない */
         while (m_running || remainQueue) {
             double audioPTS = ComputePresentTimeStamp(audioStream);
@@ -276,9 +284,8 @@ void VideoEncoder::enqueueImage(const QImage &image)
 
 void VideoEncoder::enqueueAudioBuffer(const QByteArray &bytes)
 {
-    m_audioBufferMutex.lock();
-    m_audioBuffer.append(bytes);
-    m_audioBufferMutex.unlock();
+    /* シグナル経由の場合は待機できないので、書き込めなかった分はオーバーランとして捨てられる */
+    m_audioBuffer.write(bytes.constData(), bytes.size());
 }
 
 void VideoEncoder::dequeueImage(QImage &image)
@@ -290,7 +297,7 @@ void VideoEncoder::dequeueImage(QImage &image)
 
 void VideoEncoder::dequeueAudioBuffer(QByteArray &bytes, int size)
 {
-    m_audioBufferMutex.lock();
-    bytes = m_audioBuffer.remove(0, size);
-    m_audioBufferMutex.unlock();
+    if (bytes.size() < size)
+        bytes.resize(size);
+    m_audioBuffer.read(bytes.data(), size);
 }
@@ -40,6 +40,8 @@
 #include <QtCore/QtCore>
 #include <QtGui/QImage>
 
+#include "AudioRingBuffer.h"
+
 class VideoEncoder : public QThread
 {
     Q_OBJECT
@@ -59,6 +61,7 @@ public:
 
     int sizeOfVideoQueue() const;
     int sizeOfAudioBuffer() const;
+    AudioRingBuffer *audioBuffer() { return &m_audioBuffer; }
 
 public slots:
     void stop();
@@ -75,9 +78,8 @@ private:
     void dequeueAudioBuffer(QByteArray &bytes, int size);
 
     mutable QMutex m_videoQueueMutex;
-    mutable QMutex m_audioBufferMutex;
     QString m_filename;
-    QByteArray m_audioBuffer;
+    AudioRingBuffer m_audioBuffer;
     QQueue<QImage> m_images;
     QSize m_size;
     int m_fps;
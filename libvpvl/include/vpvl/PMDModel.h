@@ -173,6 +173,7 @@ public:
     static const int kBoneCategoryNameSize = 50;
     static const float kMinBoneWeight;
     static const float kMinFaceWeight;
+    static const int kSkinningChunkSize = 4096;
 
     /**
      * Add and attach a motion to the model.
@@ -277,9 +278,29 @@ public:
 
     /**
      * Update skin vertices, toon texture coordinates and edge vertices of the model.
+     *
+     * This calls prepareSkins() and updateSkins(int, int) with vertices split into chunks
+     * of kSkinningChunkSize, which are run in parallel if VPVL_ENABLE_OPENMP is defined.
      */
     void updateSkins();
 
+    /**
+     * Prepare skinning transforms of all bones before calling updateSkins(int, int).
+     */
+    void prepareSkins();
+
+    /**
+     * Update skin vertices, toon texture coordinates and edge vertices of the specified range
+     * in one pass.
+     *
+     * prepareSkins() must be called before calling this. Different ranges can be updated
+     * concurrently.
+     *
+     * @param from The first index of the vertices to update
+     * @param to The last index of the vertices to update (exclusive)
+     */
+    void updateSkins(int from, int to);
+
     /**
      * Update skins and transforms all bones and faces of the model without seeking the motion.
      */
@@ -418,12 +439,12 @@ public:
     /**
      * Enable software (CPU not GPU) skinning.
      *
-     * If this method is called with true, do CPU based skinning, updateSkinVertices() and
-     * updateToon() will be called internally. As a result, verticesPointer(), normalsPointer(),
+     * If this method is called with true, do CPU based skinning in updateSkins(). As a result,
+     * verticesPointer(), normalsPointer(),
      * edgeVerticesPointer() and #toonTextureCoordsPointer() will be modified.
      *
-     * If this method is called with false, doesn't do skinning, updatePosition() will be called
-     * internally. As a result, just setting vertex origin
+     * If this method is called with false, doesn't do skinning in updateSkins().
+     * As a result, just setting vertex origin
      * position and bone matrices. Skinning must be done at the other.
      * (e.g. Shader skinning or GPGPU based skinning).
      *
@@ -719,10 +740,7 @@ private:
     void updateBoneFromSimulation();
     void updateAllFaces();
     void updateShadowTextureCoords(float coef);
-    void updateSkinVertices();
-    void updateToon(const Vector3 &lightPosition);
     void updateIndices();
-    void updatePosition();
 
     uint8_t m_name[kNameSize + 1];
     uint8_t m_comment[kCommentSize + 1];
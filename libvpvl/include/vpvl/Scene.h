@@ -142,10 +142,17 @@ public:
     }
 
 private:
+    struct SkinningRange {
+        PMDModel *model;
+        int from;
+        int to;
+    };
     void updateRotationFromAngle();
+    void updateSkins();
 
     btDiscreteDynamicsWorld *m_world;
     Array<PMDModel *> m_models;
+    Array<SkinningRange> m_skinningRanges;
     VMDMotion *m_cameraMotion;
     VMDMotion *m_lightMotion;
     Transform m_modelview;
@@ -364,13 +364,22 @@ void PMDModel::advanceMotion(float deltaFrame)
 }
 
 void PMDModel::updateSkins()
+{
+    prepareSkins();
+    const int nvertices = m_vertices.count();
+#ifdef VPVL_ENABLE_OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif /* VPVL_ENABLE_OPENMP */
+    for (int i = 0; i < nvertices; i += kSkinningChunkSize)
+        updateSkins(i, btMin(i + kSkinningChunkSize, nvertices));
+}
+
+void PMDModel::prepareSkins()
 {
     if (m_enableSoftwareSkinning) {
-        updateSkinVertices();
-        updateToon(m_lightPosition);
-    }
-    else {
-        updatePosition();
+        const int nbones = m_bones.count();
+        for (int i = 0; i < nbones; i++)
+            m_bones[i]->getSkinTransform(m_skinningTransform[i]);
     }
 }
 
@@ -435,58 +444,60 @@ void PMDModel::updateShadowTextureCoords(float coef)
     }
 }
 
-void PMDModel::updateSkinVertices()
+void PMDModel::updateSkins(int from, int to)
 {
-    const int nbones = m_bones.count();
-    for (int i = 0; i < nbones; i++)
-        m_bones[i]->getSkinTransform(m_skinningTransform[i]);
-    const int nvertices = m_vertices.count();
-    for (int i = 0; i < nvertices; i++) {
-        const Vertex *vertex = m_vertices[i];
-        SkinVertex &skin = m_skinnedVertices[i];
-        const float weight = vertex->weight();
-        if (weight >= 1.0f - kMinBoneWeight) {
-            const int16_t bone1 = vertex->bone1();
-            const Transform &transform = m_skinningTransform[bone1];
-            skin.position = transform * vertex->position();
-            skin.normal = transform.getBasis() * vertex->normal();
-        }
-        else if (weight <= kMinBoneWeight) {
-            const int16_t bone2 = vertex->bone2();
-            const Transform &transform = m_skinningTransform[bone2];
-            skin.position = transform * vertex->position();
-            skin.normal = transform.getBasis() * vertex->normal();
-        }
-        else {
-            const int16_t bone1 = vertex->bone1();
-            const int16_t bone2 = vertex->bone2();
-            const Vector3 &position = vertex->position();
-            const Vector3 &normal = vertex->normal();
-            const Transform &transform1 = m_skinningTransform[bone1];
-            const Transform &transform2 = m_skinningTransform[bone2];
-            const Vector3 &v1 = transform1 * position;
-            const Vector3 &n1 = transform1.getBasis() * normal;
-            const Vector3 &v2 = transform2 * position;
-            const Vector3 &n2 = transform2.getBasis() * normal;
-            skin.position.setInterpolate3(v2, v1, weight);
-            skin.normal.setInterpolate3(n2, n1, weight);
+    if (m_enableSoftwareSkinning) {
+        // Skinning, toon texture coordinate and edge offset are done in one pass per vertex
+        const Vector3 &lightPosition2 = -m_lightPosition;
+        for (int i = from; i < to; i++) {
+            const Vertex *vertex = m_vertices[i];
+            SkinVertex &skin = m_skinnedVertices[i];
+            const float weight = vertex->weight();
+            if (weight >= 1.0f - kMinBoneWeight) {
+                const int16_t bone1 = vertex->bone1();
+                const Transform &transform = m_skinningTransform[bone1];
+                skin.position = transform * vertex->position();
+                skin.normal = transform.getBasis() * vertex->normal();
+            }
+            else if (weight <= kMinBoneWeight) {
+                const int16_t bone2 = vertex->bone2();
+                const Transform &transform = m_skinningTransform[bone2];
+                skin.position = transform * vertex->position();
+                skin.normal = transform.getBasis() * vertex->normal();
+            }
+            else {
+                const int16_t bone1 = vertex->bone1();
+                const int16_t bone2 = vertex->bone2();
+                const Vector3 &position = vertex->position();
+                const Vector3 &normal = vertex->normal();
+                const Transform &transform1 = m_skinningTransform[bone1];
+                const Transform &transform2 = m_skinningTransform[bone2];
+                const Vector3 &v1 = transform1 * position;
+                const Vector3 &n1 = transform1.getBasis() * normal;
+                const Vector3 &v2 = transform2 * position;
+                const Vector3 &n2 = transform2.getBasis() * normal;
+                skin.position.setInterpolate3(v2, v1, weight);
+                skin.normal.setInterpolate3(n2, n1, weight);
+            }
+            skin.position.setW(1.0f);
+            const Scalar &v = 0.5f + lightPosition2.dot(skin.normal) * 0.5f;
+            skin.textureCoord.setW(v);
+            if (!vertex->isEdgeEnabled())
+                skin.edge = skin.position;
+            else
+                skin.edge = skin.position + skin.normal * m_edgeOffset;
         }
-        skin.position.setW(1.0f);
     }
-}
-
-void PMDModel::updateToon(const Vector3 &lightPosition)
-{
-    const int nvertices = m_vertices.count();
-    const Vector3 &lightPosition2 = -lightPosition;
-    for (int i = 0; i < nvertices; i++) {
-        SkinVertex &skin = m_skinnedVertices[i];
-        const Scalar &v = 0.5f + lightPosition2.dot(skin.normal) * 0.5f;
-        skin.textureCoord.setW(v);
-        if (!m_vertices[i]->isEdgeEnabled())
-            skin.edge = skin.position;
-        else
-            skin.edge = skin.position + skin.normal * m_edgeOffset;
+    else {
+        for (int i = from; i < to; i++) {
+            const Vertex *vertex = m_vertices[i];
+            SkinVertex &skinnedVertex = m_skinnedVertices[i];
+            Vector3 &position = skinnedVertex.position;
+            position = vertex->position();
+            position.setW(1.0f);
+            float value = vertex->isEdgeEnabled() ? m_edgeOffset : 0.0f;
+            skinnedVertex.edge.setValue(value, value, value);
+        }
     }
 }
 
@@ -499,20 +510,6 @@ void PMDModel::updateImmediate()
     updateSkins();
 }
 
-void PMDModel::updatePosition()
-{
-    const int nvertices = m_vertices.count();
-    for (int i = 0; i < nvertices; i++) {
-        const Vertex *vertex = m_vertices[i];
-        SkinVertex &skinnedVertex = m_skinnedVertices[i];
-        Vector3 &position = skinnedVertex.position;
-        position = vertex->position();
-        position.setW(1.0f);
-        float value = vertex->isEdgeEnabled() ? m_edgeOffset : 0.0f;
-        skinnedVertex.edge.setValue(value, value, value);
-    }
-}
-
 void PMDModel::updateIndices()
 {
     const int nindices = m_indices.count();
@@ -155,12 +155,16 @@ void Scene::seekMotion(float frameIndex)
 {
     const int nmodels = m_models.count();
     // Updating (Seeking) models and each motions
+#ifdef VPVL_ENABLE_OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif /* VPVL_ENABLE_OPENMP */
     for (int i = 0; i < nmodels; i++) {
         PMDModel *model = m_models[i];
         model->updateRootBone();
         model->seekMotion(frameIndex);
-        model->updateSkins();
+        model->prepareSkins();
     }
+    updateSkins();
     // Updating (Seeking) camera motion
     if (m_cameraMotion) {
         CameraAnimation *camera = m_cameraMotion->mutableCameraAnimation();
@@ -267,12 +271,16 @@ void Scene::advanceMotion(float deltaFrame)
 {
     const int nmodels = m_models.count();
     // Updating (Advance) models and each motions
+#ifdef VPVL_ENABLE_OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif /* VPVL_ENABLE_OPENMP */
     for (int i = 0; i < nmodels; i++) {
         PMDModel *model = m_models[i];
         model->updateRootBone();
         model->advanceMotion(deltaFrame);
-        model->updateSkins();
+        model->prepareSkins();
     }
+    updateSkins();
     // Updating (Advance) world simulation
 #ifndef VPVL_NO_BULLET
     if (m_world) {
@@ -305,12 +313,16 @@ void Scene::resetMotion()
 {
     const int nmodels = m_models.count();
     // Updating (Resetting) models and each motions
+#ifdef VPVL_ENABLE_OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif /* VPVL_ENABLE_OPENMP */
     for (int i = 0; i < nmodels; i++) {
         PMDModel *model = m_models[i];
         model->updateRootBone();
         model->resetMotion();
-        model->updateSkins();
+        model->prepareSkins();
     }
+    updateSkins();
     // Updating (Resetting) camera motion
     if (m_cameraMotion) {
         CameraAnimation *camera = m_cameraMotion->mutableCameraAnimation();
@@ -385,6 +397,32 @@ void Scene::updateProjection()
     SceneUtil::perspective(m_fovy, aspect, kFrustumNear, kFrustumFar, m_projection);
 }
 
+void Scene::updateSkins()
+{
+    // Split vertices of all models into chunks to run skinning in one parallel loop
+    const int nmodels = m_models.count();
+    m_skinningRanges.clear();
+    for (int i = 0; i < nmodels; i++) {
+        PMDModel *model = m_models[i];
+        const int nvertices = model->vertices().count();
+        for (int j = 0; j < nvertices; j += PMDModel::kSkinningChunkSize) {
+            SkinningRange range;
+            range.model = model;
+            range.from = j;
+            range.to = btMin(j + PMDModel::kSkinningChunkSize, nvertices);
+            m_skinningRanges.add(range);
+        }
+    }
+    const int nranges = m_skinningRanges.count();
+#ifdef VPVL_ENABLE_OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif /* VPVL_ENABLE_OPENMP */
+    for (int i = 0; i < nranges; i++) {
+        const SkinningRange &range = m_skinningRanges[i];
+        range.model->updateSkins(range.from, range.to);
+    }
+}
+
 void Scene::updateRotationFromAngle()
 {
     static const Vector3 x(1.0f, 0.0f, 0.0f), y(0.0f, 1.0f, 0.0f), z(0.0f, 0.0f, 1.0f);
@@ -0,0 +1,1026 @@
+/* ----------------------------------------------------------------- */
+/*                                                                   */
+/*  Copyright (c) 2010-2012  hkrn                                    */
+/*                                                                   */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/* - Redistributions of source code must retain the above copyright  */
+/*   notice, this list of conditions and the following disclaimer.   */
+/* - Redistributions in binary form must reproduce the above         */
+/*   copyright notice, this list of conditions and the following     */
+/*   disclaimer in the documentation and/or other materials provided */
+/*   with the distribution.                                          */
+/* - Neither the name of the MMDAI project team nor the names of     */
+/*   its contributors may be used to endorse or promote products     */
+/*   derived from this software without specific prior written       */
+/*   permission.                                                     */
+/*                                                                   */
+/* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND            */
+/* CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,       */
+/* INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF          */
+/* MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE          */
+/* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS */
+/* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,          */
+/* EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED   */
+/* TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,     */
+/* DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON */
+/* ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,   */
+/* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY    */
+/* OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE           */
+/* POSSIBILITY OF SUCH DAMAGE.                                       */
+/* ----------------------------------------------------------------- */
+
+/* libvpvl2 */
+#include <vpvl2/vpvl2.h>
+#include "vpvl2/extensions/Encoding.h"
+#include "vpvl2/pmx/Bone.h"
+#include "vpvl2/pmx/Model.h"
+#include "vpvl2/pmx/Morph.h"
+#include "vpvl2/mvd/BoneKeyframe.h"
+#include "vpvl2/mvd/MorphKeyframe.h"
+#include "vpvl2/mvd/Motion.h"
+#include "vpvl2/vmd/BoneKeyframe.h"
+#include "vpvl2/vmd/MorphKeyframe.h"
+#include "vpvl2/vmd/Motion.h"
+
+/* Bullet Physics */
+#ifndef VPVL2_NO_BULLET
+#include <btBulletDynamicsCommon.h>
+#endif
+
+/* high resolution timer */
+#if defined(_WIN32)
+#include <windows.h>
+#elif defined(__APPLE__)
+#include <mach/mach_time.h>
+#else
+#include <time.h>
+#endif
+
+/* STL */
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+namespace {
+
+using namespace vpvl2;
+
+typedef std::vector<uint8_t> Bytes;
+
+static double UIGetTimeInMicroseconds()
+{
+#if defined(_WIN32)
+    LARGE_INTEGER frequency, counter;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&counter);
+    return double(counter.QuadPart) * 1000000.0 / double(frequency.QuadPart);
+#elif defined(__APPLE__)
+    static mach_timebase_info_data_t info;
+    if (info.denom == 0)
+        mach_timebase_info(&info);
+    return double(mach_absolute_time()) * info.numer / info.denom / 1000.0;
+#else
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000.0 + ts.tv_nsec / 1000.0;
+#endif
+}
+
+static std::string UIFormatName(const char *prefix, int index)
+{
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), "%s%d", prefix, index);
+    return buffer;
+}
+
+/* fixture の規模。頂点数、ボーン数、モーフ数及びモーションの長さを同時に変える */
+struct Scale {
+    const char *name;
+    int nvertices;
+    int nchains;
+    int nchainBones;
+    int nmaterials;
+    int nmorphs;
+    int nframes;
+    int keyframeInterval;
+};
+
+static const Scale kScales[] = {
+    { "small",    2048,  8, 4,  4,  16,  300, 10 },
+    { "medium",  16384, 16, 8, 16,  64, 1800,  5 },
+    { "large",  131072, 32, 8, 64, 256, 9000,  3 }
+};
+static const int kNumScales = sizeof(kScales) / sizeof(kScales[0]);
+
+class ByteWriter {
+public:
+    ByteWriter(Bytes &bytes)
+        : m_bytes(bytes)
+    {
+    }
+
+    void write(const void *data, size_t size) {
+        const uint8_t *ptr = static_cast<const uint8_t *>(data);
+        m_bytes.insert(m_bytes.end(), ptr, ptr + size);
+    }
+    void writeU8(uint8_t value) {
+        write(&value, sizeof(value));
+    }
+    void writeU16(uint16_t value) {
+        write(&value, sizeof(value));
+    }
+    void writeI32(int32_t value) {
+        write(&value, sizeof(value));
+    }
+    void writeFloat(float value) {
+        write(&value, sizeof(value));
+    }
+    void writeVector3(float x, float y, float z) {
+        writeFloat(x);
+        writeFloat(y);
+        writeFloat(z);
+    }
+    void writeVector4(float x, float y, float z, float w) {
+        writeVector3(x, y, z);
+        writeFloat(w);
+    }
+    void writeText(const std::string &value) {
+        writeI32(int32_t(value.size()));
+        write(value.c_str(), value.size());
+    }
+    void writeText(const IString *value) {
+        writeI32(int32_t(value->length()));
+        write(value->toByteArray(), value->length());
+    }
+
+private:
+    Bytes &m_bytes;
+};
+
+/*
+ * 合成した PMX 2.0 のモデルを生成する。
+ *
+ * センターボーンから nchains 本のボーンの鎖を吊り下げ、頂点は鎖を列とする格子状に並べる。
+ * 頂点の変形方式は BDEF1/BDEF2/BDEF4/SDEF を混在させ、鎖毎に剛体とジョイントを持たせる。
+ * withIK が真の場合は鎖の末端を目標とする IK ボーンを鎖毎に追加する。
+ */
+static void UIGenerateModel(const Scale &scale, bool withIK, const IEncoding *encoding, Bytes &bytes)
+{
+    const int nchains = scale.nchains, nchainBones = scale.nchainBones;
+    const int nrows = scale.nvertices / nchains, nvertices = nrows * nchains;
+    const int nChainedBones = nchains * nchainBones, nbones = 1 + nChainedBones + (withIK ? nchains : 0);
+    const float kHeight = 10.0f, kLength = 8.0f;
+    ByteWriter writer(bytes);
+    /* header */
+    writer.write("PMX ", 4);
+    writer.writeFloat(2.0f);
+    writer.writeU8(8);
+    writer.writeU8(1); /* UTF-8 */
+    writer.writeU8(0); /* additional UV */
+    writer.writeU8(4); /* vertex index */
+    writer.writeU8(4); /* texture index */
+    writer.writeU8(4); /* material index */
+    writer.writeU8(4); /* bone index */
+    writer.writeU8(4); /* morph index */
+    writer.writeU8(4); /* rigid body index */
+    writer.writeText(withIK ? "benchmark_ik" : "benchmark");
+    writer.writeText(withIK ? "benchmark_ik" : "benchmark");
+    writer.writeText(scale.name);
+    writer.writeText(scale.name);
+    /* vertices */
+    writer.writeI32(nvertices);
+    for (int i = 0; i < nvertices; i++) {
+        const int row = i / nchains, chain = i % nchains;
+        const int link = btMin(row * nchainBones / nrows, nchainBones - 1);
+        const int bone = 1 + chain * nchainBones + link;
+        const int nextBone = link + 1 < nchainBones ? bone + 1 : bone;
+        const int parentBone = link > 0 ? bone - 1 : 0;
+        const float x = chain - (nchains - 1) * 0.5f, y = kHeight - kLength * row / nrows;
+        writer.writeVector3(x, y, (row % 4) * 0.1f);
+        writer.writeVector3(0, 0, -1);
+        writer.writeFloat(float(chain) / nchains);
+        writer.writeFloat(float(row) / nrows);
+        switch (i % 8) {
+        case 4:
+        case 5: /* BDEF4 */
+            writer.writeU8(2);
+            writer.writeI32(bone);
+            writer.writeI32(nextBone);
+            writer.writeI32(parentBone);
+            writer.writeI32(0);
+            writer.writeVector4(0.4f, 0.3f, 0.2f, 0.1f);
+            break;
+        case 6: /* BDEF1 */
+            writer.writeU8(0);
+            writer.writeI32(bone);
+            break;
+        case 7: /* SDEF */
+            writer.writeU8(3);
+            writer.writeI32(bone);
+            writer.writeI32(nextBone);
+            writer.writeFloat(0.5f);
+            writer.writeVector3(x, y, 0);
+            writer.writeVector3(x, y + 0.1f, 0);
+            writer.writeVector3(x, y - 0.1f, 0);
+            break;
+        default: /* BDEF2 */
+            writer.writeU8(1);
+            writer.writeI32(bone);
+            writer.writeI32(nextBone);
+            writer.writeFloat(float(row % 5) / 4);
+            break;
+        }
+        writer.writeFloat(1.0f); /* edge size */
+    }
+    /* indices */
+    const int ntriangles = 2 * (nrows - 1) * (nchains - 1);
+    writer.writeI32(ntriangles * 3);
+    for (int row = 0; row < nrows - 1; row++) {
+        for (int chain = 0; chain < nchains - 1; chain++) {
+            const int i = row * nchains + chain;
+            writer.writeI32(i);
+            writer.writeI32(i + 1);
+            writer.writeI32(i + nchains);
+            writer.writeI32(i + 1);
+            writer.writeI32(i + nchains + 1);
+            writer.writeI32(i + nchains);
+        }
+    }
+    /* textures */
+    writer.writeI32(0);
+    /* materials */
+    const int nmaterials = scale.nmaterials;
+    writer.writeI32(nmaterials);
+    for (int i = 0; i < nmaterials; i++) {
+        const int from = i * ntriangles / nmaterials, to = (i + 1) * ntriangles / nmaterials;
+        const std::string &name = UIFormatName("material", i);
+        writer.writeText(name);
+        writer.writeText(name);
+        writer.writeVector4(0.8f, 0.8f, 0.8f, 1.0f); /* diffuse */
+        writer.writeVector3(0.1f, 0.1f, 0.1f); /* specular */
+        writer.writeFloat(5.0f); /* shininess */
+        writer.writeVector3(0.4f, 0.4f, 0.4f); /* ambient */
+        writer.writeU8(0x1e); /* ground shadow, self shadow and edge */
+        writer.writeVector4(0, 0, 0, 1); /* edge color */
+        writer.writeFloat(1.0f); /* edge size */
+        writer.writeI32(-1); /* main texture */
+        writer.writeI32(-1); /* sphere texture */
+        writer.writeU8(0); /* sphere render mode */
+        writer.writeU8(1); /* shared toon texture */
+        writer.writeU8(0);
+        writer.writeText("");
+        writer.writeI32((to - from) * 3);
+    }
+    /* bones */
+    writer.writeI32(nbones);
+    writer.writeText(encoding->stringConstant(IEncoding::kCenter));
+    writer.writeText("center");
+    writer.writeVector3(0, kHeight, 0);
+    writer.writeI32(-1);
+    writer.writeI32(0);
+    writer.writeU16(0x001e); /* rotateable, movable, visible and operatable */
+    writer.writeVector3(0, -1, 0);
+    for (int i = 0; i < nChainedBones; i++) {
+        const int chain = i / nchainBones, link = i % nchainBones, bone = 1 + i;
+        const float x = chain - (nchains - 1) * 0.5f, y = kHeight - kLength * link / nchainBones;
+        const bool hasDestination = link + 1 < nchainBones;
+        const std::string &name = UIFormatName("bone", i);
+        writer.writeText(name);
+        writer.writeText(name);
+        writer.writeVector3(x, y, 0);
+        writer.writeI32(link > 0 ? bone - 1 : 0);
+        writer.writeI32(0);
+        writer.writeU16(0x001a | (hasDestination ? 0x0001 : 0));
+        if (hasDestination)
+            writer.writeI32(bone + 1);
+        else
+            writer.writeVector3(0, -1, 0);
+    }
+    for (int i = 0; withIK && i < nchains; i++) {
+        const int effector = (i + 1) * nchainBones, nlinks = btMin(3, nchainBones - 1);
+        const float x = i - (nchains - 1) * 0.5f, y = kHeight - kLength * (nchainBones - 1) / nchainBones;
+        const std::string &name = UIFormatName("ik", i);
+        writer.writeText(name);
+        writer.writeText(name);
+        writer.writeVector3(x, y, 0);
+        writer.writeI32(0);
+        writer.writeI32(0);
+        writer.writeU16(0x003e); /* rotateable, movable, visible, operatable and IK */
+        writer.writeVector3(0, -1, 0);
+        writer.writeI32(effector);
+        writer.writeI32(40); /* loop count */
+        writer.writeFloat(0.5f); /* angle constraint per loop */
+        writer.writeI32(nlinks);
+        for (int j = 0; j < nlinks; j++) {
+            /* 膝のように最初のリンクの回転を X 軸の負の方向にのみ制限する */
+            writer.writeI32(effector - 1 - j);
+            writer.writeU8(j == 0 ? 1 : 0);
+            if (j == 0) {
+                writer.writeVector3(-float(SIMD_PI), 0, 0);
+                writer.writeVector3(-0.0087f, 0, 0);
+            }
+        }
+    }
+    /* morphs */
+    const int nmorphs = scale.nmorphs, nMaterialMorphs = btMax(1, nmaterials / 4);
+    const int span = btMax(1, nvertices / 16);
+    writer.writeI32(nmorphs + nMaterialMorphs + 1);
+    for (int i = 0; i < nmorphs; i++) {
+        const int from = int(int64_t(i) * nvertices / nmorphs);
+        const std::string &name = UIFormatName("morph", i);
+        writer.writeText(name);
+        writer.writeText(name);
+        writer.writeU8(uint8_t(i % 4 + 1));
+        writer.writeU8(1); /* vertex */
+        writer.writeI32(span);
+        for (int j = 0; j < span; j++) {
+            writer.writeI32((from + j) % nvertices);
+            writer.writeVector3(0, 0.01f * (j % 7), 0.005f);
+        }
+    }
+    for (int i = 0; i < nMaterialMorphs; i++) {
+        const std::string &name = UIFormatName("material_morph", i);
+        writer.writeText(name);
+        writer.writeText(name);
+        writer.writeU8(4);
+        writer.writeU8(8); /* material */
+        writer.writeI32(1);
+        writer.writeI32(i * nmaterials / nMaterialMorphs);
+        writer.writeU8(uint8_t(i % 2)); /* modulate or add */
+        writer.writeVector4(0.5f, 0.5f, 0.5f, 0.5f); /* diffuse */
+        writer.writeVector3(0.5f, 0.5f, 0.5f); /* specular */
+        writer.writeFloat(0.5f); /* shininess */
+        writer.writeVector3(0.5f, 0.5f, 0.5f); /* ambient */
+        writer.writeVector4(0.5f, 0.5f, 0.5f, 0.5f); /* edge color */
+        writer.writeFloat(0.5f); /* edge size */
+        writer.writeVector4(1, 1, 1, 1); /* texture */
+        writer.writeVector4(1, 1, 1, 1); /* sphere texture */
+        writer.writeVector4(1, 1, 1, 1); /* toon texture */
+    }
+    const int nGroupedMorphs = btMin(4, nmorphs);
+    writer.writeText("group");
+    writer.writeText("group");
+    writer.writeU8(4);
+    writer.writeU8(0); /* group */
+    writer.writeI32(nGroupedMorphs + 1);
+    for (int i = 0; i < nGroupedMorphs; i++) {
+        writer.writeI32(i);
+        writer.writeFloat(0.5f);
+    }
+    writer.writeI32(nmorphs);
+    writer.writeFloat(1.0f);
+    /* labels */
+    writer.writeI32(2);
+    writer.writeText("Root");
+    writer.writeText("Root");
+    writer.writeU8(1);
+    writer.writeI32(1);
+    writer.writeU8(0);
+    writer.writeI32(0);
+    writer.writeText("Exp");
+    writer.writeText("Exp");
+    writer.writeU8(1);
+    writer.writeI32(nmorphs);
+    for (int i = 0; i < nmorphs; i++) {
+        writer.writeU8(1);
+        writer.writeI32(i);
+    }
+    /* rigid bodies */
+    writer.writeI32(nChainedBones);
+    for (int i = 0; i < nChainedBones; i++) {
+        const int chain = i / nchainBones, link = i % nchainBones;
+        const float x = chain - (nchains - 1) * 0.5f, y = kHeight - kLength * link / nchainBones;
+        const std::string &name = UIFormatName("body", i);
+        writer.writeText(name);
+        writer.writeText(name);
+        writer.writeI32(1 + i);
+        writer.writeU8(uint8_t(chain % 16));
+        writer.writeU16(0xffff);
+        writer.writeU8(0); /* sphere */
+        writer.writeVector3(0.3f, 0, 0);
+        writer.writeVector3(x, y, 0);
+        writer.writeVector3(0, 0, 0);
+        writer.writeFloat(1.0f); /* mass */
+        writer.writeFloat(0.5f); /* linear damping */
+        writer.writeFloat(0.5f); /* angular damping */
+        writer.writeFloat(0.0f); /* restitution */
+        writer.writeFloat(0.5f); /* friction */
+        writer.writeU8(link == 0 ? 0 : 1); /* follows the bone or simulated */
+    }
+    /* joints */
+    writer.writeI32(nchains * (nchainBones - 1));
+    for (int i = 0; i < nChainedBones; i++) {
+        const int chain = i / nchainBones, link = i % nchainBones;
+        if (link == 0)
+            continue;
+        const float x = chain - (nchains - 1) * 0.5f, y = kHeight - kLength * link / nchainBones;
+        const std::string &name = UIFormatName("joint", i);
+        writer.writeText(name);
+        writer.writeText(name);
+        writer.writeU8(0); /* spring 6DOF */
+        writer.writeI32(i - 1);
+        writer.writeI32(i);
+        writer.writeVector3(x, y, 0);
+        writer.writeVector3(0, 0, 0);
+        writer.writeVector3(0, 0, 0);
+        writer.writeVector3(0, 0, 0);
+        writer.writeVector3(-0.5f, -0.5f, -0.5f);
+        writer.writeVector3(0.5f, 0.5f, 0.5f);
+        writer.writeVector3(0, 0, 0);
+        writer.writeVector3(0, 0, 0);
+    }
+}
+
+/* 全てのボーン (IK ボーンは位置のみ) とモーフにキーフレームを keyframeInterval 毎に打つ */
+template<typename BoneKeyframe, typename MorphKeyframe, typename Factory>
+static void UIGenerateKeyframes(const Scale &scale, const pmx::Model *model, IMotion *motion, const Factory &factory)
+{
+    const Array<pmx::Bone *> &bones = model->bones();
+    const Array<pmx::Morph *> &morphs = model->morphs();
+    const int nbones = bones.count(), nmorphs = morphs.count();
+    for (int frame = 0; frame <= scale.nframes; frame += scale.keyframeInterval) {
+        const float phase = frame / 30.0f;
+        for (int i = 0; i < nbones; i++) {
+            const pmx::Bone *bone = bones[i];
+            BoneKeyframe *keyframe = factory.createBoneKeyframe();
+            keyframe->setName(bone->name());
+            keyframe->setTimeIndex(frame);
+            keyframe->setDefaultInterpolationParameter();
+            if (bone->hasInverseKinematics()) {
+                keyframe->setPosition(Vector3(0.5f * btSin(phase + i), 0.5f * btCos(phase), 0));
+                keyframe->setRotation(Quaternion::getIdentity());
+            }
+            else {
+                keyframe->setPosition(i == 0 ? Vector3(btSin(phase), 0, btCos(phase)) : kZeroV3);
+                keyframe->setRotation(Quaternion(btSin(phase + i) * 0.3f, btCos(phase) * 0.2f, 0.1f));
+            }
+            motion->addKeyframe(keyframe);
+        }
+        for (int i = 0; i < nmorphs && frame % (scale.keyframeInterval * 2) == 0; i++) {
+            const pmx::Morph *morph = morphs[i];
+            MorphKeyframe *keyframe = factory.createMorphKeyframe();
+            keyframe->setName(morph->name());
+            keyframe->setTimeIndex(frame);
+            keyframe->setWeight(0.5f + 0.5f * btSin(phase + i));
+            motion->addKeyframe(keyframe);
+        }
+    }
+}
+
+class VMDKeyframeFactory {
+public:
+    VMDKeyframeFactory(IEncoding *encoding) : m_encoding(encoding) {}
+    vmd::BoneKeyframe *createBoneKeyframe() const { return new vmd::BoneKeyframe(m_encoding); }
+    vmd::MorphKeyframe *createMorphKeyframe() const { return new vmd::MorphKeyframe(m_encoding); }
+private:
+    IEncoding *m_encoding;
+};
+
+class MVDKeyframeFactory {
+public:
+    MVDKeyframeFactory(mvd::NameListSection *section) : m_section(section) {}
+    mvd::BoneKeyframe *createBoneKeyframe() const { return new mvd::BoneKeyframe(m_section); }
+    mvd::MorphKeyframe *createMorphKeyframe() const { return new mvd::MorphKeyframe(m_section); }
+private:
+    mvd::NameListSection *m_section;
+};
+
+static void UISaveMotion(const IMotion *motion, Bytes &bytes)
+{
+    bytes.resize(motion->estimateSize());
+    motion->save(&bytes[0]);
+}
+
+static bool UIWriteFile(const std::string &path, const Bytes &bytes)
+{
+    FILE *fp = ::fopen(path.c_str(), "wb");
+    if (!fp)
+        return false;
+    bool ret = ::fwrite(&bytes[0], bytes.size(), 1, fp) == 1;
+    ::fclose(fp);
+    return ret;
+}
+
+#ifndef VPVL2_NO_BULLET
+class World {
+public:
+    World()
+        : m_dispatcher(&m_config),
+          m_world(&m_dispatcher, &m_broadphase, &m_solver, &m_config)
+    {
+        m_world.setGravity(btVector3(0.0f, -9.8f, 0.0f));
+    }
+    ~World() {
+    }
+
+    btDiscreteDynamicsWorld *get() { return &m_world; }
+    void stepSimulation() {
+        const Scalar &timeStep = 1.0f / Scene::defaultFPS();
+        m_world.stepSimulation(timeStep, 1, timeStep);
+    }
+
+private:
+    btDefaultCollisionConfiguration m_config;
+    btCollisionDispatcher m_dispatcher;
+    btDbvtBroadphase m_broadphase;
+    btSequentialImpulseConstraintSolver m_solver;
+    btDiscreteDynamicsWorld m_world;
+
+    VPVL2_DISABLE_COPY_AND_ASSIGN(World)
+};
+#endif
+
+/*
+ * 1つの規模のデータ一式。モデルとモーションは一度バイト列に書き出してから読み込み直すため、
+ * 読み込み及び保存の計測と、それ以外の計測が同じデータを扱う
+ */
+class Fixture {
+public:
+    Fixture(const Scale &scale, IEncoding *encoding)
+        : m_scale(scale),
+          m_encoding(encoding),
+          m_model(new pmx::Model(encoding)),
+          m_IKModel(new pmx::Model(encoding)),
+          m_vmd(0),
+          m_IKVmd(0),
+          m_mvd(0)
+    {
+        UIGenerateModel(scale, false, encoding, m_modelBytes);
+        UIGenerateModel(scale, true, encoding, m_IKModelBytes);
+        m_valid = m_model->load(&m_modelBytes[0], m_modelBytes.size())
+                && m_IKModel->load(&m_IKModelBytes[0], m_IKModelBytes.size());
+        if (!m_valid)
+            return;
+        /* IK ボーンを含むモデルを基準にキーフレームを打つ (IK を持たないモデルでは該当するボーンが無視される) */
+        vmd::Motion vmdSource(m_IKModel, encoding);
+        UIGenerateKeyframes<vmd::BoneKeyframe, vmd::MorphKeyframe>(scale, m_IKModel, &vmdSource, VMDKeyframeFactory(encoding));
+        UISaveMotion(&vmdSource, m_vmdBytes);
+        mvd::Motion mvdSource(m_IKModel, encoding);
+        UIGenerateKeyframes<mvd::BoneKeyframe, mvd::MorphKeyframe>(scale, m_IKModel, &mvdSource, MVDKeyframeFactory(mvdSource.nameListSection()));
+        UISaveMotion(&mvdSource, m_mvdBytes);
+        m_vmd = new vmd::Motion(m_model, encoding);
+        m_IKVmd = new vmd::Motion(m_IKModel, encoding);
+        m_mvd = new mvd::Motion(m_model, encoding);
+        m_valid = m_vmd->load(&m_vmdBytes[0], m_vmdBytes.size())
+                && m_IKVmd->load(&m_vmdBytes[0], m_vmdBytes.size())
+                && m_mvd->load(&m_mvdBytes[0], m_mvdBytes.size());
+    }
+    ~Fixture() {
+        delete m_vmd;
+        m_vmd = 0;
+        delete m_IKVmd;
+        m_IKVmd = 0;
+        delete m_mvd;
+        m_mvd = 0;
+        delete m_model;
+        m_model = 0;
+        delete m_IKModel;
+        m_IKModel = 0;
+    }
+
+    bool writeFiles(const std::string &dir) const {
+        const std::string &prefix = dir + "/" + m_scale.name;
+        return UIWriteFile(prefix + ".pmx", m_modelBytes)
+                && UIWriteFile(prefix + "_ik.pmx", m_IKModelBytes)
+                && UIWriteFile(prefix + ".vmd", m_vmdBytes)
+                && UIWriteFile(prefix + ".mvd", m_mvdBytes);
+    }
+
+    const Scale &scale() const { return m_scale; }
+    IEncoding *encoding() const { return m_encoding; }
+    const Bytes &modelBytes() const { return m_modelBytes; }
+    const Bytes &vmdBytes() const { return m_vmdBytes; }
+    const Bytes &mvdBytes() const { return m_mvdBytes; }
+    pmx::Model *model() const { return m_model; }
+    pmx::Model *IKModel() const { return m_IKModel; }
+    vmd::Motion *vmd() const { return m_vmd; }
+    vmd::Motion *IKVmd() const { return m_IKVmd; }
+    mvd::Motion *mvd() const { return m_mvd; }
+    bool isValid() const { return m_valid; }
+
+private:
+    const Scale &m_scale;
+    IEncoding *m_encoding;
+    Bytes m_modelBytes;
+    Bytes m_IKModelBytes;
+    Bytes m_vmdBytes;
+    Bytes m_mvdBytes;
+    pmx::Model *m_model;
+    pmx::Model *m_IKModel;
+    vmd::Motion *m_vmd;
+    vmd::Motion *m_IKVmd;
+    mvd::Motion *m_mvd;
+    bool m_valid;
+
+    VPVL2_DISABLE_COPY_AND_ASSIGN(Fixture)
+};
+
+struct Result;
+
+/*
+ * 計測対象の処理。prepare は計測の前に一度だけ呼ばれ、run は1回分の処理を行う。
+ * annotate は計測の後に呼ばれ、処理時間以外の値を結果に追加する
+ */
+class Case {
+public:
+    Case(Fixture &fixture) : m_fixture(fixture) {}
+    virtual ~Case() {}
+
+    virtual void prepare() {}
+    virtual void run(int iteration) = 0;
+    virtual int countItems() const = 0;
+    virtual void annotate(Result & /* result */) const {}
+
+protected:
+    Fixture &m_fixture;
+};
+
+class LoadModelCase : public Case {
+public:
+    LoadModelCase(Fixture &fixture) : Case(fixture) {}
+    void run(int /* iteration */) {
+        const Bytes &bytes = m_fixture.modelBytes();
+        pmx::Model model(m_fixture.encoding());
+        model.load(&bytes[0], bytes.size());
+    }
+    int countItems() const { return m_fixture.model()->vertices().count(); }
+};
+
+class SaveModelCase : public Case {
+public:
+    SaveModelCase(Fixture &fixture) : Case(fixture) {}
+    void run(int /* iteration */) {
+        const pmx::Model *model = m_fixture.model();
+        m_bytes.resize(model->estimateSize());
+        model->save(&m_bytes[0]);
+    }
+    int countItems() const { return m_fixture.model()->vertices().count(); }
+private:
+    Bytes m_bytes;
+};
+
+template<typename Motion>
+class LoadMotionCase : public Case {
+public:
+    LoadMotionCase(Fixture &fixture, const Bytes &bytes, const IMotion *motion)
+        : Case(fixture),
+          m_bytes(bytes),
+          m_motion(motion)
+    {
+    }
+    void run(int /* iteration */) {
+        Motion motion(m_fixture.model(), m_fixture.encoding());
+        motion.load(&m_bytes[0], m_bytes.size());
+    }
+    int countItems() const { return m_motion->countKeyframes(IKeyframe::kBone) + m_motion->countKeyframes(IKeyframe::kMorph); }
+private:
+    const Bytes &m_bytes;
+    const IMotion *m_motion;
+};
+
+class SaveMotionCase : public Case {
+public:
+    SaveMotionCase(Fixture &fixture, const IMotion *motion) : Case(fixture), m_motion(motion) {}
+    void run(int /* iteration */) {
+        m_bytes.resize(m_motion->estimateSize());
+        m_motion->save(&m_bytes[0]);
+    }
+    int countItems() const { return m_motion->countKeyframes(IKeyframe::kBone) + m_motion->countKeyframes(IKeyframe::kMorph); }
+private:
+    const IMotion *m_motion;
+    Bytes m_bytes;
+};
+
+/* 毎回異なるフレームを参照するように 7 フレームずつ進めながらシークする */
+class SeekMotionCase : public Case {
+public:
+    SeekMotionCase(Fixture &fixture, IMotion *motion) : Case(fixture), m_motion(motion) {}
+    void run(int iteration) {
+        m_motion->seek(IKeyframe::TimeIndex((iteration * 7) % (m_fixture.scale().nframes + 1)));
+    }
+    int countItems() const { return m_motion->countKeyframes(IKeyframe::kBone) + m_motion->countKeyframes(IKeyframe::kMorph); }
+private:
+    IMotion *m_motion;
+};
+
+class MorphCase : public Case {
+public:
+    MorphCase(Fixture &fixture) : Case(fixture) {}
+    void run(int iteration) {
+        pmx::Model *model = m_fixture.model();
+        const Array<pmx::Morph *> &morphs = model->morphs();
+        const int nmorphs = morphs.count();
+        model->resetVertices();
+        for (int i = 0; i < nmorphs; i++)
+            morphs[i]->setWeight(0.5f + 0.5f * btSin(iteration * 0.1f + i));
+    }
+    int countItems() const { return m_fixture.model()->morphs().count(); }
+};
+
+class UpdateBonesCase : public Case {
+public:
+    UpdateBonesCase(Fixture &fixture, pmx::Model *model, IMotion *motion)
+        : Case(fixture),
+          m_model(model),
+          m_motion(motion)
+    {
+    }
+    void prepare() {
+        m_motion->seek(m_fixture.scale().nframes / 2);
+    }
+    void run(int /* iteration */) {
+        m_model->performUpdateBones();
+    }
+    int countItems() const { return m_model->bones().count(); }
+private:
+    pmx::Model *m_model;
+    IMotion *m_motion;
+};
+
+class SkinningCase : public Case {
+public:
+    SkinningCase(Fixture &fixture) : Case(fixture) {}
+    void prepare() {
+        pmx::Model *model = m_fixture.model();
+        m_fixture.vmd()->seek(m_fixture.scale().nframes / 2);
+        model->performUpdateBones();
+        m_edgeScaleFactor = model->edgeScaleFactor(Vector3(0, 10, -50));
+    }
+    void run(int /* iteration */) {
+        pmx::Model *model = m_fixture.model();
+        model->performSkinning(0, model->vertices().count(), m_edgeScaleFactor, Vector3(-0.5f, -1.0f, -0.5f));
+    }
+    int countItems() const { return m_fixture.model()->vertices().count(); }
+private:
+    Scalar m_edgeScaleFactor;
+};
+
+/* 最初の並べ替えの前後で頂点キャッシュ (32 要素の FIFO) の ACMR を記録する */
+class OptimizeIndicesCase : public Case {
+public:
+    static const int kCacheSize = 32;
+    OptimizeIndicesCase(Fixture &fixture)
+        : Case(fixture),
+          m_model(fixture.encoding()),
+          m_acmrBefore(0)
+    {
+    }
+    void prepare() {
+        const Bytes &bytes = m_fixture.modelBytes();
+        m_model.load(&bytes[0], bytes.size());
+        m_acmrBefore = m_model.averageCacheMissRatio(kCacheSize);
+    }
+    void run(int /* iteration */) {
+        m_model.optimizeIndices();
+    }
+    int countItems() const { return m_model.indices().count() / 3; }
+    void annotate(Result &result) const;
+private:
+    pmx::Model m_model;
+    Scalar m_acmrBefore;
+};
+
+#ifndef VPVL2_NO_BULLET
+class PhysicsCase : public Case {
+public:
+    PhysicsCase(Fixture &fixture) : Case(fixture) {}
+    ~PhysicsCase() {
+        m_fixture.model()->leaveWorld(m_world.get());
+    }
+    void prepare() {
+        m_fixture.model()->joinWorld(m_world.get());
+    }
+    void run(int iteration) {
+        m_fixture.vmd()->seek(IKeyframe::TimeIndex(iteration % (m_fixture.scale().nframes + 1)));
+        m_world.stepSimulation();
+        m_fixture.model()->performUpdateBones();
+    }
+    int countItems() const { return m_fixture.model()->rigidBodies().count(); }
+private:
+    World m_world;
+};
+#endif
+
+struct Options {
+    Options()
+        : scale(0),
+          filter(0),
+          output(0),
+          fixtureDir(0),
+          minTime(0.5),
+          iterations(0),
+          csv(false)
+    {
+    }
+    const char *scale;
+    const char *filter;
+    const char *output;
+    const char *fixtureDir;
+    double minTime;
+    int iterations;
+    bool csv;
+};
+
+struct Result {
+    std::string name;
+    std::string scale;
+    int iterations;
+    int items;
+    double min;
+    double median;
+    double mean;
+    double max;
+    double acmrBefore;
+    double acmrAfter;
+};
+
+void OptimizeIndicesCase::annotate(Result &result) const
+{
+    result.acmrBefore = m_acmrBefore;
+    result.acmrAfter = m_model.averageCacheMissRatio(kCacheSize);
+}
+
+/*
+ * 1回分の処理時間をマイクロ秒単位で計測する。反復回数の指定が無い場合は合計時間が
+ * minTime 秒を超えるまで (最低3回) 繰り返す。最初の1回は計測に含めない
+ */
+static Result UIMeasure(const char *name, const Scale &scale, Case &c, const Options &options)
+{
+    std::vector<double> samples;
+    double total = 0;
+    c.prepare();
+    c.run(0);
+    for (int i = 1; ; i++) {
+        const double start = UIGetTimeInMicroseconds();
+        c.run(i);
+        const double elapsed = UIGetTimeInMicroseconds() - start;
+        samples.push_back(elapsed);
+        total += elapsed;
+        if (options.iterations > 0 ? i >= options.iterations : (i >= 3 && total >= options.minTime * 1000000.0))
+            break;
+    }
+    std::sort(samples.begin(), samples.end());
+    const size_t nsamples = samples.size();
+    Result result;
+    result.name = name;
+    result.scale = scale.name;
+    result.iterations = int(nsamples);
+    result.items = c.countItems();
+    result.min = samples.front();
+    result.max = samples.back();
+    result.median = nsamples % 2 == 1 ? samples[nsamples / 2] : (samples[nsamples / 2 - 1] + samples[nsamples / 2]) / 2;
+    result.mean = total / nsamples;
+    result.acmrBefore = result.acmrAfter = -1;
+    c.annotate(result);
+    return result;
+}
+
+static void UIRun(const char *name, Case *c, Fixture &fixture, const Options &options, std::vector<Result> &results)
+{
+    if (!options.filter || strstr(name, options.filter)) {
+        results.push_back(UIMeasure(name, fixture.scale(), *c, options));
+        const Result &r = results.back();
+        fprintf(stderr, "%-12s %-8s %8d iterations %12.2f us (median)\n", name, r.scale.c_str(), r.iterations, r.median);
+    }
+    delete c;
+}
+
+static void UIPrintResults(FILE *fp, const std::vector<Result> &results, bool csv)
+{
+    const size_t nresults = results.size();
+    if (csv) {
+        fprintf(fp, "name,scale,iterations,items,min_us,median_us,mean_us,max_us,acmr_before,acmr_after\n");
+        for (size_t i = 0; i < nresults; i++) {
+            const Result &r = results[i];
+            fprintf(fp, "%s,%s,%d,%d,%.3f,%.3f,%.3f,%.3f,",
+                    r.name.c_str(), r.scale.c_str(), r.iterations, r.items, r.min, r.median, r.mean, r.max);
+            if (r.acmrBefore >= 0)
+                fprintf(fp, "%.3f,%.3f\n", r.acmrBefore, r.acmrAfter);
+            else
+                fprintf(fp, ",\n");
+        }
+    }
+    else {
+        fprintf(fp, "{\n  \"version\": 1,\n  \"unit\": \"us\",\n  \"physics\": %s,\n  \"results\": [",
+#ifndef VPVL2_NO_BULLET
+                "true"
+#else
+                "false"
+#endif
+                );
+        for (size_t i = 0; i < nresults; i++) {
+            const Result &r = results[i];
+            fprintf(fp, "%s\n    { \"name\": \"%s\", \"scale\": \"%s\", \"iterations\": %d, \"items\": %d, "
+                    "\"min\": %.3f, \"median\": %.3f, \"mean\": %.3f, \"max\": %.3f",
+                    i > 0 ? "," : "", r.name.c_str(), r.scale.c_str(), r.iterations, r.items, r.min, r.median, r.mean, r.max);
+            /* ACMR は索引の並べ替えの計測のみが持つ */
+            if (r.acmrBefore >= 0)
+                fprintf(fp, ", \"acmr_before\": %.3f, \"acmr_after\": %.3f", r.acmrBefore, r.acmrAfter);
+            fprintf(fp, " }");
+        }
+        fprintf(fp, "\n  ]\n}\n");
+    }
+}
+
+static void UIPrintUsage(const char *program)
+{
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  --scale small|medium|large  run only the given scale (default is all)\n"
+            "  --filter NAME               run only benchmarks whose name contains NAME\n"
+            "  --iterations N              measure exactly N iterations per benchmark\n"
+            "  --min-time SECONDS          measure at least SECONDS per benchmark (default is 0.5)\n"
+            "  --output PATH               write results to PATH instead of stdout\n"
+            "  --csv                       write results as CSV instead of JSON\n"
+            "  --write-fixtures DIR        write generated PMX/VMD/MVD fixtures to DIR\n",
+            program);
+}
+
+static bool UIParseOptions(int argc, char *argv[], Options &options)
+{
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i], *value = i + 1 < argc ? argv[i + 1] : 0;
+        if (strcmp(arg, "--csv") == 0) {
+            options.csv = true;
+            continue;
+        }
+        if (!value)
+            return false;
+        if (strcmp(arg, "--scale") == 0)
+            options.scale = value;
+        else if (strcmp(arg, "--filter") == 0)
+            options.filter = value;
+        else if (strcmp(arg, "--iterations") == 0)
+            options.iterations = atoi(value);
+        else if (strcmp(arg, "--min-time") == 0)
+            options.minTime = atof(value);
+        else if (strcmp(arg, "--output") == 0)
+            options.output = value;
+        else if (strcmp(arg, "--write-fixtures") == 0)
+            options.fixtureDir = value;
+        else
+            return false;
+        i++;
+    }
+    return true;
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+    Options options;
+    if (!UIParseOptions(argc, argv, options)) {
+        UIPrintUsage(argv[0]);
+        return -1;
+    }
+    extensions::Encoding encoding;
+    std::vector<Result> results;
+    for (int i = 0; i < kNumScales; i++) {
+        const Scale &scale = kScales[i];
+        if (options.scale && strcmp(options.scale, scale.name) != 0)
+            continue;
+        Fixture fixture(scale, &encoding);
+        if (!fixture.isValid()) {
+            fprintf(stderr, "Failed generating the %s fixture\n", scale.name);
+            return -1;
+        }
+        if (options.fixtureDir && !fixture.writeFiles(options.fixtureDir)) {
+            fprintf(stderr, "Failed writing the %s fixture to %s\n", scale.name, options.fixtureDir);
+            return -1;
+        }
+        UIRun("pmx.load", new LoadModelCase(fixture), fixture, options, results);
+        UIRun("pmx.save", new SaveModelCase(fixture), fixture, options, results);
+        UIRun("vmd.load", new LoadMotionCase<vmd::Motion>(fixture, fixture.vmdBytes(), fixture.vmd()), fixture, options, results);
+        UIRun("vmd.save", new SaveMotionCase(fixture, fixture.vmd()), fixture, options, results);
+        UIRun("vmd.seek", new SeekMotionCase(fixture, fixture.vmd()), fixture, options, results);
+        UIRun("mvd.load", new LoadMotionCase<mvd::Motion>(fixture, fixture.mvdBytes(), fixture.mvd()), fixture, options, results);
+        UIRun("mvd.save", new SaveMotionCase(fixture, fixture.mvd()), fixture, options, results);
+        UIRun("mvd.seek", new SeekMotionCase(fixture, fixture.mvd()), fixture, options, results);
+        UIRun("morph", new MorphCase(fixture), fixture, options, results);
+        UIRun("bone", new UpdateBonesCase(fixture, fixture.model(), fixture.vmd()), fixture, options, results);
+        UIRun("ik", new UpdateBonesCase(fixture, fixture.IKModel(), fixture.IKVmd()), fixture, options, results);
+        UIRun("skinning", new SkinningCase(fixture), fixture, options, results);
+        UIRun("pmx.optimize", new OptimizeIndicesCase(fixture), fixture, options, results);
+#ifndef VPVL2_NO_BULLET
+        UIRun("physics", new PhysicsCase(fixture), fixture, options, results);
+#endif
+    }
+    FILE *fp = options.output ? ::fopen(options.output, "w") : stdout;
+    if (!fp) {
+        fprintf(stderr, "Failed opening %s\n", options.output);
+        return -1;
+    }
+    UIPrintResults(fp, results, options.csv);
+    if (fp != stdout)
+        ::fclose(fp);
+    return 0;
+}
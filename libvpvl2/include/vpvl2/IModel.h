@@ -48,6 +48,7 @@ class IBone;
 class ILabel;
 class IMorph;
 class IString;
+class Pose;
 
 /**
  * モデルをあらわすインターフェースです。
@@ -251,6 +252,26 @@ public:
     virtual void getMorphs(Array<IMorph *> &value) const = 0;
     virtual void getLabels(Array<ILabel *> &value) const = 0;
 
+    /**
+     * モデルの全てのボーンの位置と回転量及び全てのモーフの重みを value に保存します。
+     *
+     * @param Pose
+     * @sa restorePose
+     */
+    virtual void savePose(Pose &value) const = 0;
+
+    /**
+     * savePose で保存した姿勢を復元します。
+     *
+     * 現在の値から変化したボーンとモーフのみを書き換え、その数を返します。
+     * 0 を返した場合は変形が不要なため performUpdate を呼ぶ必要はありません。
+     *
+     * @param Pose
+     * @return int
+     * @sa savePose
+     */
+    virtual int restorePose(const Pose &value) = 0;
+
     /**
      * モデルのバウンディングボックスの大きさを取得します。
      *
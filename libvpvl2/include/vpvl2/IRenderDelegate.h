@@ -103,6 +103,7 @@ public:
     struct Texture {
         Texture()
             : async(true),
+              opaque(false),
               width(0),
               height(0),
               object(0)
@@ -110,12 +111,15 @@ public:
         }
         ~Texture() {
             async = true;
+            opaque = false;
             width = 0;
             height = 0;
             object = 0;
         }
 
         bool async;
+        /* テクスチャがアルファを持たない (全ての画素が不透明である) ことが分かっている場合に true を設定する */
+        bool opaque;
         int width;
         int height;
         void *object;
@@ -177,6 +181,20 @@ public:
      */
     virtual void getMatrix(float value[16], const IModel *model, int flags) const = 0;
 
+    /**
+     * 複数の行列をまとめて取得します。
+     *
+     * flags の各要素について getMatrix と同じ行列を求め、values の先頭から 16 要素ずつ
+     * nflags 個分格納します。描画パスで必要な行列を一度に取得するために利用します。
+     *
+     * @param values
+     * @param model
+     * @param flags
+     * @param nflags
+     * @sa getMatrix
+     */
+    virtual void getMatrices(float *values, const IModel *model, const int *flags, int nflags) const = 0;
+
     /**
      * 指定されたフォーマットと可変引数を用いてロギングを行います。
      *
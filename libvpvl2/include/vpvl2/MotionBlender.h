@@ -0,0 +1,142 @@
+/* ----------------------------------------------------------------- */
+/*                                                                   */
+/*  Copyright (c) 2010-2012  hkrn                                    */
+/*                                                                   */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/* - Redistributions of source code must retain the above copyright  */
+/*   notice, this list of conditions and the following disclaimer.   */
+/* - Redistributions in binary form must reproduce the above         */
+/*   copyright notice, this list of conditions and the following     */
+/*   disclaimer in the documentation and/or other materials provided */
+/*   with the distribution.                                          */
+/* - Neither the name of the MMDAI project team nor the names of     */
+/*   its contributors may be used to endorse or promote products     */
+/*   derived from this software without specific prior written       */
+/*   permission.                                                     */
+/*                                                                   */
+/* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND            */
+/* CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,       */
+/* INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF          */
+/* MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE          */
+/* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS */
+/* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,          */
+/* EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED   */
+/* TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,     */
+/* DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON */
+/* ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,   */
+/* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY    */
+/* OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE           */
+/* POSSIBILITY OF SUCH DAMAGE.                                       */
+/* ----------------------------------------------------------------- */
+
+#ifndef VPVL2_MOTIONBLENDER_H_
+#define VPVL2_MOTIONBLENDER_H_
+
+#include "vpvl2/Common.h"
+#include "vpvl2/IKeyframe.h"
+
+namespace vpvl2
+{
+
+class IBone;
+class IModel;
+class IMorph;
+class IMotion;
+
+/**
+ * 複数のモーションをレイヤーとして重ね合わせて一つのモデルに適用するクラスです。
+ *
+ * 各レイヤーのモーションを個別に姿勢のバッファに取り出し、レイヤーの重みとボーン及びモーフ毎の
+ * マスクに従って下のレイヤーから順に合成した後、最後に一度だけボーンとモーフに書き込みます。
+ * レイヤーのモーションは Scene に追加せず、呼び出し側で管理してください (MotionBlender は解放しません)。
+ *
+ */
+class VPVL2_API MotionBlender
+{
+public:
+    enum BlendMode {
+        /** 下のレイヤーの結果を重みに従って置き換える */
+        kOverrideBlend,
+        /** 下のレイヤーの結果に重みを掛けた値を加算する */
+        kAdditiveBlend,
+        kMaxBlendMode
+    };
+
+    MotionBlender(IModel *model);
+    ~MotionBlender();
+
+    /**
+     * モーションをレイヤーとして一番上に追加し、レイヤーの番号を返します。
+     *
+     * マスクの初期値はモーションがキーフレームを持つボーンとモーフが 1 、それ以外が 0 になります。
+     *
+     * @param IMotion
+     * @param BlendMode
+     * @return int
+     */
+    int addLayer(IMotion *motion, BlendMode mode);
+    void removeLayer(int index);
+    void removeAllLayers();
+
+    /**
+     * 全てのレイヤーのモーションを指定された位置に移動して合成します。
+     *
+     * @param timeIndex
+     */
+    void seek(const IKeyframe::TimeIndex &timeIndex);
+    /**
+     * 全てのレイヤーのモーションをそれぞれの位置から進めて合成します。
+     *
+     * fadeLayer で設定したレイヤーの重みの変化もここで進みます。
+     *
+     * @param deltaTimeIndex
+     */
+    void advance(const IKeyframe::TimeIndex &deltaTimeIndex);
+    /**
+     * レイヤーの重みを duration の間に weight まで線形に変化させます。
+     *
+     * duration が 0 の場合は即座に変更します。
+     *
+     * @param int
+     * @param Scalar
+     * @param timeIndex
+     */
+    void fadeLayer(int index, const Scalar &weight, const IKeyframe::TimeIndex &duration);
+
+    void setLayerWeight(int index, const Scalar &value);
+    void setLayerBoneMask(int index, const IBone *bone, const Scalar &value);
+    void setLayerMorphMask(int index, const IMorph *morph, const Scalar &value);
+    void setLayerBlendMode(int index, BlendMode value);
+
+    IModel *model() const { return m_modelRef; }
+    IMotion *layerMotion(int index) const;
+    Scalar layerWeight(int index) const;
+    int countLayers() const { return m_layers.count(); }
+
+private:
+    struct Layer;
+    void sampleLayer(Layer *layer, const IKeyframe::TimeIndex &timeIndex, bool seek);
+    void blendLayers();
+    void resetPose();
+    int findBoneIndex(const IBone *bone) const;
+    int findMorphIndex(const IMorph *morph) const;
+
+    IModel *m_modelRef;
+    Array<IBone *> m_bones;
+    Array<IMorph *> m_morphs;
+    Array<Layer *> m_layers;
+    Array<Vector3> m_positions;
+    Array<Quaternion> m_rotations;
+    Array<Scalar> m_weights;
+
+    VPVL2_DISABLE_COPY_AND_ASSIGN(MotionBlender)
+};
+
+} /* namespace vpvl2 */
+
+#endif
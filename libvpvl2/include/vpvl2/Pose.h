@@ -0,0 +1,152 @@
+/* ----------------------------------------------------------------- */
+/*                                                                   */
+/*  Copyright (c) 2010-2012  hkrn                                    */
+/*                                                                   */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/* - Redistributions of source code must retain the above copyright  */
+/*   notice, this list of conditions and the following disclaimer.   */
+/* - Redistributions in binary form must reproduce the above         */
+/*   copyright notice, this list of conditions and the following     */
+/*   disclaimer in the documentation and/or other materials provided */
+/*   with the distribution.                                          */
+/* - Neither the name of the MMDAI project team nor the names of     */
+/*   its contributors may be used to endorse or promote products     */
+/*   derived from this software without specific prior written       */
+/*   permission.                                                     */
+/*                                                                   */
+/* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND            */
+/* CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,       */
+/* INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF          */
+/* MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE          */
+/* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS */
+/* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,          */
+/* EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED   */
+/* TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,     */
+/* DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON */
+/* ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,   */
+/* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY    */
+/* OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE           */
+/* POSSIBILITY OF SUCH DAMAGE.                                       */
+/* ----------------------------------------------------------------- */
+
+#ifndef VPVL2_POSE_H_
+#define VPVL2_POSE_H_
+
+#include "vpvl2/Common.h"
+#include "vpvl2/IMorph.h"
+
+namespace vpvl2
+{
+
+class IBone;
+
+/**
+ * モデルの姿勢 (ボーンの位置と回転量及びモーフの重み) を平坦な配列で保持するクラスです。
+ *
+ * 要素は IModel::getBones/getMorphs が返す配列の添字で管理され、添字の昇順に並びます。
+ * save 直後は全ての要素を保持しますが、compact または diff によって変化のあった要素のみを
+ * 保持する差分として扱うことができます (取り消し履歴の保存量を抑えるため)。
+ *
+ */
+class VPVL2_API Pose
+{
+public:
+    Pose();
+    ~Pose();
+
+    /**
+     * bones と morphs の現在の値を全て保存します。
+     *
+     * @param bones
+     * @param morphs
+     */
+    void save(const Array<IBone *> &bones, const Array<IMorph *> &morphs);
+
+    /**
+     * 保存されたボーンの値を bones に書き戻します。
+     *
+     * 現在の値と異なるボーンのみ書き込み、書き込んだボーンの数を返します。
+     *
+     * @param bones
+     * @return int
+     */
+    int restoreBones(const Array<IBone *> &bones) const;
+
+    /**
+     * 保存されたモーフの重みのうち現在の値と異なるものがあれば true を返します。
+     *
+     * @param morphs
+     * @return bool
+     */
+    bool hasChangedMorphs(const Array<IMorph *> &morphs) const;
+
+    /**
+     * 保存されたモーフの重みを morphs に書き戻し、重みが変化したモーフの数を返します。
+     *
+     * 頂点モーフは頂点に差分を加算するため、保存されていないモーフも含めて全てのモーフの重みを
+     * 設定し直します。そのため呼び出す前に IModel::resetVertices を呼ぶ必要があります。
+     * グループモーフに属するモーフはグループモーフから重みが設定されるため直接は書き戻しません。
+     *
+     * @param morphs
+     * @return int
+     * @sa hasChangedMorphs
+     */
+    int restoreMorphs(const Array<IMorph *> &morphs) const;
+
+    /**
+     * bones と morphs の現在の値と同じ要素を取り除き、差分のみを残します。
+     *
+     * 変化した要素が残っている場合は true を返します。
+     *
+     * @param bones
+     * @param morphs
+     * @return bool
+     */
+    bool compact(const Array<IBone *> &bones, const Array<IMorph *> &morphs);
+
+    /**
+     * base に含まれる要素のうち、値が異なるものを delta に書き出します。
+     *
+     * base が compact 済みの差分の場合、delta は base で変化した要素の現在の値のみを持つため、
+     * 取り消し (base) とやり直し (delta) の組を最小の大きさで保存できます。
+     *
+     * @param base
+     * @param delta
+     */
+    void diff(const Pose &base, Pose &delta) const;
+
+    void copy(const Pose &value);
+    void clear();
+
+    bool isEmpty() const { return countBones() == 0 && countMorphs() == 0; }
+    int countBones() const { return m_boneIndices.count(); }
+    int countMorphs() const { return m_morphIndices.count(); }
+
+    /**
+     * 保持している要素が占めるおおよそのバイト数を返します。
+     *
+     * @return size_t
+     */
+    size_t estimateSize() const;
+
+private:
+    void addBone(int index, const Vector3 &position, const Quaternion &rotation);
+    void addMorph(int index, const IMorph::WeightPrecision &weight);
+
+    Array<int> m_boneIndices;
+    Array<Vector3> m_positions;
+    Array<Quaternion> m_rotations;
+    Array<int> m_morphIndices;
+    Array<IMorph::WeightPrecision> m_weights;
+
+    VPVL2_DISABLE_COPY_AND_ASSIGN(Pose)
+};
+
+} /* namespace vpvl2 */
+
+#endif
@@ -0,0 +1,139 @@
+/* ----------------------------------------------------------------- */
+/*                                                                   */
+/*  Copyright (c) 2010-2012  hkrn                                    */
+/*                                                                   */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/* - Redistributions of source code must retain the above copyright  */
+/*   notice, this list of conditions and the following disclaimer.   */
+/* - Redistributions in binary form must reproduce the above         */
+/*   copyright notice, this list of conditions and the following     */
+/*   disclaimer in the documentation and/or other materials provided */
+/*   with the distribution.                                          */
+/* - Neither the name of the MMDAI project team nor the names of     */
+/*   its contributors may be used to endorse or promote products     */
+/*   derived from this software without specific prior written       */
+/*   permission.                                                     */
+/*                                                                   */
+/* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND            */
+/* CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,       */
+/* INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF          */
+/* MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE          */
+/* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS */
+/* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,          */
+/* EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED   */
+/* TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,     */
+/* DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON */
+/* ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,   */
+/* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY    */
+/* OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE           */
+/* POSSIBILITY OF SUCH DAMAGE.                                       */
+/* ----------------------------------------------------------------- */
+
+#ifndef VPVL2_POSECACHE_H_
+#define VPVL2_POSECACHE_H_
+
+#include "vpvl2/Common.h"
+#include "vpvl2/IKeyframe.h"
+
+namespace vpvl2
+{
+
+class IBone;
+class IModel;
+class IMorph;
+class IMotion;
+class Pose;
+
+/**
+ * モデルのモーションを評価した結果の姿勢を時間毎に保持する LRU キャッシュです。
+ *
+ * キーは時間を resolution で量子化した値で、同じ時間を再び seek した場合はモーションの補間を行わずに
+ * 保存した姿勢を書き戻します。モデルに関連付けられたモーションの組み合わせやキーフレーム数が変わった
+ * 場合は自動的に破棄されますが、キーフレームの値の編集やモーション以外によるボーンの変更は検出できないため、
+ * その場合は invalidate を呼び出してください。
+ *
+ */
+class VPVL2_API PoseCache
+{
+public:
+    static const int kDefaultCapacity = 256;
+    static const int kDefaultResolution = 1000;
+
+    PoseCache(IModel *model);
+    ~PoseCache();
+
+    /**
+     * motions のうちモデルに関連付けられたモーションを timeIndex に移動します。
+     *
+     * キャッシュに姿勢があればそれを書き戻して true を返します。なければモーションを seek した後に
+     * 姿勢を保存して false を返します。
+     *
+     * @param IKeyframe::TimeIndex
+     * @param motions
+     * @return bool
+     */
+    bool seek(const IKeyframe::TimeIndex &timeIndex, const Array<IMotion *> &motions);
+
+    /**
+     * 直前の seek がキャッシュに当たった場合に、seek しなかったモーションをその時間に移動します。
+     *
+     * キャッシュに当たった場合はモーションの現在の時間が更新されないため、IMotion::advance や
+     * IMotion::isReachedTo を呼ぶ前にこのメソッドを呼び出してください。移動した場合は true を返します。
+     *
+     * @param motions
+     * @return bool
+     */
+    bool synchronize(const Array<IMotion *> &motions);
+
+    /**
+     * 保存した姿勢を全て破棄します。
+     *
+     */
+    void invalidate();
+
+    IModel *model() const { return m_modelRef; }
+    int capacity() const { return m_capacity; }
+    int resolution() const { return m_resolution; }
+    int countEntries() const { return m_entries.count(); }
+    int countHits() const { return m_nhits; }
+    int countMisses() const { return m_nmisses; }
+
+    void setCapacity(int value);
+    void setResolution(int value);
+
+private:
+    struct Entry;
+    void collectMotions(const Array<IMotion *> &motions);
+    int quantize(const IKeyframe::TimeIndex &timeIndex) const;
+    bool updateSignature(const Array<IMotion *> &motions);
+    void evictLeastRecentlyUsed();
+    void removeEntry(Entry *entry);
+
+    IModel *m_modelRef;
+    Array<IBone *> m_bones;
+    Array<IMorph *> m_morphs;
+    Array<IMotion *> m_motionRefs;
+    Array<IMotion *> m_signatureMotionRefs;
+    Array<int> m_signature;
+    Array<int> m_currentSignature;
+    Array<Entry *> m_entries;
+    Hash<btHashInt, Entry *> m_key2entries;
+    IKeyframe::TimeIndex m_pendingTimeIndex;
+    uint32_t m_tick;
+    int m_capacity;
+    int m_resolution;
+    int m_nhits;
+    int m_nmisses;
+    bool m_hasPendingSeek;
+
+    VPVL2_DISABLE_COPY_AND_ASSIGN(PoseCache)
+};
+
+} /* namespace vpvl2 */
+
+#endif
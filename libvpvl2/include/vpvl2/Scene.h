@@ -49,6 +49,8 @@ class IEncoding;
 class ILight;
 class IModel;
 class IMotion;
+class MotionBlender;
+class PoseCache;
 class IRenderDelegate;
 class IRenderEngine;
 
@@ -64,7 +66,12 @@ public:
     };
     enum RenderEngineTypeFlags {
         kEffectCapable            = 0x1,
-        kMaxRenderEngineTypeFlags = 0x2
+        kPackedVertexLayout       = 0x2,
+        kFrustumCulling           = 0x4,
+        kMaterialBatching         = 0x8,
+        kModelInstancing          = 0x10,
+        kIndexOptimization        = 0x20,
+        kMaxRenderEngineTypeFlags = 0x40
     };
     enum UpdateTypeFlags {
         kUpdateModels        = 0x1,
@@ -90,8 +97,50 @@ public:
     IEffect *createEffect(const IString *dir, const IModel *model, IRenderDelegate *delegate);
     void deleteModel(vpvl2::IModel *&model);
     void removeMotion(IMotion *motion);
+    /**
+     * MotionBlender を追加します。
+     *
+     * 追加された MotionBlender は advance と seek でモデルのモーションと共に更新され、
+     * Scene の破棄時、または対象のモデルが deleteModel で削除された時に解放されます。
+     * レイヤーのモーションは addMotion で追加しないでください。
+     *
+     * @param MotionBlender
+     */
+    void addMotionBlender(MotionBlender *blender);
+    /**
+     * MotionBlender を取り除きます。
+     *
+     * 取り除かれた MotionBlender は解放されず、所有権は呼び出し側に戻ります。不要であれば呼び出し側で解放してください。
+     *
+     * @param MotionBlender
+     */
+    void removeMotionBlender(MotionBlender *blender);
+    /**
+     * モデルのモーションを評価した姿勢のキャッシュを有効または無効にします。
+     *
+     * 有効にすると seek で同じ時間を再び指定した場合にモーションの補間を行わずに保存した姿勢を
+     * 書き戻します。advance はキャッシュを使用しません。
+     *
+     * @param IModel
+     * @param bool
+     * @sa PoseCache
+     */
+    void setPoseCacheEnable(IModel *model, bool value);
+    PoseCache *findPoseCache(const IModel *model) const;
     void advance(const IKeyframe::TimeIndex &delta, int flags);
     void seek(const IKeyframe::TimeIndex &timeIndex, int flags);
+    /**
+     * スキニングを省略するための視錐台をワールド・ビュー・射影行列で設定します。
+     *
+     * いずれの視錐台とも境界ボックスが交差しない PMX モデルは update でボーンの変形のみを行い、
+     * スキニングを行いません。影を落とすモデルを除外しないよう lightMatrix も指定してください。
+     * 両方に null を指定すると無効になります。
+     *
+     * @param cameraMatrix
+     * @param lightMatrix
+     * @sa pmx::Model::isInsideFrustum
+     */
+    void setCullingMatrices(const float *cameraMatrix, const float *lightMatrix);
     void updateModel(IModel *model) const;
     void update(int flags);
     void setPreferredFPS(const Scalar &value);
@@ -82,6 +82,8 @@ public:
     void getBones(Array<IBone *> & /* value */) const {}
     void getMorphs(Array<IMorph *> & /* value */) const {}
     void getLabels(Array<ILabel *> & /* value */) const {}
+    void savePose(Pose & /* value */) const {}
+    int restorePose(const Pose & /* value */) { return 0; }
     void getBoundingBox(Vector3 &min, Vector3 &max) const;
     void getBoundingSphere(Vector3 &center, Scalar &radius) const;
     const Vector3 &position() const { return m_asset.position(); }
@@ -98,6 +98,7 @@ protected:
 private:
     bool releaseContext0(void *context);
     void release();
+    void uploadSkinnedVertices();
 
     enum VertexBufferObjectType {
         kModelVertices,
@@ -126,6 +127,7 @@ private:
     MaterialContext *m_materialContexts;
     Hash<btHashInt, EffectEngine *> m_effects;
     Array<EffectEngine *> m_oseffects;
+    GLenum m_indexType;
     bool m_cullFaceState;
     bool m_isVertexShaderSkinning;
 
@@ -48,10 +48,27 @@ class Scene;
 namespace cl
 {
 
+class PMXSkinningBatch;
+
 class PMXAccelerator
 {
 public:
-    PMXAccelerator(Context *context);
+    /**
+     * 頂点バッファの種類です。
+     *
+     * kGLSharedBuffer は OpenGL の頂点バッファを直接書き換えます (OpenCL と OpenGL の共有が必要)。
+     * kHostBuffer はホスト側のメモリに書き出すため OpenGL のコンテキストを必要とせず、
+     * CPU の OpenCL デバイス (Scene::kOpenCLAccelerationType2) で利用することを想定しています。
+     */
+    enum BufferType {
+        kGLSharedBuffer,
+        kHostBuffer
+    };
+
+    /**
+     * batch を指定した場合はモデル毎にスキニングを行わず、batch にまとめて実行させます。
+     */
+    PMXAccelerator(Context *context, BufferType type, PMXSkinningBatch *batch);
     ~PMXAccelerator();
 
     bool isAvailable() const;
@@ -59,10 +76,51 @@ public:
     void uploadModel(const pmx::Model *model, GLuint buffer, void *context);
     void updateModel(const pmx::Model *model, const Scene *scene);
 
+    /**
+     * kHostBuffer の場合に updateModel で開始したスキニングの完了を待ち、結果の頂点を返します。
+     *
+     * スキニングは updateModel では待たずに非同期で実行されるため、その間に他のモデルの更新を
+     * 行うことができます。返された頂点は releaseSkinnedVertices を呼ぶまで有効です。
+     * updateModel は pmx::Model::vertexPtr から非同期に転送するため、次に IModel::performUpdate を
+     * 呼ぶ前にこのメソッドを呼んでください。kGLSharedBuffer の場合は常に null を返します。
+     *
+     * @return const void
+     */
+    const void *waitForSkinnedVertices();
+    void releaseSkinnedVertices();
+
+    /**
+     * 変形前の頂点 (pmx::Model::vertexPtr) を OpenCL 側で転送するかを返します。
+     *
+     * true の場合は変形前の頂点を OpenGL の頂点バッファに転送する必要はありません。
+     *
+     * @return bool
+     */
+    bool isVertexSourceTransferred() const { return m_bufferType == kHostBuffer || m_batchRef; }
+    BufferType bufferType() const { return m_bufferType; }
+
+    /**
+     * 材質モーフを反映したエッジの太さを材質毎に求め、その材質に属する頂点の値として書き込みます。
+     *
+     * materialEdgeSizes に保持している値と異なる材質 (force が true の場合は全ての材質) のみを書き込み、
+     * 一つでも書き込んだ場合に true を返します。materialEdgeSizes は材質数分、
+     * vertexEdgeSizes は頂点数分の大きさが必要です。
+     *
+     * @param pmx::Model
+     * @param bool
+     * @param float
+     * @param float
+     * @return bool
+     */
+    static bool mapMaterialEdgeSizes(const pmx::Model *model, bool force, float *materialEdgeSizes, float *vertexEdgeSizes);
+
 private:
+    bool setStaticKernelArguments(const pmx::Model *model, void *context);
     void log0(void *context, IRenderDelegate::LogLevel level, const char *format...);
 
     Context *m_contextRef;
+    PMXSkinningBatch *m_batchRef;
+    const pmx::Model *m_modelRef;
     cl_program m_program;
     cl_kernel m_performSkinningKernel;
     cl_mem m_verticesBuffer;
@@ -70,8 +128,14 @@ private:
     cl_mem m_boneWeightsBuffer;
     cl_mem m_boneIndicesBuffer;
     cl_mem m_boneMatricesBuffer;
+    cl_event m_mapEvent;
+    void *m_mappedVertices;
+    BufferType m_bufferType;
     size_t m_localWGSizeForPerformSkinning;
+    size_t m_verticesSize;
     float *m_boneTransform;
+    Array<float> m_materialEdgeSizes;
+    Array<float> m_vertexEdgeSizes;
     bool m_isBufferAllocated;
 };
 
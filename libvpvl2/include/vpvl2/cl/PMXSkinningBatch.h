@@ -0,0 +1,148 @@
+/* ----------------------------------------------------------------- */
+/*                                                                   */
+/*  Copyright (c) 2010-2012  hkrn                                    */
+/*                                                                   */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/* - Redistributions of source code must retain the above copyright  */
+/*   notice, this list of conditions and the following disclaimer.   */
+/* - Redistributions in binary form must reproduce the above         */
+/*   copyright notice, this list of conditions and the following     */
+/*   disclaimer in the documentation and/or other materials provided */
+/*   with the distribution.                                          */
+/* - Neither the name of the MMDAI project team nor the names of     */
+/*   its contributors may be used to endorse or promote products     */
+/*   derived from this software without specific prior written       */
+/*   permission.                                                     */
+/*                                                                   */
+/* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND            */
+/* CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,       */
+/* INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF          */
+/* MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE          */
+/* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS */
+/* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,          */
+/* EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED   */
+/* TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,     */
+/* DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON */
+/* ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,   */
+/* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY    */
+/* OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE           */
+/* POSSIBILITY OF SUCH DAMAGE.                                       */
+/* ----------------------------------------------------------------- */
+
+#ifndef VPVL2_CL_PMXSKINNINGBATCH_H_
+#define VPVL2_CL_PMXSKINNINGBATCH_H_
+
+#include "vpvl2/cl/PMXAccelerator.h"
+
+namespace vpvl2
+{
+
+class Scene;
+
+namespace cl
+{
+
+/**
+ * シーン内の全ての PMX モデルのスキニングを一度のカーネル実行で行うクラスです。
+ *
+ * 各モデルのボーン行列と頂点を一つのバッファに詰めて performSkinningBatch を実行します。
+ * モデル毎に転送と実行と完了待ちを行う場合と比べ、小さいモデルが多数あるシーンでの
+ * カーネル起動と同期のオーバーヘッドを削減します。PMXAccelerator から使用されます。
+ */
+class PMXSkinningBatch
+{
+public:
+    PMXSkinningBatch(Context *context, PMXAccelerator::BufferType type);
+    ~PMXSkinningBatch();
+
+    bool isAvailable() const;
+    bool createKernelProgram();
+    void addModel(const pmx::Model *model, GLuint buffer);
+    void removeModel(const pmx::Model *model);
+
+    /**
+     * モデルのボーンが更新されたことを通知します。
+     *
+     * スキニングは update を呼ぶか最初に waitForSkinnedVertices を呼んだ時点で全てのモデルに対して行われます。
+     *
+     * @param Scene
+     */
+    void invalidate(const Scene *scene);
+
+    /**
+     * invalidate されていれば全てのモデルのスキニングを一度に実行します。
+     *
+     * kHostBuffer の場合は完了を待たずに戻ります。
+     */
+    void update();
+
+    /**
+     * 指定したモデルのスキニング結果を返します。
+     *
+     * kHostBuffer の場合はスキニングの完了を待ち、連結された頂点のうちそのモデルの先頭を返します。
+     * 返された頂点は次に update が実行されるまで有効です。kGLSharedBuffer の場合は
+     * OpenGL の頂点バッファに直接書き込むため常に null を返します。
+     *
+     * @param pmx::Model
+     * @return const void
+     */
+    const void *waitForSkinnedVertices(const pmx::Model *model);
+
+    PMXAccelerator::BufferType bufferType() const { return m_bufferType; }
+
+private:
+    struct Entry {
+        const pmx::Model *model;
+        GLuint buffer;
+        cl_mem sharedBuffer;
+        int vertexOffset;
+        int boneOffset;
+        int materialOffset;
+    };
+
+    bool upload();
+    bool setStaticKernelArguments();
+    void perform();
+    void releaseSkinnedVertices();
+    void releaseBuffers();
+    void log0(void *context, IRenderDelegate::LogLevel level, const char *format...);
+
+    Context *m_contextRef;
+    const Scene *m_sceneRef;
+    cl_program m_program;
+    cl_kernel m_performSkinningKernel;
+    cl_mem m_verticesBuffer;
+    cl_mem m_materialEdgeSizeBuffer;
+    cl_mem m_boneWeightsBuffer;
+    cl_mem m_boneIndicesBuffer;
+    cl_mem m_boneMatricesBuffer;
+    cl_mem m_modelIndicesBuffer;
+    cl_mem m_edgeScaleFactorsBuffer;
+    cl_event m_mapEvent;
+    Array<Entry> m_entries;
+    Array<cl_mem> m_sharedBuffers;
+    Array<float> m_boneTransform;
+    Array<float> m_edgeScaleFactors;
+    Array<float> m_materialEdgeSizes;
+    Array<float> m_vertexEdgeSizes;
+    void *m_mappedVertices;
+    PMXAccelerator::BufferType m_bufferType;
+    size_t m_localWGSizeForPerformSkinning;
+    int m_nvertices;
+    bool m_isBufferAllocated;
+    bool m_isLayoutChanged;
+    bool m_isDirty;
+    bool m_isMapCompleted;
+
+    VPVL2_DISABLE_COPY_AND_ASSIGN(PMXSkinningBatch)
+};
+
+} /* namespace cl */
+} /* namespace vpvl2 */
+
+#endif
@@ -0,0 +1,97 @@
+/* ----------------------------------------------------------------- */
+/*                                                                   */
+/*  Copyright (c) 2010-2012  hkrn                                    */
+/*                                                                   */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/* - Redistributions of source code must retain the above copyright  */
+/*   notice, this list of conditions and the following disclaimer.   */
+/* - Redistributions in binary form must reproduce the above         */
+/*   copyright notice, this list of conditions and the following     */
+/*   disclaimer in the documentation and/or other materials provided */
+/*   with the distribution.                                          */
+/* - Neither the name of the MMDAI project team nor the names of     */
+/*   its contributors may be used to endorse or promote products     */
+/*   derived from this software without specific prior written       */
+/*   permission.                                                     */
+/*                                                                   */
+/* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND            */
+/* CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,       */
+/* INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF          */
+/* MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE          */
+/* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS */
+/* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,          */
+/* EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED   */
+/* TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,     */
+/* DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON */
+/* ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,   */
+/* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY    */
+/* OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE           */
+/* POSSIBILITY OF SUCH DAMAGE.                                       */
+/* ----------------------------------------------------------------- */
+
+#ifndef VPVL2_EXTENSIONS_STRING_H_
+#define VPVL2_EXTENSIONS_STRING_H_
+
+#include "vpvl2/Common.h"
+#include "vpvl2/IString.h"
+
+namespace vpvl2
+{
+namespace extensions
+{
+
+/**
+ * @file
+ * @author hkrn
+ *
+ * @section DESCRIPTION
+ *
+ * String class is an implementation of IString without Qt. The value is always
+ * held as a null-terminated UTF-8 byte sequence, so comparisons are done
+ * bytewise and length() returns the number of bytes like qt::CString.
+ */
+
+class VPVL2_API String : public IString
+{
+public:
+    /**
+     * 終端文字で終わる UTF-8 の文字列から作成します。
+     *
+     * @param value
+     */
+    explicit String(const char *value);
+
+    /**
+     * 長さ付きの UTF-8 のバイト列から作成します。
+     *
+     * @param value
+     * @param size バイト数
+     */
+    String(const uint8_t *value, size_t size);
+    ~String();
+
+    bool startsWith(const IString *value) const;
+    bool contains(const IString *value) const;
+    bool endsWith(const IString *value) const;
+    IString *clone() const;
+    const HashString toHashString() const;
+    bool equals(const IString *value) const;
+    const uint8_t *toByteArray() const;
+    size_t length() const;
+
+private:
+    uint8_t *m_bytes;
+    size_t m_size;
+
+    VPVL2_DISABLE_COPY_AND_ASSIGN(String)
+};
+
+}
+}
+
+#endif
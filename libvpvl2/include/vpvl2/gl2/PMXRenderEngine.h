@@ -107,6 +107,94 @@ public:
     IEffect *effect(IEffect::ScriptOrderType type) const;
     void setEffect(IEffect::ScriptOrderType type, IEffect *effect, const IString *dir);
 
+    /**
+     * 圧縮した頂点形式で頂点バッファを作成するかを設定します。
+     *
+     * upload を呼び出す前に設定する必要があります。有効にすると毎フレーム変化する属性のみを転送します。
+     * OpenCL によるスキニングが有効な場合は無視されます。
+     *
+     * @param bool
+     */
+    void setPackedVertexEnable(bool value);
+
+    /**
+     * モデルの境界ボックスが視錐台の外にある場合に描画を省略するかを設定します。
+     *
+     * renderModel と renderEdge はカメラ、renderZPlot はライトの視錐台で判定します。
+     * renderShadow は影の行列で地面に投影した境界ボックスをカメラの視錐台で判定します。
+     *
+     * @param bool
+     * @sa pmx::Model::isInsideFrustum
+     */
+    void setFrustumCullingEnable(bool value);
+
+    /**
+     * 描画状態が同じ材質をまとめて描画するかを設定します。
+     *
+     * upload を呼び出す前に設定する必要があります。頂点シェーダによるスキニングでは材質毎に
+     * ボーン行列を切り替えるため無視されます。
+     * モデル全体の不透明度が 1 未満の間は描画順を保つため、材質をまとめずに元の順番で描画します。
+     *
+     * @param bool
+     * @sa pmx::DrawList
+     */
+    void setMaterialBatchingEnable(bool value);
+
+    /**
+     * 頂点キャッシュの効率が上がるように索引を並べ替えてから転送するかを設定します。
+     *
+     * upload を呼び出す前に設定する必要があります。モデルの索引そのものを並べ替えるため、
+     * 半透明の材質を持つモデルでは同じ材質内の描画順が変わる可能性があります。
+     *
+     * @param bool
+     * @sa pmx::Model::optimizeIndices
+     */
+    void setIndexOptimizationEnable(bool value);
+
+    /**
+     * 同じデータから読み込まれたモデルの描画エンジンと変化しないリソースを共有するように設定します。
+     *
+     * upload を呼び出す前に設定する必要があり、upload が終わるまで value を解放してはいけません。
+     * 索引、圧縮した頂点形式の静的な属性、テクスチャ及び描画リストを共有し、
+     * 姿勢やモーフによって変化する頂点バッファはインスタンス毎に持ちます。
+     * モデルの内容や頂点形式などが異なる場合は共有せずに通常通り作成します。
+     *
+     * @param PMXRenderEngine
+     * @sa pmx::Model::hasSameSource
+     */
+    void setSharedEngine(const PMXRenderEngine *value);
+
+    /**
+     * 他の描画エンジンとリソースを共有しているかを返します。
+     *
+     * @return bool
+     */
+    bool isResourceShared() const;
+
+    /**
+     * シェーダプログラムが発行した OpenGL の状態変更の呼び出し回数を返します。
+     *
+     * ユニフォーム、テクスチャの割り当て及びカリングの状態が対象です。
+     *
+     * @return int
+     * @sa countElidedStateCalls
+     */
+    int countIssuedStateCalls() const;
+
+    /**
+     * 前回と同じ値のため省略された OpenGL の状態変更の呼び出し回数を返します。
+     *
+     * @return int
+     * @sa countIssuedStateCalls
+     */
+    int countElidedStateCalls() const;
+
+    /**
+     * countIssuedStateCalls と countElidedStateCalls の値を 0 に戻します。
+     *
+     */
+    void resetStateCounters();
+
 protected:
     void log0(void *context, IRenderDelegate::LogLevel level, const char *format ...);
 
@@ -120,11 +208,19 @@ private:
                        IRenderDelegate::ShaderType fragmentShaderType,
                        void *context);
     bool releaseContext0(void *context);
+    bool uploadTextures(const IString *dir, void *context);
+    void uploadSkinnedVertices();
+    bool isCulled(const float *matrix) const;
 
     const Scene *m_sceneRef;
     cl::PMXAccelerator *m_accelerator;
     pmx::Model *m_modelRef;
+    const PMXRenderEngine *m_sharedEngineRef;
     PrivateContext *m_context;
+    bool m_enablePackedVertex;
+    bool m_enableMaterialBatching;
+    bool m_enableFrustumCulling;
+    bool m_enableIndexOptimization;
 
     VPVL2_DISABLE_COPY_AND_ASSIGN(PMXRenderEngine)
 };
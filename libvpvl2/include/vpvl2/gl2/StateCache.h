@@ -0,0 +1,229 @@
+/* ----------------------------------------------------------------- */
+/*                                                                   */
+/*  Copyright (c) 2010-2012  hkrn                                    */
+/*                                                                   */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/* - Redistributions of source code must retain the above copyright  */
+/*   notice, this list of conditions and the following disclaimer.   */
+/* - Redistributions in binary form must reproduce the above         */
+/*   copyright notice, this list of conditions and the following     */
+/*   disclaimer in the documentation and/or other materials provided */
+/*   with the distribution.                                          */
+/* - Neither the name of the MMDAI project team nor the names of     */
+/*   its contributors may be used to endorse or promote products     */
+/*   derived from this software without specific prior written       */
+/*   permission.                                                     */
+/*                                                                   */
+/* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND            */
+/* CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,       */
+/* INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF          */
+/* MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE          */
+/* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS */
+/* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,          */
+/* EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED   */
+/* TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,     */
+/* DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON */
+/* ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,   */
+/* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY    */
+/* OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE           */
+/* POSSIBILITY OF SUCH DAMAGE.                                       */
+/* ----------------------------------------------------------------- */
+
+#ifndef VPVL2_GL2_STATECACHE_H_
+#define VPVL2_GL2_STATECACHE_H_
+
+#include "vpvl2/Common.h"
+
+#include <string.h>
+
+namespace vpvl2
+{
+namespace gl2
+{
+
+/**
+ * @file
+ * @author hkrn
+ *
+ * @section DESCRIPTION
+ *
+ * StateCache class remembers uniform values, texture bindings and cull state
+ * last sent to OpenGL and tells the caller whether a new call is redundant.
+ * It never calls OpenGL itself so it can be tested without a GL context.
+ */
+
+class StateCache
+{
+public:
+    static const int kMaxUniformSize = 16;
+    static const int kMaxTextureUnits = 8;
+
+    StateCache()
+        : m_cullFaceEnabled(kUnknown),
+          m_cullFaceMode(0),
+          m_nissued(0),
+          m_nelided(0)
+    {
+        invalidateState();
+    }
+    ~StateCache() {
+        invalidateUniforms();
+        m_nissued = 0;
+        m_nelided = 0;
+    }
+
+    /**
+     * float 型のユニフォームの値を更新します。
+     *
+     * 前回と同じ値の場合は false を返します。その場合は OpenGL の呼び出しを省略できます。
+     *
+     * @param int
+     * @param float
+     * @param int
+     * @return bool
+     */
+    bool updateUniform(int location, const float *value, int size) {
+        return updateUniformBytes(location, value, sizeof(float) * btMin(size, int(kMaxUniformSize)));
+    }
+    /**
+     * int 型のユニフォームの値を更新します。
+     *
+     * @param int
+     * @param int
+     * @return bool
+     * @sa updateUniform
+     */
+    bool updateUniform(int location, int value) {
+        return updateUniformBytes(location, &value, sizeof(value));
+    }
+    /**
+     * テクスチャユニットに割り当てるテクスチャを更新します。
+     *
+     * @param int
+     * @param unsigned int
+     * @return bool
+     */
+    bool updateTexture(int unit, unsigned int name) {
+        if (unit < 0 || unit >= kMaxTextureUnits)
+            return issue();
+        if (m_textures[unit] == name)
+            return elide();
+        m_textures[unit] = name;
+        return issue();
+    }
+    /**
+     * 背面カリングの有効無効を更新します。
+     *
+     * @param bool
+     * @return bool
+     */
+    bool updateCullFaceEnable(bool value) {
+        const int state = value ? kEnabled : kDisabled;
+        if (m_cullFaceEnabled == state)
+            return elide();
+        m_cullFaceEnabled = state;
+        return issue();
+    }
+    /**
+     * カリングする面を更新します。
+     *
+     * @param unsigned int
+     * @return bool
+     */
+    bool updateCullFace(unsigned int mode) {
+        if (m_cullFaceMode == mode)
+            return elide();
+        m_cullFaceMode = mode;
+        return issue();
+    }
+
+    /**
+     * 記録されているユニフォームの値を全て破棄します。
+     *
+     * ユニフォームの値はシェーダプログラムが保持するため、リンクし直した時に呼び出します。
+     *
+     */
+    void invalidateUniforms() {
+        m_uniforms.releaseAll();
+    }
+    /**
+     * 記録されているテクスチャとカリングの状態を破棄します。
+     *
+     * これらは OpenGL のコンテキスト全体の状態で他の描画処理から変更されうるため、
+     * 描画パスの開始時に呼び出します。
+     *
+     */
+    void invalidateState() {
+        for (int i = 0; i < kMaxTextureUnits; i++)
+            m_textures[i] = kUnknownTexture;
+        m_cullFaceEnabled = kUnknown;
+        m_cullFaceMode = 0;
+    }
+    void resetCounters() {
+        m_nissued = 0;
+        m_nelided = 0;
+    }
+
+    int countIssuedCalls() const { return m_nissued; }
+    int countElidedCalls() const { return m_nelided; }
+
+private:
+    enum State {
+        kUnknown = -1,
+        kDisabled,
+        kEnabled
+    };
+    static const unsigned int kUnknownTexture = ~0u;
+    struct Uniform {
+        Uniform() : size(0) {}
+        uint8_t bytes[sizeof(float) * kMaxUniformSize];
+        size_t size;
+    };
+
+    bool updateUniformBytes(int location, const void *value, size_t size) {
+        /* 見つからなかったユニフォーム (-1) への呼び出しは OpenGL 側で無視される */
+        if (location < 0)
+            return elide();
+        const btHashInt key(location);
+        Uniform **uniformPtr = m_uniforms[key], *uniform = 0;
+        if (uniformPtr) {
+            uniform = *uniformPtr;
+            if (uniform->size == size && memcmp(uniform->bytes, value, size) == 0)
+                return elide();
+        }
+        else {
+            uniform = new Uniform();
+            m_uniforms.insert(key, uniform);
+        }
+        memcpy(uniform->bytes, value, size);
+        uniform->size = size;
+        return issue();
+    }
+    bool issue() {
+        m_nissued++;
+        return true;
+    }
+    bool elide() {
+        m_nelided++;
+        return false;
+    }
+
+    Hash<btHashInt, Uniform *> m_uniforms;
+    unsigned int m_textures[kMaxTextureUnits];
+    int m_cullFaceEnabled;
+    unsigned int m_cullFaceMode;
+    int m_nissued;
+    int m_nelided;
+
+    VPVL2_DISABLE_COPY_AND_ASSIGN(StateCache)
+};
+
+} /* namespace gl2 */
+} /* namespace vpvl2 */
+
+#endif
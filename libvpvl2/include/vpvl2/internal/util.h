@@ -281,6 +281,17 @@ static inline uint8_t *copyBytes(uint8_t *dst, const uint8_t *src, size_t max)
     return ptr;
 }
 
+static inline void copyString(uint8_t *dst, const uint8_t *src, size_t max)
+{
+    assert(dst != NULL && max > 0);
+    size_t length = 0;
+    while (src && length < max && src[length] != 0)
+        length++;
+    if (length > 0)
+        memcpy(dst, src, length);
+    memset(dst + length, 0, max - length);
+}
+
 static inline void writeBytes(const uint8_t *src, size_t size, uint8_t *&dst)
 {
     copyBytes(dst, src, size);
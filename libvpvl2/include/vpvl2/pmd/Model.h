@@ -39,6 +39,7 @@
 
 #include "vpvl2/Common.h"
 #include "vpvl2/IModel.h"
+#include "vpvl2/Pose.h"
 
 #include "vpvl/PMDModel.h"
 
@@ -79,6 +80,8 @@ public:
     void getBones(Array<IBone *> &value) const { value.copy(m_bones); }
     void getMorphs(Array<IMorph *> &value) const { value.copy(m_morphs); }
     void getLabels(Array<ILabel *> &value) const { value.copy(m_labels); }
+    void savePose(Pose &value) const { value.save(m_bones, m_morphs); }
+    int restorePose(const Pose &value);
     void getBoundingBox(Vector3 &min, Vector3 &max) const;
     void getBoundingSphere(Vector3 &center, Scalar &radius) const;
     Scalar edgeScaleFactor(const Vector3 &cameraPosition) const;
@@ -0,0 +1,152 @@
+/* ----------------------------------------------------------------- */
+/*                                                                   */
+/*  Copyright (c) 2010-2012  hkrn                                    */
+/*                                                                   */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/* - Redistributions of source code must retain the above copyright  */
+/*   notice, this list of conditions and the following disclaimer.   */
+/* - Redistributions in binary form must reproduce the above         */
+/*   copyright notice, this list of conditions and the following     */
+/*   disclaimer in the documentation and/or other materials provided */
+/*   with the distribution.                                          */
+/* - Neither the name of the MMDAI project team nor the names of     */
+/*   its contributors may be used to endorse or promote products     */
+/*   derived from this software without specific prior written       */
+/*   permission.                                                     */
+/*                                                                   */
+/* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND            */
+/* CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,       */
+/* INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF          */
+/* MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE          */
+/* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS */
+/* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,          */
+/* EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED   */
+/* TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,     */
+/* DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON */
+/* ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,   */
+/* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY    */
+/* OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE           */
+/* POSSIBILITY OF SUCH DAMAGE.                                       */
+/* ----------------------------------------------------------------- */
+
+#ifndef VPVL2_PMX_DRAWLIST_H_
+#define VPVL2_PMX_DRAWLIST_H_
+
+#include "vpvl2/Common.h"
+
+namespace vpvl2
+{
+namespace pmx
+{
+
+class Material;
+class Morph;
+
+/**
+ * @file
+ * @author hkrn
+ *
+ * @section DESCRIPTION
+ *
+ * DrawList class compiles materials of a Polygon Model Extended object into
+ * draw batches. Materials with the same render state are merged into one draw
+ * call and opaque materials are sorted by texture to reduce texture switches.
+ */
+
+class VPVL2_API DrawList
+{
+public:
+    struct Batch {
+        /* 描画状態を代表する材質のインデックス */
+        int materialIndex;
+        /* まとめられた材質の数 */
+        int nmaterials;
+        /* 並べ替え後のインデックスバッファにおける開始位置 (要素単位) */
+        int indexOffset;
+        int nindices;
+    };
+
+    DrawList();
+    ~DrawList();
+
+    /**
+     * 材質から描画リストを作成します。
+     *
+     * enableBatching が false の場合は材質毎に一つずつ描画する従来通りのリストを作成します。
+     * true の場合は描画状態が同じで隣り合う材質を一つにまとめます。不透明であることが分かっている材質
+     * (不透明度が 1 で材質モーフの対象ではなく、テクスチャを持たないかアルファを持たないテクスチャのもの)
+     * は先頭に移動してテクスチャ毎、さらに描画状態毎に並べます。
+     * 特定の材質を対象とする材質モーフがある場合、その材質はまとめません。
+     *
+     * opaqueTextures は材質と同じ順番で、その材質のテクスチャがアルファを持たないことが分かっている場合に
+     * true を設定します。材質数より少ない場合は足りない分を false (半透明の可能性がある) とみなします。
+     *
+     * @param materials
+     * @param morphs
+     * @param opaqueTextures
+     * @param enableBatching
+     */
+    void compile(const Array<Material *> &materials,
+                 const Array<Morph *> &morphs,
+                 const Array<bool> &opaqueTextures,
+                 bool enableBatching);
+
+    /**
+     * 材質の並べ替えに従ってインデックスを並べ替えます。
+     *
+     * source と dest は材質数分のインデックスを持つ必要があり、同じ領域を指定してはいけません。
+     *
+     * @param source
+     * @param dest
+     * @param stride インデックス 1 要素あたりの大きさ
+     */
+    void reorderIndices(const uint8_t *source, uint8_t *dest, size_t stride) const;
+
+    /**
+     * 材質の描画順が元の順番から変わっているかを返します。
+     *
+     * false の場合は reorderIndices を呼び出す必要はありません。
+     *
+     * @return bool
+     */
+    bool isReordered() const { return m_reordered; }
+
+    const Array<int> &materialOrder() const { return m_materialOrder; }
+    const Batch &batchAt(int index) const { return m_batches[index]; }
+    /**
+     * index 番目の材質のみを描画する範囲を返します。
+     *
+     * 範囲は並べ替え後のインデックスバッファ上の位置です。モデル全体を半透明で描画する場合など、
+     * 材質を元の順番で描画する必要がある場合に 0 から countMaterials() - 1 まで順に使います。
+     *
+     * @param index
+     * @return Batch
+     */
+    const Batch &materialBatchAt(int index) const { return m_materialBatches[index]; }
+    int countBatches() const { return m_batches.count(); }
+    int countMaterials() const { return m_materialOrder.count(); }
+
+private:
+    static bool isSameTexture(const Material *left, const Material *right);
+    static bool isSameRenderState(const Material *left, const Material *right);
+    void clear();
+
+    Array<Batch> m_batches;
+    Array<Batch> m_materialBatches;
+    Array<int> m_materialOrder;
+    Array<int> m_sourceIndexOffsets;
+    Array<int> m_sourceIndexCounts;
+    bool m_reordered;
+
+    VPVL2_DISABLE_COPY_AND_ASSIGN(DrawList)
+};
+
+}
+}
+
+#endif
@@ -145,6 +145,16 @@ public:
      */
     void read(const uint8_t *data, const Model::DataInfo &info, size_t &size);
     void write(uint8_t *data, const Model::DataInfo &info) const;
+    /**
+     * テクスチャの番号を textureIndices で変換して書き出します。
+     *
+     * 材質自体は変更しません。textureIndices の範囲外の番号と共有トゥーンの番号はそのまま書き出します。
+     *
+     * @param data
+     * @param info
+     * @param textureIndices 元のテクスチャの番号から書き出すテクスチャの番号への対応表
+     */
+    void write(uint8_t *data, const Model::DataInfo &info, const Array<int> &textureIndices) const;
     size_t estimateSize(const Model::DataInfo &info) const;
     void mergeMorph(const Morph::Material *morph, float weight);
     void resetMorph();
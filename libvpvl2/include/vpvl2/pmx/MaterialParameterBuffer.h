@@ -0,0 +1,128 @@
+/* ----------------------------------------------------------------- */
+/*                                                                   */
+/*  Copyright (c) 2010-2012  hkrn                                    */
+/*                                                                   */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/* - Redistributions of source code must retain the above copyright  */
+/*   notice, this list of conditions and the following disclaimer.   */
+/* - Redistributions in binary form must reproduce the above         */
+/*   copyright notice, this list of conditions and the following     */
+/*   disclaimer in the documentation and/or other materials provided */
+/*   with the distribution.                                          */
+/* - Neither the name of the MMDAI project team nor the names of     */
+/*   its contributors may be used to endorse or promote products     */
+/*   derived from this software without specific prior written       */
+/*   permission.                                                     */
+/*                                                                   */
+/* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND            */
+/* CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,       */
+/* INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF          */
+/* MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE          */
+/* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS */
+/* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,          */
+/* EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED   */
+/* TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,     */
+/* DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON */
+/* ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,   */
+/* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY    */
+/* OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE           */
+/* POSSIBILITY OF SUCH DAMAGE.                                       */
+/* ----------------------------------------------------------------- */
+
+#ifndef VPVL2_PMX_MATERIALPARAMETERBUFFER_H_
+#define VPVL2_PMX_MATERIALPARAMETERBUFFER_H_
+
+#include "vpvl2/pmx/Morph.h"
+
+namespace vpvl2
+{
+namespace pmx
+{
+
+class Material;
+
+/**
+ * @file
+ * @author hkrn
+ *
+ * @section DESCRIPTION
+ *
+ * MaterialParameterBuffer class holds the morphed parameters of all materials
+ * of a Polygon Model Extended object in one packed buffer. Material morphs are
+ * accumulated as multiplicative and additive contributions and the results are
+ * evaluated once in a single loop when the buffer is read.
+ */
+
+class VPVL2_API MaterialParameterBuffer
+{
+public:
+    /* base * mul + add を要素毎に計算するため、全ての要素を Scalar の並びとして扱う */
+    struct Parameter {
+        Color ambient;
+        Color diffuse;
+        Color specular;
+        Color edgeColor;
+        Color mainTextureBlend;
+        Color sphereTextureBlend;
+        Color toonTextureBlend;
+        Scalar shininess;
+        Scalar edgeSize;
+        Scalar reserved[2];
+    };
+
+    MaterialParameterBuffer();
+    ~MaterialParameterBuffer();
+
+    /**
+     * 材質の現在の値を基準値として材質数分のバッファを作成します。
+     *
+     * @param Array<Material>
+     */
+    void compile(const Array<Material *> &materials);
+
+    /**
+     * 材質モーフによる寄与を全て取り除きます。
+     *
+     */
+    void reset();
+
+    /**
+     * 材質モーフの寄与を対象の材質に加えます。
+     *
+     * 乗算は積、加算は和として複数の材質モーフの寄与を累積します。重みは 0 から 1 の範囲に制限されます。
+     *
+     * @param Morph::Material
+     * @param float
+     */
+    void accumulate(const Morph::Material *morph, float weight);
+
+    /**
+     * reset または accumulate が呼ばれていた場合に全ての材質の値を計算し直します。
+     *
+     */
+    void update();
+
+    const Parameter &at(int index) const { return m_results[index]; }
+    int count() const { return m_results.count(); }
+    bool isDirty() const { return m_dirty; }
+
+private:
+    Array<Parameter> m_bases;
+    Array<Parameter> m_muls;
+    Array<Parameter> m_adds;
+    Array<Parameter> m_results;
+    bool m_hasContributions;
+    bool m_dirty;
+
+    VPVL2_DISABLE_COPY_AND_ASSIGN(MaterialParameterBuffer)
+};
+
+}
+}
+
+#endif
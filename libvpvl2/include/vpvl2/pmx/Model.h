@@ -62,6 +62,7 @@ class Bone;
 class Label;
 class Joint;
 class Material;
+class MaterialParameterBuffer;
 class Morph;
 class RigidBody;
 class Vertex;
@@ -70,6 +71,8 @@ class VPVL2_API Model : public IModel
 {
 public:
     struct SkinnedVertex;
+    struct PackedVertex;
+    struct PackedStaticVertex;
 
     enum StrideType {
         kVertexStride,
@@ -84,8 +87,12 @@ public:
         kUVA1Stride,
         kUVA2Stride,
         kUVA3Stride,
-        kUVA4Stride,
-        kIndexStride
+        kUVA4Stride
+    };
+    enum PackedStreamType {
+        kDynamicStream,
+        kStaticStream,
+        kUVA1Stream
     };
 
     struct DataInfo
@@ -139,12 +146,49 @@ public:
     static size_t strideOffset(StrideType type);
     static size_t strideSize(StrideType type);
 
+    /**
+     * 圧縮した頂点形式における各属性のオフセットを返します。
+     *
+     * 圧縮した頂点形式はスキニングで毎フレーム変化する動的な頂点 (packedVertexPtr) と、
+     * 変化しない静的な頂点 (getPackedStaticVertices) と、追加 UV (packedUVA1Ptr) に分かれます。
+     * 属性がどれに属するかは packedStreamType で判定します。
+     * 法線は 16bit の符号付き正規化整数、ボーンのインデックスは 16bit の符号付き整数、
+     * ボーンの重みは 16bit の符号なし正規化整数で格納されます。
+     *
+     * @param StrideType
+     * @return size_t
+     */
+    static size_t packedStrideOffset(StrideType type);
+    static size_t packedStrideSize(StrideType type);
+    static PackedStreamType packedStreamType(StrideType type);
+
     bool load(const uint8_t *data, size_t size);
     void save(uint8_t *data) const;
     size_t estimateSize() const;
 
     void resetVertices();
     void performUpdate(const Vector3 &cameraPosition, const Vector3 &lightDirection);
+
+    /**
+     * performUpdate のうちボーンの変形 (物理演算を含む) のみを行います。
+     *
+     * Scene が複数のモデルのスキニングを一括で行うために使用します。
+     * 続けて performSkinning を全ての頂点に対して呼び出すと performUpdate と同じ結果になります。
+     */
+    void performUpdateBones();
+
+    /**
+     * [from, to) の範囲の頂点のスキニングを行います。
+     *
+     * 範囲が重ならなければ複数のスレッドから同時に呼び出すことができます。
+     * 事前に performUpdateBones を呼び出しておく必要があります。
+     *
+     * @param int
+     * @param int
+     * @param Scalar
+     * @param Vector3
+     */
+    void performSkinning(int from, int to, const Scalar &edgeScaleFactor, const Vector3 &lightDirection);
     void joinWorld(btDiscreteDynamicsWorld *world);
     void leaveWorld(btDiscreteDynamicsWorld *world);
     IBone *findBone(const IString *value) const;
@@ -153,14 +197,83 @@ public:
     void getBones(Array<IBone *> &value) const;
     void getMorphs(Array<IMorph *> &value) const;
     void getLabels(Array<ILabel *> &value) const;
+    void savePose(Pose &value) const;
+    int restorePose(const Pose &value);
+    /**
+     * モデルの境界ボックスを求めます。
+     *
+     * 読み込み時に求めたボーン毎の境界をボーンの変形で変換して合成するため、頂点数ではなくボーン数に
+     * 比例する時間で求まり、スキニングの結果も必要としません。頂点モーフによる変位を含みます。
+     *
+     * @param min
+     * @param max
+     */
     void getBoundingBox(Vector3 &min, Vector3 &max) const;
     void getBoundingSphere(Vector3 &center, Scalar &radius) const;
+    /**
+     * 境界ボックスが matrix の視錐台と交差する場合に true を返します。
+     *
+     * matrix はワールド・ビュー・射影行列を掛け合わせた OpenGL 形式 (列優先) の行列です。
+     * 視錐台カリングに使用し、false の場合はスキニングと描画を省略できます。
+     *
+     * @param matrix
+     * @return bool
+     * @sa getBoundingBox
+     */
+    bool isInsideFrustum(const float *matrix) const;
 
     bool preparse(const uint8_t *data, size_t size, DataInfo &info);
     void setVisible(bool value);
 
     const void *vertexPtr() const;
     const void *indicesPtr() const;
+    /**
+     * indicesPtr が返すインデックスの1要素あたりの大きさを返します。
+     *
+     * 頂点数が 65536 以下のモデルは 2 (uint16_t) 、それ以外は 4 (uint32_t) を返します。
+     *
+     * @return size_t
+     */
+    size_t indexStrideSize() const;
+    /**
+     * 頂点キャッシュの効率が上がるように材質毎に三角形の順番を並べ替えます。
+     *
+     * 材質の描画範囲は変わりませんが、同じ材質内の三角形の描画順が変わるため、
+     * 描画順に依存する半透明の材質を持つモデルでは見た目が変わる可能性があります。
+     * 並べ替えた結果は indices と indicesPtr の両方に反映されます。
+     * 並べ替えても頂点キャッシュのミスが減らない材質は元の順番のままにします。
+     */
+    void optimizeIndices();
+    /**
+     * 指定された大きさの FIFO の頂点キャッシュにおける三角形あたりの平均キャッシュミス数 (ACMR) を返します。
+     *
+     * @param int
+     * @return Scalar
+     */
+    Scalar averageCacheMissRatio(int cacheSize) const;
+    /**
+     * 同じデータから読み込まれ、索引の並びも同じモデルかを返します。
+     *
+     * 真を返すモデル同士は頂点、索引、材質及びモーフの構成が同一のため、
+     * 描画に使う索引やテクスチャなどの変化しないリソースを共有することができます。
+     * 読み込んだデータの大きさとハッシュが一致した場合は、共有する内容を要素毎に比較して確かめます。
+     *
+     * @param Model
+     * @return bool
+     */
+    bool hasSameSource(const Model *value) const;
+    /**
+     * 材質モーフを適用した全ての材質の値を返します。
+     *
+     * 材質モーフの寄与は resetVertices で取り除かれるため、頂点モーフと同様にモーフの重みを再設定する必要があります。
+     * pmx::Material の値は読み込み時のまま変化しないため、描画には常にこちらの値を使用します。
+     *
+     * @return MaterialParameterBuffer
+     */
+    const MaterialParameterBuffer *materialParameters() const;
+    const void *packedVertexPtr() const;
+    const void *packedUVA1Ptr() const;
+    void getPackedStaticVertices(uint8_t *data) const;
     Scalar edgeScaleFactor(const Vector3 &cameraPosition) const;
 
     Type type() const { return kPMX; }
@@ -178,6 +291,7 @@ public:
     const IString *comment() const { return m_comment; }
     const IString *englishComment() const { return m_englishComment; }
     Error error() const { return m_info.error; }
+    const DataInfo &dataInfo() const { return m_info; }
     bool isVisible() const { return m_visible && !btFuzzyZero(m_opacity); }
 
     void setName(const IString *value);
@@ -219,6 +333,18 @@ public:
     void getSkinningMesh(SkinningMeshes &meshes) const;
     void updateSkinningMesh(SkinningMeshes &meshes) const;
     void setSkinningEnable(bool value);
+    bool isSkinningEnabled() const;
+
+    /**
+     * 圧縮した頂点形式の頂点を performUpdate で同時に更新するかを設定します。
+     *
+     * 有効にすると packedVertexPtr と packedUVA1Ptr が利用可能になります。
+     * 追加 UV を持たないモデルでは packedUVA1Ptr は常に null を返します。
+     *
+     * @param bool
+     */
+    void setPackedVertexEnable(bool value);
+    bool isPackedVertexEnabled() const;
 
 private:
     void release();
@@ -232,9 +358,20 @@ private:
     void parseLabels(const DataInfo &info);
     void parseRigidBodies(const DataInfo &info);
     void parseJoints(const DataInfo &info);
+    void packVertex(int index);
+    void buildSkinnedIndices();
+    void buildBoneBounds();
+    void compileMorphs();
 
     btDiscreteDynamicsWorld *m_worldRef;
     IEncoding *m_encodingRef;
+    Vertex *m_vertexPool;
+    Material *m_materialPool;
+    Bone *m_bonePool;
+    Morph *m_morphPool;
+    Label *m_labelPool;
+    RigidBody *m_rigidBodyPool;
+    Joint *m_jointPool;
     Array<Vertex *> m_vertices;
     Array<int> m_indices;
     Array<IString *> m_textures;
@@ -248,8 +385,19 @@ private:
     Array<Joint *> m_joints;
     Hash<HashString, IBone *> m_name2boneRefs;
     Hash<HashString, IMorph *> m_name2morphRefs;
+    Array<const Material *> m_vertexMaterialRefs;
+    Array<Vector3> m_boneBoundsMin;
+    Array<Vector3> m_boneBoundsMax;
     SkinnedVertex *m_skinnedVertices;
-    int *m_skinnedIndices;
+    Vector3 *m_morphDeltas;
+    MaterialParameterBuffer *m_materialParameters;
+    PackedVertex *m_packedVertices;
+    Vector4 *m_packedUVA1s;
+    uint8_t *m_skinnedIndices;
+    size_t m_indexStrideSize;
+    size_t m_sourceSize;
+    uint32_t m_sourceHash;
+    int m_sourceRevision;
     IString *m_name;
     IString *m_englishName;
     IString *m_comment;
@@ -45,6 +45,8 @@ namespace vpvl2
 namespace pmx
 {
 
+class MaterialParameterBuffer;
+
 /**
  * @file
  * @author hkrn
@@ -167,11 +169,48 @@ public:
     void setType(Type value);
     void setIndex(int value);
 
+    /**
+     * 頂点モーフを頂点の番号順に並べた索引と移動量の配列に変換します。
+     *
+     * 変換後の setWeight は pmx::Vertex::mergeMorph を呼び出さず、頂点数分の大きさを持つ deltas に
+     * 移動量を直接加算します。同じ頂点を複数回参照する場合は移動量を合算します。
+     * deltas はモーフより長く存在する必要があり、addVertexMorph を呼び出すと変換前の方法に戻ります。
+     *
+     * 重複や範囲外の頂点が無く変換後の配列から元に戻せる場合は Morph::Vertex を解放します。
+     * 解放した Morph::Vertex は vertices を呼び出した時に作り直し、保存時は変換後の配列から直接書き出します。
+     *
+     * @param Vector3
+     * @param int
+     */
+    void compileVertices(Vector3 *deltas, int nvertices);
+    /**
+     * グループモーフを末端のモーフとその重みの組に展開します。
+     *
+     * 展開後の setWeight は入れ子のグループを辿らずに末端のモーフにのみ適用します。
+     * 循環する参照は辿らずに無視し、その数を返します。addGroupMorph でモーフを追加した場合は
+     * 再度呼び出す必要があります。
+     *
+     * @param Array<Morph>
+     * @return int
+     */
+    static int compileGroups(const Array<Morph *> &morphs);
+    /**
+     * 材質モーフの適用先を材質毎の値をまとめたバッファに切り替えます。
+     *
+     * 切り替え後の setWeight は pmx::Material::mergeMorph を呼び出さず、buffer に寄与を累積します。
+     * buffer はモーフより長く存在する必要があり、addMaterialMorph を呼び出すと切り替え前の方法に戻ります。
+     *
+     * @param MaterialParameterBuffer
+     */
+    void compileMaterials(MaterialParameterBuffer *buffer);
+    int countFlattenedMorphs() const { return m_flattenedGroups.count(); }
+    int countCompiledVertices() const { return m_compiledVertexIndices.count(); }
+
     const Array<Bone *> &bones() const { return m_bones; }
     const Array<Group *> &groups() const { return m_groups; }
     const Array<Material *> &materials() const { return m_materials; }
     const Array<UV *> &uvs() const { return m_uvs; }
-    const Array<Vertex *> &vertices() const { return m_vertices; }
+    const Array<Vertex *> &vertices() const;
 
 private:
     static bool loadBones(const Array<pmx::Bone *> &bones, Morph *morph);
@@ -179,6 +218,8 @@ private:
     static bool loadMaterials(const Array<pmx::Material *> &materials, Morph *morph);
     static bool loadUVs(const Array<pmx::Vertex *> &vertices, int offset, Morph *morph);
     static bool loadVertices(const Array<pmx::Vertex *> &vertices, Morph *morph);
+    static void flattenGroup(Morph *morph, Hash<HashPtr, int> &states, int &ncycles);
+    void addFlattenedMorph(Morph *morph, float weight);
     void readBones(const Model::DataInfo &info, int count, uint8_t *&ptr);
     void readGroups(const Model::DataInfo &info, int count, uint8_t *&ptr);
     void readMaterials(const Model::DataInfo &info, int count, uint8_t *&ptr);
@@ -189,12 +230,23 @@ private:
     void writeMaterials(const Model::DataInfo &info, uint8_t *&ptr) const;
     void writeUVs(const Model::DataInfo &info, uint8_t *&ptr) const;
     void writeVertices(const Model::DataInfo &info, uint8_t *&ptr) const;
+    void restoreVertices() const;
+    int countVertices() const;
 
-    Array<Vertex *> m_vertices;
+    mutable Array<Vertex *> m_vertices;
     Array<UV *> m_uvs;
     Array<Bone *> m_bones;
     Array<Material *> m_materials;
     Array<Group *> m_groups;
+    Array<int> m_compiledVertexIndices;
+    Array<Vector3> m_compiledVertexDeltas;
+    Array<pmx::Vertex *> m_compiledVertexRefs;
+    Array<int> m_compiledVertexOrder;
+    Vector3 *m_vertexDeltasRef;
+    mutable bool m_hasReleasedVertices;
+    Array<Group> m_flattenedGroups;
+    bool m_hasFlattenedGroups;
+    MaterialParameterBuffer *m_materialParametersRef;
     IString *m_name;
     IString *m_englishName;
     WeightPrecision m_weight;
@@ -91,6 +91,15 @@ public:
     void mergeMorph(const Morph::UV *morph, float weight);
     void mergeMorph(const Morph::Vertex *morph, float weight);
     void performSkinning(Vector3 &position, Vector3 &normal);
+    /**
+     * delta () に加えて指定された移動量を足した位置で頂点を変形します。
+     *
+     * @param Vector3
+     * @param Vector3
+     * @param Vector3
+     * @sa pmx::Morph::compileVertices
+     */
+    void performSkinning(const Vector3 &delta, Vector3 &position, Vector3 &normal);
 
     const Vector3 &origin() const { return m_origin; }
     const Vector3 &delta() const { return m_morphDelta; }
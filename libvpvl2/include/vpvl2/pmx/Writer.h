@@ -0,0 +1,184 @@
+/* ----------------------------------------------------------------- */
+/*                                                                   */
+/*  Copyright (c) 2010-2012  hkrn                                    */
+/*                                                                   */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/* - Redistributions of source code must retain the above copyright  */
+/*   notice, this list of conditions and the following disclaimer.   */
+/* - Redistributions in binary form must reproduce the above         */
+/*   copyright notice, this list of conditions and the following     */
+/*   disclaimer in the documentation and/or other materials provided */
+/*   with the distribution.                                          */
+/* - Neither the name of the MMDAI project team nor the names of     */
+/*   its contributors may be used to endorse or promote products     */
+/*   derived from this software without specific prior written       */
+/*   permission.                                                     */
+/*                                                                   */
+/* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND            */
+/* CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,       */
+/* INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF          */
+/* MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE          */
+/* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS */
+/* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,          */
+/* EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED   */
+/* TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,     */
+/* DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON */
+/* ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,   */
+/* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY    */
+/* OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE           */
+/* POSSIBILITY OF SUCH DAMAGE.                                       */
+/* ----------------------------------------------------------------- */
+
+#ifndef VPVL2_PMX_WRITER_H_
+#define VPVL2_PMX_WRITER_H_
+
+#include "vpvl2/pmx/Model.h"
+
+#include <stdio.h>
+
+namespace vpvl2
+{
+namespace pmx
+{
+
+/**
+ * @file
+ * @author hkrn
+ *
+ * @section DESCRIPTION
+ *
+ * Writer class serializes a Polygon Model Extended object to a sink in chunks.
+ */
+
+class VPVL2_API Writer
+{
+public:
+    /**
+     * 書き出されたデータを受け取るインターフェースです。
+     */
+    class ISink
+    {
+    public:
+        virtual ~ISink() {}
+        /**
+         * 書き出されたデータを受け取ります。
+         *
+         * 失敗した場合は false を返すと書き出しを中断します。
+         *
+         * @param uint8_t
+         * @param size_t
+         * @return bool
+         */
+        virtual bool write(const uint8_t *data, size_t size) = 0;
+    };
+    /**
+     * 予め確保したメモリ領域に書き出すシンクです。
+     */
+    class VPVL2_API MemorySink : public ISink
+    {
+    public:
+        MemorySink(uint8_t *data, size_t size);
+        ~MemorySink();
+
+        bool write(const uint8_t *data, size_t size);
+        size_t written() const { return m_written; }
+
+    private:
+        uint8_t *m_data;
+        size_t m_size;
+        size_t m_written;
+
+        VPVL2_DISABLE_COPY_AND_ASSIGN(MemorySink)
+    };
+    /**
+     * 開かれたファイルに書き出すシンクです。ファイルは閉じません。
+     */
+    class VPVL2_API FileSink : public ISink
+    {
+    public:
+        FileSink(FILE *fp);
+        ~FileSink();
+
+        bool write(const uint8_t *data, size_t size);
+
+    private:
+        FILE *m_fp;
+
+        VPVL2_DISABLE_COPY_AND_ASSIGN(FileSink)
+    };
+
+    static const size_t kDefaultChunkSize = 65536;
+
+    /**
+     * Constructor
+     *
+     * 書き出し中にモデルを変更することはありません。
+     *
+     * @param Model
+     */
+    Writer(const Model *model);
+    ~Writer();
+
+    /**
+     * 書き出した場合のバイト数を返します。
+     *
+     * @return size_t
+     */
+    size_t estimateSize();
+    /**
+     * モデルを sink に書き出します。
+     *
+     * 書き出しは chunkSize 単位 (1要素がそれより大きい場合はその要素の大きさ) で sink に渡されます。
+     *
+     * @param ISink
+     * @return bool
+     */
+    bool write(ISink *sink);
+
+    /**
+     * 頂点や各要素の番号の大きさを要素数から求まる最小の大きさにするかを設定します。
+     *
+     * 無効の場合は読み込み時の大きさを使用します。
+     *
+     * @param bool
+     */
+    void setIndexSizeNarrowingEnable(bool value);
+    /**
+     * テクスチャのテーブルから同じパスを持つ項目を取り除くかを設定します。
+     *
+     * @param bool
+     */
+    void setTextureDeduplicationEnable(bool value);
+    void setChunkSize(size_t value);
+
+private:
+    void buildDataInfo(Model::DataInfo &info) const;
+    void buildTextureTable();
+    bool writeMaterials(ISink *sink, const Model::DataInfo &info);
+    bool flush(ISink *sink);
+    bool reserve(ISink *sink, size_t size, uint8_t *&ptr);
+    template<typename T>
+    bool writeElements(ISink *sink, const Array<T *> &elements, const Model::DataInfo &info);
+
+    const Model *m_modelRef;
+    Array<const IString *> m_textureRefs;
+    Array<int> m_textureIndices;
+    uint8_t *m_chunk;
+    size_t m_chunkCapacity;
+    size_t m_chunkOffset;
+    size_t m_chunkSize;
+    bool m_enableIndexSizeNarrowing;
+    bool m_enableTextureDeduplication;
+
+    VPVL2_DISABLE_COPY_AND_ASSIGN(Writer)
+};
+
+} /* namespace pmx */
+} /* namespace vpvl2 */
+
+#endif
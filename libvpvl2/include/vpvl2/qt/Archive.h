@@ -42,6 +42,8 @@
 
 #include <QtCore/QByteArray>
 #include <QtCore/QHash>
+#include <QtCore/QList>
+#include <QtCore/QMutex>
 #include <QtCore/QString>
 
 namespace vpvl2
@@ -59,13 +61,17 @@ public:
         kGoToFirstFileError,
         kOpenCurrentFileError,
         kReadCurrentFileError,
-        kCloseCurrentFileError
+        kCloseCurrentFileError,
+        kGoToFilePosError,
+        kInflateError
     };
 
     Archive();
     ~Archive();
 
     void setTextCodec(QTextCodec *value);
+    void setLazyUncompress(bool value);
+    void setMaxCacheSize(qint64 value);
     bool open(const QString &filename, QStringList &entryNames);
     bool close();
     bool uncompress(const QStringList &entryNames);
@@ -73,13 +79,44 @@ public:
     ErrorType error() const;
     const QStringList entryNames() const;
     const QByteArray data(const QString &name) const;
+    qint64 cacheSize() const;
 
 private:
+    struct Entry {
+        Entry() : method(0), compressedSize(0), uncompressedSize(0) {
+            position.pos_in_zip_directory = 0;
+            position.num_of_file = 0;
+        }
+        unz64_file_pos position;
+        int method;
+        ZPOS64_T compressedSize;
+        ZPOS64_T uncompressedSize;
+    };
+    struct InflateTask {
+        QString name;
+        Entry entry;
+        QByteArray compressed;
+        QByteArray uncompressed;
+        bool ok;
+    };
+
+    static void inflateAsync(InflateTask &task);
+    static bool inflateRaw(const QByteArray &compressed, const Entry &entry, QByteArray &uncompressed);
+    bool readRaw(const Entry &entry, QByteArray &compressed) const;
+    void addCache(const QString &name, const QByteArray &bytes) const;
+
     unzFile m_file;
     unz_global_info64 m_header;
-    ErrorType m_error;
+    mutable ErrorType m_error;
     QTextCodec *m_codec;
-    QHash<QString, QByteArray> m_entries;
+    QHash<QString, Entry> m_index;
+    QHash<QString, QString> m_requested;
+    mutable QHash<QString, QByteArray> m_entries;
+    mutable QList<QString> m_recentlyUsed;
+    mutable QMutex m_lock;
+    mutable qint64 m_cacheSize;
+    qint64 m_maxCacheSize;
+    bool m_lazy;
 
     VPVL2_DISABLE_COPY_AND_ASSIGN(Archive)
 };
@@ -50,6 +50,7 @@ class Scene;
 namespace qt
 {
 class Archive;
+class TextureDiskCache;
 
 class Delegate : public IRenderDelegate, protected QGLFunctions
 {
@@ -59,12 +60,14 @@ public:
         TextureCache(int w, int h, GLuint i)
             : width(w),
               height(h),
-              id(i)
+              id(i),
+              opaque(false)
         {
         }
         int width;
         int height;
         GLuint id;
+        bool opaque;
     };
     struct PrivateContext {
         QHash<QString, TextureCache> textureCache;
@@ -78,6 +81,7 @@ public:
 
     static QString readAllAsync(const QString &path);
     static QImage loadImageAsync(const QString &path);
+    QImage decodeImageAsync(const QString &path, QByteArray bytes);
 
     Delegate(const QHash<QString, QString> &settings, Scene *scene, QGLWidget *context);
     ~Delegate();
@@ -88,6 +92,7 @@ public:
     void getToonColor(const IString *name, const IString *dir, Color &value, void * /* context */);
     void uploadAnimatedTexture(float offset, float speed, float seek, void *texture);
     void getMatrix(float value[], const IModel *model, int flags) const;
+    void getMatrices(float *values, const IModel *model, const int *flags, int nflags) const;
     void getViewport(Vector3 &value) const;
     void getTime(float &value, bool sync) const;
     void getElapsed(float &value, bool sync) const;
@@ -105,6 +110,8 @@ public:
     void releaseRenderColorTarget(void *texture, size_t width, size_t height, int index, bool enableAA);
     void releaseRenderDepthStencilTarget(void *texture, void *depth, void *stencil, size_t width, size_t height, bool enableAA);
 
+    int uploadPendingTextures(qint64 budget);
+    void waitForPendingTextures();
     void setArchive(Archive *value);
     void setScenePtr(Scene *value);
     void updateMatrices(const QSizeF &size);
@@ -112,6 +119,7 @@ public:
     void setCameraModelMatrix(const QMatrix4x4 &value);
     void getLightMatrices(QMatrix4x4 &world, QMatrix4x4 &view, QMatrix4x4 &projection);
     void setLightMatrices(const QMatrix4x4 &world, const QMatrix4x4 &view, const QMatrix4x4 &projection);
+    void invalidateMatrixCache();
     void setMousePosition(const Vector3 &value, bool pressed, MousePositionType type);
     void addModelPath(IModel *model, const QString &filename);
     const QString findModelPath(const IModel *model) const;
@@ -131,6 +139,18 @@ public:
 
 private:
     class FrameBufferObject;
+    struct PendingTexture {
+        QFuture<QImage> future;
+        QString path;
+        GLuint textureID;
+        bool mipmap;
+    };
+    typedef QPair<const IModel *, int> MatrixCacheKey;
+    struct MatrixCache {
+        enum { kStateSize = 27 };
+        float value[16];
+        Scalar state[kStateSize];
+    };
 
     static const QString createPath(const IString *dir, const QString &name);
     static const QString createPath(const IString *dir, const IString *name);
@@ -139,7 +159,10 @@ private:
     static QImage loadTGA(const QString &path, QScopedArrayPointer<uint8_t> &dataPtr);
     static QImage loadTGA(QByteArray data, QScopedArrayPointer<uint8_t> &dataPtr);
     static QGLContext::BindOptions textureBindOptions(bool enableMipmap);
+    static void getMatrixCacheState(const IModel *model, const ILight *light, Scalar *state);
     QImage createImageFromArchive(const QFileInfo &info);
+    bool uploadTextureAsync(const QString &path, const QFileInfo &info, bool mipmap, Texture &texture, void *context);
+    void uploadDecodedImage(GLuint textureID, const QImage &image, bool mipmap);
     bool uploadTextureInternal(const QString &path,
                                Texture &texture,
                                bool isToon,
@@ -149,6 +172,7 @@ private:
                                void *context);
     void getToonColorInternal(const QString &path, bool isSystem, Color &value, bool &ok);
     FrameBufferObject *findRenderTarget(const GLuint textureID, size_t width, size_t height);
+    void getMatrixInternal(float value[], const IModel *model, int flags) const;
 
     const QHash<QString, QString> m_settings;
     const QDir m_systemDir;
@@ -159,12 +183,16 @@ private:
     mutable QMutex m_effectCachesLock;
     QGLWidget *m_context;
     Archive *m_archive;
+    TextureDiskCache *m_textureDiskCache;
     QSizeF m_viewport;
     QList<OffscreenRenderTarget> m_offscreens;
     QHash<const IModel *, QString> m_model2Paths;
     QHash<const QString, IModel *> m_filename2Models;
     QHash<GLuint, QString> m_texture2Paths;
     QHash<GLuint, QMovie *> m_texture2Movies;
+    QList<PendingTexture> m_pendingTextures;
+    QCache<QByteArray, QImage> m_decodedImages;
+    QMutex m_decodedImagesLock;
     QHash<GLuint, FrameBufferObject *> m_renderTargets;
     QHash<const QString, IEffect *> m_effectCaches;
     QHash<const IEffect *, QString> m_effectOwners;
@@ -176,12 +204,14 @@ private:
     QMatrix4x4 m_cameraModelMatrix;
     QMatrix4x4 m_cameraViewMatrix;
     QMatrix4x4 m_cameraProjectionMatrix;
+    mutable QHash<MatrixCacheKey, MatrixCache> m_matrixCache;
     QElapsedTimer m_timer;
     Vector4 m_mouseCursorPosition;
     Vector4 m_mouseLeftPressPosition;
     Vector4 m_mouseMiddlePressPosition;
     Vector4 m_mouseRightPressPosition;
     int m_msaaSamples;
+    bool m_enableAsyncTexture;
 
     VPVL2_DISABLE_COPY_AND_ASSIGN(Delegate)
 };
@@ -0,0 +1,94 @@
+/* ----------------------------------------------------------------- */
+/*                                                                   */
+/*  Copyright (c) 2010-2012  hkrn                                    */
+/*                                                                   */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/* - Redistributions of source code must retain the above copyright  */
+/*   notice, this list of conditions and the following disclaimer.   */
+/* - Redistributions in binary form must reproduce the above         */
+/*   copyright notice, this list of conditions and the following     */
+/*   disclaimer in the documentation and/or other materials provided */
+/*   with the distribution.                                          */
+/* - Neither the name of the MMDAI project team nor the names of     */
+/*   its contributors may be used to endorse or promote products     */
+/*   derived from this software without specific prior written       */
+/*   permission.                                                     */
+/*                                                                   */
+/* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND            */
+/* CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,       */
+/* INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF          */
+/* MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE          */
+/* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS */
+/* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,          */
+/* EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED   */
+/* TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,     */
+/* DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON */
+/* ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,   */
+/* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY    */
+/* OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE           */
+/* POSSIBILITY OF SUCH DAMAGE.                                       */
+/* ----------------------------------------------------------------- */
+
+#ifndef VPVL2_QT_TEXTUREDISKCACHE_H_
+#define VPVL2_QT_TEXTUREDISKCACHE_H_
+
+#include "vpvl2/Common.h"
+
+#include <QtOpenGL/QtOpenGL>
+
+namespace vpvl2
+{
+namespace qt
+{
+
+/**
+ * デコード済みのテクスチャをミップマップ込みでディスクに保存するキャッシュです。
+ *
+ * キャッシュはソースのパスから求めたファイル名で保存され、ソースの更新日時とサイズが一致するか、
+ * 一致しない場合でもソースの内容の MD5 が一致すれば有効とみなし、キャッシュに記録された更新日時を書き換えます。
+ * キャッシュは mmap で読み込まれるため、デコードを行わずに直接転送することが出来ます。
+ * また、テクスチャが完全に不透明であるかどうかも記録されるため、読み込み時に画素を走査し直す必要はありません。
+ */
+class TextureDiskCache
+{
+public:
+    TextureDiskCache(const QDir &dir);
+    ~TextureDiskCache();
+
+    bool load(const QString &path, bool mipmap, GLuint &textureID, size_t &width, size_t &height, bool &opaque) const;
+    bool store(const QString &path, const QByteArray &hash, const QImage &image) const;
+    void clear();
+
+    static bool isOpaqueImage(const QImage &image);
+
+private:
+    struct Header {
+        uint8_t magic[4];
+        uint32_t version;
+        uint32_t width;
+        uint32_t height;
+        uint32_t mipmapCount;
+        uint32_t flags;
+        int64_t modified;
+        int64_t size;
+        uint8_t hash[16];
+    };
+
+    static size_t levelSize(uint32_t width, uint32_t height, uint32_t level);
+    static void downsample(const uint8_t *src, uint32_t width, uint32_t height, uint8_t *dst);
+    const QString cacheFilePath(const QString &path) const;
+
+    const QDir m_dir;
+
+    VPVL2_DISABLE_COPY_AND_ASSIGN(TextureDiskCache)
+};
+
+}
+}
+
+#endif
@@ -53,12 +53,12 @@ public:
     BaseKeyframe()
         : m_namePtr(0),
           m_timeIndex(0),
-          m_layerIndex(0)
+          m_layerIndex(0),
+          m_sharedName(false)
     {
     }
     virtual ~BaseKeyframe() {
-        delete m_namePtr;
-        m_namePtr = 0;
+        releaseName();
         m_timeIndex = 0;
         m_layerIndex = 0;
     }
@@ -70,9 +70,52 @@ public:
     void setLayerIndex(const LayerIndex &value) { m_layerIndex = value; }
 
 protected:
+    /**
+     * 名前を複製して保持します。
+     *
+     * @param IString
+     */
+    void copyName(const IString *value) {
+        if (value && value != m_namePtr) {
+            IString *name = value->clone();
+            releaseName();
+            m_namePtr = name;
+        }
+    }
+    /**
+     * 名前の所有権を受け取ります。
+     *
+     * @param IString
+     */
+    void adoptName(IString *value) {
+        if (value && value != m_namePtr) {
+            releaseName();
+            m_namePtr = value;
+        }
+    }
+    /**
+     * NameTable が所有する名前を複製せずに参照します。
+     *
+     * @param IString
+     */
+    void shareName(IString *value) {
+        if (value && value != m_namePtr) {
+            releaseName();
+            m_namePtr = value;
+            m_sharedName = true;
+        }
+    }
+    void releaseName() {
+        if (!m_sharedName)
+            delete m_namePtr;
+        m_namePtr = 0;
+        m_sharedName = false;
+    }
+
     IString *m_namePtr;
     TimeIndex m_timeIndex;
     LayerIndex m_layerIndex;
+    bool m_sharedName;
 
     VPVL2_DISABLE_COPY_AND_ASSIGN(BaseKeyframe)
 };
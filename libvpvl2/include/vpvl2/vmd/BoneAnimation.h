@@ -42,6 +42,7 @@
 #include "vpvl2/IModel.h"
 #include "vpvl2/vmd/BaseAnimation.h"
 #include "vpvl2/vmd/BaseKeyframe.h"
+#include "vpvl2/vmd/NameTable.h"
 
 namespace vpvl2
 {
@@ -94,6 +95,7 @@ private:
     void calculateFrames(const IKeyframe::TimeIndex &frameAt, InternalBoneKeyFrameList *keyFrames);
 
     IEncoding *m_encodingRef;
+    NameTable m_nameTable;
     Hash<HashString, InternalBoneKeyFrameList *> m_name2keyframes;
     IModel *m_modelRef;
     bool m_enableNullFrame;
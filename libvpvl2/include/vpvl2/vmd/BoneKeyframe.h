@@ -48,6 +48,7 @@ class IEncoding;
 
 namespace vmd
 {
+class NameTable;
 
 class VPVL2_API BoneKeyframe : public BaseKeyframe, public IBoneKeyframe
 {
@@ -62,6 +63,7 @@ public:
     static const QuadWord kDefaultInterpolationParameterValue;
 
     void read(const uint8_t *data);
+    void read(const uint8_t *data, NameTable *nameTable);
     void write(uint8_t *data) const;
     size_t estimateSize() const;
     IBoneKeyframe *clone() const;
@@ -41,6 +41,7 @@
 
 #include "vpvl2/IModel.h"
 #include "vpvl2/vmd/BaseAnimation.h"
+#include "vpvl2/vmd/NameTable.h"
 
 namespace vpvl2
 {
@@ -85,6 +86,7 @@ private:
     void calculateFrames(const IKeyframe::TimeIndex &frameAt, InternalMorphKeyFrameList *keyFrames);
 
     IEncoding *m_encodingRef;
+    NameTable m_nameTable;
     Hash<HashString, InternalMorphKeyFrameList *> m_name2keyframes;
     IModel *m_modelRef;
     bool m_enableNullFrame;
@@ -48,6 +48,7 @@ class IEncoding;
 
 namespace vmd
 {
+class NameTable;
 
 class VPVL2_API MorphKeyframe : public BaseKeyframe, public IMorphKeyframe
 {
@@ -60,6 +61,7 @@ public:
     static const int kNameSize = 15;
 
     void read(const uint8_t *data);
+    void read(const uint8_t *data, NameTable *nameTable);
     void write(uint8_t *data) const;
     size_t estimateSize() const;
     IMorphKeyframe *clone() const;
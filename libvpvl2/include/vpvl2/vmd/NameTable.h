@@ -0,0 +1,100 @@
+/* ----------------------------------------------------------------- */
+/*                                                                   */
+/*  Copyright (c) 2010-2012  hkrn                                    */
+/*                                                                   */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/* - Redistributions of source code must retain the above copyright  */
+/*   notice, this list of conditions and the following disclaimer.   */
+/* - Redistributions in binary form must reproduce the above         */
+/*   copyright notice, this list of conditions and the following     */
+/*   disclaimer in the documentation and/or other materials provided */
+/*   with the distribution.                                          */
+/* - Neither the name of the MMDAI project team nor the names of     */
+/*   its contributors may be used to endorse or promote products     */
+/*   derived from this software without specific prior written       */
+/*   permission.                                                     */
+/*                                                                   */
+/* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND            */
+/* CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,       */
+/* INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF          */
+/* MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE          */
+/* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS */
+/* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,          */
+/* EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED   */
+/* TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,     */
+/* DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON */
+/* ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,   */
+/* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY    */
+/* OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE           */
+/* POSSIBILITY OF SUCH DAMAGE.                                       */
+/* ----------------------------------------------------------------- */
+
+#ifndef VPVL2_VMD_NAMETABLE_H_
+#define VPVL2_VMD_NAMETABLE_H_
+
+#include "vpvl2/Common.h"
+
+namespace vpvl2
+{
+class IEncoding;
+class IString;
+
+namespace vmd
+{
+
+/**
+ * @file
+ * @author hkrn
+ *
+ * @section DESCRIPTION
+ *
+ * NameTable class interns Shift_JIS keyframe names of a Vocaloid Motion Data object
+ * so that keyframes with the same name share one decoded IString.
+ */
+
+class VPVL2_API NameTable
+{
+public:
+    NameTable(IEncoding *encoding);
+    ~NameTable();
+
+    /**
+     * 生の名前のバイト列に対応する IString を返します。
+     *
+     * 初めての名前の場合はデコードして登録します。返り値は NameTable が所有するため
+     * 解放してはいけません。
+     *
+     * @param uint8_t
+     * @param size_t
+     * @return IString
+     */
+    IString *intern(const uint8_t *name, size_t maxlen);
+
+    /**
+     * 登録されている名前を全て解放します。
+     *
+     */
+    void clear();
+
+    int count() const { return m_entries.count(); }
+
+private:
+    struct Entry;
+    static const size_t kMaxNameSize = 64;
+
+    IEncoding *m_encodingRef;
+    Array<Entry *> m_entries;
+    Hash<HashString, Entry *> m_name2entries;
+
+    VPVL2_DISABLE_COPY_AND_ASSIGN(NameTable)
+};
+
+}
+}
+
+#endif
@@ -55,6 +55,9 @@
 #include "vpvl2/IMotion.h"
 #include "vpvl2/IRenderEngine.h"
 #include "vpvl2/IString.h"
+#include "vpvl2/MotionBlender.h"
+#include "vpvl2/Pose.h"
+#include "vpvl2/PoseCache.h"
 #include "vpvl2/Scene.h"
 
 #ifdef vpvl2_ENABLE_PROJECT
@@ -563,6 +563,7 @@ void UI::paintGL()
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
         return;
     }
+    m_delegate->uploadPendingTextures(m_settings->value("texture.upload.budget", 4194304).toLongLong());
     renderDepth();
     renderOffscreen();
     renderWindow();
@@ -433,6 +433,10 @@ public:
             m = glm::transpose(m);
         memcpy(value, glm::value_ptr(m), sizeof(float) * 16);
     }
+    void getMatrices(float *values, const IModel *model, const int *flags, int nflags) const {
+        for (int i = 0; i < nflags; i++)
+            getMatrix(values + i * 16, model, flags[i]);
+    }
     void log(void * /* context */, LogLevel /* level */, const char *format, va_list ap) {
         char buf[1024];
         vsnprintf(buf, sizeof(buf), format, ap);
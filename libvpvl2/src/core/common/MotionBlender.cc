@@ -0,0 +1,325 @@
+/* ----------------------------------------------------------------- */
+/*                                                                   */
+/*  Copyright (c) 2010-2012  hkrn                                    */
+/*                                                                   */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/* - Redistributions of source code must retain the above copyright  */
+/*   notice, this list of conditions and the following disclaimer.   */
+/* - Redistributions in binary form must reproduce the above         */
+/*   copyright notice, this list of conditions and the following     */
+/*   disclaimer in the documentation and/or other materials provided */
+/*   with the distribution.                                          */
+/* - Neither the name of the MMDAI project team nor the names of     */
+/*   its contributors may be used to endorse or promote products     */
+/*   derived from this software without specific prior written       */
+/*   permission.                                                     */
+/*                                                                   */
+/* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND            */
+/* CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,       */
+/* INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF          */
+/* MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE          */
+/* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS */
+/* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,          */
+/* EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED   */
+/* TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,     */
+/* DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON */
+/* ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,   */
+/* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY    */
+/* OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE           */
+/* POSSIBILITY OF SUCH DAMAGE.                                       */
+/* ----------------------------------------------------------------- */
+
+#include "vpvl2/vpvl2.h"
+#include "vpvl2/MotionBlender.h"
+
+namespace vpvl2
+{
+
+struct MotionBlender::Layer {
+    Layer(IMotion *m, BlendMode b)
+        : motion(m),
+          mode(b),
+          weight(1),
+          targetWeight(1),
+          fadeSpeed(0)
+    {
+    }
+    IMotion *motion;
+    BlendMode mode;
+    Scalar weight;
+    Scalar targetWeight;
+    Scalar fadeSpeed;
+    Array<Scalar> boneMasks;
+    Array<Scalar> morphMasks;
+    Array<Vector3> positions;
+    Array<Quaternion> rotations;
+    Array<Scalar> weights;
+};
+
+MotionBlender::MotionBlender(IModel *model)
+    : m_modelRef(model)
+{
+    m_modelRef->getBones(m_bones);
+    m_modelRef->getMorphs(m_morphs);
+    m_positions.resize(m_bones.count());
+    m_rotations.resize(m_bones.count());
+    m_weights.resize(m_morphs.count());
+}
+
+MotionBlender::~MotionBlender()
+{
+    removeAllLayers();
+    m_modelRef = 0;
+}
+
+int MotionBlender::addLayer(IMotion *motion, BlendMode mode)
+{
+    Layer *layer = new Layer(motion, mode);
+    const int nbones = m_bones.count(), nmorphs = m_morphs.count();
+    layer->boneMasks.resize(nbones);
+    layer->positions.resize(nbones);
+    layer->rotations.resize(nbones);
+    for (int i = 0; i < nbones; i++)
+        layer->boneMasks[i] = 0;
+    layer->morphMasks.resize(nmorphs);
+    layer->weights.resize(nmorphs);
+    for (int i = 0; i < nmorphs; i++)
+        layer->morphMasks[i] = 0;
+    /* キーフレームを持たない要素は下のレイヤーの結果をそのまま使うようにマスクを作る */
+    const int nBoneKeyframes = motion->countKeyframes(IKeyframe::kBone);
+    for (int i = 0; i < nBoneKeyframes; i++) {
+        const IBoneKeyframe *keyframe = motion->findBoneKeyframeAt(i);
+        const int index = findBoneIndex(m_modelRef->findBone(keyframe->name()));
+        if (index >= 0)
+            layer->boneMasks[index] = 1;
+    }
+    const int nMorphKeyframes = motion->countKeyframes(IKeyframe::kMorph);
+    for (int i = 0; i < nMorphKeyframes; i++) {
+        const IMorphKeyframe *keyframe = motion->findMorphKeyframeAt(i);
+        const int index = findMorphIndex(m_modelRef->findMorph(keyframe->name()));
+        if (index >= 0)
+            layer->morphMasks[index] = 1;
+    }
+    m_layers.add(layer);
+    return m_layers.count() - 1;
+}
+
+void MotionBlender::removeLayer(int index)
+{
+    if (index >= 0 && index < m_layers.count()) {
+        Layer *layer = m_layers[index];
+        m_layers.remove(layer);
+        delete layer;
+    }
+}
+
+void MotionBlender::removeAllLayers()
+{
+    m_layers.releaseAll();
+}
+
+void MotionBlender::seek(const IKeyframe::TimeIndex &timeIndex)
+{
+    const int nlayers = m_layers.count();
+    for (int i = 0; i < nlayers; i++)
+        sampleLayer(m_layers[i], timeIndex, true);
+    blendLayers();
+}
+
+void MotionBlender::advance(const IKeyframe::TimeIndex &deltaTimeIndex)
+{
+    const int nlayers = m_layers.count();
+    for (int i = 0; i < nlayers; i++) {
+        Layer *layer = m_layers[i];
+        if (layer->fadeSpeed > 0) {
+            const Scalar step = layer->fadeSpeed * Scalar(btFabs(Scalar(deltaTimeIndex)));
+            const Scalar &target = layer->targetWeight;
+            if (btFabs(target - layer->weight) <= step) {
+                layer->weight = target;
+                layer->fadeSpeed = 0;
+            }
+            else {
+                layer->weight += layer->weight < target ? step : -step;
+            }
+        }
+        sampleLayer(layer, deltaTimeIndex, false);
+    }
+    blendLayers();
+}
+
+void MotionBlender::fadeLayer(int index, const Scalar &weight, const IKeyframe::TimeIndex &duration)
+{
+    if (index >= 0 && index < m_layers.count()) {
+        Layer *layer = m_layers[index];
+        layer->targetWeight = weight;
+        if (duration > 0) {
+            layer->fadeSpeed = btFabs(weight - layer->weight) / Scalar(duration);
+        }
+        else {
+            layer->weight = weight;
+            layer->fadeSpeed = 0;
+        }
+    }
+}
+
+void MotionBlender::setLayerWeight(int index, const Scalar &value)
+{
+    fadeLayer(index, value, 0);
+}
+
+void MotionBlender::setLayerBoneMask(int index, const IBone *bone, const Scalar &value)
+{
+    const int boneIndex = findBoneIndex(bone);
+    if (index >= 0 && index < m_layers.count() && boneIndex >= 0)
+        m_layers[index]->boneMasks[boneIndex] = value;
+}
+
+void MotionBlender::setLayerMorphMask(int index, const IMorph *morph, const Scalar &value)
+{
+    const int morphIndex = findMorphIndex(morph);
+    if (index >= 0 && index < m_layers.count() && morphIndex >= 0)
+        m_layers[index]->morphMasks[morphIndex] = value;
+}
+
+void MotionBlender::setLayerBlendMode(int index, BlendMode value)
+{
+    if (index >= 0 && index < m_layers.count())
+        m_layers[index]->mode = value;
+}
+
+IMotion *MotionBlender::layerMotion(int index) const
+{
+    return index >= 0 && index < m_layers.count() ? m_layers[index]->motion : 0;
+}
+
+Scalar MotionBlender::layerWeight(int index) const
+{
+    return index >= 0 && index < m_layers.count() ? m_layers[index]->weight : 0;
+}
+
+void MotionBlender::sampleLayer(Layer *layer, const IKeyframe::TimeIndex &timeIndex, bool seek)
+{
+    /* キーフレームを持たない要素が前のレイヤーの値を引き継がないように初期状態に戻してから取り出す */
+    resetPose();
+    IMotion *motion = layer->motion;
+    if (seek)
+        motion->seek(timeIndex);
+    else
+        motion->advance(timeIndex);
+    const int nbones = m_bones.count();
+    for (int i = 0; i < nbones; i++) {
+        const IBone *bone = m_bones[i];
+        layer->positions[i] = bone->position();
+        layer->rotations[i] = bone->rotation();
+    }
+    const int nmorphs = m_morphs.count();
+    for (int i = 0; i < nmorphs; i++)
+        layer->weights[i] = Scalar(m_morphs[i]->weight());
+}
+
+void MotionBlender::blendLayers()
+{
+    const int nbones = m_bones.count(), nmorphs = m_morphs.count(), nlayers = m_layers.count();
+    const Quaternion &identity = Quaternion::getIdentity();
+    for (int i = 0; i < nbones; i++) {
+        m_positions[i].setZero();
+        m_rotations[i] = identity;
+    }
+    for (int i = 0; i < nmorphs; i++)
+        m_weights[i] = 0;
+    for (int i = 0; i < nlayers; i++) {
+        const Layer *layer = m_layers[i];
+        const Scalar &weight = layer->weight;
+        if (weight <= 0)
+            continue;
+        const bool isAdditive = layer->mode == kAdditiveBlend;
+        for (int j = 0; j < nbones; j++) {
+            const Scalar t = weight * layer->boneMasks[j];
+            if (t <= 0)
+                continue;
+            const Vector3 &position = layer->positions[j];
+            const Quaternion &rotation = layer->rotations[j];
+            if (isAdditive) {
+                m_positions[j] += position * t;
+                m_rotations[j] *= identity.slerp(rotation, btMin(t, Scalar(1)));
+            }
+            else if (t >= 1) {
+                m_positions[j] = position;
+                m_rotations[j] = rotation;
+            }
+            else {
+                m_positions[j] = m_positions[j].lerp(position, t);
+                m_rotations[j] = m_rotations[j].slerp(rotation, t);
+            }
+        }
+        for (int j = 0; j < nmorphs; j++) {
+            const Scalar t = weight * layer->morphMasks[j];
+            if (t <= 0)
+                continue;
+            const Scalar &value = layer->weights[j];
+            if (isAdditive)
+                m_weights[j] += value * t;
+            else
+                m_weights[j] += (value - m_weights[j]) * btMin(t, Scalar(1));
+        }
+    }
+    /* 合成した結果をまとめて書き込む */
+    for (int i = 0; i < nbones; i++) {
+        IBone *bone = m_bones[i];
+        bone->setPosition(m_positions[i]);
+        bone->setRotation(m_rotations[i]);
+    }
+    /*
+     * 頂点モーフ等の移動量は加算されるため、最後に取り出したレイヤーの寄与を取り除いてから書き込む。
+     * 親を持つモーフはグループモーフから重みが設定されるので直接は書き込まない
+     */
+    m_modelRef->resetVertices();
+    for (int i = 0; i < nmorphs; i++) {
+        IMorph *morph = m_morphs[i];
+        if (!morph->hasParent())
+            morph->setWeight(IMorph::WeightPrecision(btClamped(m_weights[i], Scalar(0), Scalar(1))));
+    }
+}
+
+void MotionBlender::resetPose()
+{
+    const int nbones = m_bones.count(), nmorphs = m_morphs.count();
+    for (int i = 0; i < nbones; i++) {
+        IBone *bone = m_bones[i];
+        bone->setPosition(kZeroV3);
+        bone->setRotation(Quaternion::getIdentity());
+    }
+    m_modelRef->resetVertices();
+    for (int i = 0; i < nmorphs; i++) {
+        IMorph *morph = m_morphs[i];
+        if (!morph->hasParent())
+            morph->setWeight(0);
+    }
+}
+
+int MotionBlender::findBoneIndex(const IBone *bone) const
+{
+    const int nbones = m_bones.count();
+    for (int i = 0; i < nbones; i++) {
+        if (m_bones[i] == bone)
+            return i;
+    }
+    return -1;
+}
+
+int MotionBlender::findMorphIndex(const IMorph *morph) const
+{
+    const int nmorphs = m_morphs.count();
+    for (int i = 0; i < nmorphs; i++) {
+        if (m_morphs[i] == morph)
+            return i;
+    }
+    return -1;
+}
+
+} /* namespace vpvl2 */
@@ -0,0 +1,254 @@
+/* ----------------------------------------------------------------- */
+/*                                                                   */
+/*  Copyright (c) 2010-2012  hkrn                                    */
+/*                                                                   */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/* - Redistributions of source code must retain the above copyright  */
+/*   notice, this list of conditions and the following disclaimer.   */
+/* - Redistributions in binary form must reproduce the above         */
+/*   copyright notice, this list of conditions and the following     */
+/*   disclaimer in the documentation and/or other materials provided */
+/*   with the distribution.                                          */
+/* - Neither the name of the MMDAI project team nor the names of     */
+/*   its contributors may be used to endorse or promote products     */
+/*   derived from this software without specific prior written       */
+/*   permission.                                                     */
+/*                                                                   */
+/* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND            */
+/* CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,       */
+/* INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF          */
+/* MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE          */
+/* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS */
+/* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,          */
+/* EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED   */
+/* TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,     */
+/* DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON */
+/* ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,   */
+/* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY    */
+/* OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE           */
+/* POSSIBILITY OF SUCH DAMAGE.                                       */
+/* ----------------------------------------------------------------- */
+
+#include "vpvl2/vpvl2.h"
+#include "vpvl2/Pose.h"
+
+namespace
+{
+
+using namespace vpvl2;
+
+static inline bool IsSameBone(const IBone *bone, const Vector3 &position, const Quaternion &rotation)
+{
+    return bone->position() == position && bone->rotation() == rotation;
+}
+
+static inline bool IsSameWeight(const IMorph::WeightPrecision &a, const IMorph::WeightPrecision &b)
+{
+    return btFuzzyZero(Scalar(a - b));
+}
+
+}
+
+namespace vpvl2
+{
+
+Pose::Pose()
+{
+}
+
+Pose::~Pose()
+{
+    clear();
+}
+
+void Pose::save(const Array<IBone *> &bones, const Array<IMorph *> &morphs)
+{
+    const int nbones = bones.count();
+    m_boneIndices.resize(nbones);
+    m_positions.resize(nbones);
+    m_rotations.resize(nbones);
+    for (int i = 0; i < nbones; i++) {
+        const IBone *bone = bones[i];
+        m_boneIndices[i] = i;
+        m_positions[i] = bone->position();
+        m_rotations[i] = bone->rotation();
+    }
+    const int nmorphs = morphs.count();
+    m_morphIndices.resize(nmorphs);
+    m_weights.resize(nmorphs);
+    for (int i = 0; i < nmorphs; i++) {
+        m_morphIndices[i] = i;
+        m_weights[i] = morphs[i]->weight();
+    }
+}
+
+int Pose::restoreBones(const Array<IBone *> &bones) const
+{
+    int nchanged = 0;
+    const int nbones = m_boneIndices.count(), nAvailableBones = bones.count();
+    for (int i = 0; i < nbones; i++) {
+        const int index = m_boneIndices[i];
+        if (index >= nAvailableBones)
+            break;
+        IBone *bone = bones[index];
+        const Vector3 &position = m_positions[i];
+        const Quaternion &rotation = m_rotations[i];
+        if (!IsSameBone(bone, position, rotation)) {
+            bone->setPosition(position);
+            bone->setRotation(rotation);
+            nchanged++;
+        }
+    }
+    return nchanged;
+}
+
+bool Pose::hasChangedMorphs(const Array<IMorph *> &morphs) const
+{
+    const int nmorphs = m_morphIndices.count(), nAvailableMorphs = morphs.count();
+    for (int i = 0; i < nmorphs; i++) {
+        const int index = m_morphIndices[i];
+        if (index >= nAvailableMorphs)
+            break;
+        if (!IsSameWeight(morphs[index]->weight(), m_weights[i]))
+            return true;
+    }
+    return false;
+}
+
+int Pose::restoreMorphs(const Array<IMorph *> &morphs) const
+{
+    const int nmorphs = m_morphIndices.count(), nAvailableMorphs = morphs.count();
+    Array<IMorph::WeightPrecision> weights;
+    weights.resize(nAvailableMorphs);
+    for (int i = 0; i < nAvailableMorphs; i++)
+        weights[i] = morphs[i]->weight();
+    int nchanged = 0;
+    for (int i = 0; i < nmorphs; i++) {
+        const int index = m_morphIndices[i];
+        if (index >= nAvailableMorphs)
+            break;
+        const IMorph::WeightPrecision &weight = m_weights[i];
+        if (!IsSameWeight(weights[index], weight)) {
+            weights[index] = weight;
+            nchanged++;
+        }
+    }
+    /*
+     * 親を持つモーフはグループモーフの setWeight から重みが設定されるため書き戻さない
+     * (頂点モーフ等の移動量は加算されるので、二重に書き戻すと寄与が倍になってしまう)
+     */
+    for (int i = 0; i < nAvailableMorphs; i++) {
+        IMorph *morph = morphs[i];
+        if (!morph->hasParent())
+            morph->setWeight(weights[i]);
+    }
+    return nchanged;
+}
+
+bool Pose::compact(const Array<IBone *> &bones, const Array<IMorph *> &morphs)
+{
+    const int nbones = m_boneIndices.count(), nAvailableBones = bones.count();
+    int nboneDeltas = 0;
+    for (int i = 0; i < nbones; i++) {
+        const int index = m_boneIndices[i];
+        const Vector3 &position = m_positions[i];
+        const Quaternion &rotation = m_rotations[i];
+        if (index < nAvailableBones && IsSameBone(bones[index], position, rotation))
+            continue;
+        m_boneIndices[nboneDeltas] = index;
+        m_positions[nboneDeltas] = position;
+        m_rotations[nboneDeltas] = rotation;
+        nboneDeltas++;
+    }
+    m_boneIndices.resize(nboneDeltas);
+    m_positions.resize(nboneDeltas);
+    m_rotations.resize(nboneDeltas);
+    const int nmorphs = m_morphIndices.count(), nAvailableMorphs = morphs.count();
+    int nmorphDeltas = 0;
+    for (int i = 0; i < nmorphs; i++) {
+        const int index = m_morphIndices[i];
+        const IMorph::WeightPrecision &weight = m_weights[i];
+        if (index < nAvailableMorphs && IsSameWeight(morphs[index]->weight(), weight))
+            continue;
+        m_morphIndices[nmorphDeltas] = index;
+        m_weights[nmorphDeltas] = weight;
+        nmorphDeltas++;
+    }
+    m_morphIndices.resize(nmorphDeltas);
+    m_weights.resize(nmorphDeltas);
+    return !isEmpty();
+}
+
+void Pose::diff(const Pose &base, Pose &delta) const
+{
+    /* いずれも添字の昇順に並んでいるため、先頭から突き合わせるだけで済む */
+    delta.clear();
+    const int nbones = m_boneIndices.count(), nbaseBones = base.m_boneIndices.count();
+    for (int i = 0, j = 0; i < nbones; i++) {
+        const int index = m_boneIndices[i];
+        while (j < nbaseBones && base.m_boneIndices[j] < index)
+            j++;
+        const Vector3 &position = m_positions[i];
+        const Quaternion &rotation = m_rotations[i];
+        if (j >= nbaseBones || base.m_boneIndices[j] != index
+                || (base.m_positions[j] == position && base.m_rotations[j] == rotation))
+            continue;
+        delta.addBone(index, position, rotation);
+    }
+    const int nmorphs = m_morphIndices.count(), nbaseMorphs = base.m_morphIndices.count();
+    for (int i = 0, j = 0; i < nmorphs; i++) {
+        const int index = m_morphIndices[i];
+        while (j < nbaseMorphs && base.m_morphIndices[j] < index)
+            j++;
+        const IMorph::WeightPrecision &weight = m_weights[i];
+        if (j >= nbaseMorphs || base.m_morphIndices[j] != index || IsSameWeight(base.m_weights[j], weight))
+            continue;
+        delta.addMorph(index, weight);
+    }
+}
+
+void Pose::copy(const Pose &value)
+{
+    m_boneIndices.copy(value.m_boneIndices);
+    m_positions.copy(value.m_positions);
+    m_rotations.copy(value.m_rotations);
+    m_morphIndices.copy(value.m_morphIndices);
+    m_weights.copy(value.m_weights);
+}
+
+void Pose::clear()
+{
+    m_boneIndices.clear();
+    m_positions.clear();
+    m_rotations.clear();
+    m_morphIndices.clear();
+    m_weights.clear();
+}
+
+size_t Pose::estimateSize() const
+{
+    size_t size = 0;
+    size += m_boneIndices.count() * (sizeof(int) + sizeof(Vector3) + sizeof(Quaternion));
+    size += m_morphIndices.count() * (sizeof(int) + sizeof(IMorph::WeightPrecision));
+    return size;
+}
+
+void Pose::addBone(int index, const Vector3 &position, const Quaternion &rotation)
+{
+    m_boneIndices.add(index);
+    m_positions.add(position);
+    m_rotations.add(rotation);
+}
+
+void Pose::addMorph(int index, const IMorph::WeightPrecision &weight)
+{
+    m_morphIndices.add(index);
+    m_weights.add(weight);
+}
+
+} /* namespace vpvl2 */
@@ -0,0 +1,209 @@
+/* ----------------------------------------------------------------- */
+/*                                                                   */
+/*  Copyright (c) 2010-2012  hkrn                                    */
+/*                                                                   */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/* - Redistributions of source code must retain the above copyright  */
+/*   notice, this list of conditions and the following disclaimer.   */
+/* - Redistributions in binary form must reproduce the above         */
+/*   copyright notice, this list of conditions and the following     */
+/*   disclaimer in the documentation and/or other materials provided */
+/*   with the distribution.                                          */
+/* - Neither the name of the MMDAI project team nor the names of     */
+/*   its contributors may be used to endorse or promote products     */
+/*   derived from this software without specific prior written       */
+/*   permission.                                                     */
+/*                                                                   */
+/* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND            */
+/* CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,       */
+/* INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF          */
+/* MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE          */
+/* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS */
+/* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,          */
+/* EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED   */
+/* TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,     */
+/* DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON */
+/* ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,   */
+/* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY    */
+/* OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE           */
+/* POSSIBILITY OF SUCH DAMAGE.                                       */
+/* ----------------------------------------------------------------- */
+
+#include "vpvl2/vpvl2.h"
+#include "vpvl2/Pose.h"
+#include "vpvl2/PoseCache.h"
+
+namespace vpvl2
+{
+
+struct PoseCache::Entry {
+    Entry(int k) : key(k), tick(0) {}
+    int key;
+    uint32_t tick;
+    Pose pose;
+};
+
+PoseCache::PoseCache(IModel *model)
+    : m_modelRef(model),
+      m_pendingTimeIndex(0),
+      m_tick(0),
+      m_capacity(kDefaultCapacity),
+      m_resolution(kDefaultResolution),
+      m_nhits(0),
+      m_nmisses(0),
+      m_hasPendingSeek(false)
+{
+    m_modelRef->getBones(m_bones);
+    m_modelRef->getMorphs(m_morphs);
+}
+
+PoseCache::~PoseCache()
+{
+    invalidate();
+    m_modelRef = 0;
+}
+
+bool PoseCache::seek(const IKeyframe::TimeIndex &timeIndex, const Array<IMotion *> &motions)
+{
+    collectMotions(motions);
+    if (updateSignature(m_motionRefs))
+        invalidate();
+    const int key = quantize(timeIndex);
+    Entry *const *entryPtr = m_key2entries.find(key);
+    if (entryPtr) {
+        Entry *entry = *entryPtr;
+        const Pose &pose = entry->pose;
+        entry->tick = ++m_tick;
+        pose.restoreBones(m_bones);
+        if (pose.hasChangedMorphs(m_morphs)) {
+            m_modelRef->resetVertices();
+            pose.restoreMorphs(m_morphs);
+        }
+        /* モーションの時間は synchronize が呼ばれるまで移動しない */
+        m_pendingTimeIndex = timeIndex;
+        m_hasPendingSeek = true;
+        m_nhits++;
+        return true;
+    }
+    m_hasPendingSeek = false;
+    const int nmodelMotions = m_motionRefs.count();
+    for (int i = 0; i < nmodelMotions; i++) {
+        IMotion *motion = m_motionRefs[i];
+        motion->seek(timeIndex);
+    }
+    if (m_capacity > 0) {
+        if (m_entries.count() >= m_capacity)
+            evictLeastRecentlyUsed();
+        Entry *entry = new Entry(key);
+        entry->tick = ++m_tick;
+        entry->pose.save(m_bones, m_morphs);
+        m_entries.add(entry);
+        m_key2entries.insert(key, entry);
+    }
+    m_nmisses++;
+    return false;
+}
+
+bool PoseCache::synchronize(const Array<IMotion *> &motions)
+{
+    if (!m_hasPendingSeek)
+        return false;
+    m_hasPendingSeek = false;
+    /* seek 以降にモーションが削除されている可能性があるため、渡されたモーションから取り出し直す */
+    collectMotions(motions);
+    const int nmodelMotions = m_motionRefs.count();
+    for (int i = 0; i < nmodelMotions; i++) {
+        IMotion *motion = m_motionRefs[i];
+        motion->seek(m_pendingTimeIndex);
+    }
+    return true;
+}
+
+void PoseCache::invalidate()
+{
+    m_key2entries.clear();
+    m_entries.releaseAll();
+}
+
+void PoseCache::setCapacity(int value)
+{
+    m_capacity = btMax(value, 0);
+    while (m_entries.count() > m_capacity)
+        evictLeastRecentlyUsed();
+}
+
+void PoseCache::setResolution(int value)
+{
+    if (value > 0 && value != m_resolution) {
+        m_resolution = value;
+        invalidate();
+    }
+}
+
+void PoseCache::collectMotions(const Array<IMotion *> &motions)
+{
+    m_motionRefs.clear();
+    const int nmotions = motions.count();
+    for (int i = 0; i < nmotions; i++) {
+        IMotion *motion = motions[i];
+        if (motion->parentModel() == m_modelRef)
+            m_motionRefs.add(motion);
+    }
+}
+
+int PoseCache::quantize(const IKeyframe::TimeIndex &timeIndex) const
+{
+    const IKeyframe::TimeIndex value = timeIndex * m_resolution;
+    return int(value < 0 ? value - 0.5 : value + 0.5);
+}
+
+bool PoseCache::updateSignature(const Array<IMotion *> &motions)
+{
+    /* モーションの組み合わせとキーフレーム数及び長さが保存時と異なる場合は入力が変わったとみなす */
+    const int nmotions = motions.count();
+    m_currentSignature.clear();
+    for (int i = 0; i < nmotions; i++) {
+        const IMotion *motion = motions[i];
+        m_currentSignature.add(motion->countKeyframes(IKeyframe::kBone));
+        m_currentSignature.add(motion->countKeyframes(IKeyframe::kMorph));
+        m_currentSignature.add(int(motion->maxTimeIndex()));
+    }
+    const int nitems = m_currentSignature.count();
+    bool changed = nmotions != m_signatureMotionRefs.count();
+    for (int i = 0; !changed && i < nmotions; i++)
+        changed = motions[i] != m_signatureMotionRefs[i];
+    for (int i = 0; !changed && i < nitems; i++)
+        changed = m_currentSignature[i] != m_signature[i];
+    if (changed) {
+        m_signatureMotionRefs.copy(motions);
+        m_signature.copy(m_currentSignature);
+    }
+    return changed;
+}
+
+void PoseCache::evictLeastRecentlyUsed()
+{
+    const int nentries = m_entries.count();
+    Entry *leastRecentlyUsed = 0;
+    for (int i = 0; i < nentries; i++) {
+        Entry *entry = m_entries[i];
+        if (!leastRecentlyUsed || entry->tick < leastRecentlyUsed->tick)
+            leastRecentlyUsed = entry;
+    }
+    if (leastRecentlyUsed)
+        removeEntry(leastRecentlyUsed);
+}
+
+void PoseCache::removeEntry(Entry *entry)
+{
+    m_key2entries.remove(entry->key);
+    m_entries.remove(entry);
+    delete entry;
+}
+
+} /* namespace vpvl2 */
@@ -60,12 +60,14 @@ BT_DECLARE_HANDLE(CGcontext);
 #include "vpvl2/cl/Context.h"
 #include "vpvl2/cl/PMDAccelerator.h"
 #include "vpvl2/cl/PMXAccelerator.h"
+#include "vpvl2/cl/PMXSkinningBatch.h"
 #else
 namespace vpvl2 {
 namespace cl {
 class Context;
 class PMDAccelerator;
 class PMXAccelerator;
+class PMXSkinningBatch;
 }
 }
 #endif /* VPVL2_ENABLE_OPENCL */
@@ -221,11 +223,22 @@ namespace vpvl2
 {
 
 struct Scene::PrivateContext {
+    struct SkinningRange {
+        pmx::Model *model;
+        int from;
+        int to;
+        Scalar edgeScaleFactor;
+    };
+
     PrivateContext()
         : computeContext(0),
+          skinningBatch(0),
+          isSkinningBatchFailed(false),
           accelerationType(Scene::kSoftwareFallback),
           effectContext(0),
-          preferredFPS(Scene::defaultFPS())
+          preferredFPS(Scene::defaultFPS()),
+          hasCameraCullingMatrix(false),
+          hasLightCullingMatrix(false)
     {
 #ifdef VPVL2_ENABLE_NVIDIA_CG
         effectContext = cgCreateContext();
@@ -236,10 +249,15 @@ struct Scene::PrivateContext {
 #endif
     }
     ~PrivateContext() {
+        model2poseCacheRef.clear();
+        poseCaches.releaseAll();
+        blenders.releaseAll();
         motions.releaseAll();
         engines.releaseAll();
         models.releaseAll();
 #ifdef VPVL2_ENABLE_OPENCL
+        delete skinningBatch;
+        skinningBatch = 0;
         delete computeContext;
         computeContext = 0;
 #endif /* VPVL2_ENABLE_OPENCL */
@@ -253,9 +271,57 @@ struct Scene::PrivateContext {
         const Vector3 &cameraPosition = camera.position() + Vector3(0, 0, camera.distance());
         const Vector3 &lightDirection = light.direction();
         const int nmodels = models.count();
+        skinningRanges.clear();
         for (int i = 0; i < nmodels; i++) {
             IModel *model = models[i];
-            model->performUpdate(cameraPosition, lightDirection);
+            if (model->type() == IModel::kPMX && static_cast<pmx::Model *>(model)->isSkinningEnabled()) {
+                /* ボーンの変形のみ先に行い、スキニングは全てのモデルの頂点をまとめて後で行う */
+                pmx::Model *m = static_cast<pmx::Model *>(model);
+                m->performUpdateBones();
+                if (isInsideCullingFrustums(m))
+                    addSkinningRanges(m, m->edgeScaleFactor(cameraPosition));
+            }
+            else {
+                model->performUpdate(cameraPosition, lightDirection);
+            }
+        }
+        performSkinning(lightDirection);
+    }
+    bool isInsideCullingFrustums(const pmx::Model *model) const {
+        if (!hasCameraCullingMatrix && !hasLightCullingMatrix)
+            return true;
+        return (hasCameraCullingMatrix && model->isInsideFrustum(cameraCullingMatrix))
+                || (hasLightCullingMatrix && model->isInsideFrustum(lightCullingMatrix));
+    }
+    void addSkinningRanges(pmx::Model *model, const Scalar &edgeScaleFactor) {
+        static const int kSkinningRangeSize = 4096;
+        const int nvertices = model->vertices().count();
+        for (int i = 0; i < nvertices; i += kSkinningRangeSize) {
+            SkinningRange range;
+            range.model = model;
+            range.from = i;
+            range.to = btMin(i + kSkinningRangeSize, nvertices);
+            range.edgeScaleFactor = edgeScaleFactor;
+            skinningRanges.add(range);
+        }
+    }
+    void performSkinning(const Vector3 &lightDirection) {
+        /* 頂点の範囲はモデルを跨いで分割されているため、モデル数に関わらず一度の並列ループで処理する */
+        const int nranges = skinningRanges.count();
+#ifdef VPVL2_ENABLE_OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif /* VPVL2_ENABLE_OPENMP */
+        for (int i = 0; i < nranges; i++) {
+            const SkinningRange &range = skinningRanges[i];
+            range.model->performSkinning(range.from, range.to, range.edgeScaleFactor, lightDirection);
+        }
+    }
+    void synchronizePoseCaches() {
+        /* キャッシュに当たって seek されなかったモーションの時間を合わせる */
+        const int nposeCaches = poseCaches.count();
+        for (int i = 0; i < nposeCaches; i++) {
+            PoseCache *cache = poseCaches[i];
+            cache->synchronize(motions);
         }
     }
     void updateRenderEngines() {
@@ -265,6 +331,13 @@ struct Scene::PrivateContext {
             engine->update();
         }
     }
+    void updateSkinningBatch() {
+#ifdef VPVL2_ENABLE_OPENCL
+        /* 各レンダリングエンジンの更新で通知されたモデルのスキニングを一度に実行する */
+        if (skinningBatch)
+            skinningBatch->update();
+#endif /* VPVL2_ENABLE_OPENCL */
+    }
     void updateCamera() {
         camera.updateTransform();
     }
@@ -288,7 +361,7 @@ struct Scene::PrivateContext {
 #ifdef VPVL2_ENABLE_OPENCL
         if (!computeContext) {
             computeContext = new cl::Context(delegate);
-            computeContext->initializeContext(hostDeviceType());
+            computeContext->initializeContext(hostDeviceType(), accelerationType != kOpenCLAccelerationType2);
         }
 #else
         (void) delegate;
@@ -311,7 +384,23 @@ struct Scene::PrivateContext {
         cl::PMXAccelerator *accelerator = 0;
 #ifdef VPVL2_ENABLE_OPENCL
         if (isOpenCLAcceleration()) {
-            accelerator = new cl::PMXAccelerator(createComputeContext(delegate));
+            /* kOpenCLAccelerationType2 は OpenGL と共有せずホスト側のメモリでスキニングを行う */
+            const cl::PMXAccelerator::BufferType type = accelerationType == kOpenCLAccelerationType2
+                    ? cl::PMXAccelerator::kHostBuffer : cl::PMXAccelerator::kGLSharedBuffer;
+            cl::Context *context = createComputeContext(delegate);
+            if (!skinningBatch && !isSkinningBatchFailed) {
+                skinningBatch = new cl::PMXSkinningBatch(context, type);
+                /*
+                 * カーネルのビルドに失敗した場合 (ビルドログは PMXSkinningBatch 側で出力される) は
+                 * まとめて実行せずにモデル毎のスキニングに切り替え、以降は作成し直さない
+                 */
+                if (!skinningBatch->createKernelProgram()) {
+                    delete skinningBatch;
+                    skinningBatch = 0;
+                    isSkinningBatchFailed = true;
+                }
+            }
+            accelerator = new cl::PMXAccelerator(context, type, skinningBatch);
             accelerator->createKernelProgram();
         }
 #else
@@ -339,17 +428,44 @@ struct Scene::PrivateContext {
     }
 
     cl::Context *computeContext;
+    IRenderEngine *findInstancingEngine(const pmx::Model *model) const {
+        const int nmodels = models.count();
+        for (int i = 0; i < nmodels; i++) {
+            IModel *m = models[i];
+            if (m->type() == IModel::kPMX && static_cast<const pmx::Model *>(m)->hasSameSource(model)) {
+                const HashPtr key(m);
+                IRenderEngine *const *engine = model2instancingEngineRef.find(key);
+                IRenderEngine *const *registered = model2engineRef.find(key);
+                /* 解放済みの描画エンジンを参照しないように Scene に登録されているもののみを対象にする */
+                if (engine && registered && *engine == *registered)
+                    return *engine;
+            }
+        }
+        return 0;
+    }
+
+    cl::PMXSkinningBatch *skinningBatch;
+    bool isSkinningBatchFailed;
     Scene::AccelerationType accelerationType;
     CGcontext effectContext;
     Hash<HashPtr, IRenderEngine *> model2engineRef;
+    Hash<HashPtr, IRenderEngine *> model2instancingEngineRef;
     Hash<HashPtr, IModel *> name2modelRef;
     Array<IModel *> models;
     Array<IMotion *> motions;
+    Array<MotionBlender *> blenders;
+    Array<PoseCache *> poseCaches;
+    Hash<HashPtr, PoseCache *> model2poseCacheRef;
     Array<IRenderEngine *> engines;
+    Array<SkinningRange> skinningRanges;
     Light light;
     Camera camera;
     Color lightColor;
     Scalar preferredFPS;
+    float cameraCullingMatrix[16];
+    float lightCullingMatrix[16];
+    bool hasCameraCullingMatrix;
+    bool hasLightCullingMatrix;
 };
 
 ICamera *Scene::createCamera()
@@ -425,7 +541,19 @@ IRenderEngine *Scene::createRenderEngine(IRenderDelegate *delegate, IModel *mode
             engine = new cg::PMXRenderEngine(delegate, this, m_context->effectContext, accelerator, m);
         else
 #endif /* VPVL2_ENABLE_NVIDIA_CG */
-            engine = new gl2::PMXRenderEngine(delegate, this, accelerator, m);
+        {
+            gl2::PMXRenderEngine *e = new gl2::PMXRenderEngine(delegate, this, accelerator, m);
+            e->setPackedVertexEnable((flags & kPackedVertexLayout) != 0);
+            e->setFrustumCullingEnable((flags & kFrustumCulling) != 0);
+            e->setMaterialBatchingEnable((flags & kMaterialBatching) != 0);
+            e->setIndexOptimizationEnable((flags & kIndexOptimization) != 0);
+            if (flags & kModelInstancing) {
+                IRenderEngine *source = m_context->findInstancingEngine(m);
+                e->setSharedEngine(static_cast<const gl2::PMXRenderEngine *>(source));
+                m_context->model2instancingEngineRef.insert(m, e);
+            }
+            engine = e;
+        }
         break;
     }
     default:
@@ -489,8 +617,19 @@ void Scene::deleteModel(IModel *&model)
         m_context->models.remove(model);
         m_context->engines.remove(engine);
         m_context->model2engineRef.remove(key);
+        m_context->model2instancingEngineRef.remove(key);
         delete engine;
     }
+    setPoseCacheEnable(model, false);
+    /* 削除されるモデルを参照し続けないように、そのモデルに適用する MotionBlender も解放する */
+    Array<MotionBlender *> &blenders = m_context->blenders;
+    for (int i = blenders.count() - 1; i >= 0; i--) {
+        MotionBlender *blender = blenders[i];
+        if (blender->model() == model) {
+            blenders.remove(blender);
+            delete blender;
+        }
+    }
     delete model;
     model = 0;
 }
@@ -500,6 +639,38 @@ void Scene::removeMotion(IMotion *motion)
     m_context->motions.remove(motion);
 }
 
+void Scene::addMotionBlender(MotionBlender *blender)
+{
+    if (blender)
+        m_context->blenders.add(blender);
+}
+
+void Scene::removeMotionBlender(MotionBlender *blender)
+{
+    m_context->blenders.remove(blender);
+}
+
+void Scene::setPoseCacheEnable(IModel *model, bool value)
+{
+    PoseCache *cache = findPoseCache(model);
+    if (value && !cache) {
+        cache = new PoseCache(model);
+        m_context->poseCaches.add(cache);
+        m_context->model2poseCacheRef.insert(model, cache);
+    }
+    else if (!value && cache) {
+        m_context->model2poseCacheRef.remove(model);
+        m_context->poseCaches.remove(cache);
+        delete cache;
+    }
+}
+
+PoseCache *Scene::findPoseCache(const IModel *model) const
+{
+    PoseCache **cache = const_cast<PoseCache **>(m_context->model2poseCacheRef.find(model));
+    return cache ? *cache : 0;
+}
+
 void Scene::advance(const IKeyframe::TimeIndex &delta, int flags)
 {
     if (flags & kUpdateCamera) {
@@ -517,10 +688,17 @@ void Scene::advance(const IKeyframe::TimeIndex &delta, int flags)
     if (flags & kUpdateModels) {
         const Array<IMotion *> &motions = m_context->motions;
         const int nmotions = motions.count();
+        m_context->synchronizePoseCaches();
         for (int i = 0; i < nmotions; i++) {
             IMotion *motion = motions[i];
             motion->advance(delta);
         }
+        const Array<MotionBlender *> &blenders = m_context->blenders;
+        const int nblenders = blenders.count();
+        for (int i = 0; i < nblenders; i++) {
+            MotionBlender *blender = blenders[i];
+            blender->advance(delta);
+        }
     }
 }
 
@@ -541,13 +719,37 @@ void Scene::seek(const IKeyframe::TimeIndex &timeIndex, int flags)
     if (flags & kUpdateModels) {
         const Array<IMotion *> &motions = m_context->motions;
         const int nmotions = motions.count();
+        const Array<PoseCache *> &poseCaches = m_context->poseCaches;
+        const int nposeCaches = poseCaches.count();
+        for (int i = 0; i < nposeCaches; i++) {
+            PoseCache *cache = poseCaches[i];
+            cache->seek(timeIndex, motions);
+        }
         for (int i = 0; i < nmotions; i++) {
             IMotion *motion = motions[i];
-            motion->seek(timeIndex);
+            /* 姿勢のキャッシュを持つモデルのモーションは PoseCache::seek で処理済み */
+            if (!nposeCaches || !findPoseCache(motion->parentModel()))
+                motion->seek(timeIndex);
+        }
+        const Array<MotionBlender *> &blenders = m_context->blenders;
+        const int nblenders = blenders.count();
+        for (int i = 0; i < nblenders; i++) {
+            MotionBlender *blender = blenders[i];
+            blender->seek(timeIndex);
         }
     }
 }
 
+void Scene::setCullingMatrices(const float *cameraMatrix, const float *lightMatrix)
+{
+    m_context->hasCameraCullingMatrix = cameraMatrix != 0;
+    if (cameraMatrix)
+        memcpy(m_context->cameraCullingMatrix, cameraMatrix, sizeof(m_context->cameraCullingMatrix));
+    m_context->hasLightCullingMatrix = lightMatrix != 0;
+    if (lightMatrix)
+        memcpy(m_context->lightCullingMatrix, lightMatrix, sizeof(m_context->lightCullingMatrix));
+}
+
 void Scene::updateModel(IModel *model) const
 {
     if (model) {
@@ -567,6 +769,7 @@ void Scene::update(int flags)
     }
     if (flags & kUpdateRenderEngines) {
         m_context->updateRenderEngines();
+        m_context->updateSkinningBatch();
     }
 }
 
@@ -579,6 +782,7 @@ bool Scene::isReachedTo(const IKeyframe::TimeIndex &timeIndex) const
 {
     const Array<IMotion *> &motions = m_context->motions;
     const int nmotions = motions.count();
+    m_context->synchronizePoseCaches();
     for (int i = 0; i < nmotions; i++) {
         IMotion *motion = motions[i];
         if (!motion->isReachedTo(timeIndex))
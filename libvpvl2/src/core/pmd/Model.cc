@@ -187,6 +187,16 @@ void Model::resetVertices()
 {
 }
 
+int Model::restorePose(const Pose &value)
+{
+    int nchanged = value.restoreBones(m_bones);
+    if (value.hasChangedMorphs(m_morphs)) {
+        resetVertices();
+        nchanged += value.restoreMorphs(m_morphs);
+    }
+    return nchanged;
+}
+
 void Model::performUpdate(const Vector3 &cameraPosition, const Vector3 &lightDirection)
 {
     m_model.setLightPosition(-lightDirection);
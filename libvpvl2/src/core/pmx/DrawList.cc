@@ -0,0 +1,231 @@
+/* ----------------------------------------------------------------- */
+/*                                                                   */
+/*  Copyright (c) 2010-2012  hkrn                                    */
+/*                                                                   */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/* - Redistributions of source code must retain the above copyright  */
+/*   notice, this list of conditions and the following disclaimer.   */
+/* - Redistributions in binary form must reproduce the above         */
+/*   copyright notice, this list of conditions and the following     */
+/*   disclaimer in the documentation and/or other materials provided */
+/*   with the distribution.                                          */
+/* - Neither the name of the MMDAI project team nor the names of     */
+/*   its contributors may be used to endorse or promote products     */
+/*   derived from this software without specific prior written       */
+/*   permission.                                                     */
+/*                                                                   */
+/* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND            */
+/* CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,       */
+/* INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF          */
+/* MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE          */
+/* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS */
+/* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,          */
+/* EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED   */
+/* TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,     */
+/* DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON */
+/* ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,   */
+/* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY    */
+/* OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE           */
+/* POSSIBILITY OF SUCH DAMAGE.                                       */
+/* ----------------------------------------------------------------- */
+
+#include "vpvl2/vpvl2.h"
+#include "vpvl2/internal/util.h"
+
+#include "vpvl2/pmx/DrawList.h"
+#include "vpvl2/pmx/Material.h"
+#include "vpvl2/pmx/Morph.h"
+
+namespace vpvl2
+{
+namespace pmx
+{
+
+DrawList::DrawList()
+    : m_reordered(false)
+{
+}
+
+DrawList::~DrawList()
+{
+    clear();
+}
+
+void DrawList::compile(const Array<Material *> &materials,
+                       const Array<Morph *> &morphs,
+                       const Array<bool> &opaqueTextures,
+                       bool enableBatching)
+{
+    clear();
+    const int nmaterials = materials.count();
+    /* 材質モーフの対象となる材質は実行時に描画状態が変わるため並べ替えない */
+    Array<bool> morphed, isolated;
+    morphed.resize(nmaterials);
+    isolated.resize(nmaterials);
+    for (int i = 0; i < nmaterials; i++) {
+        morphed[i] = false;
+        isolated[i] = false;
+    }
+    const int nmorphs = morphs.count();
+    for (int i = 0; i < nmorphs; i++) {
+        const Morph *morph = morphs[i];
+        if (morph->type() != IMorph::kMaterial)
+            continue;
+        const Array<Morph::Material *> &morphMaterials = morph->materials();
+        const int nMorphMaterials = morphMaterials.count();
+        for (int j = 0; j < nMorphMaterials; j++) {
+            const Morph::Material *morphMaterial = morphMaterials[j];
+            const int index = morphMaterial->index;
+            if (index >= 0 && index < nmaterials) {
+                morphed[index] = true;
+                isolated[index] = true;
+            }
+            else if (index < 0) {
+                /* 全ての材質が同じ演算を受けるため、描画状態が同じ材質は同じままでありまとめてよい */
+                for (int k = 0; k < nmaterials; k++)
+                    morphed[k] = true;
+            }
+        }
+    }
+    int offset = 0;
+    m_sourceIndexOffsets.reserve(nmaterials);
+    m_sourceIndexCounts.reserve(nmaterials);
+    m_materialOrder.reserve(nmaterials);
+    for (int i = 0; i < nmaterials; i++) {
+        const int nindices = materials[i]->indices();
+        m_sourceIndexOffsets.add(offset);
+        m_sourceIndexCounts.add(nindices);
+        offset += nindices;
+    }
+    if (enableBatching) {
+        /*
+         * 不透明な材質はデプステストにより描画順に依存しないので先頭に集め、テクスチャの切り替えが
+         * 少なくなるようにテクスチャ毎に、その中で描画状態毎に並べる。半透明の可能性がある材質は元の順番を保つ
+         */
+        const int nopaqueTextures = opaqueTextures.count();
+        Array<bool> opaque, ordered;
+        opaque.resize(nmaterials);
+        ordered.resize(nmaterials);
+        for (int i = 0; i < nmaterials; i++) {
+            const Material *material = materials[i];
+            const bool isTextureOpaque = !material->mainTexture() || (i < nopaqueTextures && opaqueTextures[i]);
+            opaque[i] = !morphed[i] && isTextureOpaque && material->diffuse().w() >= 1;
+            ordered[i] = false;
+        }
+        for (int i = 0; i < nmaterials; i++) {
+            if (!opaque[i] || ordered[i])
+                continue;
+            const Material *material = materials[i];
+            for (int j = i; j < nmaterials; j++) {
+                if (!opaque[j] || ordered[j] || !isSameTexture(material, materials[j]))
+                    continue;
+                const Material *sameTextureMaterial = materials[j];
+                m_materialOrder.add(j);
+                ordered[j] = true;
+                for (int k = j + 1; k < nmaterials; k++) {
+                    if (opaque[k] && !ordered[k] && isSameRenderState(sameTextureMaterial, materials[k])) {
+                        m_materialOrder.add(k);
+                        ordered[k] = true;
+                    }
+                }
+            }
+        }
+        for (int i = 0; i < nmaterials; i++) {
+            if (!ordered[i])
+                m_materialOrder.add(i);
+        }
+    }
+    else {
+        for (int i = 0; i < nmaterials; i++)
+            m_materialOrder.add(i);
+    }
+    offset = 0;
+    m_materialBatches.resize(nmaterials);
+    for (int i = 0; i < nmaterials; i++) {
+        const int materialIndex = m_materialOrder[i];
+        const int nindices = m_sourceIndexCounts[materialIndex];
+        if (materialIndex != i)
+            m_reordered = true;
+        Batch &materialBatch = m_materialBatches[materialIndex];
+        materialBatch.materialIndex = materialIndex;
+        materialBatch.nmaterials = 1;
+        materialBatch.indexOffset = offset;
+        materialBatch.nindices = nindices;
+        const int nbatches = m_batches.count();
+        if (enableBatching && nbatches > 0 && !isolated[materialIndex]) {
+            Batch &last = m_batches[nbatches - 1];
+            if (!isolated[last.materialIndex] && isSameRenderState(materials[last.materialIndex], materials[materialIndex])) {
+                last.nmaterials++;
+                last.nindices += nindices;
+                offset += nindices;
+                continue;
+            }
+        }
+        Batch batch;
+        batch.materialIndex = materialIndex;
+        batch.nmaterials = 1;
+        batch.indexOffset = offset;
+        batch.nindices = nindices;
+        m_batches.add(batch);
+        offset += nindices;
+    }
+}
+
+void DrawList::reorderIndices(const uint8_t *source, uint8_t *dest, size_t stride) const
+{
+    const int nmaterials = m_materialOrder.count();
+    size_t offset = 0;
+    for (int i = 0; i < nmaterials; i++) {
+        const int materialIndex = m_materialOrder[i];
+        const size_t size = m_sourceIndexCounts[materialIndex] * stride;
+        if (size > 0)
+            memcpy(dest + offset, source + m_sourceIndexOffsets[materialIndex] * stride, size);
+        offset += size;
+    }
+}
+
+bool DrawList::isSameTexture(const Material *left, const Material *right)
+{
+    return left->textureIndex() == right->textureIndex() &&
+            left->sphereTextureIndex() == right->sphereTextureIndex() &&
+            left->sphereTextureRenderMode() == right->sphereTextureRenderMode() &&
+            left->isSharedToonTextureUsed() == right->isSharedToonTextureUsed() &&
+            left->toonTextureIndex() == right->toonTextureIndex();
+}
+
+bool DrawList::isSameRenderState(const Material *left, const Material *right)
+{
+    return isSameTexture(left, right) &&
+            left->ambient() == right->ambient() &&
+            left->diffuse() == right->diffuse() &&
+            left->specular() == right->specular() &&
+            left->shininess() == right->shininess() &&
+            left->mainTextureBlend() == right->mainTextureBlend() &&
+            left->sphereTextureBlend() == right->sphereTextureBlend() &&
+            left->toonTextureBlend() == right->toonTextureBlend() &&
+            left->edgeColor() == right->edgeColor() &&
+            left->edgeSize() == right->edgeSize() &&
+            left->isCullFaceDisabled() == right->isCullFaceDisabled() &&
+            left->hasShadow() == right->hasShadow() &&
+            left->isShadowMapDrawn() == right->isShadowMapDrawn() &&
+            left->isSelfShadowDrawn() == right->isSelfShadowDrawn() &&
+            left->isEdgeDrawn() == right->isEdgeDrawn();
+}
+
+void DrawList::clear()
+{
+    m_batches.clear();
+    m_materialBatches.clear();
+    m_materialOrder.clear();
+    m_sourceIndexOffsets.clear();
+    m_sourceIndexCounts.clear();
+    m_reordered = false;
+}
+
+}
+}
@@ -56,6 +56,11 @@ struct MaterialUnit {
 
 #pragma pack(pop)
 
+static inline int RemapTextureIndex(int index, const vpvl2::Array<int> &textureIndices)
+{
+    return index >= 0 && index < textureIndices.count() ? textureIndices[index] : index;
+}
+
 }
 
 namespace vpvl2
@@ -247,6 +252,11 @@ void Material::read(const uint8_t *data, const Model::DataInfo &info, size_t &si
 }
 
 void Material::write(uint8_t *data, const Model::DataInfo &info) const
+{
+    write(data, info, Array<int>());
+}
+
+void Material::write(uint8_t *data, const Model::DataInfo &info, const Array<int> &textureIndices) const
 {
     internal::writeString(m_name, data);
     internal::writeString(m_englishName, data);
@@ -260,14 +270,15 @@ void Material::write(uint8_t *data, const Model::DataInfo &info) const
     mu.flags = m_flags;
     internal::writeBytes(reinterpret_cast<const uint8_t *>(&mu), sizeof(mu), data);
     size_t textureIndexSize = info.textureIndexSize;
-    internal::writeSignedIndex(m_textureIndex, textureIndexSize, data);
-    internal::writeSignedIndex(m_sphereTextureIndex, textureIndexSize, data);
+    internal::writeSignedIndex(RemapTextureIndex(m_textureIndex, textureIndices), textureIndexSize, data);
+    internal::writeSignedIndex(RemapTextureIndex(m_sphereTextureIndex, textureIndices), textureIndexSize, data);
     internal::writeBytes(reinterpret_cast<const uint8_t *>(&m_sphereTextureRenderMode), sizeof(uint8_t), data);
     internal::writeBytes(reinterpret_cast<const uint8_t *>(&m_useSharedToonTexture), sizeof(uint8_t), data);
+    /* 共有トゥーンの場合は toon01.bmp などの番号なので変換しない */
     if (m_useSharedToonTexture)
         internal::writeBytes(reinterpret_cast<const uint8_t *>(&m_toonTextureIndex), sizeof(uint8_t), data);
     else
-        internal::writeSignedIndex(m_toonTextureIndex, textureIndexSize, data);
+        internal::writeSignedIndex(RemapTextureIndex(m_toonTextureIndex, textureIndices), textureIndexSize, data);
     internal::writeString(m_userDataArea, data);
     internal::writeBytes(reinterpret_cast<const uint8_t *>(&m_indices), sizeof(int), data);
 }
@@ -0,0 +1,217 @@
+/* ----------------------------------------------------------------- */
+/*                                                                   */
+/*  Copyright (c) 2010-2012  hkrn                                    */
+/*                                                                   */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/* - Redistributions of source code must retain the above copyright  */
+/*   notice, this list of conditions and the following disclaimer.   */
+/* - Redistributions in binary form must reproduce the above         */
+/*   copyright notice, this list of conditions and the following     */
+/*   disclaimer in the documentation and/or other materials provided */
+/*   with the distribution.                                          */
+/* - Neither the name of the MMDAI project team nor the names of     */
+/*   its contributors may be used to endorse or promote products     */
+/*   derived from this software without specific prior written       */
+/*   permission.                                                     */
+/*                                                                   */
+/* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND            */
+/* CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,       */
+/* INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF          */
+/* MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE          */
+/* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS */
+/* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,          */
+/* EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED   */
+/* TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,     */
+/* DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON */
+/* ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,   */
+/* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY    */
+/* OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE           */
+/* POSSIBILITY OF SUCH DAMAGE.                                       */
+/* ----------------------------------------------------------------- */
+
+#include "vpvl2/vpvl2.h"
+#include "vpvl2/internal/util.h"
+
+#include "vpvl2/pmx/Material.h"
+#include "vpvl2/pmx/MaterialParameterBuffer.h"
+
+namespace
+{
+
+using namespace vpvl2;
+typedef pmx::MaterialParameterBuffer::Parameter Parameter;
+
+static void FillParameter(Parameter &parameter, const Scalar &value)
+{
+    Scalar *values = reinterpret_cast<Scalar *>(&parameter);
+    static const int kNumScalars = sizeof(Parameter) / sizeof(Scalar);
+    for (int i = 0; i < kNumScalars; i++)
+        values[i] = value;
+}
+
+/* pmx::Material::RGB3 と同じく色の乗算と加算は RGB のみを対象にする */
+static inline void MultiplyRGB(Color &mul, const Vector3 &value, const Scalar &weight)
+{
+    mul.setValue(mul.x() * (1 - (1 - value.x()) * weight),
+                 mul.y() * (1 - (1 - value.y()) * weight),
+                 mul.z() * (1 - (1 - value.z()) * weight),
+                 mul.w());
+}
+
+static inline void MultiplyRGBA(Color &mul, const Vector4 &value, const Scalar &weight)
+{
+    mul.setValue(mul.x() * (1 - (1 - value.x()) * weight),
+                 mul.y() * (1 - (1 - value.y()) * weight),
+                 mul.z() * (1 - (1 - value.z()) * weight),
+                 mul.w() * (1 - (1 - value.w()) * weight));
+}
+
+static inline void AddRGB(Color &add, const Vector3 &value, const Scalar &weight)
+{
+    add.setValue(add.x() + value.x() * weight,
+                 add.y() + value.y() * weight,
+                 add.z() + value.z() * weight,
+                 add.w());
+}
+
+static inline void AddRGBA(Color &add, const Vector4 &value, const Scalar &weight)
+{
+    add.setValue(add.x() + value.x() * weight,
+                 add.y() + value.y() * weight,
+                 add.z() + value.z() * weight,
+                 add.w() + value.w() * weight);
+}
+
+}
+
+namespace vpvl2
+{
+namespace pmx
+{
+
+MaterialParameterBuffer::MaterialParameterBuffer()
+    : m_hasContributions(false),
+      m_dirty(false)
+{
+}
+
+MaterialParameterBuffer::~MaterialParameterBuffer()
+{
+    m_hasContributions = false;
+    m_dirty = false;
+}
+
+void MaterialParameterBuffer::compile(const Array<Material *> &materials)
+{
+    const int nmaterials = materials.count();
+    m_bases.resize(nmaterials);
+    m_muls.resize(nmaterials);
+    m_adds.resize(nmaterials);
+    m_results.resize(nmaterials);
+    for (int i = 0; i < nmaterials; i++) {
+        const Material *material = materials[i];
+        Parameter &base = m_bases[i];
+        FillParameter(base, 0);
+        base.ambient = material->ambient();
+        base.diffuse = material->diffuse();
+        base.specular = material->specular();
+        base.edgeColor = material->edgeColor();
+        base.mainTextureBlend = material->mainTextureBlend();
+        base.sphereTextureBlend = material->sphereTextureBlend();
+        base.toonTextureBlend = material->toonTextureBlend();
+        base.shininess = material->shininess();
+        base.edgeSize = material->edgeSize();
+        FillParameter(m_muls[i], 1);
+        FillParameter(m_adds[i], 0);
+        m_results[i] = base;
+    }
+    m_hasContributions = false;
+    m_dirty = false;
+}
+
+void MaterialParameterBuffer::reset()
+{
+    if (!m_hasContributions)
+        return;
+    const int nmaterials = m_results.count();
+    for (int i = 0; i < nmaterials; i++) {
+        FillParameter(m_muls[i], 1);
+        FillParameter(m_adds[i], 0);
+    }
+    m_hasContributions = false;
+    m_dirty = true;
+}
+
+void MaterialParameterBuffer::accumulate(const Morph::Material *morph, float weight)
+{
+    const Array<Material *> *materials = morph->materials;
+    btClamp(weight, 0.0f, 1.0f);
+    if (!materials || btFuzzyZero(weight))
+        return;
+    const int ntargets = materials->count(), nmaterials = m_results.count();
+    const Scalar w(weight);
+    for (int i = 0; i < ntargets; i++) {
+        const int index = materials->at(i)->index();
+        if (index < 0 || index >= nmaterials)
+            continue;
+        switch (morph->operation) {
+        case 0: { // modulate
+            Parameter &mul = m_muls[index];
+            MultiplyRGB(mul.ambient, morph->ambient, w);
+            MultiplyRGBA(mul.diffuse, morph->diffuse, w);
+            MultiplyRGB(mul.specular, morph->specular, w);
+            MultiplyRGBA(mul.edgeColor, morph->edgeColor, w);
+            MultiplyRGBA(mul.mainTextureBlend, morph->textureWeight, w);
+            MultiplyRGBA(mul.sphereTextureBlend, morph->sphereTextureWeight, w);
+            MultiplyRGBA(mul.toonTextureBlend, morph->toonTextureWeight, w);
+            mul.shininess *= 1 - (1 - morph->shininess) * w;
+            mul.edgeSize *= 1 - (1 - morph->edgeSize) * w;
+            break;
+        }
+        case 1: { // add
+            Parameter &add = m_adds[index];
+            AddRGB(add.ambient, morph->ambient, w);
+            AddRGBA(add.diffuse, morph->diffuse, w);
+            AddRGB(add.specular, morph->specular, w);
+            AddRGBA(add.edgeColor, morph->edgeColor, w);
+            AddRGBA(add.mainTextureBlend, morph->textureWeight, w);
+            AddRGBA(add.sphereTextureBlend, morph->sphereTextureWeight, w);
+            AddRGBA(add.toonTextureBlend, morph->toonTextureWeight, w);
+            add.shininess += morph->shininess * w;
+            add.edgeSize += morph->edgeSize * w;
+            break;
+        }
+        default:
+            continue;
+        }
+        m_hasContributions = true;
+        m_dirty = true;
+    }
+}
+
+void MaterialParameterBuffer::update()
+{
+    if (!m_dirty)
+        return;
+    const int nmaterials = m_results.count();
+    if (nmaterials > 0) {
+        /* 全ての材質の全ての要素が同じ形式で連続して並ぶため、1つのループで計算できる */
+        static const int kNumScalars = sizeof(Parameter) / sizeof(Scalar);
+        const Scalar *bases = reinterpret_cast<const Scalar *>(&m_bases[0]);
+        const Scalar *muls = reinterpret_cast<const Scalar *>(&m_muls[0]);
+        const Scalar *adds = reinterpret_cast<const Scalar *>(&m_adds[0]);
+        Scalar *results = reinterpret_cast<Scalar *>(&m_results[0]);
+        const int nscalars = nmaterials * kNumScalars;
+        for (int i = 0; i < nscalars; i++)
+            results[i] = bases[i] * muls[i] + adds[i];
+    }
+    m_dirty = false;
+}
+
+}
+}
@@ -41,10 +41,12 @@
 #include "vpvl2/pmx/Joint.h"
 #include "vpvl2/pmx/Label.h"
 #include "vpvl2/pmx/Material.h"
+#include "vpvl2/pmx/MaterialParameterBuffer.h"
 #include "vpvl2/pmx/Model.h"
 #include "vpvl2/pmx/Morph.h"
 #include "vpvl2/pmx/RigidBody.h"
 #include "vpvl2/pmx/Vertex.h"
+#include "vpvl2/pmx/Writer.h"
 
 #ifndef VPVL2_NO_BULLET
 #include <btBulletDynamicsCommon.h>
@@ -64,6 +66,17 @@ namespace {
 
 #pragma pack(pop)
 
+    static uint32_t HashSourceData(const uint8_t *data, size_t size)
+    {
+        /* FNV-1a */
+        uint32_t hash = 2166136261u;
+        for (size_t i = 0; i < size; i++) {
+            hash ^= data[i];
+            hash *= 16777619u;
+        }
+        return hash;
+    }
+
 }
 
 namespace vpvl2
@@ -85,11 +98,302 @@ struct Model::SkinnedVertex {
     Vector4 uva4;
 };
 
+struct Model::PackedVertex {
+    PackedVertex() {}
+    float position[4];
+    int16_t normal[4];
+    float texcoord[4];
+    float edge[3];
+};
+
+struct Model::PackedStaticVertex {
+    PackedStaticVertex() {}
+    int16_t boneIndices[4];
+    uint16_t boneWeights[4];
+    float edgeSize;
+};
+
+static inline int16_t PackSignedNormalized(float value)
+{
+    btClamp(value, -1.0f, 1.0f);
+    return int16_t(value * 32767.0f + (value < 0 ? -0.5f : 0.5f));
+}
+
+static inline uint16_t PackUnsignedNormalized(float value)
+{
+    btClamp(value, 0.0f, 1.0f);
+    return uint16_t(value * 65535.0f + 0.5f);
+}
+
+/* Forsyth の "Linear-Speed Vertex Cache Optimisation" に基づく三角形の並べ替え */
+static const int kVertexCacheSize = 32;
+
+struct CacheVertex {
+    int cachePosition;
+    int nactiveTriangles;
+    int ntriangles;
+    int triangleOffset;
+    float score;
+};
+
+static inline float CalculateVertexScore(const CacheVertex &vertex)
+{
+    if (vertex.nactiveTriangles == 0)
+        return -1.0f;
+    float score = 0.0f;
+    const int position = vertex.cachePosition;
+    if (position >= 0) {
+        /* 直前の三角形で使われた頂点は次の三角形でも使われる可能性が高いため一定値にする */
+        if (position < 3)
+            score = 0.75f;
+        else
+            score = btPow(1.0f - (position - 3) / float(kVertexCacheSize - 3), 1.5f);
+    }
+    /* 残りの三角形が少ない頂点を優先して孤立した三角形を作らないようにする */
+    score += 2.0f / btSqrt(float(vertex.nactiveTriangles));
+    return score;
+}
+
+/* 頂点キャッシュを FIFO として見なして索引を順に処理した場合のキャッシュミスの回数を求める */
+static int CountCacheMisses(const int *indices, int nindices, int cacheSize, Array<int> &timestamps)
+{
+    const int nvertices = timestamps.count();
+    for (int i = 0; i < nindices; i++) {
+        const int index = indices[i];
+        if (index >= 0 && index < nvertices)
+            timestamps[index] = -1;
+    }
+    int nmisses = 0;
+    for (int i = 0; i < nindices; i++) {
+        const int index = indices[i];
+        if (index < 0 || index >= nvertices)
+            continue;
+        const int timestamp = timestamps[index];
+        if (timestamp < 0 || nmisses - timestamp > cacheSize) {
+            timestamps[index] = nmisses;
+            nmisses++;
+        }
+    }
+    return nmisses;
+}
+
+static void OptimizeTriangleOrder(int *indices, int nindices, Array<CacheVertex> &vertices, Array<int> &timestamps)
+{
+    const int ntriangles = nindices / 3;
+    if (ntriangles < 2)
+        return;
+    for (int i = 0; i < nindices; i++) {
+        CacheVertex &v = vertices[indices[i]];
+        v.cachePosition = -1;
+        v.nactiveTriangles = 0;
+        v.ntriangles = 0;
+        v.triangleOffset = -1;
+    }
+    for (int i = 0; i < nindices; i++)
+        vertices[indices[i]].nactiveTriangles++;
+    Array<int> vertexTriangles, triangleIndices;
+    Array<float> triangleScores;
+    Array<bool> triangleAdded;
+    vertexTriangles.resize(nindices);
+    triangleScores.resize(ntriangles);
+    triangleAdded.resize(ntriangles);
+    triangleIndices.reserve(nindices);
+    int offset = 0;
+    for (int i = 0; i < nindices; i++) {
+        CacheVertex &v = vertices[indices[i]];
+        if (v.triangleOffset < 0) {
+            v.triangleOffset = offset;
+            offset += v.nactiveTriangles;
+            v.score = CalculateVertexScore(v);
+        }
+        vertexTriangles[v.triangleOffset + v.ntriangles++] = i / 3;
+    }
+    for (int i = 0; i < ntriangles; i++) {
+        const int *triangle = &indices[i * 3];
+        triangleScores[i] = vertices[triangle[0]].score + vertices[triangle[1]].score + vertices[triangle[2]].score;
+        triangleAdded[i] = false;
+    }
+    int cache[kVertexCacheSize + 3], newCache[kVertexCacheSize + 3], ncache = 0;
+    int bestTriangle = -1, cursor = 0;
+    for (int added = 0; added < ntriangles; added++) {
+        if (bestTriangle < 0) {
+            /* キャッシュ上の頂点から候補が見つからない場合は未追加の三角形を先頭から探す */
+            while (triangleAdded[cursor])
+                cursor++;
+            bestTriangle = cursor;
+        }
+        const int *triangle = &indices[bestTriangle * 3];
+        triangleAdded[bestTriangle] = true;
+        int nnewCache = 0;
+        for (int i = 0; i < 3; i++) {
+            const int index = triangle[i];
+            CacheVertex &v = vertices[index];
+            triangleIndices.add(index);
+            /* 追加した三角形を頂点の未追加の三角形の一覧から取り除く */
+            int *triangles = &vertexTriangles[v.triangleOffset];
+            for (int j = 0; j < v.nactiveTriangles; j++) {
+                if (triangles[j] == bestTriangle) {
+                    btSwap(triangles[j], triangles[v.nactiveTriangles - 1]);
+                    break;
+                }
+            }
+            v.nactiveTriangles--;
+            newCache[nnewCache++] = index;
+        }
+        for (int i = 0; i < ncache; i++) {
+            const int index = cache[i];
+            if (index != triangle[0] && index != triangle[1] && index != triangle[2])
+                newCache[nnewCache++] = index;
+        }
+        float bestScore = -1.0f;
+        bestTriangle = -1;
+        for (int i = 0; i < nnewCache; i++) {
+            const int index = newCache[i];
+            CacheVertex &v = vertices[index];
+            v.cachePosition = i < kVertexCacheSize ? i : -1;
+            const float score = CalculateVertexScore(v), delta = score - v.score;
+            v.score = score;
+            const int *triangles = &vertexTriangles[v.triangleOffset];
+            for (int j = 0; j < v.nactiveTriangles; j++) {
+                const int t = triangles[j];
+                float &triangleScore = triangleScores[t];
+                triangleScore += delta;
+                if (triangleScore > bestScore) {
+                    bestScore = triangleScore;
+                    bestTriangle = t;
+                }
+            }
+        }
+        ncache = btMin(nnewCache, kVertexCacheSize);
+        for (int i = 0; i < ncache; i++)
+            cache[i] = newCache[i];
+    }
+    /* 元から整列している格子などでは FIFO の評価で悪化することがあるため、その場合は元の順番を残す */
+    if (CountCacheMisses(&triangleIndices[0], nindices, kVertexCacheSize, timestamps)
+            < CountCacheMisses(indices, nindices, kVertexCacheSize, timestamps)) {
+        for (int i = 0; i < nindices; i++)
+            indices[i] = triangleIndices[i];
+    }
+}
+
+static inline bool IsSameString(const IString *left, const IString *right)
+{
+    return left == right || (left && right && left->equals(right));
+}
+
+/*
+ * 描画エンジン間で共有する内容 (索引、頂点の静的な属性、材質の描画範囲と状態、テクスチャ) が
+ * 全て一致するかを要素毎に比較する
+ */
+static bool HasSameSharedContents(const Model *left, const Model *right)
+{
+    const Array<int> &leftIndices = left->indices(), &rightIndices = right->indices();
+    const int nindices = leftIndices.count();
+    if (nindices != rightIndices.count())
+        return false;
+    for (int i = 0; i < nindices; i++) {
+        if (leftIndices[i] != rightIndices[i])
+            return false;
+    }
+    const Array<Vertex *> &leftVertices = left->vertices(), &rightVertices = right->vertices();
+    const int nvertices = leftVertices.count();
+    if (nvertices != rightVertices.count())
+        return false;
+    for (int i = 0; i < nvertices; i++) {
+        const Vertex *l = leftVertices[i], *r = rightVertices[i];
+        if (l->type() != r->type() || l->origin() != r->origin() || l->normal() != r->normal()
+                || l->texcoord() != r->texcoord() || l->uv(0) != r->uv(0) || l->edgeSize() != r->edgeSize())
+            return false;
+        for (int j = 0; j < 4; j++) {
+            const Bone *lb = l->bone(j), *rb = r->bone(j);
+            if ((lb ? lb->index() : -1) != (rb ? rb->index() : -1) || l->weight(j) != r->weight(j))
+                return false;
+        }
+    }
+    const Array<Material *> &leftMaterials = left->materials(), &rightMaterials = right->materials();
+    const int nmaterials = leftMaterials.count();
+    if (nmaterials != rightMaterials.count())
+        return false;
+    for (int i = 0; i < nmaterials; i++) {
+        const Material *l = leftMaterials[i], *r = rightMaterials[i];
+        if (l->indices() != r->indices() || l->textureIndex() != r->textureIndex()
+                || l->sphereTextureIndex() != r->sphereTextureIndex() || l->toonTextureIndex() != r->toonTextureIndex()
+                || l->sphereTextureRenderMode() != r->sphereTextureRenderMode()
+                || l->isSharedToonTextureUsed() != r->isSharedToonTextureUsed()
+                || l->isCullFaceDisabled() != r->isCullFaceDisabled() || l->hasShadow() != r->hasShadow()
+                || l->isShadowMapDrawn() != r->isShadowMapDrawn() || l->isSelfShadowDrawn() != r->isSelfShadowDrawn()
+                || l->isEdgeDrawn() != r->isEdgeDrawn())
+            return false;
+    }
+    const Array<IString *> &leftTextures = left->textures(), &rightTextures = right->textures();
+    const int ntextures = leftTextures.count();
+    if (ntextures != rightTextures.count())
+        return false;
+    for (int i = 0; i < ntextures; i++) {
+        if (!IsSameString(leftTextures[i], rightTextures[i]))
+            return false;
+    }
+    return true;
+}
+
+/* 行列から視錐台の6平面を取り出し、各平面の法線方向に最も進んだ頂点が全て内側にあるかを調べる */
+static bool IntersectsFrustum(const float *m, const Vector3 &min, const Vector3 &max)
+{
+    for (int i = 0; i < 6; i++) {
+        const int row = i >> 1;
+        const float sign = (i & 1) ? -1.0f : 1.0f;
+        const float a = m[3]  + m[row]      * sign;
+        const float b = m[7]  + m[row + 4]  * sign;
+        const float c = m[11] + m[row + 8]  * sign;
+        const float d = m[15] + m[row + 12] * sign;
+        const float x = a >= 0 ? max.x() : min.x();
+        const float y = b >= 0 ? max.y() : min.y();
+        const float z = c >= 0 ? max.z() : min.z();
+        if (a * x + b * y + c * z + d < 0)
+            return false;
+    }
+    return true;
+}
+
+template<typename T>
+static T *CreateObjectPool(int size, Array<T *> &objects)
+{
+    /* 要素毎に確保せず一括で確保した連続した領域の各要素を配列から参照する */
+    T *pool = size > 0 ? new T[size] : 0;
+    objects.reserve(size);
+    for (int i = 0; i < size; i++)
+        objects.add(&pool[i]);
+    return pool;
+}
+
+template<typename T>
+static void ReleaseObjectPool(T *&pool, Array<T *> &objects)
+{
+    objects.clear();
+    delete[] pool;
+    pool = 0;
+}
+
 Model::Model(IEncoding *encoding)
     : m_worldRef(0),
       m_encodingRef(encoding),
+      m_vertexPool(0),
+      m_materialPool(0),
+      m_bonePool(0),
+      m_morphPool(0),
+      m_labelPool(0),
+      m_rigidBodyPool(0),
+      m_jointPool(0),
       m_skinnedVertices(0),
+      m_morphDeltas(0),
+      m_materialParameters(0),
+      m_packedVertices(0),
+      m_packedUVA1s(0),
       m_skinnedIndices(0),
+      m_indexStrideSize(sizeof(uint32_t)),
+      m_sourceSize(0),
+      m_sourceHash(0),
+      m_sourceRevision(0),
       m_name(0),
       m_englishName(0),
       m_comment(0),
@@ -146,6 +450,71 @@ size_t Model::strideOffset(StrideType type)
     }
 }
 
+size_t Model::packedStrideOffset(StrideType type)
+{
+    static const PackedVertex v;
+    static const PackedStaticVertex s;
+    static const uint8_t *base = reinterpret_cast<const uint8_t *>(&v);
+    static const uint8_t *staticBase = reinterpret_cast<const uint8_t *>(&s);
+    switch (type) {
+    case kVertexStride:
+        return reinterpret_cast<const uint8_t *>(&v.position) - base;
+    case kNormalStride:
+        return reinterpret_cast<const uint8_t *>(&v.normal) - base;
+    case kTexCoordStride:
+        return reinterpret_cast<const uint8_t *>(&v.texcoord) - base;
+    case kToonCoordStride:
+        return reinterpret_cast<const uint8_t *>(&v.texcoord[2]) - base;
+    case kEdgeVertexStride:
+        return reinterpret_cast<const uint8_t *>(&v.edge) - base;
+    case kBoneIndexStride:
+        return reinterpret_cast<const uint8_t *>(&s.boneIndices) - staticBase;
+    case kBoneWeightStride:
+        return reinterpret_cast<const uint8_t *>(&s.boneWeights) - staticBase;
+    case kEdgeSizeStride:
+        return reinterpret_cast<const uint8_t *>(&s.edgeSize) - staticBase;
+    case kUVA1Stride:
+    default:
+        return 0;
+    }
+}
+
+size_t Model::packedStrideSize(StrideType type)
+{
+    switch (type) {
+    case kVertexStride:
+    case kNormalStride:
+    case kTexCoordStride:
+    case kToonCoordStride:
+    case kEdgeVertexStride:
+        return sizeof(PackedVertex);
+    case kBoneIndexStride:
+    case kBoneWeightStride:
+    case kEdgeSizeStride:
+        return sizeof(PackedStaticVertex);
+    case kUVA1Stride:
+        return sizeof(Vector4);
+    default:
+        return 0;
+    }
+}
+
+Model::PackedStreamType Model::packedStreamType(StrideType type)
+{
+    switch (type) {
+    case kVertexStride:
+    case kNormalStride:
+    case kTexCoordStride:
+    case kToonCoordStride:
+    case kEdgeVertexStride:
+        return kDynamicStream;
+    case kUVA1Stride:
+        return kUVA1Stream;
+    default:
+        return kStaticStream;
+    }
+}
+
 size_t Model::strideSize(StrideType type)
 {
     switch (type) {
@@ -163,8 +532,6 @@ size_t Model::strideSize(StrideType type)
     case kUVA3Stride:
     case kUVA4Stride:
         return sizeof(SkinnedVertex);
-    case kIndexStride:
-        return sizeof(uint32_t);
     default:
         return 0;
     }
@@ -196,6 +563,10 @@ bool Model::load(const uint8_t *data, size_t size)
             m_info.error = info.error;
             return false;
         }
+        buildBoneBounds();
+        compileMorphs();
+        m_sourceSize = size;
+        m_sourceHash = HashSourceData(data, size);
         m_info = info;
         return true;
     }
@@ -205,71 +576,17 @@ bool Model::load(const uint8_t *data, size_t size)
     return false;
 }
 
-void Model::save(uint8_t * /* data */) const
+void Model::save(uint8_t *data) const
 {
+    Writer writer(this);
+    Writer::MemorySink sink(data, writer.estimateSize());
+    writer.write(&sink);
 }
 
 size_t Model::estimateSize() const
 {
-    size_t size = 0;
-    size += sizeof(Header);
-    size += sizeof(uint8_t) + 8;
-    size += internal::estimateSize(m_name);
-    size += internal::estimateSize(m_englishName);
-    size += internal::estimateSize(m_comment);
-    size += internal::estimateSize(m_englishComment);
-    const int nvertices = m_vertices.count();
-    size += sizeof(nvertices);
-    for (int i = 0; i < nvertices; i++) {
-        Vertex *vertex = m_vertices[i];
-        size += vertex->estimateSize(m_info);
-    }
-    const int nindices = m_indices.count();
-    size += sizeof(nindices);
-    size += m_info.vertexIndexSize * nindices;
-    const int ntextures = m_textures.count();
-    size += sizeof(ntextures);
-    for (int i = 0; i < ntextures; i++) {
-        IString *texture = m_textures[i];
-        size += internal::estimateSize(texture);
-    }
-    const int nmaterials = m_materials.count();
-    size += sizeof(nmaterials);
-    for (int i = 0; i < nmaterials; i++) {
-        Material *material = m_materials[i];
-        size += material->estimateSize(m_info);
-    }
-    const int nbones = m_bones.count();
-    size += sizeof(nbones);
-    for (int i = 0; i < nbones; i++) {
-        Bone *bone = m_bones[i];
-        size += bone->estimateSize(m_info);
-    }
-    const int nmorphs = m_morphs.count();
-    size += sizeof(nmorphs);
-    for (int i = 0; i < nmorphs; i++) {
-        Morph *morph = m_morphs[i];
-        size += morph->estimateSize(m_info);
-    }
-    const int nlabels = m_labels.count();
-    size += sizeof(nlabels);
-    for (int i = 0; i < nlabels; i++) {
-        Label *label = m_labels[i];
-        size += label->estimateSize(m_info);
-    }
-    const int nbodies = m_rigidBodies.count();
-    size += sizeof(nbodies);
-    for (int i = 0; i < nbodies; i++) {
-        RigidBody *body = m_rigidBodies[i];
-        size += body->estimateSize(m_info);
-    }
-    const int njoints = m_joints.count();
-    size += sizeof(njoints);
-    for (int i = 0; i < njoints; i++) {
-        Joint *joint = m_joints[i];
-        size += joint->estimateSize(m_info);
-    }
-    return size;
+    Writer writer(this);
+    return writer.estimateSize();
 }
 
 void Model::resetVertices()
@@ -279,10 +596,41 @@ void Model::resetVertices()
         Vertex *vertex = m_vertices[i];
         vertex->reset();
     }
+    if (m_morphDeltas) {
+        for (int i = 0; i < nvertices; i++)
+            m_morphDeltas[i].setZero();
+    }
+    if (m_materialParameters)
+        m_materialParameters->reset();
 }
 
 void Model::performUpdate(const Vector3 &cameraPosition, const Vector3 &lightDirection)
 {
+    performUpdateBones();
+    // skinning
+    if (m_enableSkinning) {
+        const Scalar &esf = edgeScaleFactor(cameraPosition);
+        performSkinning(0, m_vertices.count(), esf, lightDirection);
+    }
+    else {
+        const int nvertices = m_vertices.count();
+        for (int i = 0; i < nvertices; i++) {
+            Vertex *vertex = m_vertices[i];
+            SkinnedVertex &v = m_skinnedVertices[i];
+            v.position = vertex->origin() + vertex->delta() + m_morphDeltas[i];
+            v.normal[3] = vertex->edgeSize();
+            v.edge[3] = i;
+            if (m_packedVertices)
+                packVertex(i);
+        }
+    }
+}
+
+void Model::performUpdateBones()
+{
+    /* performSkinning は複数のスレッドから呼ばれるため、材質モーフの結果はここで計算しておく */
+    if (m_materialParameters)
+        m_materialParameters->update();
     // update local transform matrix
     const int nbones = m_bones.count();
     for (int i = 0; i < nbones; i++) {
@@ -319,44 +667,59 @@ void Model::performUpdate(const Vector3 &cameraPosition, const Vector3 &lightDir
         Bone *bone = m_APSOrderedBones[i];
         bone->performUpdateLocalTransform();
     }
-    const Scalar &esf = edgeScaleFactor(cameraPosition);
-    // skinning
-    if (m_enableSkinning) {
-        const int nmaterials = m_materials.count();
-        int offset = 0;
-        for (int i = 0; i < nmaterials; i++) {
-            const Material *material = m_materials[i];
-            const int nindices = material->indices(), offsetTo = offset + nindices;
-            const float materialEdgeSize = material->edgeSize();
-            for (int j = offset; j < offsetTo; j++) {
-                const int index = m_indices[j];
-                Vertex *vertex = m_vertices[index];
-                SkinnedVertex &v = m_skinnedVertices[index];
-                const Vector3 &tex = vertex->texcoord() + vertex->uv(0);
-                const float edgeSize = vertex->edgeSize();
-                vertex->performSkinning(v.position, v.normal);
-                v.texcoord.setValue(tex.x(), tex.y(), 0, 1 + lightDirection.dot(-v.normal) * 0.5);
-                v.edge = v.position + v.normal * edgeSize * materialEdgeSize * esf;
-                v.uva1 = vertex->uv(1);
-                v.uva2 = vertex->uv(2);
-                v.uva3 = vertex->uv(3);
-                v.uva4 = vertex->uv(4);
-            }
-            offset += nindices;
-        }
-    }
-    else {
-        const int nvertices = m_vertices.count();
-        for (int i = 0; i < nvertices; i++) {
-            Vertex *vertex = m_vertices[i];
-            SkinnedVertex &v = m_skinnedVertices[i];
-            v.position = vertex->origin() + vertex->delta();
-            v.normal[3] = vertex->edgeSize();
-            v.edge[3] = i;
-        }
+}
+
+void Model::performSkinning(int from, int to, const Scalar &edgeScaleFactor, const Vector3 &lightDirection)
+{
+    btClamp(to, 0, m_vertexMaterialRefs.count());
+    for (int i = from; i < to; i++) {
+        const Material *material = m_vertexMaterialRefs[i];
+        /* どの材質からも参照されない頂点は描画されないため変形しない */
+        if (!material)
+            continue;
+        Vertex *vertex = m_vertices[i];
+        SkinnedVertex &v = m_skinnedVertices[i];
+        const Vector3 &tex = vertex->texcoord() + vertex->uv(0);
+        const float edgeSize = vertex->edgeSize();
+        const Scalar &materialEdgeSize = m_materialParameters
+                ? m_materialParameters->at(material->index()).edgeSize : Scalar(material->edgeSize());
+        vertex->performSkinning(m_morphDeltas[i], v.position, v.normal);
+        v.texcoord.setValue(tex.x(), tex.y(), 0, 1 + lightDirection.dot(-v.normal) * 0.5);
+        v.edge = v.position + v.normal * edgeSize * materialEdgeSize * edgeScaleFactor;
+        v.uva1 = vertex->uv(1);
+        v.uva2 = vertex->uv(2);
+        v.uva3 = vertex->uv(3);
+        v.uva4 = vertex->uv(4);
+        if (m_packedVertices)
+            packVertex(i);
     }
 }
 
+void Model::packVertex(int index)
+{
+    const SkinnedVertex &v = m_skinnedVertices[index];
+    PackedVertex &p = m_packedVertices[index];
+    const Vector3 &position = v.position, &normal = v.normal, &edge = v.edge;
+    const Vector4 &texcoord = v.texcoord;
+    p.position[0] = position.x();
+    p.position[1] = position.y();
+    p.position[2] = position.z();
+    p.position[3] = position.w();
+    p.normal[0] = PackSignedNormalized(normal.x());
+    p.normal[1] = PackSignedNormalized(normal.y());
+    p.normal[2] = PackSignedNormalized(normal.z());
+    p.normal[3] = 0;
+    p.texcoord[0] = texcoord.x();
+    p.texcoord[1] = texcoord.y();
+    p.texcoord[2] = texcoord.z();
+    p.texcoord[3] = texcoord.w();
+    p.edge[0] = edge.x();
+    p.edge[1] = edge.y();
+    p.edge[2] = edge.z();
+    if (m_packedUVA1s)
+        m_packedUVA1s[index] = v.uva1;
+}
+
 void Model::joinWorld(btDiscreteDynamicsWorld *world)
 {
 #ifndef VPVL2_NO_BULLET
@@ -466,6 +829,29 @@ void Model::getMorphs(Array<IMorph *> &value) const
     }
 }
 
+void Model::savePose(Pose &value) const
+{
+    Array<IBone *> bones;
+    Array<IMorph *> morphs;
+    getBones(bones);
+    getMorphs(morphs);
+    value.save(bones, morphs);
+}
+
+int Model::restorePose(const Pose &value)
+{
+    Array<IBone *> bones;
+    Array<IMorph *> morphs;
+    getBones(bones);
+    getMorphs(morphs);
+    int nchanged = value.restoreBones(bones);
+    if (value.hasChangedMorphs(morphs)) {
+        resetVertices();
+        nchanged += value.restoreMorphs(morphs);
+    }
+    return nchanged;
+}
+
 void Model::getLabels(Array<ILabel *> &value) const
 {
     const int nlabels = m_labels.count();
@@ -479,11 +865,40 @@ void Model::getBoundingBox(Vector3 &min, Vector3 &max) const
 {
     min.setZero();
     max.setZero();
-    const int nvertices = m_vertices.count();
-    for (int i = 0; i < nvertices; i++) {
-        const Vector3 &position = m_skinnedVertices[i].position;
-        min.setMin(position);
-        max.setMax(position);
+    const int nbones = m_bones.count();
+    if (nbones > 0 && m_boneBoundsMin.count() == nbones) {
+        bool found = false;
+        for (int i = 0; i < nbones; i++) {
+            const Vector3 &boneMin = m_boneBoundsMin[i], &boneMax = m_boneBoundsMax[i];
+            /* 頂点から参照されないボーンは min が max を超える */
+            if (boneMin.x() > boneMax.x())
+                continue;
+            /* 中心と半分の大きさで表し、回転後の大きさは基底の絶対値との積で求める */
+            const Transform &transform = m_bones[i]->localTransform();
+            const Matrix3x3 &basis = transform.getBasis();
+            const Vector3 &center = transform * ((boneMin + boneMax) * 0.5);
+            const Vector3 &extent = (boneMax - boneMin) * 0.5;
+            const Vector3 transformedExtent(basis[0].absolute().dot(extent),
+                                            basis[1].absolute().dot(extent),
+                                            basis[2].absolute().dot(extent));
+            if (found) {
+                min.setMin(center - transformedExtent);
+                max.setMax(center + transformedExtent);
+            }
+            else {
+                min = center - transformedExtent;
+                max = center + transformedExtent;
+                found = true;
+            }
+        }
+    }
+    else {
+        const int nvertices = m_vertices.count();
+        for (int i = 0; i < nvertices; i++) {
+            const Vector3 &position = m_skinnedVertices[i].position;
+            min.setMin(position);
+            max.setMax(position);
+        }
     }
 }
 
@@ -494,11 +909,12 @@ void Model::getBoundingSphere(Vector3 &center, Scalar &radius) const
     IBone *bone = findBone(m_encodingRef->stringConstant(IEncoding::kCenter));
     if (bone) {
         const Vector3 &centerPosition = bone->worldTransform().getOrigin();
-        const int nvertices = m_vertices.count();
-        for (int i = 0; i < nvertices; i++) {
-            const Vector3 &position = m_skinnedVertices[i].position;
-            btSetMax(radius, centerPosition.distance2(position));
-        }
+        Vector3 min, max;
+        getBoundingBox(min, max);
+        /* 境界ボックスの頂点のうちセンターボーンから最も遠いものまでの距離を半径とする */
+        Vector3 farthest = (centerPosition - min).absolute();
+        farthest.setMax((max - centerPosition).absolute());
+        radius = farthest.length2();
         center = centerPosition;
         radius = btSqrt(radius);
     }
@@ -510,6 +926,13 @@ void Model::getBoundingSphere(Vector3 &center, Scalar &radius) const
     }
 }
 
+bool Model::isInsideFrustum(const float *matrix) const
+{
+    Vector3 min, max;
+    getBoundingBox(min, max);
+    return IntersectsFrustum(matrix, min, max);
+}
+
 bool Model::preparse(const uint8_t *data, size_t size, DataInfo &info)
 {
     size_t rest = size;
@@ -657,9 +1080,89 @@ const void *Model::vertexPtr() const
     return &m_skinnedVertices[0].position;
 }
 
+const void *Model::packedVertexPtr() const
+{
+    return m_packedVertices;
+}
+
+const void *Model::packedUVA1Ptr() const
+{
+    return m_packedUVA1s;
+}
+
+void Model::getPackedStaticVertices(uint8_t *data) const
+{
+    const int nvertices = m_vertices.count();
+    for (int i = 0; i < nvertices; i++) {
+        const Vertex *vertex = m_vertices[i];
+        const SkinnedVertex &v = m_skinnedVertices[i];
+        PackedStaticVertex s;
+        for (int j = 0; j < 4; j++) {
+            /* 使用しないボーンを表す -1 を残すため符号付きで格納する */
+            s.boneIndices[j] = int16_t(v.boneIndices[j]);
+            s.boneWeights[j] = PackUnsignedNormalized(v.boneWeights[j]);
+        }
+        s.edgeSize = vertex->edgeSize();
+        internal::copyBytes(data, reinterpret_cast<const uint8_t *>(&s), sizeof(s));
+        data += sizeof(s);
+    }
+}
+
 const void *Model::indicesPtr() const
 {
-    return &m_skinnedIndices[0];
+    return m_skinnedIndices;
+}
+
+size_t Model::indexStrideSize() const
+{
+    return m_indexStrideSize;
+}
+
+void Model::optimizeIndices()
+{
+    const int nmaterials = m_materials.count();
+    Array<CacheVertex> vertices;
+    Array<int> timestamps;
+    vertices.resize(m_vertices.count());
+    timestamps.resize(m_vertices.count());
+    int offset = 0;
+    /* 材質の描画範囲を変えないように材質毎に並べ替える */
+    for (int i = 0; i < nmaterials; i++) {
+        const int nindices = m_materials[i]->indices();
+        if (offset + nindices > m_indices.count())
+            break;
+        OptimizeTriangleOrder(&m_indices[offset], nindices, vertices, timestamps);
+        offset += nindices;
+    }
+    buildSkinnedIndices();
+    /* 並べ替え前のモデルと索引を共有しないように区別する */
+    m_sourceRevision++;
+}
+
+Scalar Model::averageCacheMissRatio(int cacheSize) const
+{
+    const int nindices = m_indices.count(), ntriangles = nindices / 3;
+    if (ntriangles == 0 || cacheSize <= 0)
+        return 0;
+    Array<int> timestamps;
+    timestamps.resize(m_vertices.count());
+    return CountCacheMisses(&m_indices[0], nindices, cacheSize, timestamps) / Scalar(ntriangles);
+}
+
+const MaterialParameterBuffer *Model::materialParameters() const
+{
+    if (m_materialParameters)
+        m_materialParameters->update();
+    return m_materialParameters;
+}
+
+bool Model::hasSameSource(const Model *value) const
+{
+    if (!value || m_sourceSize == 0 || m_sourceSize != value->m_sourceSize
+            || m_sourceHash != value->m_sourceHash || m_sourceRevision != value->m_sourceRevision)
+        return false;
+    /* ハッシュは 32 ビットで衝突し得るため、共有する内容そのものを比較して確かめる */
+    return value == this || HasSameSharedContents(this, value);
 }
 
 Scalar Model::edgeScaleFactor(const Vector3 &cameraPosition) const
@@ -696,18 +1199,33 @@ void Model::release()
 {
     leaveWorld(m_worldRef);
     internal::zerofill(&m_info, sizeof(m_info));
-    m_vertices.releaseAll();
+    ReleaseObjectPool(m_vertexPool, m_vertices);
     m_textures.releaseAll();
-    m_materials.releaseAll();
-    m_bones.releaseAll();
-    m_morphs.releaseAll();
-    m_labels.releaseAll();
-    m_rigidBodies.releaseAll();
-    m_joints.releaseAll();
+    ReleaseObjectPool(m_materialPool, m_materials);
+    ReleaseObjectPool(m_bonePool, m_bones);
+    ReleaseObjectPool(m_morphPool, m_morphs);
+    ReleaseObjectPool(m_labelPool, m_labels);
+    ReleaseObjectPool(m_rigidBodyPool, m_rigidBodies);
+    ReleaseObjectPool(m_jointPool, m_joints);
     delete[] m_skinnedVertices;
     m_skinnedVertices = 0;
+    delete[] m_morphDeltas;
+    m_morphDeltas = 0;
+    delete m_materialParameters;
+    m_materialParameters = 0;
+    delete[] m_packedVertices;
+    m_packedVertices = 0;
+    delete[] m_packedUVA1s;
+    m_packedUVA1s = 0;
     delete[] m_skinnedIndices;
     m_skinnedIndices = 0;
+    m_indexStrideSize = sizeof(uint32_t);
+    m_sourceSize = 0;
+    m_sourceHash = 0;
+    m_sourceRevision = 0;
+    m_vertexMaterialRefs.clear();
+    m_boneBoundsMin.clear();
+    m_boneBoundsMax.clear();
     delete m_name;
     m_name = 0;
     delete m_englishName;
@@ -738,9 +1256,13 @@ void Model::parseVertices(const DataInfo &info)
     size_t size;
     delete[] m_skinnedVertices;
     m_skinnedVertices = new SkinnedVertex[nvertices];
+    delete[] m_morphDeltas;
+    m_morphDeltas = new Vector3[nvertices];
+    for (int i = 0; i < nvertices; i++)
+        m_morphDeltas[i].setZero();
+    m_vertexPool = CreateObjectPool(nvertices, m_vertices);
     for(int i = 0; i < nvertices; i++) {
-        Vertex *vertex = new Vertex();
-        m_vertices.add(vertex);
+        Vertex *vertex = m_vertices[i];
         vertex->read(ptr, info, size);
         ptr += size;
     }
@@ -752,22 +1274,105 @@ void Model::parseIndices(const DataInfo &info)
     const int nvertices = info.verticesCount;
     uint8_t *ptr = info.indicesPtr;
     size_t size = info.vertexIndexSize;
-    delete[] m_skinnedIndices;
-    m_skinnedIndices = new int[nindices];
     for(int i = 0; i < nindices; i++) {
         int index = internal::readUnsignedIndex(ptr, size);
-        if (index >= 0 && index < nvertices) {
+        if (index >= 0 && index < nvertices)
             m_indices.add(index);
-            m_skinnedIndices[i] = index;
-        }
-        else {
+        else
             m_indices.add(0);
-            m_skinnedIndices[i] = 0;
+    }
+    /* 頂点数が 65536 以下であれば 16bit のインデックスで転送する */
+    m_indexStrideSize = nvertices <= 0x10000 ? sizeof(uint16_t) : sizeof(uint32_t);
+    buildSkinnedIndices();
+}
+
+void Model::compileMorphs()
+{
+    /*
+     * 頂点モーフは頂点毎の連続した移動量の配列に直接加算し、スキニング時に読み出す。
+     * 材質モーフは材質毎の値をまとめたバッファに寄与を累積する。
+     * グループモーフは末端のモーフに展開し、循環する参照は取り除く
+     */
+    const int nmorphs = m_morphs.count(), nvertices = m_vertices.count();
+    if (!m_materialParameters)
+        m_materialParameters = new MaterialParameterBuffer();
+    m_materialParameters->compile(m_materials);
+    for (int i = 0; i < nmorphs; i++) {
+        Morph *morph = m_morphs[i];
+        morph->compileVertices(m_morphDeltas, nvertices);
+        morph->compileMaterials(m_materialParameters);
+    }
+    Morph::compileGroups(m_morphs);
+}
+
+void Model::buildBoneBounds()
+{
+    /* 頂点モーフは重みが 1 以下のため、頂点毎の変位の長さの合計を移動量の上限とする */
+    const int nvertices = m_vertices.count(), nbones = m_bones.count(), nmorphs = m_morphs.count();
+    Hash<HashPtr, int> vertex2index;
+    Array<Scalar> morphExtents;
+    morphExtents.resize(nvertices);
+    for (int i = 0; i < nvertices; i++) {
+        vertex2index.insert(m_vertices[i], i);
+        morphExtents[i] = 0;
+    }
+    for (int i = 0; i < nmorphs; i++) {
+        const Morph *morph = m_morphs[i];
+        if (morph->type() != IMorph::kVertex)
+            continue;
+        const Array<Morph::Vertex *> &vertices = morph->vertices();
+        const int nmorphVertices = vertices.count();
+        for (int j = 0; j < nmorphVertices; j++) {
+            const Morph::Vertex *v = vertices[j];
+            const int *index = vertex2index.find(v->vertex);
+            if (index)
+                morphExtents[*index] += v->position.length();
         }
     }
+    /* 頂点が参照するボーン毎に変形前の頂点を含む境界ボックスを作る */
+    m_boneBoundsMin.resize(nbones);
+    m_boneBoundsMax.resize(nbones);
+    for (int i = 0; i < nbones; i++) {
+        m_boneBoundsMin[i].setValue(BT_LARGE_FLOAT, BT_LARGE_FLOAT, BT_LARGE_FLOAT);
+        m_boneBoundsMax[i].setValue(-BT_LARGE_FLOAT, -BT_LARGE_FLOAT, -BT_LARGE_FLOAT);
+    }
+    for (int i = 0; i < nvertices; i++) {
+        const Vertex *vertex = m_vertices[i];
+        const Scalar &e = morphExtents[i];
+        const Vector3 &origin = vertex->origin(), extent(e, e, e);
+        const int nweights = vertex->type() == Vertex::kBdef1 ? 1 : vertex->type() == Vertex::kBdef4 ? 4 : 2;
+        for (int j = 0; j < nweights; j++) {
+            const Bone *bone = vertex->bone(j);
+            const int index = bone ? bone->index() : -1;
+            if (index >= 0 && index < nbones) {
+                m_boneBoundsMin[index].setMin(origin - extent);
+                m_boneBoundsMax[index].setMax(origin + extent);
+            }
+        }
+    }
+}
+
+void Model::buildSkinnedIndices()
+{
+    const int nindices = m_indices.count();
+    delete[] m_skinnedIndices;
+    m_skinnedIndices = new uint8_t[nindices * m_indexStrideSize];
+    uint16_t *indices16 = reinterpret_cast<uint16_t *>(m_skinnedIndices);
+    uint32_t *indices32 = reinterpret_cast<uint32_t *>(m_skinnedIndices);
+    for (int i = 0; i < nindices; i++) {
+        const int index = m_indices[i];
+        if (m_indexStrideSize == sizeof(uint16_t))
+            indices16[i] = uint16_t(index);
+        else
+            indices32[i] = uint32_t(index);
+    }
 #ifdef VPVL2_COORDINATE_OPENGL
-    for (int i = 0; i < nindices; i += 3)
-        btSwap(m_skinnedIndices[i], m_skinnedIndices[i + 1]);
+    for (int i = 0; i + 2 < nindices; i += 3) {
+        if (m_indexStrideSize == sizeof(uint16_t))
+            btSwap(indices16[i], indices16[i + 1]);
+        else
+            btSwap(indices32[i], indices32[i + 1]);
+    }
 #endif
 }
 
@@ -788,13 +1393,17 @@ void Model::parseMaterials(const DataInfo &info)
     const int nmaterials = info.materialsCount;
     uint8_t *ptr = info.materialsPtr;
     size_t size;
+    m_materialPool = CreateObjectPool(nmaterials, m_materials);
     for(int i = 0; i < nmaterials; i++) {
-        Material *material = new Material();
-        m_materials.add(material);
+        Material *material = m_materials[i];
         material->read(ptr, info, size);
         ptr += size;
     }
     /* set initial skinned vertex value */
+    const int nvertices = m_vertices.count();
+    m_vertexMaterialRefs.resize(nvertices);
+    for (int i = 0; i < nvertices; i++)
+        m_vertexMaterialRefs[i] = 0;
     int offset = 0;
     for (int i = 0; i < nmaterials; i++) {
         const Material *material = m_materials[i];
@@ -805,6 +1414,7 @@ void Model::parseMaterials(const DataInfo &info)
             SkinnedVertex &v = m_skinnedVertices[index];
             v.normal[3] = vertex->edgeSize();
             v.edge[3] = index;
+            m_vertexMaterialRefs[index] = material;
         }
         offset += nindices;
     }
@@ -815,9 +1425,9 @@ void Model::parseBones(const DataInfo &info)
     const int nbones = info.bonesCount;
     uint8_t *ptr = info.bonesPtr;
     size_t size;
+    m_bonePool = CreateObjectPool(nbones, m_bones);
     for(int i = 0; i < nbones; i++) {
-        Bone *bone = new Bone();
-        m_bones.add(bone);
+        Bone *bone = m_bones[i];
         bone->read(ptr, info, size);
         bone->performTransform();
         bone->performUpdateLocalTransform();
@@ -832,9 +1442,9 @@ void Model::parseMorphs(const DataInfo &info)
     const int nmorphs = info.morphsCount;
     uint8_t *ptr = info.morphsPtr;
     size_t size;
+    m_morphPool = CreateObjectPool(nmorphs, m_morphs);
     for(int i = 0; i < nmorphs; i++) {
-        Morph *morph = new Morph();
-        m_morphs.add(morph);
+        Morph *morph = m_morphs[i];
         morph->read(ptr, info, size);
         m_name2morphRefs.insert(morph->name()->toHashString(), morph);
         m_name2morphRefs.insert(morph->englishName()->toHashString(), morph);
@@ -847,9 +1457,9 @@ void Model::parseLabels(const DataInfo &info)
     const int nlabels = info.labelsCount;
     uint8_t *ptr = info.labelsPtr;
     size_t size;
+    m_labelPool = CreateObjectPool(nlabels, m_labels);
     for(int i = 0; i < nlabels; i++) {
-        Label *label = new Label();
-        m_labels.add(label);
+        Label *label = m_labels[i];
         label->read(ptr, info, size);
         ptr += size;
     }
@@ -860,9 +1470,9 @@ void Model::parseRigidBodies(const DataInfo &info)
     const int nRigidBodies = info.rigidBodiesCount;
     uint8_t *ptr = info.rigidBodiesPtr;
     size_t size;
+    m_rigidBodyPool = CreateObjectPool(nRigidBodies, m_rigidBodies);
     for(int i = 0; i < nRigidBodies; i++) {
-        RigidBody *rigidBody = new RigidBody();
-        m_rigidBodies.add(rigidBody);
+        RigidBody *rigidBody = m_rigidBodies[i];
         rigidBody->read(ptr, info, size);
         ptr += size;
     }
@@ -873,9 +1483,9 @@ void Model::parseJoints(const DataInfo &info)
     const int nJoints = info.jointsCount;
     uint8_t *ptr = info.jointsPtr;
     size_t size;
+    m_jointPool = CreateObjectPool(nJoints, m_joints);
     for(int i = 0; i < nJoints; i++) {
-        Joint *joint = new Joint();
-        m_joints.add(joint);
+        Joint *joint = m_joints[i];
         joint->read(ptr, info, size);
         ptr += size;
     }
@@ -893,7 +1503,7 @@ void Model::getSkinningMesh(SkinningMeshes &meshes) const
         const int nindices = material->indices();
         int boneIndexInteral = 0;
         for (int j = 0; j < nindices; j++) {
-            int vertexIndex = m_skinnedIndices[offset + j];
+            int vertexIndex = m_indices[offset + j];
             Vertex *vertex = m_vertices[vertexIndex];
             switch (vertex->type()) {
             case Vertex::kBdef1:
@@ -962,7 +1572,7 @@ void Model::updateSkinningMesh(SkinningMeshes &meshes) const
     }
     const int nvertices = m_vertices.count();
     for (int i = 0; i < nvertices; i++)
-        m_skinnedVertices[i].position = m_vertices[i]->origin() + m_vertices[i]->delta();
+        m_skinnedVertices[i].position = m_vertices[i]->origin() + m_vertices[i]->delta() + m_morphDeltas[i];
 }
 
 void Model::setSkinningEnable(bool value)
@@ -970,5 +1580,32 @@ void Model::setSkinningEnable(bool value)
     m_enableSkinning = value;
 }
 
+bool Model::isSkinningEnabled() const
+{
+    return m_enableSkinning;
+}
+
+void Model::setPackedVertexEnable(bool value)
+{
+    delete[] m_packedVertices;
+    m_packedVertices = 0;
+    delete[] m_packedUVA1s;
+    m_packedUVA1s = 0;
+    if (value) {
+        const int nvertices = m_vertices.count();
+        m_packedVertices = new PackedVertex[nvertices];
+        /* 追加 UV を持たないモデルでは UVA の領域を確保しない */
+        if (m_info.additionalUVSize > 0)
+            m_packedUVA1s = new Vector4[nvertices];
+        for (int i = 0; i < nvertices; i++)
+            packVertex(i);
+    }
+}
+
+bool Model::isPackedVertexEnabled() const
+{
+    return m_packedVertices != 0;
+}
+
 }
 }
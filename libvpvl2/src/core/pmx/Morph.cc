@@ -39,6 +39,7 @@
 
 #include "vpvl2/pmx/Bone.h"
 #include "vpvl2/pmx/Material.h"
+#include "vpvl2/pmx/MaterialParameterBuffer.h"
 #include "vpvl2/pmx/Morph.h"
 #include "vpvl2/pmx/Vertex.h"
 
@@ -84,6 +85,19 @@ struct GroupMorph {
 
 #pragma pack(pop)
 
+enum GroupMorphState {
+    kGroupVisiting,
+    kGroupFlattened
+};
+
+class VertexMorphIndexPredication
+{
+public:
+    inline bool operator()(const vpvl2::pmx::Morph::Vertex *left, const vpvl2::pmx::Morph::Vertex *right) const {
+        return left->index < right->index;
+    }
+};
+
 }
 
 namespace vpvl2
@@ -92,7 +106,11 @@ namespace pmx
 {
 
 Morph::Morph()
-    : m_name(0),
+    : m_vertexDeltasRef(0),
+      m_hasReleasedVertices(false),
+      m_hasFlattenedGroups(false),
+      m_materialParametersRef(0),
+      m_name(0),
       m_englishName(0),
       m_weight(0),
       m_category(kReserved),
@@ -104,6 +122,10 @@ Morph::Morph()
 
 Morph::~Morph()
 {
+    m_vertexDeltasRef = 0;
+    m_hasReleasedVertices = false;
+    m_hasFlattenedGroups = false;
+    m_materialParametersRef = 0;
     m_vertices.releaseAll();
     m_uvs.releaseAll();
     m_bones.releaseAll();
@@ -260,14 +282,10 @@ bool Morph::loadGroups(const Array<Morph *> &morphs, Morph *morph)
                 return false;
             }
             else {
+                /* 入れ子のグループモーフ及びその循環参照は compileGroups で解決する */
                 Morph *morph = morphs[groupIndex];
-                if (morph->m_type == kGroup) {
-                    return false;
-                }
-                else {
-                    group->morph = morph;
-                    morph->m_hasParent = true;
-                }
+                group->morph = morph;
+                morph->m_hasParent = true;
             }
         }
     }
@@ -389,7 +407,7 @@ void Morph::write(uint8_t *data, const Model::DataInfo &info) const
         writeGroups(info, data);
         break;
     case kVertex: /* vertex */
-        mu.size = m_vertices.count();
+        mu.size = countVertices();
         internal::writeBytes(reinterpret_cast<const uint8_t *>(&mu), sizeof(mu), data);
         writeVertices(info, data);
         break;
@@ -428,7 +446,7 @@ size_t Morph::estimateSize(const Model::DataInfo &info) const
         size += m_groups.count() * (sizeof(GroupMorph) + info.morphIndexSize);
         break;
     case kVertex:
-        size += m_vertices.count() * (sizeof(VertexMorph) + info.vertexIndexSize);
+        size += countVertices() * (sizeof(VertexMorph) + info.vertexIndexSize);
         break;
     case kBone:
         size += m_bones.count() * (sizeof(BoneMorph) + info.boneIndexSize);
@@ -456,6 +474,15 @@ void Morph::setWeight(const IMorph::WeightPrecision &value)
     int nmorphs;
     switch (m_type) {
     case kGroup: /* group */
+        if (m_hasFlattenedGroups) {
+            /* 展開済みのため入れ子のグループを辿らずに末端のモーフにのみ適用する */
+            nmorphs = m_flattenedGroups.count();
+            for (int i = 0; i < nmorphs; i++) {
+                const Group &v = m_flattenedGroups[i];
+                v.morph->setWeight(v.weight * value);
+            }
+            break;
+        }
         nmorphs = m_groups.count();
         for (int i = 0; i < nmorphs; i++) {
             Group *v = m_groups[i];
@@ -465,6 +492,18 @@ void Morph::setWeight(const IMorph::WeightPrecision &value)
         }
         break;
     case kVertex: /* vertex */
+        if (m_vertexDeltasRef) {
+            /* 頂点の番号順に並んだ連続する配列に加算するため、Vector3 の SIMD 演算がそのまま使われる */
+            nmorphs = m_compiledVertexIndices.count();
+            if (nmorphs > 0) {
+                const Scalar weight(value);
+                const int *indices = &m_compiledVertexIndices[0];
+                const Vector3 *deltas = &m_compiledVertexDeltas[0];
+                for (int i = 0; i < nmorphs; i++)
+                    m_vertexDeltasRef[indices[i]] += deltas[i] * weight;
+            }
+            break;
+        }
         nmorphs = m_vertices.count();
         for (int i = 0; i < nmorphs; i++) {
             Vertex *v = m_vertices[i];
@@ -497,6 +536,11 @@ void Morph::setWeight(const IMorph::WeightPrecision &value)
         break;
     case kMaterial: /* material */
         nmorphs = m_materials.count();
+        if (m_materialParametersRef) {
+            for (int i = 0; i < nmorphs; i++)
+                m_materialParametersRef->accumulate(m_materials.at(i), value);
+            break;
+        }
         for (int i = 0; i < nmorphs; i++) {
             Material *v = m_materials.at(i);
             const Array<pmx::Material *> *materials = v->materials;
@@ -530,11 +574,32 @@ void Morph::addBoneMorph(Bone *value)
 void Morph::addGroupMorph(Group *value)
 {
     m_groups.add(value);
+    m_flattenedGroups.clear();
+    m_hasFlattenedGroups = false;
+}
+
+int Morph::compileGroups(const Array<Morph *> &morphs)
+{
+    Hash<HashPtr, int> states;
+    const int nmorphs = morphs.count();
+    int ncycles = 0;
+    for (int i = 0; i < nmorphs; i++) {
+        Morph *morph = morphs[i];
+        morph->m_flattenedGroups.clear();
+        morph->m_hasFlattenedGroups = false;
+    }
+    for (int i = 0; i < nmorphs; i++) {
+        Morph *morph = morphs[i];
+        if (morph->m_type == kGroup && !states.find(morph))
+            flattenGroup(morph, states, ncycles);
+    }
+    return ncycles;
 }
 
 void Morph::addMaterialMorph(Material *value)
 {
     m_materials.add(value);
+    m_materialParametersRef = 0;
 }
 
 void Morph::addUVMorph(UV *value)
@@ -544,7 +609,120 @@ void Morph::addUVMorph(UV *value)
 
 void Morph::addVertexMorph(Vertex *value)
 {
+    restoreVertices();
     m_vertices.add(value);
+    /* 変換済みの配列には含まれないため、変換前の適用方法に戻す */
+    m_compiledVertexIndices.clear();
+    m_compiledVertexDeltas.clear();
+    m_compiledVertexRefs.clear();
+    m_compiledVertexOrder.clear();
+    m_vertexDeltasRef = 0;
+}
+
+void Morph::compileVertices(Vector3 *deltas, int nvertices)
+{
+    restoreVertices();
+    m_compiledVertexIndices.clear();
+    m_compiledVertexDeltas.clear();
+    m_compiledVertexRefs.clear();
+    m_compiledVertexOrder.clear();
+    m_vertexDeltasRef = 0;
+    if (m_type != kVertex || !deltas)
+        return;
+    Array<Vertex *> ordered;
+    const int nMorphVertices = m_vertices.count();
+    ordered.reserve(nMorphVertices);
+    for (int i = 0; i < nMorphVertices; i++) {
+        Vertex *vertex = m_vertices[i];
+        const int vertexIndex = vertex->index;
+        if (vertexIndex >= 0 && vertexIndex < nvertices)
+            ordered.add(vertex);
+    }
+    ordered.sort(VertexMorphIndexPredication());
+    const int nordered = ordered.count();
+    m_compiledVertexIndices.reserve(nordered);
+    m_compiledVertexDeltas.reserve(nordered);
+    m_compiledVertexRefs.reserve(nordered);
+    int previousIndex = -1;
+    for (int i = 0; i < nordered; i++) {
+        const Vertex *vertex = ordered[i];
+        const int vertexIndex = vertex->index;
+        /* 同じ頂点を複数回参照する場合は移動量を合算して1要素にまとめる */
+        if (vertexIndex == previousIndex) {
+            m_compiledVertexDeltas[m_compiledVertexDeltas.count() - 1] += vertex->position;
+        }
+        else {
+            m_compiledVertexIndices.add(vertexIndex);
+            m_compiledVertexDeltas.add(vertex->position);
+            m_compiledVertexRefs.add(vertex->vertex);
+            previousIndex = vertexIndex;
+        }
+    }
+    m_vertexDeltasRef = deltas;
+    /* 要素をまとめたり除いた場合は元に戻せないため、変換前の頂点モーフを残す */
+    const int ncompiled = m_compiledVertexIndices.count();
+    if (ncompiled != nMorphVertices)
+        return;
+    /* 元の順番が頂点の番号順と異なる場合のみ、元の順番の各要素が変換後の何番目かを記録する */
+    bool isSorted = true;
+    for (int i = 0; i < nMorphVertices; i++) {
+        if (int(m_vertices[i]->index) != m_compiledVertexIndices[i]) {
+            isSorted = false;
+            break;
+        }
+    }
+    if (!isSorted) {
+        m_compiledVertexOrder.reserve(nMorphVertices);
+        for (int i = 0; i < nMorphVertices; i++) {
+            /* 変換後の索引は重複の無い昇順のため二分探索で位置を求める */
+            const int vertexIndex = m_vertices[i]->index;
+            int low = 0, high = ncompiled - 1;
+            while (low < high) {
+                const int middle = (low + high) / 2;
+                if (m_compiledVertexIndices[middle] < vertexIndex)
+                    low = middle + 1;
+                else
+                    high = middle;
+            }
+            m_compiledVertexOrder.add(low);
+        }
+    }
+    m_vertices.releaseAll();
+    m_hasReleasedVertices = true;
+}
+
+const Array<Morph::Vertex *> &Morph::vertices() const
+{
+    restoreVertices();
+    return m_vertices;
+}
+
+void Morph::restoreVertices() const
+{
+    if (!m_hasReleasedVertices)
+        return;
+    const int nvertices = m_compiledVertexIndices.count();
+    const bool hasOrder = m_compiledVertexOrder.count() > 0;
+    m_vertices.reserve(nvertices);
+    for (int i = 0; i < nvertices; i++) {
+        const int index = hasOrder ? m_compiledVertexOrder[i] : i;
+        Vertex *vertex = new Vertex();
+        vertex->vertex = m_compiledVertexRefs[index];
+        vertex->position = m_compiledVertexDeltas[index];
+        vertex->index = m_compiledVertexIndices[index];
+        m_vertices.add(vertex);
+    }
+    m_hasReleasedVertices = false;
+}
+
+int Morph::countVertices() const
+{
+    return m_hasReleasedVertices ? m_compiledVertexIndices.count() : m_vertices.count();
+}
+
+void Morph::compileMaterials(MaterialParameterBuffer *buffer)
+{
+    m_materialParametersRef = m_type == kMaterial ? buffer : 0;
 }
 
 void Morph::setCategory(Category value)
@@ -562,6 +740,69 @@ void Morph::setIndex(int value)
     m_index = value;
 }
 
+void Morph::flattenGroup(Morph *morph, Hash<HashPtr, int> &states, int &ncycles)
+{
+    const HashPtr key(morph);
+    states.insert(key, kGroupVisiting);
+    const int ngroups = morph->m_groups.count();
+    for (int i = 0; i < ngroups; i++) {
+        const Group *group = morph->m_groups[i];
+        Morph *child = group->morph;
+        if (!child)
+            continue;
+        if (child->m_type != kGroup) {
+            morph->addFlattenedMorph(child, group->weight);
+            continue;
+        }
+        const HashPtr childKey(child);
+        if (!states.find(childKey))
+            flattenGroup(child, states, ncycles);
+        /* 展開中のグループを再び参照する場合は循環しているため、その参照を無視する */
+        if (*states.find(childKey) == kGroupVisiting) {
+            ncycles++;
+            continue;
+        }
+        const Array<Group> &leaves = child->m_flattenedGroups;
+        const int nleaves = leaves.count();
+        for (int j = 0; j < nleaves; j++) {
+            const Group &leaf = leaves[j];
+            morph->addFlattenedMorph(leaf.morph, leaf.weight * group->weight);
+        }
+    }
+    morph->m_hasFlattenedGroups = true;
+    states.insert(key, kGroupFlattened);
+}
+
+void Morph::addFlattenedMorph(Morph *morph, float weight)
+{
+    /* 頂点と UV のモーフは重みに対して線形のため、同じモーフへの複数の経路を1つにまとめる */
+    switch (morph->m_type) {
+    case kVertex:
+    case kTexCoord:
+    case kUVA1:
+    case kUVA2:
+    case kUVA3:
+    case kUVA4: {
+        const int nflattened = m_flattenedGroups.count();
+        for (int i = 0; i < nflattened; i++) {
+            Group &v = m_flattenedGroups[i];
+            if (v.morph == morph) {
+                v.weight += weight;
+                return;
+            }
+        }
+        break;
+    }
+    default:
+        break;
+    }
+    Group v;
+    v.morph = morph;
+    v.weight = weight;
+    v.index = morph->m_index;
+    m_flattenedGroups.add(v);
+}
+
 void Morph::readBones(const Model::DataInfo &info, int count, uint8_t *&ptr)
 {
     BoneMorph morph;
@@ -712,7 +953,18 @@ void Morph::writeUVs(const Model::DataInfo &info, uint8_t *&ptr) const
 void Morph::writeVertices(const Model::DataInfo &info, uint8_t *&ptr) const
 {
     VertexMorph morph;
-    int nvertices = m_vertices.count(), vertexIndexSize = info.vertexIndexSize;
+    int nvertices = countVertices(), vertexIndexSize = info.vertexIndexSize;
+    if (m_hasReleasedVertices) {
+        /* Morph::Vertex を作り直さずに変換後の配列から元の順番で書き出す */
+        const bool hasOrder = m_compiledVertexOrder.count() > 0;
+        for (int i = 0; i < nvertices; i++) {
+            const int index = hasOrder ? m_compiledVertexOrder[i] : i;
+            internal::getPosition(m_compiledVertexDeltas[index], morph.position);
+            internal::writeUnsignedIndex(m_compiledVertexIndices[index], vertexIndexSize, ptr);
+            internal::writeBytes(reinterpret_cast<const uint8_t *>(&morph), sizeof(morph), ptr);
+        }
+        return;
+    }
     for (int i = 0; i < nvertices; i++) {
         const Morph::Vertex *vertex = m_vertices[i];
         internal::getPosition(vertex->position, morph.position);
@@ -405,7 +405,12 @@ void Vertex::mergeMorph(const Morph::Vertex *morph, float weight)
 
 void Vertex::performSkinning(Vector3 &position, Vector3 &normal)
 {
-    const Vector3 &vertexPosition = m_origin + m_morphDelta;
+    performSkinning(kZeroV3, position, normal);
+}
+
+void Vertex::performSkinning(const Vector3 &delta, Vector3 &position, Vector3 &normal)
+{
+    const Vector3 &vertexPosition = m_origin + m_morphDelta + delta;
     switch (m_type) {
     case kBdef1: {
         const Transform &transform = m_boneRefs[0]->localTransform();
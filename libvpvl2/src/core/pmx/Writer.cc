@@ -0,0 +1,403 @@
+/* ----------------------------------------------------------------- */
+/*                                                                   */
+/*  Copyright (c) 2010-2012  hkrn                                    */
+/*                                                                   */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/* - Redistributions of source code must retain the above copyright  */
+/*   notice, this list of conditions and the following disclaimer.   */
+/* - Redistributions in binary form must reproduce the above         */
+/*   copyright notice, this list of conditions and the following     */
+/*   disclaimer in the documentation and/or other materials provided */
+/*   with the distribution.                                          */
+/* - Neither the name of the MMDAI project team nor the names of     */
+/*   its contributors may be used to endorse or promote products     */
+/*   derived from this software without specific prior written       */
+/*   permission.                                                     */
+/*                                                                   */
+/* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND            */
+/* CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,       */
+/* INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF          */
+/* MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE          */
+/* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS */
+/* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,          */
+/* EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED   */
+/* TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,     */
+/* DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON */
+/* ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,   */
+/* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY    */
+/* OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE           */
+/* POSSIBILITY OF SUCH DAMAGE.                                       */
+/* ----------------------------------------------------------------- */
+
+#include "vpvl2/vpvl2.h"
+#include "vpvl2/internal/util.h"
+
+#include "vpvl2/pmx/Bone.h"
+#include "vpvl2/pmx/Joint.h"
+#include "vpvl2/pmx/Label.h"
+#include "vpvl2/pmx/Material.h"
+#include "vpvl2/pmx/Morph.h"
+#include "vpvl2/pmx/RigidBody.h"
+#include "vpvl2/pmx/Vertex.h"
+#include "vpvl2/pmx/Writer.h"
+
+namespace {
+
+#pragma pack(push, 1)
+
+    struct Header
+    {
+        uint8_t signature[4];
+        float version;
+    };
+
+#pragma pack(pop)
+
+    static const uint8_t kFlagSize = 8;
+
+    static size_t UnsignedIndexSize(int count)
+    {
+        if (count <= 0x100)
+            return sizeof(uint8_t);
+        else if (count <= 0x10000)
+            return sizeof(uint16_t);
+        return sizeof(int32_t);
+    }
+
+    static size_t SignedIndexSize(int count)
+    {
+        /* -1 を「なし」として扱うため符号付きの範囲に収める */
+        if (count <= 0x80)
+            return sizeof(int8_t);
+        else if (count <= 0x8000)
+            return sizeof(int16_t);
+        return sizeof(int32_t);
+    }
+
+}
+
+namespace vpvl2
+{
+namespace pmx
+{
+
+Writer::MemorySink::MemorySink(uint8_t *data, size_t size)
+    : m_data(data),
+      m_size(size),
+      m_written(0)
+{
+}
+
+Writer::MemorySink::~MemorySink()
+{
+    m_data = 0;
+    m_size = 0;
+    m_written = 0;
+}
+
+bool Writer::MemorySink::write(const uint8_t *data, size_t size)
+{
+    if (!m_data || m_written + size > m_size)
+        return false;
+    internal::copyBytes(m_data + m_written, data, size);
+    m_written += size;
+    return true;
+}
+
+Writer::FileSink::FileSink(FILE *fp)
+    : m_fp(fp)
+{
+}
+
+Writer::FileSink::~FileSink()
+{
+    m_fp = 0;
+}
+
+bool Writer::FileSink::write(const uint8_t *data, size_t size)
+{
+    return m_fp && fwrite(data, 1, size, m_fp) == size;
+}
+
+Writer::Writer(const Model *model)
+    : m_modelRef(model),
+      m_chunk(0),
+      m_chunkCapacity(0),
+      m_chunkOffset(0),
+      m_chunkSize(kDefaultChunkSize),
+      m_enableIndexSizeNarrowing(false),
+      m_enableTextureDeduplication(false)
+{
+}
+
+Writer::~Writer()
+{
+    delete[] m_chunk;
+    m_chunk = 0;
+    m_chunkCapacity = 0;
+    m_chunkOffset = 0;
+    m_modelRef = 0;
+}
+
+size_t Writer::estimateSize()
+{
+    Model::DataInfo info;
+    buildDataInfo(info);
+    buildTextureTable();
+    size_t size = 0;
+    size += sizeof(Header);
+    size += sizeof(kFlagSize) + kFlagSize;
+    size += internal::estimateSize(m_modelRef->name());
+    size += internal::estimateSize(m_modelRef->englishName());
+    size += internal::estimateSize(m_modelRef->comment());
+    size += internal::estimateSize(m_modelRef->englishComment());
+    const Array<Vertex *> &vertices = m_modelRef->vertices();
+    const int nvertices = vertices.count();
+    size += sizeof(int);
+    for (int i = 0; i < nvertices; i++)
+        size += vertices[i]->estimateSize(info);
+    size += sizeof(int);
+    size += m_modelRef->indices().count() * info.vertexIndexSize;
+    const int ntextures = m_textureRefs.count();
+    size += sizeof(int);
+    for (int i = 0; i < ntextures; i++)
+        size += internal::estimateSize(m_textureRefs[i]);
+    const Array<Material *> &materials = m_modelRef->materials();
+    const int nmaterials = materials.count();
+    size += sizeof(int);
+    for (int i = 0; i < nmaterials; i++)
+        size += materials[i]->estimateSize(info);
+    const Array<Bone *> &bones = m_modelRef->bones();
+    const int nbones = bones.count();
+    size += sizeof(int);
+    for (int i = 0; i < nbones; i++)
+        size += bones[i]->estimateSize(info);
+    const Array<Morph *> &morphs = m_modelRef->morphs();
+    const int nmorphs = morphs.count();
+    size += sizeof(int);
+    for (int i = 0; i < nmorphs; i++)
+        size += morphs[i]->estimateSize(info);
+    const Array<Label *> &labels = m_modelRef->labels();
+    const int nlabels = labels.count();
+    size += sizeof(int);
+    for (int i = 0; i < nlabels; i++)
+        size += labels[i]->estimateSize(info);
+    const Array<RigidBody *> &bodies = m_modelRef->rigidBodies();
+    const int nbodies = bodies.count();
+    size += sizeof(int);
+    for (int i = 0; i < nbodies; i++)
+        size += bodies[i]->estimateSize(info);
+    const Array<Joint *> &joints = m_modelRef->joints();
+    const int njoints = joints.count();
+    size += sizeof(int);
+    for (int i = 0; i < njoints; i++)
+        size += joints[i]->estimateSize(info);
+    return size;
+}
+
+bool Writer::write(ISink *sink)
+{
+    if (!sink)
+        return false;
+    Model::DataInfo info;
+    buildDataInfo(info);
+    buildTextureTable();
+    m_chunkOffset = 0;
+    uint8_t *ptr = 0;
+    /* header */
+    Header header;
+    internal::copyBytes(header.signature, reinterpret_cast<const uint8_t *>("PMX "), sizeof(header.signature));
+    header.version = 2.0;
+    if (!reserve(sink, sizeof(header) + sizeof(kFlagSize) + kFlagSize, ptr))
+        return false;
+    internal::writeBytes(reinterpret_cast<const uint8_t *>(&header), sizeof(header), ptr);
+    const uint8_t flags[] = {
+        kFlagSize,
+        uint8_t(info.codec == IString::kUTF8 ? 1 : 0),
+        uint8_t(info.additionalUVSize),
+        uint8_t(info.vertexIndexSize),
+        uint8_t(info.textureIndexSize),
+        uint8_t(info.materialIndexSize),
+        uint8_t(info.boneIndexSize),
+        uint8_t(info.morphIndexSize),
+        uint8_t(info.rigidBodyIndexSize)
+    };
+    internal::writeBytes(flags, sizeof(flags), ptr);
+    /* names and comments */
+    const IString *strings[] = {
+        m_modelRef->name(),
+        m_modelRef->englishName(),
+        m_modelRef->comment(),
+        m_modelRef->englishComment()
+    };
+    for (size_t i = 0; i < sizeof(strings) / sizeof(strings[0]); i++) {
+        const IString *s = strings[i];
+        if (!reserve(sink, internal::estimateSize(s), ptr))
+            return false;
+        internal::writeString(s, ptr);
+    }
+    /* vertices */
+    if (!writeElements(sink, m_modelRef->vertices(), info))
+        return false;
+    /* indices */
+    const Array<int> &indices = m_modelRef->indices();
+    const int nindices = indices.count();
+    if (!reserve(sink, sizeof(nindices), ptr))
+        return false;
+    internal::writeBytes(reinterpret_cast<const uint8_t *>(&nindices), sizeof(nindices), ptr);
+    for (int i = 0; i < nindices; i++) {
+        if (!reserve(sink, info.vertexIndexSize, ptr))
+            return false;
+        internal::writeUnsignedIndex(indices[i], info.vertexIndexSize, ptr);
+    }
+    /* textures */
+    const int ntextures = m_textureRefs.count();
+    if (!reserve(sink, sizeof(ntextures), ptr))
+        return false;
+    internal::writeBytes(reinterpret_cast<const uint8_t *>(&ntextures), sizeof(ntextures), ptr);
+    for (int i = 0; i < ntextures; i++) {
+        const IString *texture = m_textureRefs[i];
+        if (!reserve(sink, internal::estimateSize(texture), ptr))
+            return false;
+        internal::writeString(texture, ptr);
+    }
+    /* materials (with texture indices pointing to the written table) and the rest */
+    return writeMaterials(sink, info)
+            && writeElements(sink, m_modelRef->bones(), info)
+            && writeElements(sink, m_modelRef->morphs(), info)
+            && writeElements(sink, m_modelRef->labels(), info)
+            && writeElements(sink, m_modelRef->rigidBodies(), info)
+            && writeElements(sink, m_modelRef->joints(), info)
+            && flush(sink);
+}
+
+void Writer::setIndexSizeNarrowingEnable(bool value)
+{
+    m_enableIndexSizeNarrowing = value;
+}
+
+void Writer::setTextureDeduplicationEnable(bool value)
+{
+    m_enableTextureDeduplication = value;
+}
+
+void Writer::setChunkSize(size_t value)
+{
+    m_chunkSize = btMax(value, size_t(1));
+}
+
+void Writer::buildDataInfo(Model::DataInfo &info) const
+{
+    info = m_modelRef->dataInfo();
+    const int nvertices = m_modelRef->vertices().count();
+    const int ntextures = m_modelRef->textures().count();
+    const int nmaterials = m_modelRef->materials().count();
+    const int nbones = m_modelRef->bones().count();
+    const int nmorphs = m_modelRef->morphs().count();
+    const int nbodies = m_modelRef->rigidBodies().count();
+    /* 読み込まれていないモデルは大きさが 0 になっているため、常に要素数から求める */
+    if (m_enableIndexSizeNarrowing || info.vertexIndexSize == 0) {
+        info.vertexIndexSize = UnsignedIndexSize(nvertices);
+        info.textureIndexSize = SignedIndexSize(ntextures);
+        info.materialIndexSize = SignedIndexSize(nmaterials);
+        info.boneIndexSize = SignedIndexSize(nbones);
+        info.morphIndexSize = SignedIndexSize(nmorphs);
+        info.rigidBodyIndexSize = SignedIndexSize(nbodies);
+    }
+}
+
+void Writer::buildTextureTable()
+{
+    const Array<IString *> &textures = m_modelRef->textures();
+    const int ntextures = textures.count();
+    m_textureRefs.clear();
+    m_textureIndices.resize(ntextures);
+    for (int i = 0; i < ntextures; i++) {
+        const IString *texture = textures[i];
+        int index = -1;
+        if (m_enableTextureDeduplication) {
+            const int nrefs = m_textureRefs.count();
+            for (int j = 0; j < nrefs; j++) {
+                if (texture->equals(m_textureRefs[j])) {
+                    index = j;
+                    break;
+                }
+            }
+        }
+        if (index < 0) {
+            index = m_textureRefs.count();
+            m_textureRefs.add(texture);
+        }
+        m_textureIndices[i] = index;
+    }
+}
+
+/* 材質のテクスチャの番号は書き出すテクスチャのテーブルの番号に変換する */
+bool Writer::writeMaterials(ISink *sink, const Model::DataInfo &info)
+{
+    const Array<Material *> &materials = m_modelRef->materials();
+    const int nmaterials = materials.count();
+    uint8_t *ptr = 0;
+    if (!reserve(sink, sizeof(nmaterials), ptr))
+        return false;
+    internal::writeBytes(reinterpret_cast<const uint8_t *>(&nmaterials), sizeof(nmaterials), ptr);
+    for (int i = 0; i < nmaterials; i++) {
+        const Material *material = materials[i];
+        if (!reserve(sink, material->estimateSize(info), ptr))
+            return false;
+        material->write(ptr, info, m_textureIndices);
+    }
+    return true;
+}
+
+bool Writer::flush(ISink *sink)
+{
+    bool ret = true;
+    if (m_chunkOffset > 0)
+        ret = sink->write(m_chunk, m_chunkOffset);
+    m_chunkOffset = 0;
+    return ret;
+}
+
+bool Writer::reserve(ISink *sink, size_t size, uint8_t *&ptr)
+{
+    if (m_chunkOffset + size > m_chunkCapacity) {
+        if (!flush(sink))
+            return false;
+        /* 1要素がチャンクより大きい場合はその要素が収まるまで広げる */
+        const size_t capacity = btMax(m_chunkSize, size);
+        if (capacity > m_chunkCapacity) {
+            delete[] m_chunk;
+            m_chunk = new uint8_t[capacity];
+            m_chunkCapacity = capacity;
+        }
+    }
+    ptr = m_chunk + m_chunkOffset;
+    m_chunkOffset += size;
+    return true;
+}
+
+template<typename T>
+bool Writer::writeElements(ISink *sink, const Array<T *> &elements, const Model::DataInfo &info)
+{
+    const int nelements = elements.count();
+    uint8_t *ptr = 0;
+    if (!reserve(sink, sizeof(nelements), ptr))
+        return false;
+    internal::writeBytes(reinterpret_cast<const uint8_t *>(&nelements), sizeof(nelements), ptr);
+    for (int i = 0; i < nelements; i++) {
+        const T *element = elements[i];
+        if (!reserve(sink, element->estimateSize(info), ptr))
+            return false;
+        element->write(ptr, info);
+    }
+    return true;
+}
+
+} /* namespace pmx */
+} /* namespace vpvl2 */
@@ -111,6 +111,7 @@ void BoneAnimation::lerpVector3(const BoneKeyframe *keyFrame,
 BoneAnimation::BoneAnimation(IEncoding *encoding)
     : BaseAnimation(),
       m_encodingRef(encoding),
+      m_nameTable(encoding),
       m_modelRef(0),
       m_enableNullFrame(false)
 {
@@ -119,6 +120,8 @@ BoneAnimation::BoneAnimation(IEncoding *encoding)
 BoneAnimation::~BoneAnimation()
 {
     m_name2keyframes.releaseAll();
+    /* キーフレームは NameTable の名前を参照しているため先に解放する */
+    m_keyframes.releaseAll();
     m_modelRef = 0;
 }
 
@@ -129,7 +132,7 @@ void BoneAnimation::read(const uint8_t *data, int size)
     for (int i = 0; i < size; i++) {
         BoneKeyframe *frame = new BoneKeyframe(m_encodingRef);
         m_keyframes.add(frame);
-        frame->read(ptr);
+        frame->read(ptr, &m_nameTable);
         ptr += frame->estimateSize();
     }
 }
@@ -40,6 +40,7 @@
 #include "vpvl2/internal/util.h"
 
 #include "vpvl2/vmd/BoneKeyframe.h"
+#include "vpvl2/vmd/NameTable.h"
 
 namespace vpvl2
 {
@@ -112,6 +113,11 @@ void BoneKeyframe::setDefaultInterpolationParameter()
 }
 
 void BoneKeyframe::read(const uint8_t *data)
+{
+    read(data, 0);
+}
+
+void BoneKeyframe::read(const uint8_t *data, NameTable *nameTable)
 {
     BoneKeyframeChunk chunk;
     internal::copyBytes(reinterpret_cast<uint8_t *>(&chunk), data, sizeof(chunk));
@@ -123,7 +129,10 @@ void BoneKeyframe::read(const uint8_t *data)
     float *pos = chunk.position;
     float *rot = chunk.rotation;
 #endif
-    internal::setStringDirect(m_encodingRef->toString(chunk.name, IString::kShiftJIS, sizeof(chunk.name)), m_namePtr);
+    if (nameTable)
+        shareName(nameTable->intern(chunk.name, sizeof(chunk.name)));
+    else
+        adoptName(m_encodingRef->toString(chunk.name, IString::kShiftJIS, sizeof(chunk.name)));
     setTimeIndex(static_cast<float>(chunk.timeIndex));
 #ifdef VPVL2_COORDINATE_OPENGL
     setPosition(Vector3(pos[0], pos[1], -pos[2]));
@@ -147,7 +156,7 @@ void BoneKeyframe::write(uint8_t *data) const
 {
     BoneKeyframeChunk chunk;
     uint8_t *name = m_encodingRef->toByteArray(m_namePtr, IString::kShiftJIS);
-    internal::copyBytes(chunk.name, name, sizeof(chunk.name));
+    internal::copyString(chunk.name, name, sizeof(chunk.name));
     m_encodingRef->disposeByteArray(name);
     chunk.timeIndex = static_cast<int>(m_timeIndex);
     chunk.position[0] = m_position.x();
@@ -265,7 +274,7 @@ QuadWord &BoneKeyframe::getInterpolationParameterInternal(InterpolationType type
 
 void BoneKeyframe::setName(const IString *value)
 {
-    internal::setString(value, m_namePtr);
+    copyName(value);
 }
 
 void BoneKeyframe::setPosition(const Vector3 &value)
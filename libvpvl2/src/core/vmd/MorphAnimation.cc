@@ -81,6 +81,7 @@ struct InternalMorphKeyFrameList {
 MorphAnimation::MorphAnimation(IEncoding *encoding)
     : BaseAnimation(),
       m_encodingRef(encoding),
+      m_nameTable(encoding),
       m_modelRef(0),
       m_enableNullFrame(false)
 {
@@ -89,6 +90,8 @@ MorphAnimation::MorphAnimation(IEncoding *encoding)
 MorphAnimation::~MorphAnimation()
 {
     m_name2keyframes.releaseAll();
+    /* キーフレームは NameTable の名前を参照しているため先に解放する */
+    m_keyframes.releaseAll();
     m_modelRef = 0;
 }
 
@@ -99,7 +102,7 @@ void MorphAnimation::read(const uint8_t *data, int size)
     for (int i = 0; i < size; i++) {
         MorphKeyframe *frame = new MorphKeyframe(m_encodingRef);
         m_keyframes.add(frame);
-        frame->read(ptr);
+        frame->read(ptr, &m_nameTable);
         ptr += frame->estimateSize();
     }
 }
@@ -40,6 +40,7 @@
 #include "vpvl2/internal/util.h"
 
 #include "vpvl2/vmd/MorphKeyframe.h"
+#include "vpvl2/vmd/NameTable.h"
 
 namespace vpvl2
 {
@@ -74,10 +75,18 @@ MorphKeyframe::~MorphKeyframe()
 }
 
 void MorphKeyframe::read(const uint8_t *data)
+{
+    read(data, 0);
+}
+
+void MorphKeyframe::read(const uint8_t *data, NameTable *nameTable)
 {
     MorphKeyframeChunk chunk;
     internal::copyBytes(reinterpret_cast<uint8_t *>(&chunk), data, sizeof(chunk));
-    internal::setStringDirect(m_encodingRef->toString(chunk.name, IString::kShiftJIS, sizeof(chunk.name)), m_namePtr);
+    if (nameTable)
+        shareName(nameTable->intern(chunk.name, sizeof(chunk.name)));
+    else
+        adoptName(m_encodingRef->toString(chunk.name, IString::kShiftJIS, sizeof(chunk.name)));
     setTimeIndex(static_cast<float>(chunk.timeIndex));
 #ifdef VPVL2_BUILD_IOS
     float weight;
@@ -92,7 +101,7 @@ void MorphKeyframe::write(uint8_t *data) const
 {
     MorphKeyframeChunk chunk;
     uint8_t *name = m_encodingRef->toByteArray(m_namePtr, IString::kShiftJIS);
-    internal::copyBytes(chunk.name, name, sizeof(chunk.name));
+    internal::copyString(chunk.name, name, sizeof(chunk.name));
     m_encodingRef->disposeByteArray(name);
     chunk.timeIndex = static_cast<int>(m_timeIndex);
     chunk.weight = m_weight;
@@ -115,7 +124,7 @@ IMorphKeyframe *MorphKeyframe::clone() const
 
 void MorphKeyframe::setName(const IString *value)
 {
-    internal::setString(value, m_namePtr);
+    copyName(value);
 }
 
 void MorphKeyframe::setWeight(const IMorph::WeightPrecision &value)
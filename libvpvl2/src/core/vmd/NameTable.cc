@@ -0,0 +1,104 @@
+/* ----------------------------------------------------------------- */
+/*                                                                   */
+/*  Copyright (c) 2010-2012  hkrn                                    */
+/*                                                                   */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/* - Redistributions of source code must retain the above copyright  */
+/*   notice, this list of conditions and the following disclaimer.   */
+/* - Redistributions in binary form must reproduce the above         */
+/*   copyright notice, this list of conditions and the following     */
+/*   disclaimer in the documentation and/or other materials provided */
+/*   with the distribution.                                          */
+/* - Neither the name of the MMDAI project team nor the names of     */
+/*   its contributors may be used to endorse or promote products     */
+/*   derived from this software without specific prior written       */
+/*   permission.                                                     */
+/*                                                                   */
+/* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND            */
+/* CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,       */
+/* INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF          */
+/* MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE          */
+/* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS */
+/* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,          */
+/* EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED   */
+/* TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,     */
+/* DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON */
+/* ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,   */
+/* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY    */
+/* OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE           */
+/* POSSIBILITY OF SUCH DAMAGE.                                       */
+/* ----------------------------------------------------------------- */
+
+#include "vpvl2/vpvl2.h"
+#include "vpvl2/internal/util.h"
+
+#include "vpvl2/vmd/NameTable.h"
+
+namespace vpvl2
+{
+namespace vmd
+{
+
+struct NameTable::Entry {
+    Entry(const char *bytes, size_t size, IString *value)
+        : bytes(new char[size + 1]),
+          value(value)
+    {
+        memcpy(this->bytes, bytes, size);
+        this->bytes[size] = 0;
+    }
+    ~Entry() {
+        delete[] bytes;
+        bytes = 0;
+        delete value;
+        value = 0;
+    }
+    char *bytes;
+    IString *value;
+};
+
+NameTable::NameTable(IEncoding *encoding)
+    : m_encodingRef(encoding)
+{
+}
+
+NameTable::~NameTable()
+{
+    clear();
+    m_encodingRef = 0;
+}
+
+IString *NameTable::intern(const uint8_t *name, size_t maxlen)
+{
+    /* VMD の名前は NUL 終端されているとは限らないため、長さを制限した複製をキーにする */
+    char key[kMaxNameSize];
+    size_t size = 0, limit = btMin(maxlen, kMaxNameSize - 1);
+    while (size < limit && name[size] != 0)
+        size++;
+    memcpy(key, name, size);
+    key[size] = 0;
+    if (Entry *const *entry = m_name2entries.find(HashString(key)))
+        return (*entry)->value;
+    IString *value = m_encodingRef->toString(name, IString::kShiftJIS, maxlen);
+    if (!value)
+        return 0;
+    Entry *entry = new Entry(key, size, value);
+    m_entries.add(entry);
+    /* HashString は文字列を複製しないため、Entry が保持するバイト列をキーにする */
+    m_name2entries.insert(HashString(entry->bytes), entry);
+    return value;
+}
+
+void NameTable::clear()
+{
+    m_name2entries.clear();
+    m_entries.releaseAll();
+}
+
+}
+}
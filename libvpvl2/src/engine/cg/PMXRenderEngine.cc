@@ -38,6 +38,7 @@
 
 #include "vpvl2/vpvl2.h"
 #include "vpvl2/pmx/Material.h"
+#include "vpvl2/pmx/MaterialParameterBuffer.h"
 #include "vpvl2/pmx/Model.h"
 #include "vpvl2/pmx/Vertex.h"
 
@@ -69,6 +70,7 @@ PMXRenderEngine::PMXRenderEngine(IRenderDelegate *delegate,
       m_modelRef(model),
       m_contextRef(effectContext),
       m_materialContexts(0),
+      m_indexType(GL_UNSIGNED_INT),
       m_cullFaceState(true),
       m_isVertexShaderSkinning(false)
 {
@@ -92,7 +94,8 @@ bool PMXRenderEngine::upload(const IString *dir)
     void *context = 0;
     m_delegateRef->allocateContext(m_modelRef, context);
     glGenBuffers(kVertexBufferObjectMax, m_vertexBufferObjects);
-    size_t size = pmx::Model::strideSize(pmx::Model::kIndexStride);
+    size_t size = m_modelRef->indexStrideSize();
+    m_indexType = size == sizeof(uint16_t) ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_vertexBufferObjects[kModelIndices]);
     glBufferData(GL_ELEMENT_ARRAY_BUFFER, m_modelRef->indices().count() * size, m_modelRef->indicesPtr(), GL_STATIC_DRAW);
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
@@ -163,10 +166,18 @@ void PMXRenderEngine::update()
 {
     if (!m_modelRef || !m_modelRef->isVisible() || !m_currentRef)
         return;
-    size_t size = pmx::Model::strideSize(pmx::Model::kVertexStride);
-    glBindBuffer(GL_ARRAY_BUFFER, m_vertexBufferObjects[kModelVertices]);
-    glBufferSubData(GL_ARRAY_BUFFER, 0, m_modelRef->vertices().count() * size, m_modelRef->vertexPtr());
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    bool isVertexSourceTransferred = false;
+#ifdef VPVL2_ENABLE_OPENCL
+    isVertexSourceTransferred = m_accelerator && m_accelerator->isAvailable()
+            && m_accelerator->isVertexSourceTransferred();
+#endif
+    /* OpenCL 側で変形前の頂点を転送してスキニングする場合は結果が後で転送されるため、ここでの転送を省略する */
+    if (!isVertexSourceTransferred) {
+        size_t size = pmx::Model::strideSize(pmx::Model::kVertexStride);
+        glBindBuffer(GL_ARRAY_BUFFER, m_vertexBufferObjects[kModelVertices]);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, m_modelRef->vertices().count() * size, m_modelRef->vertexPtr());
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
     if (m_isVertexShaderSkinning)
         m_modelRef->updateSkinningMesh(m_mesh);
 #ifdef VPVL2_ENABLE_OPENCL
@@ -181,9 +192,11 @@ void PMXRenderEngine::renderModel()
 {
     if (!m_modelRef || !m_modelRef->isVisible() || !m_currentRef || !m_currentRef->validateStandard())
         return;
+    uploadSkinnedVertices();
     m_currentRef->setModelMatrixParameters(m_modelRef);
     const Array<pmx::Material *> &materials = m_modelRef->materials();
-    const size_t indexStride = m_modelRef->strideSize(pmx::Model::kIndexStride);
+    const pmx::MaterialParameterBuffer *parameters = m_modelRef->materialParameters();
+    const size_t indexStride = m_modelRef->indexStrideSize();
     const Scalar &modelOpacity = m_modelRef->opacity();
     const ILight *light = m_sceneRef->light();
     const GLuint *depthTexturePtr = static_cast<const GLuint *>(light->depthTexture());
@@ -211,12 +224,13 @@ void PMXRenderEngine::renderModel()
         const pmx::Material *material = materials[i];
         const MaterialContext &materialContext = m_materialContexts[i];
         const Color &toonColor = materialContext.toonTextureColor;
-        const Color &diffuse = material->diffuse();
+        const pmx::MaterialParameterBuffer::Parameter &parameter = parameters->at(i);
+        const Color &diffuse = parameter.diffuse;
         m_currentRef->ambient.setGeometryColor(diffuse);
         m_currentRef->diffuse.setGeometryColor(diffuse);
-        m_currentRef->emissive.setGeometryColor(material->ambient());
-        m_currentRef->specular.setGeometryColor(material->specular());
-        m_currentRef->specularPower.setGeometryValue(btMax(material->shininess(), 1.0f));
+        m_currentRef->emissive.setGeometryColor(parameter.ambient);
+        m_currentRef->specular.setGeometryColor(parameter.specular);
+        m_currentRef->specularPower.setGeometryValue(btMax(parameter.shininess, 1.0f));
         m_currentRef->toonColor.setGeometryColor(toonColor);
         GLuint mainTexture = materialContext.mainTextureID;
         GLuint sphereTexture = materialContext.sphereTextureID;
@@ -238,7 +252,7 @@ void PMXRenderEngine::renderModel()
         const int nindices = material->indices();
         const char *const target = hasShadowMap && material->isSelfShadowDrawn() ? "object_ss" : "object";
         CGtechnique technique = m_currentRef->findTechnique(target, i, nmaterials, hasMainTexture, hasSphereMap, true);
-        m_currentRef->executeTechniquePasses(technique, GL_TRIANGLES, nindices, GL_UNSIGNED_INT, reinterpret_cast<const GLvoid *>(offset));
+        m_currentRef->executeTechniquePasses(technique, GL_TRIANGLES, nindices, m_indexType, reinterpret_cast<const GLvoid *>(offset));
         offset += nindices * indexStride;
     }
     glDisableClientState(GL_VERTEX_ARRAY);
@@ -257,10 +271,12 @@ void PMXRenderEngine::renderEdge()
     if (!m_modelRef || !m_modelRef->isVisible() || btFuzzyZero(m_modelRef->edgeWidth())
             || !m_currentRef || m_currentRef->scriptOrder() != IEffect::kStandard)
         return;
+    uploadSkinnedVertices();
     m_currentRef->setModelMatrixParameters(m_modelRef);
     m_currentRef->setZeroGeometryParameters(m_modelRef);
     const Array<pmx::Material *> &materials = m_modelRef->materials();
-    const size_t indexStride = m_modelRef->strideSize(pmx::Model::kIndexStride);
+    const pmx::MaterialParameterBuffer *parameters = m_modelRef->materialParameters();
+    const size_t indexStride = m_modelRef->indexStrideSize();
     const int nmaterials = materials.count();
     size_t offset = 0;
     glBindBuffer(GL_ARRAY_BUFFER, m_vertexBufferObjects[kModelVertices]);
@@ -274,8 +290,8 @@ void PMXRenderEngine::renderEdge()
         const int nindices = material->indices();
         if (material->isEdgeDrawn()) {
             CGtechnique technique = m_currentRef->findTechnique("edge", i, nmaterials, false, false, true);
-            m_currentRef->edgeColor.setGeometryColor(material->edgeColor());
-            m_currentRef->executeTechniquePasses(technique, GL_TRIANGLES, nindices, GL_UNSIGNED_INT, reinterpret_cast<const GLvoid *>(offset));
+            m_currentRef->edgeColor.setGeometryColor(parameters->at(i).edgeColor);
+            m_currentRef->executeTechniquePasses(technique, GL_TRIANGLES, nindices, m_indexType, reinterpret_cast<const GLvoid *>(offset));
         }
         offset += nindices * indexStride;
     }
@@ -289,10 +305,11 @@ void PMXRenderEngine::renderShadow()
 {
     if (!m_modelRef || !m_modelRef->isVisible() || !m_currentRef || m_currentRef->scriptOrder() != IEffect::kStandard)
         return;
+    uploadSkinnedVertices();
     m_currentRef->setModelMatrixParameters(m_modelRef, IRenderDelegate::kShadowMatrix);
     m_currentRef->setZeroGeometryParameters(m_modelRef);
     const Array<pmx::Material *> &materials = m_modelRef->materials();
-    const size_t indexStride = m_modelRef->strideSize(pmx::Model::kIndexStride);
+    const size_t indexStride = m_modelRef->indexStrideSize();
     const int nmaterials = materials.count();
     size_t offset = 0;
     glBindBuffer(GL_ARRAY_BUFFER, m_vertexBufferObjects[kModelVertices]);
@@ -305,7 +322,7 @@ void PMXRenderEngine::renderShadow()
         const pmx::Material *material = materials[i];
         const int nindices = material->indices();
         CGtechnique technique = m_currentRef->findTechnique("shadow", i, nmaterials, false, false, true);
-        m_currentRef->executeTechniquePasses(technique, GL_TRIANGLES, nindices, GL_UNSIGNED_INT, reinterpret_cast<const GLvoid *>(offset));
+        m_currentRef->executeTechniquePasses(technique, GL_TRIANGLES, nindices, m_indexType, reinterpret_cast<const GLvoid *>(offset));
         offset += nindices * indexStride;
     }
     glCullFace(GL_BACK);
@@ -318,10 +335,11 @@ void PMXRenderEngine::renderZPlot()
 {
     if (!m_modelRef || !m_modelRef->isVisible() || !m_currentRef || m_currentRef->scriptOrder() != IEffect::kStandard)
         return;
+    uploadSkinnedVertices();
     m_currentRef->setModelMatrixParameters(m_modelRef);
     m_currentRef->setZeroGeometryParameters(m_modelRef);
     const Array<pmx::Material *> &materials = m_modelRef->materials();
-    const size_t indexStride = m_modelRef->strideSize(pmx::Model::kIndexStride);
+    const size_t indexStride = m_modelRef->indexStrideSize();
     const int nmaterials = materials.count();
     size_t offset = 0;
     glBindBuffer(GL_ARRAY_BUFFER, m_vertexBufferObjects[kModelVertices]);
@@ -335,7 +353,7 @@ void PMXRenderEngine::renderZPlot()
         const int nindices = material->indices();
         if (material->isShadowMapDrawn()) {
             CGtechnique technique = m_currentRef->findTechnique("zplot", i, nmaterials, false, false, true);
-            m_currentRef->executeTechniquePasses(technique, GL_TRIANGLES, nindices, GL_UNSIGNED_INT, reinterpret_cast<const GLvoid *>(offset));
+            m_currentRef->executeTechniquePasses(technique, GL_TRIANGLES, nindices, m_indexType, reinterpret_cast<const GLvoid *>(offset));
         }
         offset += nindices * indexStride;
     }
@@ -429,6 +447,22 @@ void PMXRenderEngine::setEffect(IEffect::ScriptOrderType type, IEffect *effect,
     }
 }
 
+void PMXRenderEngine::uploadSkinnedVertices()
+{
+#ifdef VPVL2_ENABLE_OPENCL
+    /* update で開始した OpenCL のスキニングの完了を待ち、結果を頂点バッファに転送する (最初の描画時のみ) */
+    if (m_accelerator && m_accelerator->isAvailable()) {
+        if (const void *vertices = m_accelerator->waitForSkinnedVertices()) {
+            size_t size = pmx::Model::strideSize(pmx::Model::kVertexStride);
+            glBindBuffer(GL_ARRAY_BUFFER, m_vertexBufferObjects[kModelVertices]);
+            glBufferSubData(GL_ARRAY_BUFFER, 0, m_modelRef->vertices().count() * size, vertices);
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+            m_accelerator->releaseSkinnedVertices();
+        }
+    }
+#endif
+}
+
 void PMXRenderEngine::log0(void *context, IRenderDelegate::LogLevel level, const char *format ...)
 {
     va_list ap;
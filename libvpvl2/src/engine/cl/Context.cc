@@ -62,7 +62,7 @@ bool Context::isAvailable() const
     return m_context && m_queue;
 }
 
-bool Context::initializeContext(cl_device_type hostDeviceType)
+bool Context::initializeContext(cl_device_type hostDeviceType, bool enableGLSharing)
 {
     if (isAvailable())
         return true;
@@ -118,12 +118,19 @@ bool Context::initializeContext(cl_device_type hostDeviceType)
     cl_context_properties props[] = {
         CL_CONTEXT_PLATFORM,
         reinterpret_cast<cl_context_properties>(firstPlatform),
-    #ifdef __APPLE__
-        CL_CONTEXT_PROPERTY_USE_CGL_SHAREGROUP_APPLE,
-        reinterpret_cast<cl_context_properties>(CGLGetShareGroup(CGLGetCurrentContext())),
-    #endif
+        0,
+        0,
         0
     };
+#ifdef __APPLE__
+    /* OpenGL と共有しない場合は OpenGL のコンテキストを必要としない */
+    if (enableGLSharing) {
+        props[2] = CL_CONTEXT_PROPERTY_USE_CGL_SHAREGROUP_APPLE;
+        props[3] = reinterpret_cast<cl_context_properties>(CGLGetShareGroup(CGLGetCurrentContext()));
+    }
+#else
+    (void) enableGLSharing;
+#endif
     clReleaseContext(m_context);
     m_context = clCreateContext(props, 1, &m_device, 0, 0, &err);
     if (err != CL_SUCCESS) {
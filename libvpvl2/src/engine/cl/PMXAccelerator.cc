@@ -37,8 +37,10 @@
 #include "vpvl2/vpvl2.h"
 
 #include "vpvl2/cl/PMXAccelerator.h"
+#include "vpvl2/cl/PMXSkinningBatch.h"
 #include "vpvl2/pmx/Bone.h"
 #include "vpvl2/pmx/Material.h"
+#include "vpvl2/pmx/MaterialParameterBuffer.h"
 #include "vpvl2/pmx/Vertex.h"
 
 namespace vpvl2
@@ -49,8 +51,10 @@ namespace cl
 static const int kMaxBonesPerVertex = 4;
 static const char kProgramCompileFlags[] = "-cl-fast-relaxed-math -DMAC -DGUID_ARG";
 
-PMXAccelerator::PMXAccelerator(Context *context)
+PMXAccelerator::PMXAccelerator(Context *context, BufferType type, PMXSkinningBatch *batch)
     : m_contextRef(context),
+      m_batchRef(batch),
+      m_modelRef(0),
       m_program(0),
       m_performSkinningKernel(0),
       m_verticesBuffer(0),
@@ -58,7 +62,11 @@ PMXAccelerator::PMXAccelerator(Context *context)
       m_boneWeightsBuffer(0),
       m_boneIndicesBuffer(0),
       m_boneMatricesBuffer(0),
+      m_mapEvent(0),
+      m_mappedVertices(0),
+      m_bufferType(type),
       m_localWGSizeForPerformSkinning(0),
+      m_verticesSize(0),
       m_boneTransform(0),
       m_isBufferAllocated(false)
 {
@@ -66,6 +74,11 @@ PMXAccelerator::PMXAccelerator(Context *context)
 
 PMXAccelerator::~PMXAccelerator()
 {
+    if (m_batchRef && m_modelRef)
+        m_batchRef->removeModel(m_modelRef);
+    releaseSkinnedVertices();
+    if (m_contextRef->isAvailable())
+        clFinish(m_contextRef->commandQueue());
     clReleaseProgram(m_program);
     m_program = 0;
     clReleaseKernel(m_performSkinningKernel);
@@ -78,20 +91,30 @@ PMXAccelerator::~PMXAccelerator()
     m_boneIndicesBuffer = 0;
     clReleaseMemObject(m_boneWeightsBuffer);
     m_boneWeightsBuffer = 0;
+    clReleaseMemObject(m_boneMatricesBuffer);
+    m_boneMatricesBuffer = 0;
     m_localWGSizeForPerformSkinning = 0;
+    m_verticesSize = 0;
     delete[] m_boneTransform;
     m_boneTransform = 0;
     m_isBufferAllocated = false;
+    m_modelRef = 0;
+    m_batchRef = 0;
     m_contextRef = 0;
 }
 
 bool PMXAccelerator::isAvailable() const
 {
+    if (m_batchRef)
+        return m_batchRef->isAvailable();
     return m_contextRef->isAvailable() && m_program;
 }
 
 bool PMXAccelerator::createKernelProgram()
 {
+    /* まとめて実行する場合はカーネルは PMXSkinningBatch 側で作成済み */
+    if (m_batchRef)
+        return m_batchRef->isAvailable();
     cl_int err;
     const IString *source = m_contextRef->renderDelegate()->loadKernelSource(IRenderDelegate::kModelSkinningKernel, 0);
     const char *sourceText = reinterpret_cast<const char *>(source->toByteArray());
@@ -127,13 +150,33 @@ bool PMXAccelerator::createKernelProgram()
 
 void PMXAccelerator::uploadModel(const pmx::Model *model, GLuint buffer, void *context)
 {
+    if (m_batchRef) {
+        if (m_modelRef)
+            m_batchRef->removeModel(m_modelRef);
+        m_batchRef->addModel(model, buffer);
+        m_modelRef = model;
+        return;
+    }
     cl_int err;
     cl_context computeContext = m_contextRef->computeContext();
+    m_isBufferAllocated = false;
+    releaseSkinnedVertices();
     clReleaseMemObject(m_verticesBuffer);
-    m_verticesBuffer = clCreateFromGLBuffer(computeContext,
-                                            CL_MEM_READ_WRITE,
-                                            buffer,
-                                            &err);
+    m_verticesSize = model->vertices().count() * pmx::Model::strideSize(pmx::Model::kVertexStride);
+    if (m_bufferType == kHostBuffer) {
+        /* OpenGL を経由せず、ホスト側から直接読み書きできるメモリに確保する (CPU デバイスではコピーが発生しない) */
+        m_verticesBuffer = clCreateBuffer(computeContext,
+                                          CL_MEM_READ_WRITE | CL_MEM_ALLOC_HOST_PTR,
+                                          m_verticesSize,
+                                          0,
+                                          &err);
+    }
+    else {
+        m_verticesBuffer = clCreateFromGLBuffer(computeContext,
+                                                CL_MEM_READ_WRITE,
+                                                buffer,
+                                                &err);
+    }
     if (err != CL_SUCCESS) {
         log0(context, IRenderDelegate::kLogWarning, "Failed creating OpenCL vertex buffer: %d", err);
         return;
@@ -144,10 +187,10 @@ void PMXAccelerator::uploadModel(const pmx::Model *model, GLuint buffer, void *c
     const int nvertices = vertices.count();
     const int nVerticesAlloc = nvertices * kMaxBonesPerVertex;
     Array<int> boneIndices;
-    Array<float> boneWeights, materialEdgeSize;
+    Array<float> boneWeights;
     boneIndices.resize(nVerticesAlloc);
     boneWeights.resize(nVerticesAlloc);
-    materialEdgeSize.resize(nvertices);
+    m_vertexEdgeSizes.resize(nvertices);
     for (int i = 0; i < nvertices; i++) {
         const pmx::Vertex *vertex = vertices[i];
         for (int j = 0; j < kMaxBonesPerVertex; j++) {
@@ -156,20 +199,9 @@ void PMXAccelerator::uploadModel(const pmx::Model *model, GLuint buffer, void *c
             boneWeights[i * kMaxBonesPerVertex + j] = vertex->weight(j);
         }
     }
-    const Array<int> &indices = model->indices();
-    const Array<pmx::Material *> &materials = model->materials();
-    const int nmaterials = materials.count();
-    size_t offset = 0;
-    for (int i = 0; i < nmaterials; i++) {
-        const pmx::Material *material = materials[i];
-        const int nindices = material->indices(), offsetTo = offset + nindices;
-        const float edgeSize = material->edgeSize();
-        for (int j = offset; j < offsetTo; j++) {
-            const int index = indices[j];
-            materialEdgeSize[index] = edgeSize;
-        }
-        offset += nindices;
-    }
+    m_materialEdgeSizes.resize(model->materials().count());
+    if (m_materialEdgeSizes.count() > 0)
+        mapMaterialEdgeSizes(model, true, &m_materialEdgeSizes[0], &m_vertexEdgeSizes[0]);
     delete[] m_boneTransform;
     m_boneTransform = new float[nBoneMatricesAllocs];
     clReleaseMemObject(m_materialEdgeSizeBuffer);
@@ -196,12 +228,6 @@ void PMXAccelerator::uploadModel(const pmx::Model *model, GLuint buffer, void *c
         log0(context, IRenderDelegate::kLogWarning, "Failed creating boneWeightsBuffer: %d", err);
         return;
     }
-    clReleaseMemObject(m_boneMatricesBuffer);
-    m_boneMatricesBuffer = clCreateBuffer(computeContext, CL_MEM_READ_ONLY, nBoneMatricesSize, 0, &err);
-    if (err != CL_SUCCESS) {
-        log0(context, IRenderDelegate::kLogWarning, "Failed creating boneMatricesBuffer: %d", err);
-        return;
-    }
     cl_device_id device = m_contextRef->hostDevice();
     err = clGetKernelWorkGroupInfo(m_performSkinningKernel,
                                    device,
@@ -214,7 +240,7 @@ void PMXAccelerator::uploadModel(const pmx::Model *model, GLuint buffer, void *c
         return;
     }
     cl_command_queue queue = m_contextRef->commandQueue();
-    err = clEnqueueWriteBuffer(queue, m_materialEdgeSizeBuffer, CL_TRUE, 0, nvertices * sizeof(float), &materialEdgeSize[0], 0, 0, 0);
+    err = clEnqueueWriteBuffer(queue, m_materialEdgeSizeBuffer, CL_TRUE, 0, nvertices * sizeof(float), &m_vertexEdgeSizes[0], 0, 0, 0);
     if (err != CL_SUCCESS) {
         log0(0, IRenderDelegate::kLogWarning, "Failed enqueue a command to write materialEdgeSizeBuffer: %d", err);
         return;
@@ -229,15 +255,21 @@ void PMXAccelerator::uploadModel(const pmx::Model *model, GLuint buffer, void *c
         log0(0, IRenderDelegate::kLogWarning, "Failed enqueue a command to write boneWeightsBuffer: %d", err);
         return;
     }
-    m_isBufferAllocated = true;
+    m_isBufferAllocated = setStaticKernelArguments(model, context);
 }
 
 void PMXAccelerator::updateModel(const pmx::Model *model, const Scene *scene)
 {
+    /* 全てのモデルの更新が終わった後に PMXSkinningBatch::update でまとめて実行される */
+    if (m_batchRef) {
+        m_batchRef->invalidate(scene);
+        return;
+    }
     if (!m_isBufferAllocated)
         return;
+    /* 前のフレームの結果が使われなかった場合はここで解放する (転送元の m_boneTransform の再利用を防ぐ) */
+    releaseSkinnedVertices();
     const Array<pmx::Bone *> &bones = model->bones();
-    const int nvertices = model->vertices().count();
     const int nbones = bones.count();
     for (int i = 0; i < nbones; i++) {
         pmx::Bone *bone = bones[i];
@@ -248,104 +280,202 @@ void PMXAccelerator::updateModel(const pmx::Model *model, const Scene *scene)
     cl_int err;
     size_t local, global;
     cl_command_queue queue = m_contextRef->commandQueue();
-    /* force flushing OpenGL commands to acquire GL objects by OpenCL */
-    glFinish();
-    clEnqueueAcquireGLObjects(queue, 1, &m_verticesBuffer, 0, 0, 0);
-    err = clEnqueueWriteBuffer(queue, m_boneMatricesBuffer, CL_TRUE, 0, nsize, m_boneTransform, 0, 0, 0);
+    if (m_bufferType == kGLSharedBuffer) {
+        /* force flushing OpenGL commands to acquire GL objects by OpenCL */
+        glFinish();
+        clEnqueueAcquireGLObjects(queue, 1, &m_verticesBuffer, 0, 0, 0);
+    }
+    else {
+        /* スキニングは頂点バッファをその場で書き換えるため、毎フレーム変形前の頂点を転送し直す */
+        err = clEnqueueWriteBuffer(queue, m_verticesBuffer, CL_FALSE, 0, m_verticesSize, model->vertexPtr(), 0, 0, 0);
+        if (err != CL_SUCCESS) {
+            log0(0, IRenderDelegate::kLogWarning, "Failed enqueue a command to write verticesBuffer: %d", err);
+            return;
+        }
+    }
+    err = clEnqueueWriteBuffer(queue, m_boneMatricesBuffer, CL_FALSE, 0, nsize, m_boneTransform, 0, 0, 0);
     if (err != CL_SUCCESS) {
         log0(0, IRenderDelegate::kLogWarning, "Failed enqueue a command to write boneMatricesBuffer: %d", err);
         return;
     }
-    int argumentIndex = 0;
-    err = clSetKernelArg(m_performSkinningKernel, argumentIndex++, sizeof(m_boneMatricesBuffer), &m_boneMatricesBuffer);
+    /* 材質モーフでエッジの太さが変わった場合のみ転送し直す (頻度が低いため転送の完了を待つ) */
+    const int nvertices = model->vertices().count();
+    if (nvertices > 0 && m_materialEdgeSizes.count() > 0
+            && mapMaterialEdgeSizes(model, false, &m_materialEdgeSizes[0], &m_vertexEdgeSizes[0])) {
+        err = clEnqueueWriteBuffer(queue, m_materialEdgeSizeBuffer, CL_TRUE, 0, nvertices * sizeof(float), &m_vertexEdgeSizes[0], 0, 0, 0);
+        if (err != CL_SUCCESS) {
+            log0(0, IRenderDelegate::kLogWarning, "Failed enqueue a command to write materialEdgeSizeBuffer: %d", err);
+            return;
+        }
+    }
+    /* 毎フレーム変化する引数のみ設定する。それ以外は uploadModel の時点で設定済み */
+    int argumentIndex = 4;
+    const Vector3 &lightDirection = scene->light()->direction();
+    err = clSetKernelArg(m_performSkinningKernel, argumentIndex++, sizeof(lightDirection), &lightDirection);
     if (err != CL_SUCCESS) {
-        log0(0, IRenderDelegate::kLogWarning, "Failed setting 1st argument of kernel (localMatrices): %d", err);
+        log0(0, IRenderDelegate::kLogWarning, "Failed setting %dth argument of kernel (lightDirection): %d", argumentIndex, err);
         return;
     }
-    err = clSetKernelArg(m_performSkinningKernel, argumentIndex++, sizeof(m_boneWeightsBuffer), &m_boneWeightsBuffer);
+    const ICamera *camera = scene->camera();
+    const Vector3 &cameraPosition = camera->position() + Vector3(0, 0, camera->distance());
+    const float edgeScaleFactor = model->edgeScaleFactor(cameraPosition) * model->edgeWidth();
+    err = clSetKernelArg(m_performSkinningKernel, argumentIndex++, sizeof(edgeScaleFactor), &edgeScaleFactor);
     if (err != CL_SUCCESS) {
-        log0(0, IRenderDelegate::kLogWarning, "Failed setting 2nd argument of kernel (boneWeights): %d", err);
+        log0(0, IRenderDelegate::kLogWarning, "Failed setting %dth argument of kernel (edgeScaleFactor): %d", argumentIndex, err);
         return;
     }
-    err = clSetKernelArg(m_performSkinningKernel, argumentIndex++, sizeof(m_boneIndicesBuffer), &m_boneIndicesBuffer);
+    local = m_localWGSizeForPerformSkinning;
+    global = local * ((nvertices + (local - 1)) / local);
+    err = clEnqueueNDRangeKernel(queue, m_performSkinningKernel, 1, 0, &global, &local, 0, 0, 0);
     if (err != CL_SUCCESS) {
-        log0(0, IRenderDelegate::kLogWarning, "Failed setting 3rd argument of kernel (boneIndices): %d", err);
+        log0(0, IRenderDelegate::kLogWarning, "Failed enqueue executing kernel: %d", err);
         return;
     }
-    err = clSetKernelArg(m_performSkinningKernel, argumentIndex++, sizeof(m_materialEdgeSizeBuffer), &m_materialEdgeSizeBuffer);
+    if (m_bufferType == kGLSharedBuffer) {
+        clEnqueueReleaseGLObjects(queue, 1, &m_verticesBuffer, 0, 0, 0);
+        clFinish(queue);
+    }
+    else {
+        /* 完了は待たずに結果の読み出しだけ予約しておき、waitForSkinnedVertices で待つ */
+        m_mappedVertices = clEnqueueMapBuffer(queue, m_verticesBuffer, CL_FALSE, CL_MAP_READ,
+                                              0, m_verticesSize, 0, 0, &m_mapEvent, &err);
+        if (err != CL_SUCCESS) {
+            log0(0, IRenderDelegate::kLogWarning, "Failed enqueue a command to map verticesBuffer: %d", err);
+            m_mappedVertices = 0;
+            return;
+        }
+        clFlush(queue);
+    }
+}
+
+bool PMXAccelerator::mapMaterialEdgeSizes(const pmx::Model *model, bool force, float *materialEdgeSizes, float *vertexEdgeSizes)
+{
+    const Array<int> &indices = model->indices();
+    const Array<pmx::Material *> &materials = model->materials();
+    const pmx::MaterialParameterBuffer *parameters = model->materialParameters();
+    const int nmaterials = materials.count();
+    const bool hasParameters = parameters && parameters->count() == nmaterials;
+    bool changed = false;
+    int offset = 0;
+    for (int i = 0; i < nmaterials; i++) {
+        const pmx::Material *material = materials[i];
+        const int nindices = material->indices(), offsetTo = offset + nindices;
+        const float edgeSize = hasParameters ? float(parameters->at(i).edgeSize) : material->edgeSize();
+        if (force || materialEdgeSizes[i] != edgeSize) {
+            materialEdgeSizes[i] = edgeSize;
+            for (int j = offset; j < offsetTo; j++)
+                vertexEdgeSizes[indices[j]] = edgeSize;
+            changed = true;
+        }
+        offset += nindices;
+    }
+    return changed;
+}
+
+const void *PMXAccelerator::waitForSkinnedVertices()
+{
+    if (m_batchRef)
+        return m_batchRef->waitForSkinnedVertices(m_modelRef);
+    if (!m_mappedVertices)
+        return 0;
+    cl_int err = clWaitForEvents(1, &m_mapEvent);
     if (err != CL_SUCCESS) {
-        log0(0, IRenderDelegate::kLogWarning, "Failed setting %dth argument of kernel (materialEdgeSize): %d", argumentIndex, err);
-        return;
+        log0(0, IRenderDelegate::kLogWarning, "Failed waiting for mapping verticesBuffer: %d", err);
+        releaseSkinnedVertices();
+        return 0;
     }
-    const Vector3 &lightDirection = scene->light()->direction();
-    err = clSetKernelArg(m_performSkinningKernel, argumentIndex++, sizeof(lightDirection), &lightDirection);
+    return m_mappedVertices;
+}
+
+void PMXAccelerator::releaseSkinnedVertices()
+{
+    if (m_mappedVertices) {
+        cl_command_queue queue = m_contextRef->commandQueue();
+        clWaitForEvents(1, &m_mapEvent);
+        clEnqueueUnmapMemObject(queue, m_verticesBuffer, m_mappedVertices, 0, 0, 0);
+        m_mappedVertices = 0;
+    }
+    if (m_mapEvent) {
+        clReleaseEvent(m_mapEvent);
+        m_mapEvent = 0;
+    }
+}
+
+bool PMXAccelerator::setStaticKernelArguments(const pmx::Model *model, void *context)
+{
+    cl_int err;
+    int argumentIndex = 0;
+    err = clSetKernelArg(m_performSkinningKernel, argumentIndex++, sizeof(m_boneMatricesBuffer), &m_boneMatricesBuffer);
     if (err != CL_SUCCESS) {
-        log0(0, IRenderDelegate::kLogWarning, "Failed setting %dth argument of kernel (lightDirection): %d", argumentIndex, err);
-        return;
+        log0(context, IRenderDelegate::kLogWarning, "Failed setting 1st argument of kernel (localMatrices): %d", err);
+        return false;
     }
-    const ICamera *camera = scene->camera();
-    const Vector3 &cameraPosition = camera->position() + Vector3(0, 0, camera->distance());
-    const Scalar &edgeScaleFactor = model->edgeScaleFactor(cameraPosition) * model->edgeWidth();
-    err = clSetKernelArg(m_performSkinningKernel, argumentIndex++, sizeof(edgeScaleFactor), &edgeScaleFactor);
+    err = clSetKernelArg(m_performSkinningKernel, argumentIndex++, sizeof(m_boneWeightsBuffer), &m_boneWeightsBuffer);
     if (err != CL_SUCCESS) {
-        log0(0, IRenderDelegate::kLogWarning, "Failed setting %dth argument of kernel (edgeScaleFactor): %d", argumentIndex, err);
-        return;
+        log0(context, IRenderDelegate::kLogWarning, "Failed setting 2nd argument of kernel (boneWeights): %d", err);
+        return false;
+    }
+    err = clSetKernelArg(m_performSkinningKernel, argumentIndex++, sizeof(m_boneIndicesBuffer), &m_boneIndicesBuffer);
+    if (err != CL_SUCCESS) {
+        log0(context, IRenderDelegate::kLogWarning, "Failed setting 3rd argument of kernel (boneIndices): %d", err);
+        return false;
+    }
+    err = clSetKernelArg(m_performSkinningKernel, argumentIndex++, sizeof(m_materialEdgeSizeBuffer), &m_materialEdgeSizeBuffer);
+    if (err != CL_SUCCESS) {
+        log0(context, IRenderDelegate::kLogWarning, "Failed setting %dth argument of kernel (materialEdgeSize): %d", argumentIndex, err);
+        return false;
     }
+    /* lightDirection と edgeScaleFactor は毎フレーム updateModel で設定する */
+    argumentIndex += 2;
+    /* カーネル側の引数は int であるため、size_t ではなく cl_int で渡す */
+    const cl_int nvertices = model->vertices().count();
     err = clSetKernelArg(m_performSkinningKernel, argumentIndex++, sizeof(nvertices), &nvertices);
     if (err != CL_SUCCESS) {
-        log0(0, IRenderDelegate::kLogWarning, "Failed setting %dth argument of kernel (nvertices): %d", argumentIndex, err);
-        return;
+        log0(context, IRenderDelegate::kLogWarning, "Failed setting %dth argument of kernel (nvertices): %d", argumentIndex, err);
+        return false;
     }
-    size_t strideSize = model->strideSize(pmx::Model::kVertexStride) >> 4;
+    const cl_int strideSize = model->strideSize(pmx::Model::kVertexStride) >> 4;
     err = clSetKernelArg(m_performSkinningKernel, argumentIndex++, sizeof(strideSize), &strideSize);
     if (err != CL_SUCCESS) {
-        log0(0, IRenderDelegate::kLogWarning, "Failed setting %th argument of kernel (strideSize): %d", argumentIndex, err);
-        return;
+        log0(context, IRenderDelegate::kLogWarning, "Failed setting %dth argument of kernel (strideSize): %d", argumentIndex, err);
+        return false;
     }
-    size_t offsetPosition = model->strideOffset(pmx::Model::kVertexStride) >> 4;
+    const cl_int offsetPosition = model->strideOffset(pmx::Model::kVertexStride) >> 4;
     err = clSetKernelArg(m_performSkinningKernel, argumentIndex++, sizeof(offsetPosition), &offsetPosition);
     if (err != CL_SUCCESS) {
-        log0(0, IRenderDelegate::kLogWarning, "Failed setting %th argument of kernel (offsetPosition): %d", argumentIndex, err);
-        return;
+        log0(context, IRenderDelegate::kLogWarning, "Failed setting %dth argument of kernel (offsetPosition): %d", argumentIndex, err);
+        return false;
     }
-    size_t offsetNormal = model->strideOffset(pmx::Model::kNormalStride) >> 4;
+    const cl_int offsetNormal = model->strideOffset(pmx::Model::kNormalStride) >> 4;
     err = clSetKernelArg(m_performSkinningKernel, argumentIndex++, sizeof(offsetNormal), &offsetNormal);
     if (err != CL_SUCCESS) {
-        log0(0, IRenderDelegate::kLogWarning, "Failed setting %th argument of kernel (offsetNormal): %d", argumentIndex, err);
-        return;
+        log0(context, IRenderDelegate::kLogWarning, "Failed setting %dth argument of kernel (offsetNormal): %d", argumentIndex, err);
+        return false;
     }
-    size_t offsetTexCoord = model->strideOffset(pmx::Model::kTexCoordStride) >> 4;
+    const cl_int offsetTexCoord = model->strideOffset(pmx::Model::kTexCoordStride) >> 4;
     err = clSetKernelArg(m_performSkinningKernel, argumentIndex++, sizeof(offsetTexCoord), &offsetTexCoord);
     if (err != CL_SUCCESS) {
-        log0(0, IRenderDelegate::kLogWarning, "Failed setting %dth argument of kernel (offsetTexCoord): %d", argumentIndex, err);
-        return;
+        log0(context, IRenderDelegate::kLogWarning, "Failed setting %dth argument of kernel (offsetTexCoord): %d", argumentIndex, err);
+        return false;
     }
-    size_t offsetEdgeVertex = model->strideOffset(pmx::Model::kEdgeVertexStride) >> 4;
+    const cl_int offsetEdgeVertex = model->strideOffset(pmx::Model::kEdgeVertexStride) >> 4;
     err = clSetKernelArg(m_performSkinningKernel, argumentIndex++, sizeof(offsetEdgeVertex), &offsetEdgeVertex);
     if (err != CL_SUCCESS) {
-        log0(0, IRenderDelegate::kLogWarning, "Failed setting %dth argument of kernel (offsetEdgeVertex): %d", argumentIndex, err);
-        return;
+        log0(context, IRenderDelegate::kLogWarning, "Failed setting %dth argument of kernel (offsetEdgeVertex): %d", argumentIndex, err);
+        return false;
     }
-    size_t offsetEdgeSize = model->strideOffset(pmx::Model::kEdgeSizeStride) >> 4;
+    const cl_int offsetEdgeSize = model->strideOffset(pmx::Model::kEdgeSizeStride) >> 4;
     err = clSetKernelArg(m_performSkinningKernel, argumentIndex++, sizeof(offsetEdgeSize), &offsetEdgeSize);
     if (err != CL_SUCCESS) {
-        log0(0, IRenderDelegate::kLogWarning, "Failed setting %dth argument of kernel (offsetEdgeVertex): %d", argumentIndex, err);
-        return;
+        log0(context, IRenderDelegate::kLogWarning, "Failed setting %dth argument of kernel (offsetEdgeSize): %d", argumentIndex, err);
+        return false;
     }
     err = clSetKernelArg(m_performSkinningKernel, argumentIndex++, sizeof(m_verticesBuffer), &m_verticesBuffer);
     if (err != CL_SUCCESS) {
-        log0(0, IRenderDelegate::kLogWarning, "Failed setting %th argument of kernel (vertices): %d", argumentIndex, err);
-        return;
-    }
-    local = m_localWGSizeForPerformSkinning;
-    global = local * ((nvertices + (local - 1)) / local);
-    err = clEnqueueNDRangeKernel(queue, m_performSkinningKernel, 1, 0, &global, &local, 0, 0, 0);
-    if (err != CL_SUCCESS) {
-        log0(0, IRenderDelegate::kLogWarning, "Failed enqueue executing kernel: %d", err);
-        return;
+        log0(context, IRenderDelegate::kLogWarning, "Failed setting %dth argument of kernel (vertices): %d", argumentIndex, err);
+        return false;
     }
-    clEnqueueReleaseGLObjects(queue, 1, &m_verticesBuffer, 0, 0, 0);
-    clFinish(queue);
+    return true;
 }
 
 void PMXAccelerator::log0(void *context, IRenderDelegate::LogLevel level, const char *format...)
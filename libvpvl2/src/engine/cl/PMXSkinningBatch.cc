@@ -0,0 +1,565 @@
+/* ----------------------------------------------------------------- */
+/*                                                                   */
+/*  Copyright (c) 2010-2012  hkrn                                    */
+/*                                                                   */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/* - Redistributions of source code must retain the above copyright  */
+/*   notice, this list of conditions and the following disclaimer.   */
+/* - Redistributions in binary form must reproduce the above         */
+/*   copyright notice, this list of conditions and the following     */
+/*   disclaimer in the documentation and/or other materials provided */
+/*   with the distribution.                                          */
+/* - Neither the name of the MMDAI project team nor the names of     */
+/*   its contributors may be used to endorse or promote products     */
+/*   derived from this software without specific prior written       */
+/*   permission.                                                     */
+/*                                                                   */
+/* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND            */
+/* CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,       */
+/* INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF          */
+/* MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE          */
+/* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS */
+/* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,          */
+/* EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED   */
+/* TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,     */
+/* DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON */
+/* ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,   */
+/* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY    */
+/* OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE           */
+/* POSSIBILITY OF SUCH DAMAGE.                                       */
+/* ----------------------------------------------------------------- */
+
+#include "vpvl2/vpvl2.h"
+
+#include "vpvl2/cl/PMXSkinningBatch.h"
+#include "vpvl2/pmx/Bone.h"
+#include "vpvl2/pmx/Material.h"
+#include "vpvl2/pmx/Vertex.h"
+
+namespace vpvl2
+{
+namespace cl
+{
+
+static const int kMaxBonesPerVertex = 4;
+static const char kProgramCompileFlags[] = "-cl-fast-relaxed-math -DMAC -DGUID_ARG";
+
+PMXSkinningBatch::PMXSkinningBatch(Context *context, PMXAccelerator::BufferType type)
+    : m_contextRef(context),
+      m_sceneRef(0),
+      m_program(0),
+      m_performSkinningKernel(0),
+      m_verticesBuffer(0),
+      m_materialEdgeSizeBuffer(0),
+      m_boneWeightsBuffer(0),
+      m_boneIndicesBuffer(0),
+      m_boneMatricesBuffer(0),
+      m_modelIndicesBuffer(0),
+      m_edgeScaleFactorsBuffer(0),
+      m_mapEvent(0),
+      m_mappedVertices(0),
+      m_bufferType(type),
+      m_localWGSizeForPerformSkinning(0),
+      m_nvertices(0),
+      m_isBufferAllocated(false),
+      m_isLayoutChanged(false),
+      m_isDirty(false),
+      m_isMapCompleted(false)
+{
+}
+
+PMXSkinningBatch::~PMXSkinningBatch()
+{
+    releaseSkinnedVertices();
+    if (m_contextRef->isAvailable())
+        clFinish(m_contextRef->commandQueue());
+    releaseBuffers();
+    const int nentries = m_entries.count();
+    for (int i = 0; i < nentries; i++)
+        clReleaseMemObject(m_entries[i].sharedBuffer);
+    m_entries.clear();
+    clReleaseProgram(m_program);
+    m_program = 0;
+    clReleaseKernel(m_performSkinningKernel);
+    m_performSkinningKernel = 0;
+    m_localWGSizeForPerformSkinning = 0;
+    m_sceneRef = 0;
+    m_contextRef = 0;
+}
+
+bool PMXSkinningBatch::isAvailable() const
+{
+    return m_contextRef->isAvailable() && m_program && m_performSkinningKernel;
+}
+
+bool PMXSkinningBatch::createKernelProgram()
+{
+    cl_int err;
+    const IString *source = m_contextRef->renderDelegate()->loadKernelSource(IRenderDelegate::kModelSkinningKernel, 0);
+    const char *sourceText = reinterpret_cast<const char *>(source->toByteArray());
+    const size_t sourceSize = source->length();
+    clReleaseProgram(m_program);
+    cl_context context = m_contextRef->computeContext();
+    m_program = clCreateProgramWithSource(context, 1, &sourceText, &sourceSize, &err);
+    delete source;
+    if (err != CL_SUCCESS) {
+        log0(0, IRenderDelegate::kLogWarning, "Failed creating an OpenCL program: %d", err);
+        return false;
+    }
+    cl_device_id device = m_contextRef->hostDevice();
+    err = clBuildProgram(m_program, 1, &device, kProgramCompileFlags, 0, 0);
+    if (err != CL_SUCCESS) {
+        size_t buildLogSize;
+        clGetProgramBuildInfo(m_program, device, CL_PROGRAM_BUILD_LOG, 0, 0, &buildLogSize);
+        cl_char *buildLog = new cl_char[buildLogSize + 1];
+        clGetProgramBuildInfo(m_program, device, CL_PROGRAM_BUILD_LOG, buildLogSize, buildLog, 0);
+        buildLog[buildLogSize] = 0;
+        log0(0, IRenderDelegate::kLogWarning, "Failed building a program: %s", buildLog);
+        delete[] buildLog;
+        return false;
+    }
+    clReleaseKernel(m_performSkinningKernel);
+    m_performSkinningKernel = clCreateKernel(m_program, "performSkinningBatch", &err);
+    if (err != CL_SUCCESS) {
+        log0(0, IRenderDelegate::kLogWarning, "Failed creating a kernel (performSkinningBatch): %d", err);
+        m_performSkinningKernel = 0;
+        return false;
+    }
+    err = clGetKernelWorkGroupInfo(m_performSkinningKernel,
+                                   device,
+                                   CL_KERNEL_WORK_GROUP_SIZE,
+                                   sizeof(m_localWGSizeForPerformSkinning),
+                                   &m_localWGSizeForPerformSkinning,
+                                   0);
+    if (err != CL_SUCCESS) {
+        log0(0, IRenderDelegate::kLogWarning, "Failed getting kernel work group information (CL_KERNEL_WORK_GROUP_SIZE): %d", err);
+        return false;
+    }
+    return true;
+}
+
+void PMXSkinningBatch::addModel(const pmx::Model *model, GLuint buffer)
+{
+    Entry entry;
+    entry.model = model;
+    entry.buffer = buffer;
+    entry.sharedBuffer = 0;
+    entry.vertexOffset = 0;
+    entry.boneOffset = 0;
+    entry.materialOffset = 0;
+    if (m_bufferType == PMXAccelerator::kGLSharedBuffer) {
+        cl_int err;
+        entry.sharedBuffer = clCreateFromGLBuffer(m_contextRef->computeContext(), CL_MEM_READ_WRITE, buffer, &err);
+        if (err != CL_SUCCESS) {
+            log0(0, IRenderDelegate::kLogWarning, "Failed creating OpenCL vertex buffer: %d", err);
+            return;
+        }
+    }
+    releaseSkinnedVertices();
+    m_entries.add(entry);
+    m_isLayoutChanged = true;
+    m_isDirty = true;
+}
+
+void PMXSkinningBatch::removeModel(const pmx::Model *model)
+{
+    const int nentries = m_entries.count();
+    for (int i = 0; i < nentries; i++) {
+        const Entry &entry = m_entries[i];
+        if (entry.model == model) {
+            /* 連結されたバッファの位置が変わるため、実行中のスキニングを待ってから取り除く */
+            releaseSkinnedVertices();
+            clFinish(m_contextRef->commandQueue());
+            clReleaseMemObject(entry.sharedBuffer);
+            for (int j = i + 1; j < nentries; j++)
+                m_entries[j - 1] = m_entries[j];
+            m_entries.resize(nentries - 1);
+            m_isLayoutChanged = true;
+            break;
+        }
+    }
+}
+
+void PMXSkinningBatch::invalidate(const Scene *scene)
+{
+    m_sceneRef = scene;
+    m_isDirty = true;
+}
+
+void PMXSkinningBatch::update()
+{
+    if (!m_isDirty || !m_sceneRef)
+        return;
+    m_isDirty = false;
+    if (m_isLayoutChanged) {
+        m_isLayoutChanged = false;
+        m_isBufferAllocated = upload();
+    }
+    if (m_isBufferAllocated && m_nvertices > 0)
+        perform();
+}
+
+const void *PMXSkinningBatch::waitForSkinnedVertices(const pmx::Model *model)
+{
+    update();
+    if (!m_mappedVertices)
+        return 0;
+    if (!m_isMapCompleted) {
+        cl_int err = clWaitForEvents(1, &m_mapEvent);
+        if (err != CL_SUCCESS) {
+            log0(0, IRenderDelegate::kLogWarning, "Failed waiting for mapping verticesBuffer: %d", err);
+            releaseSkinnedVertices();
+            return 0;
+        }
+        m_isMapCompleted = true;
+    }
+    const int nentries = m_entries.count();
+    const size_t stride = pmx::Model::strideSize(pmx::Model::kVertexStride);
+    for (int i = 0; i < nentries; i++) {
+        const Entry &entry = m_entries[i];
+        if (entry.model == model)
+            return static_cast<const uint8_t *>(m_mappedVertices) + entry.vertexOffset * stride;
+    }
+    return 0;
+}
+
+bool PMXSkinningBatch::upload()
+{
+    cl_int err;
+    cl_context computeContext = m_contextRef->computeContext();
+    cl_command_queue queue = m_contextRef->commandQueue();
+    releaseSkinnedVertices();
+    clFinish(queue);
+    releaseBuffers();
+    /* 各モデルの頂点とボーンの連結後の位置を決める */
+    const int nentries = m_entries.count();
+    int nvertices = 0, nbones = 0, nmaterials = 0;
+    for (int i = 0; i < nentries; i++) {
+        Entry &entry = m_entries[i];
+        entry.vertexOffset = nvertices;
+        entry.boneOffset = nbones;
+        entry.materialOffset = nmaterials;
+        nvertices += entry.model->vertices().count();
+        nbones += entry.model->bones().count();
+        nmaterials += entry.model->materials().count();
+        if (entry.sharedBuffer)
+            m_sharedBuffers.add(entry.sharedBuffer);
+    }
+    m_nvertices = nvertices;
+    if (nvertices == 0 || nbones == 0)
+        return false;
+    const int nVerticesAlloc = nvertices * kMaxBonesPerVertex;
+    Array<int> boneIndices, modelIndices;
+    Array<float> boneWeights;
+    boneIndices.resize(nVerticesAlloc);
+    boneWeights.resize(nVerticesAlloc);
+    m_vertexEdgeSizes.resize(nvertices);
+    m_materialEdgeSizes.resize(nmaterials);
+    modelIndices.resize(nvertices);
+    for (int i = 0; i < nentries; i++) {
+        const Entry &entry = m_entries[i];
+        const pmx::Model *model = entry.model;
+        const Array<pmx::Vertex *> &vertices = model->vertices();
+        const int nModelVertices = vertices.count();
+        for (int j = 0; j < nModelVertices; j++) {
+            const pmx::Vertex *vertex = vertices[j];
+            const int index = entry.vertexOffset + j;
+            for (int k = 0; k < kMaxBonesPerVertex; k++) {
+                const pmx::Bone *bone = vertex->bone(k);
+                /* 未使用を表す -1 はそのまま残す (カーネルがボーンの数の判定に使用するため) */
+                boneIndices[index * kMaxBonesPerVertex + k] = bone ? entry.boneOffset + bone->index() : -1;
+                boneWeights[index * kMaxBonesPerVertex + k] = vertex->weight(k);
+            }
+            m_vertexEdgeSizes[index] = 0;
+            modelIndices[index] = i;
+        }
+        if (model->materials().count() > 0) {
+            PMXAccelerator::mapMaterialEdgeSizes(model, true, &m_materialEdgeSizes[entry.materialOffset],
+                                                 &m_vertexEdgeSizes[entry.vertexOffset]);
+        }
+    }
+    m_boneTransform.resize(nbones << 4);
+    m_edgeScaleFactors.resize(nentries);
+    const size_t verticesSize = nvertices * pmx::Model::strideSize(pmx::Model::kVertexStride);
+    const cl_mem_flags flags = m_bufferType == PMXAccelerator::kHostBuffer
+            ? CL_MEM_READ_WRITE | CL_MEM_ALLOC_HOST_PTR : CL_MEM_READ_WRITE;
+    m_verticesBuffer = clCreateBuffer(computeContext, flags, verticesSize, 0, &err);
+    if (err != CL_SUCCESS) {
+        log0(0, IRenderDelegate::kLogWarning, "Failed creating verticesBuffer: %d", err);
+        return false;
+    }
+    m_materialEdgeSizeBuffer = clCreateBuffer(computeContext, CL_MEM_READ_ONLY, nvertices * sizeof(float), 0, &err);
+    if (err != CL_SUCCESS) {
+        log0(0, IRenderDelegate::kLogWarning, "Failed creating materialEdgeSizeBuffer: %d", err);
+        return false;
+    }
+    m_boneMatricesBuffer = clCreateBuffer(computeContext, CL_MEM_READ_ONLY, m_boneTransform.count() * sizeof(float), 0, &err);
+    if (err != CL_SUCCESS) {
+        log0(0, IRenderDelegate::kLogWarning, "Failed creating boneMatricesBuffer: %d", err);
+        return false;
+    }
+    m_boneIndicesBuffer = clCreateBuffer(computeContext, CL_MEM_READ_ONLY, nVerticesAlloc * sizeof(int), 0, &err);
+    if (err != CL_SUCCESS) {
+        log0(0, IRenderDelegate::kLogWarning, "Failed creating boneIndicesBuffer: %d", err);
+        return false;
+    }
+    m_boneWeightsBuffer = clCreateBuffer(computeContext, CL_MEM_READ_ONLY, nVerticesAlloc * sizeof(float), 0, &err);
+    if (err != CL_SUCCESS) {
+        log0(0, IRenderDelegate::kLogWarning, "Failed creating boneWeightsBuffer: %d", err);
+        return false;
+    }
+    m_modelIndicesBuffer = clCreateBuffer(computeContext, CL_MEM_READ_ONLY, nvertices * sizeof(int), 0, &err);
+    if (err != CL_SUCCESS) {
+        log0(0, IRenderDelegate::kLogWarning, "Failed creating modelIndicesBuffer: %d", err);
+        return false;
+    }
+    m_edgeScaleFactorsBuffer = clCreateBuffer(computeContext, CL_MEM_READ_ONLY, nentries * sizeof(float), 0, &err);
+    if (err != CL_SUCCESS) {
+        log0(0, IRenderDelegate::kLogWarning, "Failed creating edgeScaleFactorsBuffer: %d", err);
+        return false;
+    }
+    err = clEnqueueWriteBuffer(queue, m_materialEdgeSizeBuffer, CL_TRUE, 0, nvertices * sizeof(float), &m_vertexEdgeSizes[0], 0, 0, 0);
+    if (err != CL_SUCCESS) {
+        log0(0, IRenderDelegate::kLogWarning, "Failed enqueue a command to write materialEdgeSizeBuffer: %d", err);
+        return false;
+    }
+    err = clEnqueueWriteBuffer(queue, m_boneIndicesBuffer, CL_TRUE, 0, nVerticesAlloc * sizeof(int), &boneIndices[0], 0, 0, 0);
+    if (err != CL_SUCCESS) {
+        log0(0, IRenderDelegate::kLogWarning, "Failed enqueue a command to write boneIndicesBuffer: %d", err);
+        return false;
+    }
+    err = clEnqueueWriteBuffer(queue, m_boneWeightsBuffer, CL_TRUE, 0, nVerticesAlloc * sizeof(float), &boneWeights[0], 0, 0, 0);
+    if (err != CL_SUCCESS) {
+        log0(0, IRenderDelegate::kLogWarning, "Failed enqueue a command to write boneWeightsBuffer: %d", err);
+        return false;
+    }
+    err = clEnqueueWriteBuffer(queue, m_modelIndicesBuffer, CL_TRUE, 0, nvertices * sizeof(int), &modelIndices[0], 0, 0, 0);
+    if (err != CL_SUCCESS) {
+        log0(0, IRenderDelegate::kLogWarning, "Failed enqueue a command to write modelIndicesBuffer: %d", err);
+        return false;
+    }
+    return setStaticKernelArguments();
+}
+
+bool PMXSkinningBatch::setStaticKernelArguments()
+{
+    cl_int err;
+    int argumentIndex = 0;
+    err = clSetKernelArg(m_performSkinningKernel, argumentIndex++, sizeof(m_boneMatricesBuffer), &m_boneMatricesBuffer);
+    if (err != CL_SUCCESS) {
+        log0(0, IRenderDelegate::kLogWarning, "Failed setting %dth argument of kernel (localMatrices): %d", argumentIndex, err);
+        return false;
+    }
+    err = clSetKernelArg(m_performSkinningKernel, argumentIndex++, sizeof(m_boneWeightsBuffer), &m_boneWeightsBuffer);
+    if (err != CL_SUCCESS) {
+        log0(0, IRenderDelegate::kLogWarning, "Failed setting %dth argument of kernel (boneWeights): %d", argumentIndex, err);
+        return false;
+    }
+    err = clSetKernelArg(m_performSkinningKernel, argumentIndex++, sizeof(m_boneIndicesBuffer), &m_boneIndicesBuffer);
+    if (err != CL_SUCCESS) {
+        log0(0, IRenderDelegate::kLogWarning, "Failed setting %dth argument of kernel (boneIndices): %d", argumentIndex, err);
+        return false;
+    }
+    err = clSetKernelArg(m_performSkinningKernel, argumentIndex++, sizeof(m_materialEdgeSizeBuffer), &m_materialEdgeSizeBuffer);
+    if (err != CL_SUCCESS) {
+        log0(0, IRenderDelegate::kLogWarning, "Failed setting %dth argument of kernel (materialEdgeSize): %d", argumentIndex, err);
+        return false;
+    }
+    err = clSetKernelArg(m_performSkinningKernel, argumentIndex++, sizeof(m_modelIndicesBuffer), &m_modelIndicesBuffer);
+    if (err != CL_SUCCESS) {
+        log0(0, IRenderDelegate::kLogWarning, "Failed setting %dth argument of kernel (modelIndices): %d", argumentIndex, err);
+        return false;
+    }
+    err = clSetKernelArg(m_performSkinningKernel, argumentIndex++, sizeof(m_edgeScaleFactorsBuffer), &m_edgeScaleFactorsBuffer);
+    if (err != CL_SUCCESS) {
+        log0(0, IRenderDelegate::kLogWarning, "Failed setting %dth argument of kernel (edgeScaleFactors): %d", argumentIndex, err);
+        return false;
+    }
+    /* lightDirection は毎フレーム perform で設定する */
+    argumentIndex++;
+    const cl_int nvertices = m_nvertices;
+    err = clSetKernelArg(m_performSkinningKernel, argumentIndex++, sizeof(nvertices), &nvertices);
+    if (err != CL_SUCCESS) {
+        log0(0, IRenderDelegate::kLogWarning, "Failed setting %dth argument of kernel (nvertices): %d", argumentIndex, err);
+        return false;
+    }
+    const cl_int values[] = {
+        static_cast<cl_int>(pmx::Model::strideSize(pmx::Model::kVertexStride) >> 4),
+        static_cast<cl_int>(pmx::Model::strideOffset(pmx::Model::kVertexStride) >> 4),
+        static_cast<cl_int>(pmx::Model::strideOffset(pmx::Model::kNormalStride) >> 4),
+        static_cast<cl_int>(pmx::Model::strideOffset(pmx::Model::kTexCoordStride) >> 4),
+        static_cast<cl_int>(pmx::Model::strideOffset(pmx::Model::kEdgeVertexStride) >> 4),
+        static_cast<cl_int>(pmx::Model::strideOffset(pmx::Model::kEdgeSizeStride) >> 4)
+    };
+    static const char *kValueNames[] = {
+        "strideSize",
+        "offsetPosition",
+        "offsetNormal",
+        "offsetTexCoord",
+        "offsetEdgeVertex",
+        "offsetEdgeSize"
+    };
+    const int nvalues = sizeof(values) / sizeof(values[0]);
+    for (int i = 0; i < nvalues; i++) {
+        err = clSetKernelArg(m_performSkinningKernel, argumentIndex++, sizeof(values[i]), &values[i]);
+        if (err != CL_SUCCESS) {
+            log0(0, IRenderDelegate::kLogWarning, "Failed setting %dth argument of kernel (%s): %d", argumentIndex, kValueNames[i], err);
+            return false;
+        }
+    }
+    err = clSetKernelArg(m_performSkinningKernel, argumentIndex++, sizeof(m_verticesBuffer), &m_verticesBuffer);
+    if (err != CL_SUCCESS) {
+        log0(0, IRenderDelegate::kLogWarning, "Failed setting %dth argument of kernel (vertices): %d", argumentIndex, err);
+        return false;
+    }
+    return true;
+}
+
+void PMXSkinningBatch::perform()
+{
+    /* 前回の結果が使われなかった場合はここで解放する (転送元の配列の再利用を防ぐ) */
+    releaseSkinnedVertices();
+    cl_int err;
+    cl_command_queue queue = m_contextRef->commandQueue();
+    const ICamera *camera = m_sceneRef->camera();
+    const Vector3 &cameraPosition = camera->position() + Vector3(0, 0, camera->distance());
+    const size_t stride = pmx::Model::strideSize(pmx::Model::kVertexStride);
+    const int nentries = m_entries.count();
+    bool isEdgeSizeChanged = false;
+    for (int i = 0; i < nentries; i++) {
+        const Entry &entry = m_entries[i];
+        const pmx::Model *model = entry.model;
+        if (model->materials().count() > 0) {
+            isEdgeSizeChanged |= PMXAccelerator::mapMaterialEdgeSizes(model, false, &m_materialEdgeSizes[entry.materialOffset],
+                                                                      &m_vertexEdgeSizes[entry.vertexOffset]);
+        }
+        const Array<pmx::Bone *> &bones = model->bones();
+        const int nbones = bones.count();
+        for (int j = 0; j < nbones; j++) {
+            const pmx::Bone *bone = bones[j];
+            bone->localTransform().getOpenGLMatrix(&m_boneTransform[(entry.boneOffset + j) << 4]);
+        }
+        m_edgeScaleFactors[i] = model->edgeScaleFactor(cameraPosition) * model->edgeWidth();
+        /* スキニングは頂点をその場で書き換えるため、毎回変形前の頂点を転送し直す */
+        err = clEnqueueWriteBuffer(queue, m_verticesBuffer, CL_FALSE, entry.vertexOffset * stride,
+                                   model->vertices().count() * stride, model->vertexPtr(), 0, 0, 0);
+        if (err != CL_SUCCESS) {
+            log0(0, IRenderDelegate::kLogWarning, "Failed enqueue a command to write verticesBuffer: %d", err);
+            return;
+        }
+    }
+    err = clEnqueueWriteBuffer(queue, m_boneMatricesBuffer, CL_FALSE, 0,
+                               m_boneTransform.count() * sizeof(float), &m_boneTransform[0], 0, 0, 0);
+    if (err != CL_SUCCESS) {
+        log0(0, IRenderDelegate::kLogWarning, "Failed enqueue a command to write boneMatricesBuffer: %d", err);
+        return;
+    }
+    err = clEnqueueWriteBuffer(queue, m_edgeScaleFactorsBuffer, CL_FALSE, 0,
+                               nentries * sizeof(float), &m_edgeScaleFactors[0], 0, 0, 0);
+    if (err != CL_SUCCESS) {
+        log0(0, IRenderDelegate::kLogWarning, "Failed enqueue a command to write edgeScaleFactorsBuffer: %d", err);
+        return;
+    }
+    /* 材質モーフでエッジの太さが変わった場合のみ転送し直す (頻度が低いため転送の完了を待つ) */
+    if (isEdgeSizeChanged) {
+        err = clEnqueueWriteBuffer(queue, m_materialEdgeSizeBuffer, CL_TRUE, 0,
+                                   m_nvertices * sizeof(float), &m_vertexEdgeSizes[0], 0, 0, 0);
+        if (err != CL_SUCCESS) {
+            log0(0, IRenderDelegate::kLogWarning, "Failed enqueue a command to write materialEdgeSizeBuffer: %d", err);
+            return;
+        }
+    }
+    const Vector3 &lightDirection = m_sceneRef->light()->direction();
+    err = clSetKernelArg(m_performSkinningKernel, 6, sizeof(lightDirection), &lightDirection);
+    if (err != CL_SUCCESS) {
+        log0(0, IRenderDelegate::kLogWarning, "Failed setting 7th argument of kernel (lightDirection): %d", err);
+        return;
+    }
+    size_t local = m_localWGSizeForPerformSkinning, global = local * ((m_nvertices + (local - 1)) / local);
+    err = clEnqueueNDRangeKernel(queue, m_performSkinningKernel, 1, 0, &global, &local, 0, 0, 0);
+    if (err != CL_SUCCESS) {
+        log0(0, IRenderDelegate::kLogWarning, "Failed enqueue executing kernel: %d", err);
+        return;
+    }
+    if (m_bufferType == PMXAccelerator::kGLSharedBuffer) {
+        /* 結果を各モデルの OpenGL の頂点バッファに複写する。共有オブジェクトの獲得と解放はまとめて一度だけ行う */
+        const int nSharedBuffers = m_sharedBuffers.count();
+        glFinish();
+        clEnqueueAcquireGLObjects(queue, nSharedBuffers, &m_sharedBuffers[0], 0, 0, 0);
+        for (int i = 0; i < nentries; i++) {
+            const Entry &entry = m_entries[i];
+            if (!entry.sharedBuffer)
+                continue;
+            err = clEnqueueCopyBuffer(queue, m_verticesBuffer, entry.sharedBuffer, entry.vertexOffset * stride,
+                                      0, entry.model->vertices().count() * stride, 0, 0, 0);
+            if (err != CL_SUCCESS)
+                log0(0, IRenderDelegate::kLogWarning, "Failed enqueue a command to copy verticesBuffer: %d", err);
+        }
+        clEnqueueReleaseGLObjects(queue, nSharedBuffers, &m_sharedBuffers[0], 0, 0, 0);
+        clFinish(queue);
+    }
+    else {
+        /* 完了は待たずに結果の読み出しだけ予約しておき、waitForSkinnedVertices で待つ */
+        m_mappedVertices = clEnqueueMapBuffer(queue, m_verticesBuffer, CL_FALSE, CL_MAP_READ,
+                                              0, m_nvertices * stride, 0, 0, &m_mapEvent, &err);
+        if (err != CL_SUCCESS) {
+            log0(0, IRenderDelegate::kLogWarning, "Failed enqueue a command to map verticesBuffer: %d", err);
+            m_mappedVertices = 0;
+            return;
+        }
+        m_isMapCompleted = false;
+        clFlush(queue);
+    }
+}
+
+void PMXSkinningBatch::releaseSkinnedVertices()
+{
+    if (m_mappedVertices) {
+        cl_command_queue queue = m_contextRef->commandQueue();
+        clWaitForEvents(1, &m_mapEvent);
+        clEnqueueUnmapMemObject(queue, m_verticesBuffer, m_mappedVertices, 0, 0, 0);
+        m_mappedVertices = 0;
+    }
+    if (m_mapEvent) {
+        clReleaseEvent(m_mapEvent);
+        m_mapEvent = 0;
+    }
+    m_isMapCompleted = false;
+}
+
+void PMXSkinningBatch::releaseBuffers()
+{
+    clReleaseMemObject(m_verticesBuffer);
+    m_verticesBuffer = 0;
+    clReleaseMemObject(m_materialEdgeSizeBuffer);
+    m_materialEdgeSizeBuffer = 0;
+    clReleaseMemObject(m_boneWeightsBuffer);
+    m_boneWeightsBuffer = 0;
+    clReleaseMemObject(m_boneIndicesBuffer);
+    m_boneIndicesBuffer = 0;
+    clReleaseMemObject(m_boneMatricesBuffer);
+    m_boneMatricesBuffer = 0;
+    clReleaseMemObject(m_modelIndicesBuffer);
+    m_modelIndicesBuffer = 0;
+    clReleaseMemObject(m_edgeScaleFactorsBuffer);
+    m_edgeScaleFactorsBuffer = 0;
+    m_sharedBuffers.clear();
+    m_nvertices = 0;
+    m_isBufferAllocated = false;
+}
+
+void PMXSkinningBatch::log0(void *context, IRenderDelegate::LogLevel level, const char *format...)
+{
+    va_list ap;
+    va_start(ap, format);
+    m_contextRef->renderDelegate()->log(context, level, format, ap);
+    va_end(ap);
+}
+
+} /* namespace cl */
+} /* namespace vpvl2 */
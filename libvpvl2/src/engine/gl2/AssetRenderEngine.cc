@@ -623,24 +623,19 @@ void AssetRenderEngine::renderRecurse(const aiScene *scene, const aiNode *node)
     const GLvoid *normalPtr = reinterpret_cast<const GLvoid *>(reinterpret_cast<const uint8_t *>(&v.normal) - reinterpret_cast<const uint8_t *>(&v.position));
     const GLvoid *texcoordPtr = reinterpret_cast<const GLvoid *>(reinterpret_cast<const uint8_t *>(&v.texcoord) - reinterpret_cast<const uint8_t *>(&v.position));
     const unsigned int nmeshes = node->mNumMeshes;
-    float matrix4x4[16];
+    static const int kMatrixFlags[] = {
+        IRenderDelegate::kViewMatrix | IRenderDelegate::kProjectionMatrix | IRenderDelegate::kCameraMatrix,
+        IRenderDelegate::kWorldMatrix | IRenderDelegate::kViewMatrix | IRenderDelegate::kProjectionMatrix | IRenderDelegate::kLightMatrix,
+        IRenderDelegate::kWorldMatrix | IRenderDelegate::kCameraMatrix
+    };
+    static const int kNumMatrices = sizeof(kMatrixFlags) / sizeof(kMatrixFlags[0]);
+    float matrices[kNumMatrices * 16];
     Program *program = m_context->assetPrograms[node];
     program->bind();
-    m_delegateRef->getMatrix(matrix4x4, m_modelRef,
-                          IRenderDelegate::kViewMatrix
-                          | IRenderDelegate::kProjectionMatrix
-                          | IRenderDelegate::kCameraMatrix);
-    program->setViewProjectionMatrix(matrix4x4);
-    m_delegateRef->getMatrix(matrix4x4, m_modelRef,
-                          IRenderDelegate::kWorldMatrix
-                          | IRenderDelegate::kViewMatrix
-                          | IRenderDelegate::kProjectionMatrix
-                          | IRenderDelegate::kLightMatrix);
-    program->setLightViewProjectionMatrix(matrix4x4);
-    m_delegateRef->getMatrix(matrix4x4, m_modelRef,
-                          IRenderDelegate::kWorldMatrix
-                          | IRenderDelegate::kCameraMatrix);
-    program->setModelMatrix(matrix4x4);
+    m_delegateRef->getMatrices(matrices, m_modelRef, kMatrixFlags, kNumMatrices);
+    program->setViewProjectionMatrix(&matrices[0]);
+    program->setLightViewProjectionMatrix(&matrices[16]);
+    program->setModelMatrix(&matrices[32]);
     const ILight *light = m_sceneRef->light();
     program->setLightColor(light->color());
     program->setLightDirection(light->direction());
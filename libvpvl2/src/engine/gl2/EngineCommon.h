@@ -38,6 +38,7 @@
 
 #include <vpvl2/vpvl2.h>
 #include <vpvl2/IRenderDelegate.h>
+#include <vpvl2/gl2/StateCache.h>
 
 #ifdef VPVL2_LINK_QT
 #include <QtOpenGL/QtOpenGL>
@@ -155,11 +156,14 @@ public:
             return false;
         }
         log0(context, IRenderDelegate::kLogInfo, "Created a shader program (ID=%d)", m_program);
+        m_stateCache.invalidateUniforms();
         getLocations();
         return true;
     }
     virtual void bind() {
         glUseProgram(m_program);
+        /* テクスチャとカリングの状態は他の描画処理で変更されうるので描画パス毎に破棄する */
+        m_stateCache.invalidateState();
     }
     virtual void unbind() {
         glUseProgram(0);
@@ -167,15 +171,32 @@ public:
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
     }
     void setModelViewProjectionMatrix(const float value[16]) {
-        glUniformMatrix4fv(m_modelViewProjectionUniformLocation, 1, GL_FALSE, value);
+        uniformMatrix4fv(m_modelViewProjectionUniformLocation, value);
     }
     void setPosition(const GLvoid *ptr, GLsizei stride) {
         glVertexAttribPointer(m_positionAttributeLocation, 4, GL_FLOAT, GL_FALSE, stride, ptr);
     }
+    void setPosition(const GLvoid *ptr, GLsizei stride, GLint size) {
+        glVertexAttribPointer(m_positionAttributeLocation, size, GL_FLOAT, GL_FALSE, stride, ptr);
+    }
     void enableAttribute(GLuint value) {
         if (value != kAddressNotFound)
             glEnableVertexAttribArray(value);
     }
+    void setCullFaceEnable(bool value) {
+        if (m_stateCache.updateCullFaceEnable(value)) {
+            if (value)
+                glEnable(GL_CULL_FACE);
+            else
+                glDisable(GL_CULL_FACE);
+        }
+    }
+    void setCullFace(GLenum value) {
+        if (m_stateCache.updateCullFace(value))
+            glCullFace(value);
+    }
+    const StateCache &stateCache() const { return m_stateCache; }
+    void resetStateCounters() { m_stateCache.resetCounters(); }
 
 protected:
     virtual void getLocations() {
@@ -183,6 +204,40 @@ protected:
         m_positionAttributeLocation = glGetAttribLocation(m_program, "inPosition");
         enableAttribute(m_positionAttributeLocation);
     }
+    void uniform1i(GLuint location, GLint value) {
+        if (m_stateCache.updateUniform(location, value))
+            glUniform1i(location, value);
+    }
+    void uniform1f(GLuint location, GLfloat value) {
+        if (m_stateCache.updateUniform(location, &value, 1))
+            glUniform1f(location, value);
+    }
+    void uniform2fv(GLuint location, const GLfloat *value) {
+        if (m_stateCache.updateUniform(location, value, 2))
+            glUniform2fv(location, 1, value);
+    }
+    void uniform3fv(GLuint location, const GLfloat *value) {
+        if (m_stateCache.updateUniform(location, value, 3))
+            glUniform3fv(location, 1, value);
+    }
+    void uniform4fv(GLuint location, const GLfloat *value) {
+        if (m_stateCache.updateUniform(location, value, 4))
+            glUniform4fv(location, 1, value);
+    }
+    void uniformMatrix3fv(GLuint location, const GLfloat *value) {
+        if (m_stateCache.updateUniform(location, value, 9))
+            glUniformMatrix3fv(location, 1, GL_FALSE, value);
+    }
+    void uniformMatrix4fv(GLuint location, const GLfloat *value) {
+        if (m_stateCache.updateUniform(location, value, 16))
+            glUniformMatrix4fv(location, 1, GL_FALSE, value);
+    }
+    void bindTexture(GLint unit, GLuint value) {
+        if (m_stateCache.updateTexture(unit, value)) {
+            glActiveTexture(GL_TEXTURE0 + unit);
+            glBindTexture(GL_TEXTURE_2D, value);
+        }
+    }
     void log0(void *context, IRenderDelegate::LogLevel level, const char *format...) {
         va_list ap;
         va_start(ap, format);
@@ -197,6 +252,7 @@ private:
     GLuint m_modelViewProjectionUniformLocation;
     GLuint m_positionAttributeLocation;
     char *m_message;
+    StateCache m_stateCache;
 };
 
 class ObjectProgram : public BaseShaderProgram
@@ -236,58 +292,59 @@ public:
     }
 
     void setLightColor(const Vector3 &value) {
-        glUniform3fv(m_lightColorUniformLocation, 1, value);
+        uniform3fv(m_lightColorUniformLocation, value);
     }
     void setLightDirection(const Vector3 &value) {
-        glUniform3fv(m_lightDirectionUniformLocation, 1, value);
+        uniform3fv(m_lightDirectionUniformLocation, value);
     }
     void setLightViewProjectionMatrix(const GLfloat value[16]) {
-        glUniformMatrix4fv(m_lightViewProjectionMatrixUniformLocation, 1, GL_FALSE, value);
+        uniformMatrix4fv(m_lightViewProjectionMatrixUniformLocation, value);
     }
     void setNormal(const GLvoid *ptr, GLsizei stride) {
         glVertexAttribPointer(m_normalAttributeLocation, 4, GL_FLOAT, GL_FALSE, stride, ptr);
     }
+    void setNormal(const GLvoid *ptr, GLsizei stride, GLenum type, GLboolean normalized) {
+        glVertexAttribPointer(m_normalAttributeLocation, 4, type, normalized, stride, ptr);
+    }
     void setNormalMatrix(const float value[16]) {
         float m[] = {
             value[0], value[1], value[2],
             value[4], value[5], value[6],
             value[8], value[9], value[10]
         };
-        glUniformMatrix3fv(m_normalMatrixUniformLocation, 1, GL_FALSE, m);
+        uniformMatrix3fv(m_normalMatrixUniformLocation, m);
     }
     void setTexCoord(const GLvoid *ptr, GLsizei stride) {
         glVertexAttribPointer(m_texCoordAttributeLocation, 2, GL_FLOAT, GL_FALSE, stride, ptr);
     }
     void setMainTexture(GLuint value) {
         if (value) {
-            glActiveTexture(GL_TEXTURE0);
-            glBindTexture(GL_TEXTURE_2D, value);
-            glUniform1i(m_mainTextureUniformLocation, 0);
-            glUniform1i(m_hasMainTextureUniformLocation, 1);
+            bindTexture(0, value);
+            uniform1i(m_mainTextureUniformLocation, 0);
+            uniform1i(m_hasMainTextureUniformLocation, 1);
         }
         else {
-            glUniform1i(m_hasMainTextureUniformLocation, 0);
+            uniform1i(m_hasMainTextureUniformLocation, 0);
         }
     }
     void setDepthTexture(GLuint value) {
         if (value) {
-            glActiveTexture(GL_TEXTURE3);
-            glBindTexture(GL_TEXTURE_2D, value);
-            glUniform1i(m_depthTextureUniformLocation, 3);
-            glUniform1i(m_hasDepthTextureUniformLocation, 1);
+            bindTexture(3, value);
+            uniform1i(m_depthTextureUniformLocation, 3);
+            uniform1i(m_hasDepthTextureUniformLocation, 1);
         }
         else {
-            glUniform1i(m_hasDepthTextureUniformLocation, 0);
+            uniform1i(m_hasDepthTextureUniformLocation, 0);
         }
     }
     void setDepthTextureSize(const Vector3 &value) {
-        glUniform2fv(m_depthTextureSizeUniformLocation, 1, value);
+        uniform2fv(m_depthTextureSizeUniformLocation, value);
     }
     void setSoftShadowEnable(bool value) {
-        glUniform1f(m_enableSoftShadowUniformLocation, value ? 1 : 0);
+        uniform1f(m_enableSoftShadowUniformLocation, value ? 1 : 0);
     }
     void setOpacity(const Scalar &value) {
-        glUniform1f(m_opacityUniformLocation, value);
+        uniform1f(m_opacityUniformLocation, value);
     }
 
 protected:
@@ -339,7 +396,7 @@ public:
     }
 
     void setTransformMatrix(const float value[16]) {
-        glUniformMatrix4fv(m_transformUniformLocation, 1, GL_FALSE, value);
+        uniformMatrix4fv(m_transformUniformLocation, value);
     }
 
 protected:
@@ -631,24 +631,17 @@ void PMDRenderEngine::renderModel()
                             model->strideSize(PMDModel::kNormalsStride));
     modelProgram->setTexCoord(reinterpret_cast<const GLvoid *>(model->strideOffset(PMDModel::kTextureCoordsStride)),
                               model->strideSize(PMDModel::kTextureCoordsStride));
-    float matrix4x4[16];
-    m_delegateRef->getMatrix(matrix4x4, m_modelRef,
-                          IRenderDelegate::kWorldMatrix
-                          | IRenderDelegate::kViewMatrix
-                          | IRenderDelegate::kProjectionMatrix
-                          | IRenderDelegate::kCameraMatrix);
-    modelProgram->setModelViewProjectionMatrix(matrix4x4);
-    m_delegateRef->getMatrix(matrix4x4, m_modelRef,
-                          IRenderDelegate::kWorldMatrix
-                          | IRenderDelegate::kViewMatrix
-                          | IRenderDelegate::kCameraMatrix);
-    modelProgram->setNormalMatrix(matrix4x4);
-    m_delegateRef->getMatrix(matrix4x4, m_modelRef,
-                          IRenderDelegate::kWorldMatrix
-                          | IRenderDelegate::kViewMatrix
-                          | IRenderDelegate::kProjectionMatrix
-                          | IRenderDelegate::kLightMatrix);
-    modelProgram->setLightViewProjectionMatrix(matrix4x4);
+    static const int kMatrixFlags[] = {
+        IRenderDelegate::kWorldMatrix | IRenderDelegate::kViewMatrix | IRenderDelegate::kProjectionMatrix | IRenderDelegate::kCameraMatrix,
+        IRenderDelegate::kWorldMatrix | IRenderDelegate::kViewMatrix | IRenderDelegate::kCameraMatrix,
+        IRenderDelegate::kWorldMatrix | IRenderDelegate::kViewMatrix | IRenderDelegate::kProjectionMatrix | IRenderDelegate::kLightMatrix
+    };
+    static const int kNumMatrices = sizeof(kMatrixFlags) / sizeof(kMatrixFlags[0]);
+    float matrices[kNumMatrices * 16];
+    m_delegateRef->getMatrices(matrices, m_modelRef, kMatrixFlags, kNumMatrices);
+    modelProgram->setModelViewProjectionMatrix(&matrices[0]);
+    modelProgram->setNormalMatrix(&matrices[16]);
+    modelProgram->setLightViewProjectionMatrix(&matrices[32]);
     const ILight *light = m_sceneRef->light();
     void *texture = light->depthTexture();
     GLuint textureID = texture ? *static_cast<GLuint *>(texture) : 0;
@@ -38,7 +38,9 @@
 
 #include "vpvl2/vpvl2.h"
 #include "vpvl2/gl2/PMXRenderEngine.h"
+#include "vpvl2/pmx/DrawList.h"
 #include "vpvl2/pmx/Material.h"
+#include "vpvl2/pmx/MaterialParameterBuffer.h"
 #include "vpvl2/pmx/Model.h"
 #include "vpvl2/pmx/Vertex.h"
 #ifdef VPVL2_ENABLE_OPENCL
@@ -56,15 +58,23 @@ using namespace vpvl2::gl2;
 enum VertexBufferObjectType
 {
     kModelVertices,
-    kModelIndices,
+    kModelUVA1Vertices,
     kVertexBufferObjectMax
 };
 
+enum SharedBufferObjectType
+{
+    kModelIndices,
+    kModelStaticVertices,
+    kSharedBufferObjectMax
+};
+
 struct MaterialTextures
 {
     GLuint mainTextureID;
     GLuint sphereTextureID;
     GLuint toonTextureID;
+    bool isMainTextureOpaque;
 };
 
 class ExtendedZPlotProgram : public ZPlotProgram
@@ -83,11 +93,11 @@ public:
         m_boneMatricesUniformLocation = 0;
     }
 
-    void setBoneIndices(const GLvoid *ptr, GLsizei stride) {
-        glVertexAttribPointer(m_boneIndicesAttributeLocation, 4, GL_FLOAT, GL_FALSE, stride, ptr);
+    void setBoneIndices(const GLvoid *ptr, GLsizei stride, GLenum type) {
+        glVertexAttribPointer(m_boneIndicesAttributeLocation, 4, type, GL_FALSE, stride, ptr);
     }
-    void setBoneWeights(const GLvoid *ptr, GLsizei stride) {
-        glVertexAttribPointer(m_boneWeightsAttributeLocation, 4, GL_FLOAT, GL_FALSE, stride, ptr);
+    void setBoneWeights(const GLvoid *ptr, GLsizei stride, GLenum type, GLboolean normalized) {
+        glVertexAttribPointer(m_boneWeightsAttributeLocation, 4, type, normalized, stride, ptr);
     }
     void setBoneMatrices(const Scalar *value, size_t size) {
         glUniformMatrix4fv(m_boneMatricesUniformLocation, size, GL_FALSE, value);
@@ -136,25 +146,25 @@ public:
     }
 
     void setColor(const Color &value) {
-        glUniform4fv(m_colorUniformLocation, 1, value);
+        uniform4fv(m_colorUniformLocation, value);
     }
     void setSize(const Scalar &value) {
-        glUniform1f(m_edgeSizeUniformLocation, value);
+        uniform1f(m_edgeSizeUniformLocation, value);
     }
     void setOpacity(const Scalar &value) {
-        glUniform1f(m_opacityUniformLocation, value);
+        uniform1f(m_opacityUniformLocation, value);
     }
-    void setNormal(const GLvoid *ptr, GLsizei stride) {
-        glVertexAttribPointer(m_normalAttributeLocation, 1, GL_FLOAT, GL_FALSE, stride, ptr);
+    void setNormal(const GLvoid *ptr, GLsizei stride, GLenum type, GLboolean normalized) {
+        glVertexAttribPointer(m_normalAttributeLocation, 1, type, normalized, stride, ptr);
     }
     void setVertexEdgeSize(const GLvoid *ptr, GLsizei stride) {
         glVertexAttribPointer(m_edgeAttributeLocation, 1, GL_FLOAT, GL_FALSE, stride, ptr);
     }
-    void setBoneIndices(const GLvoid *ptr, GLsizei stride) {
-        glVertexAttribPointer(m_boneIndicesAttributeLocation, 4, GL_FLOAT, GL_FALSE, stride, ptr);
+    void setBoneIndices(const GLvoid *ptr, GLsizei stride, GLenum type) {
+        glVertexAttribPointer(m_boneIndicesAttributeLocation, 4, type, GL_FALSE, stride, ptr);
     }
-    void setBoneWeights(const GLvoid *ptr, GLsizei stride) {
-        glVertexAttribPointer(m_boneWeightsAttributeLocation, 4, GL_FLOAT, GL_FALSE, stride, ptr);
+    void setBoneWeights(const GLvoid *ptr, GLsizei stride, GLenum type, GLboolean normalized) {
+        glVertexAttribPointer(m_boneWeightsAttributeLocation, 4, type, normalized, stride, ptr);
     }
     void setBoneMatrices(const Scalar *value, size_t size) {
         glUniformMatrix4fv(m_boneMatricesUniformLocation, size, GL_FALSE, value);
@@ -207,13 +217,13 @@ public:
     }
 
     void setShadowMatrix(const float value[16]) {
-        glUniformMatrix4fv(m_shadowMatrixUniformLocation, 1, GL_FALSE, value);
+        uniformMatrix4fv(m_shadowMatrixUniformLocation, value);
     }
-    void setBoneIndices(const GLvoid *ptr, GLsizei stride) {
-        glVertexAttribPointer(m_boneIndicesAttributeLocation, 4, GL_FLOAT, GL_FALSE, stride, ptr);
+    void setBoneIndices(const GLvoid *ptr, GLsizei stride, GLenum type) {
+        glVertexAttribPointer(m_boneIndicesAttributeLocation, 4, type, GL_FALSE, stride, ptr);
     }
-    void setBoneWeights(const GLvoid *ptr, GLsizei stride) {
-        glVertexAttribPointer(m_boneWeightsAttributeLocation, 4, GL_FLOAT, GL_FALSE, stride, ptr);
+    void setBoneWeights(const GLvoid *ptr, GLsizei stride, GLenum type, GLboolean normalized) {
+        glVertexAttribPointer(m_boneWeightsAttributeLocation, 4, type, normalized, stride, ptr);
     }
     void setBoneMatrices(const Scalar *value, size_t size) {
         glUniformMatrix4fv(m_boneMatricesUniformLocation, size, GL_FALSE, value);
@@ -288,7 +298,7 @@ public:
     }
 
     void setCameraPosition(const Vector3 &value) {
-        glUniform3fv(m_cameraPositionUniformLocation, 1, value);
+        uniform3fv(m_cameraPositionUniformLocation, value);
     }
     void setToonTexCoord(const GLvoid *ptr, GLsizei stride) {
         glVertexAttribPointer(m_toonTexCoordAttributeLocation, 2, GL_FLOAT, GL_FALSE, stride, ptr);
@@ -297,79 +307,77 @@ public:
         glVertexAttribPointer(m_uva1AttributeLocation, 4, GL_FLOAT, GL_FALSE, stride, ptr);
     }
     void setMaterialColor(const Color &value) {
-        glUniform4fv(m_materialColorUniformLocation, 1, value);
+        uniform4fv(m_materialColorUniformLocation, value);
     }
     void setMaterialSpecular(const Color &value) {
-        glUniform3fv(m_materialSpecularUniformLocation, 1, value);
+        uniform3fv(m_materialSpecularUniformLocation, value);
     }
     void setMaterialShininess(const Scalar &value) {
-        glUniform1f(m_materialShininessUniformLocation, value);
+        uniform1f(m_materialShininessUniformLocation, value);
     }
     void setMainTextureBlend(const Color &value) {
-        glUniform4fv(m_mainTextureBlendUniformLocation, 1, value);
+        uniform4fv(m_mainTextureBlendUniformLocation, value);
     }
     void setSphereTextureBlend(const Color &value) {
-        glUniform4fv(m_sphereTextureBlendUniformLocation, 1, value);
+        uniform4fv(m_sphereTextureBlendUniformLocation, value);
     }
     void setToonTextureBlend(const Color &value) {
-        glUniform4fv(m_toonTextureBlendUniformLocation, 1, value);
+        uniform4fv(m_toonTextureBlendUniformLocation, value);
     }
     void setToonEnable(bool value) {
-        glUniform1i(m_useToonUniformLocation, value ? 1 : 0);
+        uniform1i(m_useToonUniformLocation, value ? 1 : 0);
     }
     void setSphereTexture(GLuint value, pmx::Material::SphereTextureRenderMode mode) {
         if (value) {
-            glActiveTexture(GL_TEXTURE1);
-            glBindTexture(GL_TEXTURE_2D, value);
-            glUniform1i(m_sphereTextureUniformLocation, 1);
+            bindTexture(1, value);
+            uniform1i(m_sphereTextureUniformLocation, 1);
             switch (mode) {
             case pmx::Material::kNone:
             default:
-                glUniform1i(m_hasSphereTextureUniformLocation, 0);
-                glUniform1i(m_isSPHTextureUniformLocation, 0);
-                glUniform1i(m_isSPATextureUniformLocation, 0);
-                glUniform1i(m_isSubTextureUniformLocation, 0);
+                uniform1i(m_hasSphereTextureUniformLocation, 0);
+                uniform1i(m_isSPHTextureUniformLocation, 0);
+                uniform1i(m_isSPATextureUniformLocation, 0);
+                uniform1i(m_isSubTextureUniformLocation, 0);
                 break;
             case pmx::Material::kMultTexture:
-                glUniform1i(m_hasSphereTextureUniformLocation, 1);
-                glUniform1i(m_isSPHTextureUniformLocation, 1);
-                glUniform1i(m_isSPATextureUniformLocation, 0);
-                glUniform1i(m_isSubTextureUniformLocation, 0);
+                uniform1i(m_hasSphereTextureUniformLocation, 1);
+                uniform1i(m_isSPHTextureUniformLocation, 1);
+                uniform1i(m_isSPATextureUniformLocation, 0);
+                uniform1i(m_isSubTextureUniformLocation, 0);
                 break;
             case pmx::Material::kAddTexture:
-                glUniform1i(m_hasSphereTextureUniformLocation, 1);
-                glUniform1i(m_isSPHTextureUniformLocation, 0);
-                glUniform1i(m_isSPATextureUniformLocation, 1);
-                glUniform1i(m_isSubTextureUniformLocation, 0);
+                uniform1i(m_hasSphereTextureUniformLocation, 1);
+                uniform1i(m_isSPHTextureUniformLocation, 0);
+                uniform1i(m_isSPATextureUniformLocation, 1);
+                uniform1i(m_isSubTextureUniformLocation, 0);
                 break;
             case pmx::Material::kSubTexture:
-                glUniform1i(m_hasSphereTextureUniformLocation, 1);
-                glUniform1i(m_isSPHTextureUniformLocation, 0);
-                glUniform1i(m_isSPATextureUniformLocation, 0);
-                glUniform1i(m_isSubTextureUniformLocation, 1);
+                uniform1i(m_hasSphereTextureUniformLocation, 1);
+                uniform1i(m_isSPHTextureUniformLocation, 0);
+                uniform1i(m_isSPATextureUniformLocation, 0);
+                uniform1i(m_isSubTextureUniformLocation, 1);
                 break;
             }
         }
         else {
-            glUniform1i(m_hasSphereTextureUniformLocation, 0);
+            uniform1i(m_hasSphereTextureUniformLocation, 0);
         }
     }
     void setToonTexture(GLuint value) {
         if (value) {
-            glActiveTexture(GL_TEXTURE2);
-            glBindTexture(GL_TEXTURE_2D, value);
-            glUniform1i(m_toonTextureUniformLocation, 2);
-            glUniform1i(m_hasToonTextureUniformLocation, 1);
+            bindTexture(2, value);
+            uniform1i(m_toonTextureUniformLocation, 2);
+            uniform1i(m_hasToonTextureUniformLocation, 1);
         }
         else {
-            glUniform1i(m_hasToonTextureUniformLocation, 0);
+            uniform1i(m_hasToonTextureUniformLocation, 0);
         }
     }
-    void setBoneIndices(const GLvoid *ptr, GLsizei stride) {
-        glVertexAttribPointer(m_boneIndicesAttributeLocation, 4, GL_FLOAT, GL_FALSE, stride, ptr);
+    void setBoneIndices(const GLvoid *ptr, GLsizei stride, GLenum type) {
+        glVertexAttribPointer(m_boneIndicesAttributeLocation, 4, type, GL_FALSE, stride, ptr);
     }
-    void setBoneWeights(const GLvoid *ptr, GLsizei stride) {
-        glVertexAttribPointer(m_boneWeightsAttributeLocation, 4, GL_FLOAT, GL_FALSE, stride, ptr);
+    void setBoneWeights(const GLvoid *ptr, GLsizei stride, GLenum type, GLboolean normalized) {
+        glVertexAttribPointer(m_boneWeightsAttributeLocation, 4, type, normalized, stride, ptr);
     }
     void setBoneMatrices(const Scalar *value, size_t size) {
         glUniformMatrix4fv(m_boneMatricesUniformLocation, size, GL_FALSE, value);
@@ -434,6 +442,73 @@ namespace vpvl2
 namespace gl2
 {
 
+/* 同じデータのモデルのインスタンス間で共有する索引、静的な頂点属性、テクスチャ及び描画リスト */
+class SharedContext
+        #ifdef VPVL2_LINK_QT
+        : protected QGLFunctions
+        #endif
+{
+public:
+    SharedContext()
+        : materials(0),
+          nmaterials(0),
+          indexType(GL_UNSIGNED_INT),
+          isPackedVertex(false),
+          enableMaterialBatching(false),
+          m_refCount(1)
+    {
+#ifdef VPVL2_LINK_QT
+        initializeGLFunctions();
+#endif
+        glGenBuffers(kSharedBufferObjectMax, bufferObjects);
+    }
+    ~SharedContext() {
+        glDeleteBuffers(kSharedBufferObjectMax, bufferObjects);
+        releaseMaterials();
+        indexType = GL_UNSIGNED_INT;
+        isPackedVertex = false;
+        enableMaterialBatching = false;
+    }
+
+    void retain() {
+        m_refCount++;
+    }
+    bool isUnique() const {
+        return m_refCount == 1;
+    }
+    static void release(SharedContext *&value) {
+        if (value && --value->m_refCount == 0)
+            delete value;
+        value = 0;
+    }
+    void releaseMaterials() {
+        if (materials) {
+            for (int i = 0; i < nmaterials; i++) {
+                MaterialTextures &materialPrivate = materials[i];
+                glDeleteTextures(1, &materialPrivate.mainTextureID);
+                glDeleteTextures(1, &materialPrivate.sphereTextureID);
+                glDeleteTextures(1, &materialPrivate.toonTextureID);
+            }
+            delete[] materials;
+            materials = 0;
+            nmaterials = 0;
+        }
+    }
+
+    pmx::DrawList drawList;
+    GLuint bufferObjects[kSharedBufferObjectMax];
+    MaterialTextures *materials;
+    int nmaterials;
+    GLenum indexType;
+    bool isPackedVertex;
+    bool enableMaterialBatching;
+
+private:
+    int m_refCount;
+
+    VPVL2_DISABLE_COPY_AND_ASSIGN(SharedContext)
+};
+
 class PMXRenderEngine::PrivateContext
         #ifdef VPVL2_LINK_QT
         : protected QGLFunctions
@@ -445,9 +520,11 @@ public:
           modelProgram(0),
           shadowProgram(0),
           zplotProgram(0),
-          materials(0),
+          shared(0),
           cullFaceState(true),
-          isVertexShaderSkinning(false)
+          isVertexShaderSkinning(false),
+          isPackedVertex(false),
+          hasPackedUVA1(false)
     {
 #ifdef VPVL2_LINK_QT
         initializeGLFunctions();
@@ -463,23 +540,52 @@ public:
         shadowProgram = 0;
         delete zplotProgram;
         zplotProgram = 0;
+        SharedContext::release(shared);
         cullFaceState = false;
         isVertexShaderSkinning = false;
+        isPackedVertex = false;
+        hasPackedUVA1 = false;
     }
 
-    void releaseMaterials(pmx::Model *model) {
-        if (materials) {
-            const Array<pmx::Material *> &modelMaterials = model->materials();
-            const int nmaterials = modelMaterials.count();
-            for (int i = 0; i < nmaterials; i++) {
-                MaterialTextures &materialPrivate = materials[i];
-                glDeleteTextures(1, &materialPrivate.mainTextureID);
-                glDeleteTextures(1, &materialPrivate.sphereTextureID);
-                glDeleteTextures(1, &materialPrivate.toonTextureID);
+    void bindVertexBuffer(pmx::Model::StrideType type, size_t &offset, size_t &size) {
+        GLuint buffer = vertexBufferObjects[kModelVertices];
+        if (isPackedVertex) {
+            switch (pmx::Model::packedStreamType(type)) {
+            case pmx::Model::kStaticStream:
+                buffer = shared->bufferObjects[kModelStaticVertices];
+                break;
+            case pmx::Model::kUVA1Stream:
+                if (hasPackedUVA1) {
+                    buffer = vertexBufferObjects[kModelUVA1Vertices];
+                    break;
+                }
+                /* 追加 UV を持たないモデルは UVA の頂点バッファを作らないため、代わりに UV を参照させる */
+                type = pmx::Model::kTexCoordStride;
+                break;
+            case pmx::Model::kDynamicStream:
+            default:
+                break;
             }
-            delete[] materials;
-            materials = 0;
+            offset = pmx::Model::packedStrideOffset(type);
+            size = pmx::Model::packedStrideSize(type);
         }
+        else {
+            offset = pmx::Model::strideOffset(type);
+            size = pmx::Model::strideSize(type);
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    }
+    GLenum normalType() const {
+        return isPackedVertex ? GL_SHORT : GL_FLOAT;
+    }
+    GLenum boneIndexType() const {
+        return isPackedVertex ? GL_SHORT : GL_FLOAT;
+    }
+    GLenum boneWeightType() const {
+        return isPackedVertex ? GL_UNSIGNED_SHORT : GL_FLOAT;
+    }
+    GLboolean isNormalized() const {
+        return isPackedVertex ? GL_TRUE : GL_FALSE;
     }
 
     EdgeProgram *edgeProgram;
@@ -487,10 +593,12 @@ public:
     ShadowProgram *shadowProgram;
     ExtendedZPlotProgram *zplotProgram;
     pmx::Model::SkinningMeshes mesh;
+    SharedContext *shared;
     GLuint vertexBufferObjects[kVertexBufferObjectMax];
-    MaterialTextures *materials;
     bool cullFaceState;
     bool isVertexShaderSkinning;
+    bool isPackedVertex;
+    bool hasPackedUVA1;
 };
 
 PMXRenderEngine::PMXRenderEngine(IRenderDelegate *delegate,
@@ -506,7 +614,12 @@ PMXRenderEngine::PMXRenderEngine(IRenderDelegate *delegate,
       m_sceneRef(scene),
       m_accelerator(accelerator),
       m_modelRef(model),
-      m_context(0)
+      m_sharedEngineRef(0),
+      m_context(0),
+      m_enablePackedVertex(false),
+      m_enableMaterialBatching(false),
+      m_enableFrustumCulling(false),
+      m_enableIndexOptimization(false)
 {
     m_context = new PrivateContext();
 #ifdef VPVL2_LINK_QT
@@ -516,17 +629,15 @@ PMXRenderEngine::PMXRenderEngine(IRenderDelegate *delegate,
 
 PMXRenderEngine::~PMXRenderEngine()
 {
-    if (m_context) {
-        m_context->releaseMaterials(m_modelRef);
-        delete m_context;
-        m_context = 0;
-    }
+    delete m_context;
+    m_context = 0;
 #ifdef VPVL2_ENABLE_OPENCL
     delete m_accelerator;
 #endif
     m_delegateRef = 0;
     m_sceneRef = 0;
     m_modelRef = 0;
+    m_sharedEngineRef = 0;
     m_accelerator = 0;
 }
 
@@ -537,7 +648,6 @@ IModel *PMXRenderEngine::model() const
 
 bool PMXRenderEngine::upload(const IString *dir)
 {
-    bool ret = true;
     void *context = 0;
     if (!m_context)
         m_context = new PrivateContext();
@@ -576,79 +686,110 @@ bool PMXRenderEngine::upload(const IString *dir)
         return releaseContext0(context);
     }
     glGenBuffers(kVertexBufferObjectMax, m_context->vertexBufferObjects);
-    size_t size = pmx::Model::strideSize(pmx::Model::kIndexStride);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_context->vertexBufferObjects[kModelIndices]);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, m_modelRef->indices().count() * size, m_modelRef->indicesPtr(), GL_STATIC_DRAW);
-    log0(context, IRenderDelegate::kLogInfo,
-         "Binding indices to the vertex buffer object (ID=%d)",
-         m_context->vertexBufferObjects[kModelIndices]);
-    size = pmx::Model::strideSize(pmx::Model::kVertexStride);
-    glBindBuffer(GL_ARRAY_BUFFER, m_context->vertexBufferObjects[kModelVertices]);
-    glBufferData(GL_ARRAY_BUFFER, m_modelRef->vertices().count() * size, m_modelRef->vertexPtr(), GL_DYNAMIC_DRAW);
-    log0(context, IRenderDelegate::kLogInfo,
-         "Binding model vertices to the vertex buffer object (ID=%d)",
-         m_context->vertexBufferObjects[kModelVertices]);
-    if (m_context->isVertexShaderSkinning)
-        m_modelRef->getSkinningMesh(m_context->mesh);
-    const Array<pmx::Material *> &materials = m_modelRef->materials();
-    const int nmaterials = materials.count();
-    IRenderDelegate::Texture texture;
-    GLuint textureID = 0;
-    MaterialTextures *materialPrivates = m_context->materials = new MaterialTextures[nmaterials];
-    texture.object = &textureID;
-    for (int i = 0; i < nmaterials; i++) {
-        const pmx::Material *material = materials[i];
-        MaterialTextures &materialPrivate = materialPrivates[i];
-        materialPrivate.mainTextureID = 0;
-        materialPrivate.sphereTextureID = 0;
-        materialPrivate.toonTextureID = 0;
-        const IString *path = 0;
-        path = material->mainTexture();
-        if (path) {
-            if (m_delegateRef->uploadTexture(path, dir, IRenderDelegate::kTexture2D, texture, context)) {
-                materialPrivate.mainTextureID = textureID = *static_cast<const GLuint *>(texture.object);
-                log0(context, IRenderDelegate::kLogInfo, "Binding the texture as a main texture (ID=%d)", textureID);
-            }
-            else {
-                return releaseContext0(context);
-            }
-        }
-        path = material->sphereTexture();
-        if (path) {
-            if (m_delegateRef->uploadTexture(path, dir, IRenderDelegate::kTexture2D, texture, context)) {
-                materialPrivate.sphereTextureID = textureID = *static_cast<const GLuint *>(texture.object);
-                log0(context, IRenderDelegate::kLogInfo, "Binding the texture as a sphere texture (ID=%d)", textureID);
-            }
-            else {
-                return releaseContext0(context);
-            }
+    bool isAcceleratorAvailable = false;
+#ifdef VPVL2_ENABLE_OPENCL
+    isAcceleratorAvailable = m_accelerator && m_accelerator->isAvailable();
+#endif
+    /* OpenCL は従来の頂点形式の頂点バッファに直接書き込むため、圧縮した頂点形式は使用しない */
+    m_context->isPackedVertex = m_enablePackedVertex && !isAcceleratorAvailable;
+    m_modelRef->setPackedVertexEnable(m_context->isPackedVertex);
+    /* 頂点シェーダによるスキニングは材質毎にボーン行列を切り替えるため材質をまとめない */
+    const bool enableMaterialBatching = m_enableMaterialBatching && !m_context->isVertexShaderSkinning;
+    /* 並べ替えの結果は同じデータからは常に同じになるため、共有の判定より前に行う */
+    if (m_enableIndexOptimization)
+        m_modelRef->optimizeIndices();
+    SharedContext *shared = 0;
+    if (const PrivateContext *sourceContext = m_sharedEngineRef ? m_sharedEngineRef->m_context : 0) {
+        shared = sourceContext->shared;
+        /* 索引の並びや頂点形式が異なる場合は共有できないため、個別にリソースを作成する */
+        if (!shared || shared->isPackedVertex != m_context->isPackedVertex
+                || shared->enableMaterialBatching != enableMaterialBatching
+                || !m_modelRef->hasSameSource(m_sharedEngineRef->m_modelRef)) {
+            shared = 0;
         }
-        if (material->isSharedToonTextureUsed()) {
-            char buf[16];
-            snprintf(buf, sizeof(buf), "toon%02d.bmp", material->toonTextureIndex() + 1);
-            IString *s = m_delegateRef->toUnicode(reinterpret_cast<const uint8_t *>(buf));
-            ret = m_delegateRef->uploadTexture(s, 0, IRenderDelegate::kToonTexture, texture, context);
-            delete s;
-            if (ret) {
-                materialPrivate.toonTextureID = textureID = *static_cast<const GLuint *>(texture.object);
-                log0(context, IRenderDelegate::kLogInfo, "Binding the texture as a shared toon texture (ID=%d)", textureID);
-            }
-            else {
-                return releaseContext0(context);
-            }
+    }
+    m_sharedEngineRef = 0;
+    const bool isShared = shared != 0;
+    if (isShared) {
+        shared->retain();
+        m_context->shared = shared;
+        log0(context, IRenderDelegate::kLogInfo,
+             "Sharing indices, static vertices and textures with the other instance (ID=%d)",
+             shared->bufferObjects[kModelIndices]);
+    }
+    else {
+        shared = m_context->shared = new SharedContext();
+        shared->isPackedVertex = m_context->isPackedVertex;
+        shared->enableMaterialBatching = enableMaterialBatching;
+        size_t size = m_modelRef->indexStrideSize();
+        shared->indexType = size == sizeof(uint16_t) ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+        /* 描画リストの作成時にテクスチャがアルファを持つかを参照するため先にテクスチャを読み込む */
+        if (!uploadTextures(dir, context))
+            return releaseContext0(context);
+        const int nmaterials = shared->nmaterials;
+        Array<bool> opaqueTextures;
+        opaqueTextures.reserve(nmaterials);
+        for (int i = 0; i < nmaterials; i++)
+            opaqueTextures.add(shared->materials[i].isMainTextureOpaque);
+        pmx::DrawList &drawList = shared->drawList;
+        drawList.compile(m_modelRef->materials(), m_modelRef->morphs(), opaqueTextures, enableMaterialBatching);
+        const int nindices = m_modelRef->indices().count();
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, shared->bufferObjects[kModelIndices]);
+        if (drawList.isReordered()) {
+            uint8_t *indices = new uint8_t[nindices * size];
+            drawList.reorderIndices(static_cast<const uint8_t *>(m_modelRef->indicesPtr()), indices, size);
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, nindices * size, indices, GL_STATIC_DRAW);
+            delete[] indices;
         }
         else {
-            path = material->toonTexture();
-            if (path) {
-                if (m_delegateRef->uploadTexture(path, dir, IRenderDelegate::kTexture2D, texture, context)) {
-                    materialPrivate.toonTextureID = textureID = *static_cast<const GLuint *>(texture.object);
-                    log0(context, IRenderDelegate::kLogInfo, "Binding the texture as a static toon texture (ID=%d)", textureID);
-                }
-                else {
-                    return releaseContext0(context);
-                }
-            }
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, nindices * size, m_modelRef->indicesPtr(), GL_STATIC_DRAW);
+        }
+        log0(context, IRenderDelegate::kLogInfo,
+             "Compiled %d materials into %d draw batches", drawList.countMaterials(), drawList.countBatches());
+        log0(context, IRenderDelegate::kLogInfo,
+             "Binding indices to the vertex buffer object (ID=%d)",
+             shared->bufferObjects[kModelIndices]);
+    }
+    if (m_context->isVertexShaderSkinning)
+        m_modelRef->getSkinningMesh(m_context->mesh);
+    const int nvertices = m_modelRef->vertices().count();
+    size_t size = 0;
+    if (m_context->isPackedVertex) {
+        size = pmx::Model::packedStrideSize(pmx::Model::kVertexStride);
+        glBindBuffer(GL_ARRAY_BUFFER, m_context->vertexBufferObjects[kModelVertices]);
+        glBufferData(GL_ARRAY_BUFFER, nvertices * size, m_modelRef->packedVertexPtr(), GL_DYNAMIC_DRAW);
+        log0(context, IRenderDelegate::kLogInfo,
+             "Binding packed model vertices to the vertex buffer object (ID=%d)",
+             m_context->vertexBufferObjects[kModelVertices]);
+        if (!isShared) {
+            size = pmx::Model::packedStrideSize(pmx::Model::kBoneIndexStride);
+            uint8_t *staticVertices = new uint8_t[nvertices * size];
+            m_modelRef->getPackedStaticVertices(staticVertices);
+            glBindBuffer(GL_ARRAY_BUFFER, shared->bufferObjects[kModelStaticVertices]);
+            glBufferData(GL_ARRAY_BUFFER, nvertices * size, staticVertices, GL_STATIC_DRAW);
+            delete[] staticVertices;
+            log0(context, IRenderDelegate::kLogInfo,
+                 "Binding static model vertices to the vertex buffer object (ID=%d)",
+                 shared->bufferObjects[kModelStaticVertices]);
+        }
+        if (const void *uva1 = m_modelRef->packedUVA1Ptr()) {
+            size = pmx::Model::packedStrideSize(pmx::Model::kUVA1Stride);
+            glBindBuffer(GL_ARRAY_BUFFER, m_context->vertexBufferObjects[kModelUVA1Vertices]);
+            glBufferData(GL_ARRAY_BUFFER, nvertices * size, uva1, GL_DYNAMIC_DRAW);
+            m_context->hasPackedUVA1 = true;
+            log0(context, IRenderDelegate::kLogInfo,
+                 "Binding additional UV of model vertices to the vertex buffer object (ID=%d)",
+                 m_context->vertexBufferObjects[kModelUVA1Vertices]);
         }
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+    else {
+        size = pmx::Model::strideSize(pmx::Model::kVertexStride);
+        glBindBuffer(GL_ARRAY_BUFFER, m_context->vertexBufferObjects[kModelVertices]);
+        glBufferData(GL_ARRAY_BUFFER, nvertices * size, m_modelRef->vertexPtr(), GL_DYNAMIC_DRAW);
+        log0(context, IRenderDelegate::kLogInfo,
+             "Binding model vertices to the vertex buffer object (ID=%d)",
+             m_context->vertexBufferObjects[kModelVertices]);
     }
 #ifdef VPVL2_ENABLE_OPENCL
     if (m_accelerator && m_accelerator->isAvailable())
@@ -659,17 +800,39 @@ bool PMXRenderEngine::upload(const IString *dir)
     update();
     log0(context, IRenderDelegate::kLogInfo, "Created the model: %s", m_modelRef->name()->toByteArray());
     m_delegateRef->releaseContext(m_modelRef, context);
-    return ret;
+    return true;
 }
 
 void PMXRenderEngine::update()
 {
     if (!m_modelRef || !m_modelRef->isVisible() || !m_context)
         return;
-    size_t size = pmx::Model::strideSize(pmx::Model::kVertexStride);
-    glBindBuffer(GL_ARRAY_BUFFER, m_context->vertexBufferObjects[kModelVertices]);
-    glBufferSubData(GL_ARRAY_BUFFER, 0, m_modelRef->vertices().count() * size, m_modelRef->vertexPtr());
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    bool isVertexSourceTransferred = false;
+#ifdef VPVL2_ENABLE_OPENCL
+    isVertexSourceTransferred = m_accelerator && m_accelerator->isAvailable()
+            && m_accelerator->isVertexSourceTransferred();
+#endif
+    /* OpenCL 側で変形前の頂点を転送してスキニングする場合は結果が後で転送されるため、ここでの転送を省略する */
+    if (!isVertexSourceTransferred) {
+        const int nvertices = m_modelRef->vertices().count();
+        if (m_context->isPackedVertex) {
+            /* 圧縮した頂点形式ではボーンの情報が変化しないため、動的な属性のみを転送する */
+            size_t size = pmx::Model::packedStrideSize(pmx::Model::kVertexStride);
+            glBindBuffer(GL_ARRAY_BUFFER, m_context->vertexBufferObjects[kModelVertices]);
+            glBufferSubData(GL_ARRAY_BUFFER, 0, nvertices * size, m_modelRef->packedVertexPtr());
+            if (m_context->hasPackedUVA1) {
+                size = pmx::Model::packedStrideSize(pmx::Model::kUVA1Stride);
+                glBindBuffer(GL_ARRAY_BUFFER, m_context->vertexBufferObjects[kModelUVA1Vertices]);
+                glBufferSubData(GL_ARRAY_BUFFER, 0, nvertices * size, m_modelRef->packedUVA1Ptr());
+            }
+        }
+        else {
+            size_t size = pmx::Model::strideSize(pmx::Model::kVertexStride);
+            glBindBuffer(GL_ARRAY_BUFFER, m_context->vertexBufferObjects[kModelVertices]);
+            glBufferSubData(GL_ARRAY_BUFFER, 0, nvertices * size, m_modelRef->vertexPtr());
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
     if (m_context->isVertexShaderSkinning)
         m_modelRef->updateSkinningMesh(m_context->mesh);
 #ifdef VPVL2_ENABLE_OPENCL
@@ -682,42 +845,42 @@ void PMXRenderEngine::renderModel()
 {
     if (!m_modelRef || !m_modelRef->isVisible() || !m_context)
         return;
+    static const int kMatrixFlags[] = {
+        IRenderDelegate::kWorldMatrix | IRenderDelegate::kViewMatrix | IRenderDelegate::kProjectionMatrix | IRenderDelegate::kCameraMatrix,
+        IRenderDelegate::kWorldMatrix | IRenderDelegate::kViewMatrix | IRenderDelegate::kCameraMatrix,
+        IRenderDelegate::kWorldMatrix | IRenderDelegate::kViewMatrix | IRenderDelegate::kProjectionMatrix | IRenderDelegate::kLightMatrix
+    };
+    static const int kNumMatrices = sizeof(kMatrixFlags) / sizeof(kMatrixFlags[0]);
+    float matrices[kNumMatrices * 16];
+    m_delegateRef->getMatrices(matrices, m_modelRef, kMatrixFlags, kNumMatrices);
+    if (isCulled(&matrices[0]))
+        return;
+    uploadSkinnedVertices();
     ModelProgram *modelProgram = m_context->modelProgram;
     modelProgram->bind();
-    glBindBuffer(GL_ARRAY_BUFFER, m_context->vertexBufferObjects[kModelVertices]);
-    size_t offset = pmx::Model::strideOffset(pmx::Model::kVertexStride);
-    size_t size   = pmx::Model::strideSize(pmx::Model::kVertexStride);
+    size_t offset, size;
+    m_context->bindVertexBuffer(pmx::Model::kVertexStride, offset, size);
     modelProgram->setPosition(reinterpret_cast<const GLvoid *>(offset), size);
-    offset = pmx::Model::strideOffset(pmx::Model::kNormalStride);
-    size   = pmx::Model::strideSize(pmx::Model::kNormalStride);
-    modelProgram->setNormal(reinterpret_cast<const GLvoid *>(offset), size);
-    offset = pmx::Model::strideOffset(pmx::Model::kTexCoordStride);
-    size   = pmx::Model::strideSize(pmx::Model::kTexCoordStride);
+    m_context->bindVertexBuffer(pmx::Model::kNormalStride, offset, size);
+    modelProgram->setNormal(reinterpret_cast<const GLvoid *>(offset), size,
+                            m_context->normalType(), m_context->isNormalized());
+    m_context->bindVertexBuffer(pmx::Model::kTexCoordStride, offset, size);
     modelProgram->setTexCoord(reinterpret_cast<const GLvoid *>(offset), size);
-    offset = pmx::Model::strideOffset(pmx::Model::kToonCoordStride);
-    size   = pmx::Model::strideSize(pmx::Model::kToonCoordStride);
+    m_context->bindVertexBuffer(pmx::Model::kToonCoordStride, offset, size);
     modelProgram->setToonTexCoord(reinterpret_cast<const GLvoid *>(offset), size);
-    offset = pmx::Model::strideOffset(pmx::Model::kUVA1Stride);
-    size   = pmx::Model::strideSize(pmx::Model::kUVA1Stride);
+    m_context->bindVertexBuffer(pmx::Model::kUVA1Stride, offset, size);
     modelProgram->setUVA1(reinterpret_cast<const GLvoid *>(offset), size);
-    float matrix4x4[16];
-    m_delegateRef->getMatrix(matrix4x4, m_modelRef,
-                          IRenderDelegate::kWorldMatrix
-                          | IRenderDelegate::kViewMatrix
-                          | IRenderDelegate::kProjectionMatrix
-                          | IRenderDelegate::kCameraMatrix);
-    modelProgram->setModelViewProjectionMatrix(matrix4x4);
-    m_delegateRef->getMatrix(matrix4x4, m_modelRef,
-                          IRenderDelegate::kWorldMatrix
-                          | IRenderDelegate::kViewMatrix
-                          | IRenderDelegate::kCameraMatrix);
-    modelProgram->setNormalMatrix(matrix4x4);
-    m_delegateRef->getMatrix(matrix4x4, m_modelRef,
-                          IRenderDelegate::kWorldMatrix
-                          | IRenderDelegate::kViewMatrix
-                          | IRenderDelegate::kProjectionMatrix
-                          | IRenderDelegate::kLightMatrix);
-    modelProgram->setLightViewProjectionMatrix(matrix4x4);
+    const bool isVertexShaderSkinning = m_context->isVertexShaderSkinning;
+    if (isVertexShaderSkinning) {
+        m_context->bindVertexBuffer(pmx::Model::kBoneIndexStride, offset, size);
+        modelProgram->setBoneIndices(reinterpret_cast<const GLvoid *>(offset), size, m_context->boneIndexType());
+        m_context->bindVertexBuffer(pmx::Model::kBoneWeightStride, offset, size);
+        modelProgram->setBoneWeights(reinterpret_cast<const GLvoid *>(offset), size,
+                                     m_context->boneWeightType(), m_context->isNormalized());
+    }
+    modelProgram->setModelViewProjectionMatrix(&matrices[0]);
+    modelProgram->setNormalMatrix(&matrices[16]);
+    modelProgram->setLightViewProjectionMatrix(&matrices[32]);
     const ILight *light = m_sceneRef->light();
     void *texture = light->depthTexture();
     GLuint textureID = texture ? *static_cast<GLuint *>(texture) : 0;
@@ -730,29 +893,31 @@ void PMXRenderEngine::renderModel()
     const Scalar &opacity = m_modelRef->opacity();
     modelProgram->setOpacity(opacity);
     const Array<pmx::Material *> &materials = m_modelRef->materials();
-    const MaterialTextures *materialPrivates = m_context->materials;
-    const int nmaterials = materials.count();
-    const size_t boneIndexOffset = m_modelRef->strideOffset(pmx::Model::kBoneIndexStride),
-            boneWeightOffset = m_modelRef->strideOffset(pmx::Model::kBoneWeightStride),
-            boneStride = m_modelRef->strideSize(pmx::Model::kVertexStride);
-    const bool hasModelTransparent = !btFuzzyZero(opacity - 1.0),
-            isVertexShaderSkinning = m_context->isVertexShaderSkinning;
+    const pmx::MaterialParameterBuffer *parameters = m_modelRef->materialParameters();
+    const MaterialTextures *materialPrivates = m_context->shared->materials;
+    const pmx::DrawList &drawList = m_context->shared->drawList;
+    const bool hasModelTransparent = !btFuzzyZero(opacity - 1.0);
+    /* モデル全体が半透明の場合は描画順に依存するため、まとめずに材質を元の順番で描画する */
+    const int nbatches = hasModelTransparent ? drawList.countMaterials() : drawList.countBatches();
     const Vector3 &lc = light->color();
     Color diffuse, specular;
-    offset = 0; size = pmx::Model::strideSize(pmx::Model::kIndexStride);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_context->vertexBufferObjects[kModelIndices]);
-    for (int i = 0; i < nmaterials; i++) {
-        const pmx::Material *material = materials[i];
-        const MaterialTextures &materialPrivate = materialPrivates[i];
-        const Color &ma = material->ambient(), &md = material->diffuse(), &ms = material->specular();
+    size = m_modelRef->indexStrideSize();
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_context->shared->bufferObjects[kModelIndices]);
+    for (int i = 0; i < nbatches; i++) {
+        const pmx::DrawList::Batch &batch = hasModelTransparent ? drawList.materialBatchAt(i) : drawList.batchAt(i);
+        const int materialIndex = batch.materialIndex;
+        const pmx::Material *material = materials[materialIndex];
+        const MaterialTextures &materialPrivate = materialPrivates[materialIndex];
+        const pmx::MaterialParameterBuffer::Parameter &parameter = parameters->at(materialIndex);
+        const Color &ma = parameter.ambient, &md = parameter.diffuse, &ms = parameter.specular;
         diffuse.setValue(ma.x() + md.x() * lc.x(), ma.y() + md.y() * lc.y(), ma.z() + md.z() * lc.z(), md.w());
         specular.setValue(ms.x() * lc.x(), ms.y() * lc.y(), ms.z() * lc.z(), 1.0);
         modelProgram->setMaterialColor(diffuse);
         modelProgram->setMaterialSpecular(specular);
-        modelProgram->setMaterialShininess(material->shininess());
-        modelProgram->setMainTextureBlend(material->mainTextureBlend());
-        modelProgram->setSphereTextureBlend(material->sphereTextureBlend());
-        modelProgram->setToonTextureBlend(material->toonTextureBlend());
+        modelProgram->setMaterialShininess(parameter.shininess);
+        modelProgram->setMainTextureBlend(parameter.mainTextureBlend);
+        modelProgram->setSphereTextureBlend(parameter.sphereTextureBlend);
+        modelProgram->setToonTextureBlend(parameter.toonTextureBlend);
         modelProgram->setMainTexture(materialPrivate.mainTextureID);
         modelProgram->setSphereTexture(materialPrivate.sphereTextureID, material->sphereTextureRenderMode());
         modelProgram->setToonTexture(materialPrivate.toonTextureID);
@@ -762,26 +927,23 @@ void PMXRenderEngine::renderModel()
             modelProgram->setDepthTexture(0);
         if (isVertexShaderSkinning) {
             const pmx::Model::SkinningMeshes &mesh = m_context->mesh;
-            modelProgram->setBoneIndices(reinterpret_cast<const GLvoid *>(boneIndexOffset), boneStride);
-            modelProgram->setBoneWeights(reinterpret_cast<const GLvoid *>(boneWeightOffset), boneStride);
-            modelProgram->setBoneMatrices(mesh.matrices[i], mesh.bones[i].size());
+            modelProgram->setBoneMatrices(mesh.matrices[materialIndex], mesh.bones[materialIndex].size());
         }
         if ((!hasModelTransparent && m_context->cullFaceState) ||
                 (material->isCullFaceDisabled() && m_context->cullFaceState)) {
-            glDisable(GL_CULL_FACE);
+            modelProgram->setCullFaceEnable(false);
             m_context->cullFaceState = false;
         }
         else if (!m_context->cullFaceState) {
-            glEnable(GL_CULL_FACE);
+            modelProgram->setCullFaceEnable(true);
             m_context->cullFaceState = true;
         }
-        const int nindices = material->indices();
-        glDrawElements(GL_TRIANGLES, nindices, GL_UNSIGNED_INT, reinterpret_cast<const GLvoid *>(offset));
-        offset += nindices * size;
+        offset = batch.indexOffset * size;
+        glDrawElements(GL_TRIANGLES, batch.nindices, m_context->shared->indexType, reinterpret_cast<const GLvoid *>(offset));
     }
     modelProgram->unbind();
     if (!m_context->cullFaceState) {
-        glEnable(GL_CULL_FACE);
+        modelProgram->setCullFaceEnable(true);
         m_context->cullFaceState = true;
     }
 }
@@ -790,46 +952,53 @@ void PMXRenderEngine::renderShadow()
 {
     if (!m_modelRef || !m_modelRef->isVisible() || !m_context)
         return;
-    ShadowProgram *shadowProgram = m_context->shadowProgram;
-    shadowProgram->bind();
     float matrix4x4[16];
     m_delegateRef->getMatrix(matrix4x4, m_modelRef,
                           IRenderDelegate::kWorldMatrix
                           | IRenderDelegate::kViewMatrix
                           | IRenderDelegate::kProjectionMatrix
                           | IRenderDelegate::kShadowMatrix);
+    /* 影の行列で地面に投影した境界ボックスをカメラの視錐台で判定する */
+    if (isCulled(matrix4x4))
+        return;
+    uploadSkinnedVertices();
+    ShadowProgram *shadowProgram = m_context->shadowProgram;
+    shadowProgram->bind();
     shadowProgram->setModelViewProjectionMatrix(matrix4x4);
     const ILight *light = m_sceneRef->light();
     shadowProgram->setLightColor(light->color());
     shadowProgram->setLightDirection(light->direction());
-    size_t offset = pmx::Model::strideOffset(pmx::Model::kVertexStride);
-    size_t size = pmx::Model::strideSize(pmx::Model::kVertexStride);
-    glBindBuffer(GL_ARRAY_BUFFER, m_context->vertexBufferObjects[kModelVertices]);
+    size_t offset, size;
+    m_context->bindVertexBuffer(pmx::Model::kVertexStride, offset, size);
     shadowProgram->setPosition(reinterpret_cast<const GLvoid *>(offset), size);
-    glCullFace(GL_FRONT);
-    const Array<pmx::Material *> &materials = m_modelRef->materials();
-    const size_t boneIndexOffset = m_modelRef->strideOffset(pmx::Model::kBoneIndexStride),
-            boneWeightOffset = m_modelRef->strideOffset(pmx::Model::kBoneWeightStride),
-            boneStride = m_modelRef->strideSize(pmx::Model::kVertexStride);
-    const int nmaterials = materials.count();
     const bool isVertexShaderSkinning = m_context->isVertexShaderSkinning;
-    offset = 0; size = pmx::Model::strideSize(pmx::Model::kIndexStride);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_context->vertexBufferObjects[kModelIndices]);
-    for (int i = 0; i < nmaterials; i++) {
-        const pmx::Material *material = materials[i];
-        const int nindices = material->indices();
+    if (isVertexShaderSkinning) {
+        m_context->bindVertexBuffer(pmx::Model::kBoneIndexStride, offset, size);
+        shadowProgram->setBoneIndices(reinterpret_cast<const GLvoid *>(offset), size, m_context->boneIndexType());
+        m_context->bindVertexBuffer(pmx::Model::kBoneWeightStride, offset, size);
+        shadowProgram->setBoneWeights(reinterpret_cast<const GLvoid *>(offset), size,
+                                      m_context->boneWeightType(), m_context->isNormalized());
+    }
+    shadowProgram->setCullFace(GL_FRONT);
+    const Array<pmx::Material *> &materials = m_modelRef->materials();
+    const pmx::DrawList &drawList = m_context->shared->drawList;
+    const int nbatches = drawList.countBatches();
+    size = m_modelRef->indexStrideSize();
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_context->shared->bufferObjects[kModelIndices]);
+    for (int i = 0; i < nbatches; i++) {
+        const pmx::DrawList::Batch &batch = drawList.batchAt(i);
+        const int materialIndex = batch.materialIndex;
+        const pmx::Material *material = materials[materialIndex];
         if (material->hasShadow()) {
             if (isVertexShaderSkinning) {
                 const pmx::Model::SkinningMeshes &mesh = m_context->mesh;
-                shadowProgram->setBoneIndices(reinterpret_cast<const GLvoid *>(boneIndexOffset), boneStride);
-                shadowProgram->setBoneWeights(reinterpret_cast<const GLvoid *>(boneWeightOffset), boneStride);
-                shadowProgram->setBoneMatrices(mesh.matrices[i], mesh.bones[i].size());
+                shadowProgram->setBoneMatrices(mesh.matrices[materialIndex], mesh.bones[materialIndex].size());
             }
-            glDrawElements(GL_TRIANGLES, nindices, GL_UNSIGNED_INT, reinterpret_cast<const GLvoid *>(offset));
+            offset = batch.indexOffset * size;
+            glDrawElements(GL_TRIANGLES, batch.nindices, m_context->shared->indexType, reinterpret_cast<const GLvoid *>(offset));
         }
-        offset += nindices * size;
     }
-    glCullFace(GL_BACK);
+    shadowProgram->setCullFace(GL_BACK);
     shadowProgram->unbind();
 }
 
@@ -837,63 +1006,69 @@ void PMXRenderEngine::renderEdge()
 {
     if (!m_modelRef || !m_modelRef->isVisible() || btFuzzyZero(m_modelRef->edgeWidth()) || !m_context)
         return;
-    EdgeProgram *edgeProgram = m_context->edgeProgram;
-    edgeProgram->bind();
-    glBindBuffer(GL_ARRAY_BUFFER, m_context->vertexBufferObjects[kModelVertices]);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_context->vertexBufferObjects[kModelIndices]);
     float matrix4x4[16];
     m_delegateRef->getMatrix(matrix4x4, m_modelRef,
                           IRenderDelegate::kWorldMatrix
                           | IRenderDelegate::kViewMatrix
                           | IRenderDelegate::kProjectionMatrix
                           | IRenderDelegate::kCameraMatrix);
+    if (isCulled(matrix4x4))
+        return;
+    uploadSkinnedVertices();
+    EdgeProgram *edgeProgram = m_context->edgeProgram;
+    edgeProgram->bind();
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_context->shared->bufferObjects[kModelIndices]);
     edgeProgram->setModelViewProjectionMatrix(matrix4x4);
-    edgeProgram->setOpacity(m_modelRef->opacity());
+    const Scalar &opacity = m_modelRef->opacity();
+    edgeProgram->setOpacity(opacity);
     const Array<pmx::Material *> &materials = m_modelRef->materials();
-    const int nmaterials = materials.count();
+    const pmx::MaterialParameterBuffer *parameters = m_modelRef->materialParameters();
+    const pmx::DrawList &drawList = m_context->shared->drawList;
+    const bool hasModelTransparent = !btFuzzyZero(opacity - 1.0);
+    const int nbatches = hasModelTransparent ? drawList.countMaterials() : drawList.countBatches();
     const bool isVertexShaderSkinning = m_context->isVertexShaderSkinning;
     size_t offset, size;
     Scalar edgeScaleFactor;
     if (isVertexShaderSkinning) {
         const ICamera *camera = m_sceneRef->camera();
-        size_t boneIndexOffset = m_modelRef->strideOffset(pmx::Model::kBoneIndexStride);
-        size_t boneWeightOffset = m_modelRef->strideOffset(pmx::Model::kBoneWeightStride);
-        size_t boneStride = m_modelRef->strideSize(pmx::Model::kVertexStride);
         edgeScaleFactor = m_modelRef->edgeScaleFactor(camera->position() + Vector3(0, 0, camera->distance()));
-        offset = m_modelRef->strideOffset(pmx::Model::kEdgeSizeStride);
-        size = m_modelRef->strideSize(pmx::Model::kEdgeSizeStride);
+        m_context->bindVertexBuffer(pmx::Model::kEdgeSizeStride, offset, size);
         edgeProgram->setVertexEdgeSize(reinterpret_cast<const GLvoid *>(offset), size);
-        offset = pmx::Model::strideOffset(pmx::Model::kVertexStride);
-        size   = pmx::Model::strideSize(pmx::Model::kVertexStride);
+        m_context->bindVertexBuffer(pmx::Model::kVertexStride, offset, size);
         edgeProgram->setPosition(reinterpret_cast<const GLvoid *>(offset), size);
-        offset = pmx::Model::strideOffset(pmx::Model::kNormalStride);
-        size   = pmx::Model::strideSize(pmx::Model::kNormalStride);
-        edgeProgram->setNormal(reinterpret_cast<const GLvoid *>(offset), size);
-        edgeProgram->setBoneIndices(reinterpret_cast<const GLvoid *>(boneIndexOffset), boneStride);
-        edgeProgram->setBoneWeights(reinterpret_cast<const GLvoid *>(boneWeightOffset), boneStride);
+        m_context->bindVertexBuffer(pmx::Model::kNormalStride, offset, size);
+        edgeProgram->setNormal(reinterpret_cast<const GLvoid *>(offset), size,
+                               m_context->normalType(), m_context->isNormalized());
+        m_context->bindVertexBuffer(pmx::Model::kBoneIndexStride, offset, size);
+        edgeProgram->setBoneIndices(reinterpret_cast<const GLvoid *>(offset), size, m_context->boneIndexType());
+        m_context->bindVertexBuffer(pmx::Model::kBoneWeightStride, offset, size);
+        edgeProgram->setBoneWeights(reinterpret_cast<const GLvoid *>(offset), size,
+                                    m_context->boneWeightType(), m_context->isNormalized());
     }
     else {
-        offset = pmx::Model::strideOffset(pmx::Model::kEdgeVertexStride);
-        size   = pmx::Model::strideSize(pmx::Model::kEdgeVertexStride);
-        edgeProgram->setPosition(reinterpret_cast<const GLvoid *>(offset), size);
+        m_context->bindVertexBuffer(pmx::Model::kEdgeVertexStride, offset, size);
+        /* 圧縮した頂点形式ではエッジの頂点は3要素のみを持つ */
+        edgeProgram->setPosition(reinterpret_cast<const GLvoid *>(offset), size, m_context->isPackedVertex ? 3 : 4);
     }
-    offset = 0; size = pmx::Model::strideSize(pmx::Model::kIndexStride);
-    glCullFace(GL_FRONT);
-    for (int i = 0; i < nmaterials; i++) {
-        const pmx::Material *material = materials[i];
-        const int nindices = material->indices();
-        edgeProgram->setColor(material->edgeColor());
+    size = m_modelRef->indexStrideSize();
+    edgeProgram->setCullFace(GL_FRONT);
+    for (int i = 0; i < nbatches; i++) {
+        const pmx::DrawList::Batch &batch = hasModelTransparent ? drawList.materialBatchAt(i) : drawList.batchAt(i);
+        const int materialIndex = batch.materialIndex;
+        const pmx::Material *material = materials[materialIndex];
+        const pmx::MaterialParameterBuffer::Parameter &parameter = parameters->at(materialIndex);
+        edgeProgram->setColor(parameter.edgeColor);
         if (material->isEdgeDrawn()) {
             if (isVertexShaderSkinning) {
                 const pmx::Model::SkinningMeshes &mesh = m_context->mesh;
-                edgeProgram->setBoneMatrices(mesh.matrices[i], mesh.bones[i].size());
-                edgeProgram->setSize(material->edgeSize() * edgeScaleFactor);
+                edgeProgram->setBoneMatrices(mesh.matrices[materialIndex], mesh.bones[materialIndex].size());
+                edgeProgram->setSize(parameter.edgeSize * edgeScaleFactor);
             }
-            glDrawElements(GL_TRIANGLES, nindices, GL_UNSIGNED_INT, reinterpret_cast<const GLvoid *>(offset));
+            offset = batch.indexOffset * size;
+            glDrawElements(GL_TRIANGLES, batch.nindices, m_context->shared->indexType, reinterpret_cast<const GLvoid *>(offset));
         }
-        offset += nindices * size;
     }
-    glCullFace(GL_BACK);
+    edgeProgram->setCullFace(GL_BACK);
     edgeProgram->unbind();
 }
 
@@ -901,43 +1076,49 @@ void PMXRenderEngine::renderZPlot()
 {
     if (!m_modelRef || !m_modelRef->isVisible() || !m_context)
         return;
-    ExtendedZPlotProgram *zplotProgram = m_context->zplotProgram;
-    zplotProgram->bind();
-    glBindBuffer(GL_ARRAY_BUFFER, m_context->vertexBufferObjects[kModelVertices]);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_context->vertexBufferObjects[kModelIndices]);
-    size_t offset = pmx::Model::strideOffset(pmx::Model::kVertexStride);
-    size_t size   = pmx::Model::strideSize(pmx::Model::kVertexStride);
-    zplotProgram->setPosition(reinterpret_cast<const GLvoid *>(offset), size);
     float matrix4x4[16];
     m_delegateRef->getMatrix(matrix4x4, m_modelRef,
                           IRenderDelegate::kWorldMatrix
                           | IRenderDelegate::kViewMatrix
                           | IRenderDelegate::kProjectionMatrix
                           | IRenderDelegate::kLightMatrix);
+    if (isCulled(matrix4x4))
+        return;
+    uploadSkinnedVertices();
+    ExtendedZPlotProgram *zplotProgram = m_context->zplotProgram;
+    zplotProgram->bind();
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_context->shared->bufferObjects[kModelIndices]);
+    size_t offset, size;
+    m_context->bindVertexBuffer(pmx::Model::kVertexStride, offset, size);
+    zplotProgram->setPosition(reinterpret_cast<const GLvoid *>(offset), size);
+    const bool isVertexShaderSkinning = m_context->isVertexShaderSkinning;
+    if (isVertexShaderSkinning) {
+        m_context->bindVertexBuffer(pmx::Model::kBoneIndexStride, offset, size);
+        zplotProgram->setBoneIndices(reinterpret_cast<const GLvoid *>(offset), size, m_context->boneIndexType());
+        m_context->bindVertexBuffer(pmx::Model::kBoneWeightStride, offset, size);
+        zplotProgram->setBoneWeights(reinterpret_cast<const GLvoid *>(offset), size,
+                                     m_context->boneWeightType(), m_context->isNormalized());
+    }
     zplotProgram->setModelViewProjectionMatrix(matrix4x4);
-    glCullFace(GL_FRONT);
+    zplotProgram->setCullFace(GL_FRONT);
     const Array<pmx::Material *> &materials = m_modelRef->materials();
-    const size_t boneIndexOffset = m_modelRef->strideOffset(pmx::Model::kBoneIndexStride),
-            boneWeightOffset = m_modelRef->strideOffset(pmx::Model::kBoneWeightStride),
-            boneStride = m_modelRef->strideSize(pmx::Model::kVertexStride);
-    const int nmaterials = materials.count();
-    const bool isVertexShaderSkinning = m_context->isVertexShaderSkinning;
-    offset = 0; size = pmx::Model::strideSize(pmx::Model::kIndexStride);
-    for (int i = 0; i < nmaterials; i++) {
-        const pmx::Material *material = materials[i];
-        const int nindices = material->indices();
+    const pmx::DrawList &drawList = m_context->shared->drawList;
+    const int nbatches = drawList.countBatches();
+    size = m_modelRef->indexStrideSize();
+    for (int i = 0; i < nbatches; i++) {
+        const pmx::DrawList::Batch &batch = drawList.batchAt(i);
+        const int materialIndex = batch.materialIndex;
+        const pmx::Material *material = materials[materialIndex];
         if (material->isShadowMapDrawn()) {
             if (isVertexShaderSkinning) {
                 const pmx::Model::SkinningMeshes &mesh = m_context->mesh;
-                zplotProgram->setBoneIndices(reinterpret_cast<const GLvoid *>(boneIndexOffset), boneStride);
-                zplotProgram->setBoneWeights(reinterpret_cast<const GLvoid *>(boneWeightOffset), boneStride);
-                zplotProgram->setBoneMatrices(mesh.matrices[i], mesh.bones[i].size());
+                zplotProgram->setBoneMatrices(mesh.matrices[materialIndex], mesh.bones[materialIndex].size());
             }
-            glDrawElements(GL_TRIANGLES, nindices, GL_UNSIGNED_INT, reinterpret_cast<const GLvoid *>(offset));
+            offset = batch.indexOffset * size;
+            glDrawElements(GL_TRIANGLES, batch.nindices, m_context->shared->indexType, reinterpret_cast<const GLvoid *>(offset));
         }
-        offset += nindices * size;
     }
-    glCullFace(GL_BACK);
+    zplotProgram->setCullFace(GL_BACK);
     zplotProgram->unbind();
 }
 
@@ -976,6 +1157,170 @@ void PMXRenderEngine::setEffect(IEffect::ScriptOrderType /* type */, IEffect * /
     /* do nothing */
 }
 
+void PMXRenderEngine::setPackedVertexEnable(bool value)
+{
+    m_enablePackedVertex = value;
+}
+
+void PMXRenderEngine::setFrustumCullingEnable(bool value)
+{
+    m_enableFrustumCulling = value;
+}
+
+void PMXRenderEngine::setMaterialBatchingEnable(bool value)
+{
+    m_enableMaterialBatching = value;
+}
+
+void PMXRenderEngine::setIndexOptimizationEnable(bool value)
+{
+    m_enableIndexOptimization = value;
+}
+
+void PMXRenderEngine::setSharedEngine(const PMXRenderEngine *value)
+{
+    m_sharedEngineRef = value != this ? value : 0;
+}
+
+bool PMXRenderEngine::isResourceShared() const
+{
+    return m_context && m_context->shared && !m_context->shared->isUnique();
+}
+
+int PMXRenderEngine::countIssuedStateCalls() const
+{
+    if (!m_context)
+        return 0;
+    const BaseShaderProgram *programs[] = {
+        m_context->modelProgram, m_context->edgeProgram, m_context->shadowProgram, m_context->zplotProgram
+    };
+    int count = 0;
+    for (size_t i = 0; i < sizeof(programs) / sizeof(programs[0]); i++) {
+        if (programs[i])
+            count += programs[i]->stateCache().countIssuedCalls();
+    }
+    return count;
+}
+
+int PMXRenderEngine::countElidedStateCalls() const
+{
+    if (!m_context)
+        return 0;
+    const BaseShaderProgram *programs[] = {
+        m_context->modelProgram, m_context->edgeProgram, m_context->shadowProgram, m_context->zplotProgram
+    };
+    int count = 0;
+    for (size_t i = 0; i < sizeof(programs) / sizeof(programs[0]); i++) {
+        if (programs[i])
+            count += programs[i]->stateCache().countElidedCalls();
+    }
+    return count;
+}
+
+void PMXRenderEngine::resetStateCounters()
+{
+    if (!m_context)
+        return;
+    BaseShaderProgram *programs[] = {
+        m_context->modelProgram, m_context->edgeProgram, m_context->shadowProgram, m_context->zplotProgram
+    };
+    for (size_t i = 0; i < sizeof(programs) / sizeof(programs[0]); i++) {
+        if (programs[i])
+            programs[i]->resetStateCounters();
+    }
+}
+
+bool PMXRenderEngine::isCulled(const float *matrix) const
+{
+    return m_enableFrustumCulling && !m_modelRef->isInsideFrustum(matrix);
+}
+
+void PMXRenderEngine::uploadSkinnedVertices()
+{
+#ifdef VPVL2_ENABLE_OPENCL
+    /* update で開始した OpenCL のスキニングの完了を待ち、結果を頂点バッファに転送する (最初の描画時のみ) */
+    if (m_accelerator && m_accelerator->isAvailable()) {
+        if (const void *vertices = m_accelerator->waitForSkinnedVertices()) {
+            size_t size = pmx::Model::strideSize(pmx::Model::kVertexStride);
+            glBindBuffer(GL_ARRAY_BUFFER, m_context->vertexBufferObjects[kModelVertices]);
+            glBufferSubData(GL_ARRAY_BUFFER, 0, m_modelRef->vertices().count() * size, vertices);
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+            m_accelerator->releaseSkinnedVertices();
+        }
+    }
+#endif
+}
+
+bool PMXRenderEngine::uploadTextures(const IString *dir, void *context)
+{
+    const Array<pmx::Material *> &materials = m_modelRef->materials();
+    const int nmaterials = materials.count();
+    IRenderDelegate::Texture texture;
+    GLuint textureID = 0;
+    SharedContext *shared = m_context->shared;
+    MaterialTextures *materialPrivates = shared->materials = new MaterialTextures[nmaterials]();
+    shared->nmaterials = nmaterials;
+    texture.object = &textureID;
+    for (int i = 0; i < nmaterials; i++) {
+        const pmx::Material *material = materials[i];
+        MaterialTextures &materialPrivate = materialPrivates[i];
+        materialPrivate.mainTextureID = 0;
+        materialPrivate.sphereTextureID = 0;
+        materialPrivate.toonTextureID = 0;
+        materialPrivate.isMainTextureOpaque = false;
+        const IString *path = 0;
+        path = material->mainTexture();
+        if (path) {
+            texture.opaque = false;
+            if (m_delegateRef->uploadTexture(path, dir, IRenderDelegate::kTexture2D, texture, context)) {
+                materialPrivate.mainTextureID = textureID = *static_cast<const GLuint *>(texture.object);
+                materialPrivate.isMainTextureOpaque = texture.opaque;
+                log0(context, IRenderDelegate::kLogInfo, "Binding the texture as a main texture (ID=%d)", textureID);
+            }
+            else {
+                return false;
+            }
+        }
+        path = material->sphereTexture();
+        if (path) {
+            if (m_delegateRef->uploadTexture(path, dir, IRenderDelegate::kTexture2D, texture, context)) {
+                materialPrivate.sphereTextureID = textureID = *static_cast<const GLuint *>(texture.object);
+                log0(context, IRenderDelegate::kLogInfo, "Binding the texture as a sphere texture (ID=%d)", textureID);
+            }
+            else {
+                return false;
+            }
+        }
+        if (material->isSharedToonTextureUsed()) {
+            char buf[16];
+            snprintf(buf, sizeof(buf), "toon%02d.bmp", material->toonTextureIndex() + 1);
+            IString *s = m_delegateRef->toUnicode(reinterpret_cast<const uint8_t *>(buf));
+            bool ret = m_delegateRef->uploadTexture(s, 0, IRenderDelegate::kToonTexture, texture, context);
+            delete s;
+            if (ret) {
+                materialPrivate.toonTextureID = textureID = *static_cast<const GLuint *>(texture.object);
+                log0(context, IRenderDelegate::kLogInfo, "Binding the texture as a shared toon texture (ID=%d)", textureID);
+            }
+            else {
+                return false;
+            }
+        }
+        else {
+            path = material->toonTexture();
+            if (path) {
+                if (m_delegateRef->uploadTexture(path, dir, IRenderDelegate::kTexture2D, texture, context)) {
+                    materialPrivate.toonTextureID = textureID = *static_cast<const GLuint *>(texture.object);
+                    log0(context, IRenderDelegate::kLogInfo, "Binding the texture as a static toon texture (ID=%d)", textureID);
+                }
+                else {
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
 void PMXRenderEngine::log0(void *context, IRenderDelegate::LogLevel level, const char *format...)
 {
     va_list ap;
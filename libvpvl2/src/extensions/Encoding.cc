@@ -0,0 +1,220 @@
+/* ----------------------------------------------------------------- */
+/*                                                                   */
+/*  Copyright (c) 2010-2012  hkrn                                    */
+/*                                                                   */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/* - Redistributions of source code must retain the above copyright  */
+/*   notice, this list of conditions and the following disclaimer.   */
+/* - Redistributions in binary form must reproduce the above         */
+/*   copyright notice, this list of conditions and the following     */
+/*   disclaimer in the documentation and/or other materials provided */
+/*   with the distribution.                                          */
+/* - Neither the name of the MMDAI project team nor the names of     */
+/*   its contributors may be used to endorse or promote products     */
+/*   derived from this software without specific prior written       */
+/*   permission.                                                     */
+/*                                                                   */
+/* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND            */
+/* CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,       */
+/* INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF          */
+/* MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE          */
+/* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS */
+/* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,          */
+/* EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED   */
+/* TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,     */
+/* DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON */
+/* ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,   */
+/* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY    */
+/* OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE           */
+/* POSSIBILITY OF SUCH DAMAGE.                                       */
+/* ----------------------------------------------------------------- */
+
+#include "vpvl2/extensions/Encoding.h"
+#include "vpvl2/extensions/String.h"
+
+#if defined(VPVL2_HAS_ICU)
+#include <unicode/ucnv.h>
+#elif defined(VPVL2_HAS_ICONV)
+#include <errno.h>
+#include <iconv.h>
+#endif
+
+namespace
+{
+
+using namespace vpvl2;
+
+static const char *kUTF8CodecName = "UTF-8";
+
+static const char *GetCodecName(IString::Codec codec)
+{
+    switch (codec) {
+    case IString::kShiftJIS:
+        return "Shift_JIS";
+    case IString::kUTF8:
+        return kUTF8CodecName;
+    case IString::kUTF16:
+        return "UTF-16LE";
+    default:
+        return 0;
+    }
+}
+
+/*
+ * from から to の文字コードにバイト列を変換する。返り値は new[] で確保され、UTF-16 の場合も
+ * 考慮して 2 バイトの終端文字が付与される。PMD/VMD の名前は固定長で切り詰められて文字の途中で
+ * 終わることがあるため、変換できないバイト列は読み飛ばす。変換器を作成できない場合は 0 を返す
+ */
+static uint8_t *ConvertBytes(const char *to, const char *from, const uint8_t *value, size_t size, size_t &length)
+{
+    length = 0;
+    if (!to || !from)
+        return 0;
+    const char *source = reinterpret_cast<const char *>(value);
+    /* Shift_JIS から UTF-8 では最大で 3 倍、UTF-8 から UTF-16 では最大で 2 倍になる */
+    const size_t capacity = size * 4;
+#if defined(VPVL2_HAS_ICU)
+    UErrorCode status = U_ZERO_ERROR;
+    UConverter *targetConverter = ucnv_open(to, &status);
+    UConverter *sourceConverter = ucnv_open(from, &status);
+    ucnv_setToUCallBack(sourceConverter, UCNV_TO_U_CALLBACK_SKIP, 0, 0, 0, &status);
+    ucnv_setFromUCallBack(targetConverter, UCNV_FROM_U_CALLBACK_SKIP, 0, 0, 0, &status);
+    if (U_FAILURE(status)) {
+        ucnv_close(targetConverter);
+        ucnv_close(sourceConverter);
+        return 0;
+    }
+    uint8_t *data = new uint8_t[capacity + 2];
+    char *outbuf = reinterpret_cast<char *>(data);
+    const char *inbuf = source;
+    ucnv_convertEx(targetConverter, sourceConverter, &outbuf, outbuf + capacity, &inbuf, source + size,
+                   0, 0, 0, 0, true, true, &status);
+    ucnv_close(targetConverter);
+    ucnv_close(sourceConverter);
+    length = outbuf - reinterpret_cast<char *>(data);
+#elif defined(VPVL2_HAS_ICONV)
+    iconv_t cd = iconv_open(to, from);
+    if (cd == reinterpret_cast<iconv_t>(-1))
+        return 0;
+    size_t inbytesleft = size, outbytesleft = capacity;
+    uint8_t *data = new uint8_t[capacity + 2];
+    char *inbuf = const_cast<char *>(source), *outbuf = reinterpret_cast<char *>(data);
+    while (inbytesleft > 0) {
+        if (iconv(cd, &inbuf, &inbytesleft, &outbuf, &outbytesleft) != size_t(-1) || errno == E2BIG)
+            break;
+        /* EILSEQ (不正なバイト列) 及び EINVAL (途中で切れた文字) は 1 バイト読み飛ばして続ける */
+        inbuf++;
+        inbytesleft--;
+    }
+    iconv_close(cd);
+    length = capacity - outbytesleft;
+#else
+    (void) to;
+    (void) from;
+    uint8_t *data = new uint8_t[size + 2];
+    memcpy(data, source, size);
+    length = size;
+#endif
+    data[length] = 0;
+    data[length + 1] = 0;
+    return data;
+}
+
+}
+
+namespace vpvl2
+{
+namespace extensions
+{
+
+Encoding::Encoding()
+{
+}
+
+Encoding::~Encoding()
+{
+}
+
+const IString *Encoding::stringConstant(ConstantType value) const
+{
+    switch (value) {
+    case kLeft: {
+        static const String s("左");
+        return &s;
+    }
+    case kRight: {
+        static const String s("右");
+        return &s;
+    }
+    case kFinger: {
+        static const String s("指");
+        return &s;
+    }
+    case kElbow: {
+        static const String s("ひじ");
+        return &s;
+    }
+    case kArm: {
+        static const String s("腕");
+        return &s;
+    }
+    case kWrist: {
+        static const String s("手首");
+        return &s;
+    }
+    case kCenter: {
+        static const String s("センター");
+        return &s;
+    }
+    default: {
+        static const String s("");
+        return &s;
+    }
+    }
+}
+
+IString *Encoding::toString(const uint8_t *value, size_t size, IString::Codec codec) const
+{
+    if (!value || size == 0)
+        return new String("");
+    size_t length = 0;
+    uint8_t *bytes = ConvertBytes(kUTF8CodecName, GetCodecName(codec), value, size, length);
+    /* 変換できなかった場合も呼び出し側が名前を持たないものとして扱えるように空の文字列を返す */
+    IString *s = bytes ? new String(bytes, length) : new String("");
+    delete[] bytes;
+    return s;
+}
+
+IString *Encoding::toString(const uint8_t *value, IString::Codec codec, size_t maxlen) const
+{
+    size_t size = 0;
+    while (value && size < maxlen && value[size] != 0)
+        size++;
+    return toString(value, size, codec);
+}
+
+uint8_t *Encoding::toByteArray(const IString *value, IString::Codec codec) const
+{
+    if (value && value->length() > 0) {
+        size_t length = 0;
+        uint8_t *bytes = ConvertBytes(GetCodecName(codec), kUTF8CodecName, value->toByteArray(), value->length(), length);
+        if (bytes)
+            return bytes;
+    }
+    uint8_t *s = new uint8_t[1];
+    s[0] = 0;
+    return s;
+}
+
+void Encoding::disposeByteArray(uint8_t *value) const
+{
+    delete[] value;
+}
+
+}
+}
@@ -0,0 +1,122 @@
+/* ----------------------------------------------------------------- */
+/*                                                                   */
+/*  Copyright (c) 2010-2012  hkrn                                    */
+/*                                                                   */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/* - Redistributions of source code must retain the above copyright  */
+/*   notice, this list of conditions and the following disclaimer.   */
+/* - Redistributions in binary form must reproduce the above         */
+/*   copyright notice, this list of conditions and the following     */
+/*   disclaimer in the documentation and/or other materials provided */
+/*   with the distribution.                                          */
+/* - Neither the name of the MMDAI project team nor the names of     */
+/*   its contributors may be used to endorse or promote products     */
+/*   derived from this software without specific prior written       */
+/*   permission.                                                     */
+/*                                                                   */
+/* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND            */
+/* CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,       */
+/* INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF          */
+/* MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE          */
+/* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS */
+/* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,          */
+/* EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED   */
+/* TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,     */
+/* DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON */
+/* ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,   */
+/* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY    */
+/* OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE           */
+/* POSSIBILITY OF SUCH DAMAGE.                                       */
+/* ----------------------------------------------------------------- */
+
+#include "vpvl2/extensions/String.h"
+
+namespace vpvl2
+{
+namespace extensions
+{
+
+String::String(const char *value)
+    : m_bytes(0),
+      m_size(value ? strlen(value) : 0)
+{
+    m_bytes = new uint8_t[m_size + 1];
+    if (m_size > 0)
+        memcpy(m_bytes, value, m_size);
+    m_bytes[m_size] = 0;
+}
+
+String::String(const uint8_t *value, size_t size)
+    : m_bytes(0),
+      m_size(value ? size : 0)
+{
+    m_bytes = new uint8_t[m_size + 1];
+    if (m_size > 0)
+        memcpy(m_bytes, value, m_size);
+    m_bytes[m_size] = 0;
+}
+
+String::~String()
+{
+    delete[] m_bytes;
+    m_bytes = 0;
+    m_size = 0;
+}
+
+bool String::startsWith(const IString *value) const
+{
+    const String *s = static_cast<const String *>(value);
+    return m_size >= s->m_size && memcmp(m_bytes, s->m_bytes, s->m_size) == 0;
+}
+
+bool String::contains(const IString *value) const
+{
+    const String *s = static_cast<const String *>(value);
+    if (s->m_size == 0)
+        return true;
+    for (size_t i = 0; i + s->m_size <= m_size; i++) {
+        if (memcmp(m_bytes + i, s->m_bytes, s->m_size) == 0)
+            return true;
+    }
+    return false;
+}
+
+bool String::endsWith(const IString *value) const
+{
+    const String *s = static_cast<const String *>(value);
+    return m_size >= s->m_size && memcmp(m_bytes + m_size - s->m_size, s->m_bytes, s->m_size) == 0;
+}
+
+IString *String::clone() const
+{
+    return new String(m_bytes, m_size);
+}
+
+const HashString String::toHashString() const
+{
+    return HashString(reinterpret_cast<const char *>(m_bytes));
+}
+
+bool String::equals(const IString *value) const
+{
+    const String *s = static_cast<const String *>(value);
+    return m_size == s->m_size && memcmp(m_bytes, s->m_bytes, m_size) == 0;
+}
+
+const uint8_t *String::toByteArray() const
+{
+    return m_bytes;
+}
+
+size_t String::length() const
+{
+    return m_size;
+}
+
+}
+}
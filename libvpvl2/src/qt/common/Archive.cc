@@ -46,7 +46,10 @@ namespace qt
 Archive::Archive()
     : m_file(0),
       m_error(kNone),
-      m_codec(0)
+      m_codec(0),
+      m_cacheSize(0),
+      m_maxCacheSize(0),
+      m_lazy(false)
 {
     m_codec = QTextCodec::codecForName("Shift-JIS");
 }
@@ -61,6 +64,16 @@ void Archive::setTextCodec(QTextCodec *value)
     m_codec = value;
 }
 
+void Archive::setLazyUncompress(bool value)
+{
+    m_lazy = value;
+}
+
+void Archive::setMaxCacheSize(qint64 value)
+{
+    m_maxCacheSize = value;
+}
+
 bool Archive::open(const QString &filename, QStringList &entries)
 {
     m_file = unzOpen64(filename.toLocal8Bit().constData());
@@ -70,13 +83,26 @@ bool Archive::open(const QString &filename, QStringList &entries)
         int err = unzGetGlobalInfo64(m_file, &m_header);
         if (err == UNZ_OK) {
             int nentries = m_header.number_entry;
+            m_index.reserve(nentries);
             for (int i = 0; i < nentries; i++) {
                 err = unzGetCurrentFileInfo64(m_file, &info, 0, 0, 0, 0, 0, 0);
                 if (err == UNZ_OK && (info.compression_method == 0 || info.compression_method == Z_DEFLATED)) {
                     filename.resize(info.size_filename);
                     err = unzGetCurrentFileInfo64(m_file, 0, filename.data(), info.size_filename, 0, 0, 0, 0);
                     if (err == UNZ_OK) {
-                        entries.append(QTextCodec::codecForName("Shift_JIS")->toUnicode(filename));
+                        /* 後で展開する際に中央ディレクトリを再走査しなくて済むように位置を記録しておく */
+                        const QString &name = m_codec->toUnicode(filename);
+                        Entry entry;
+                        err = unzGetFilePos64(m_file, &entry.position);
+                        if (err != UNZ_OK) {
+                            m_error = kGetCurrentFileError;
+                            break;
+                        }
+                        entry.method = info.compression_method;
+                        entry.compressedSize = info.compressed_size;
+                        entry.uncompressedSize = info.uncompressed_size;
+                        m_index.insert(name, entry);
+                        entries.append(name);
                     }
                     else {
                         m_error = kGetCurrentFileError;
@@ -108,88 +134,77 @@ bool Archive::open(const QString &filename, QStringList &entries)
 
 bool Archive::close()
 {
-    return unzClose(m_file) == Z_OK;
+    QMutexLocker locker(&m_lock); Q_UNUSED(locker)
+    bool ret = unzClose(m_file) == Z_OK;
+    m_file = 0;
+    m_index.clear();
+    m_requested.clear();
+    m_entries.clear();
+    m_recentlyUsed.clear();
+    m_cacheSize = 0;
+    return ret;
 }
 
 bool Archive::uncompress(const QStringList &entries)
 {
     if (m_file == 0)
         return false;
-    unz_file_info64 info;
-    QByteArray filename, data;
-    int nentries = m_header.number_entry, err = Z_OK;
-    for (int i = 0; i < nentries; i++) {
-        err = unzGetCurrentFileInfo64(m_file, &info, 0, 0, 0, 0, 0, 0);
-        if (err == UNZ_OK && (info.compression_method == 0 || info.compression_method == Z_DEFLATED)) {
-            filename.resize(info.size_filename);
-            err = unzGetCurrentFileInfo64(m_file, 0, filename.data(), info.size_filename, 0, 0, 0, 0);
-            if (err == UNZ_OK) {
-                const QString &name = QTextCodec::codecForName("Shift_JIS")->toUnicode(filename);
-                if (entries.contains(name)) {
-                    data.resize(info.uncompressed_size);
-                    err = unzOpenCurrentFile(m_file);
-                    if (err != Z_OK) {
-                        m_error = kOpenCurrentFileError;
-                        break;
-                    }
-                    err = unzReadCurrentFile(m_file, data.data(), info.uncompressed_size);
-                    if (err < 0) {
-                        m_error = kReadCurrentFileError;
-                        break;
-                    }
-                    err = unzCloseCurrentFile(m_file);
-                    if (err != Z_OK) {
-                        m_error = kCloseCurrentFileError;
-                        break;
-                    }
-                    m_entries.insert(name, data);
-                }
-            }
-            else {
-                m_error = kGetCurrentFileError;
-                break;
-            }
-        }
-        else {
-            m_error = kGetCurrentFileError;
-            break;
-        }
-        if (i + 1 < nentries) {
-            err = unzGoToNextFile(m_file);
-            if (err != UNZ_OK) {
-                m_error = kGoToNextFileError;
-                break;
-            }
-        }
+    QMutexLocker locker(&m_lock); Q_UNUSED(locker)
+    QList<InflateTask> tasks;
+    foreach (const QString &name, entries) {
+        if (!m_index.contains(name))
+            continue;
+        m_requested.insert(name, name);
+        if (m_lazy || m_entries.contains(name))
+            continue;
+        /* I/O は unzFile が共有できないため直列で行い、展開だけを並列に行う */
+        InflateTask task;
+        task.name = name;
+        task.entry = m_index.value(name);
+        task.ok = false;
+        if (!readRaw(task.entry, task.compressed))
+            return false;
+        tasks.append(task);
     }
-    if (err == Z_OK) {
-        err = unzGoToFirstFile(m_file);
-        if (err != Z_OK)
-            m_error = kGoToFirstFileError;
+    QtConcurrent::blockingMap(tasks, &Archive::inflateAsync);
+    foreach (const InflateTask &task, tasks) {
+        if (!task.ok) {
+            m_error = kInflateError;
+            return false;
+        }
+        addCache(task.name, task.uncompressed);
     }
-    return err == Z_OK;
+    return true;
 }
 
 void Archive::replaceFilePath(const QString &from, const QString &to)
 {
+    QMutexLocker locker(&m_lock); Q_UNUSED(locker)
+    QHash<QString, QString> newRequested;
     QHash<QString, QByteArray> newEntries;
-    QHashIterator<QString, QByteArray> it(m_entries);
+    QList<QString> newRecentlyUsed;
+    QHashIterator<QString, QString> it(m_requested);
     const QRegExp regexp("^" + from + "/");
     while (it.hasNext()) {
         it.next();
         QString key = it.key();
-        const QByteArray &bytes = it.value();
+        const QString &name = it.value();
         /* 一致した場合はパスを置換するが、ディレクトリ名が入っていないケースで一致しない場合はパスを追加 */
         if (regexp.indexIn(key) != -1) {
             key.replace(regexp, to);
-            newEntries.insert(key, bytes);
         }
         else {
             key = to + key;
-            newEntries.insert(key, bytes);
+        }
+        newRequested.insert(key, name);
+        if (m_entries.contains(it.key())) {
+            newEntries.insert(key, m_entries.value(it.key()));
+            newRecentlyUsed.append(key);
         }
     }
+    m_requested = newRequested;
     m_entries = newEntries;
+    m_recentlyUsed = newRecentlyUsed;
 }
 
 Archive::ErrorType Archive::error() const
@@ -199,12 +214,114 @@ Archive::ErrorType Archive::error() const
 
 const QStringList Archive::entryNames() const
 {
-    return m_entries.keys();
+    QMutexLocker locker(&m_lock); Q_UNUSED(locker)
+    return m_requested.keys();
 }
 
 const QByteArray Archive::data(const QString &name) const
 {
-    return m_entries[name];
+    QMutexLocker locker(&m_lock); Q_UNUSED(locker)
+    if (m_entries.contains(name)) {
+        m_recentlyUsed.removeOne(name);
+        m_recentlyUsed.append(name);
+        return m_entries.value(name);
+    }
+    /* 遅延展開あるいはキャッシュから追い出されたエントリはここで展開する */
+    if (m_file && m_requested.contains(name)) {
+        const Entry &entry = m_index.value(m_requested.value(name));
+        QByteArray compressed, bytes;
+        if (readRaw(entry, compressed)) {
+            if (inflateRaw(compressed, entry, bytes)) {
+                addCache(name, bytes);
+                return bytes;
+            }
+            m_error = kInflateError;
+        }
+    }
+    return QByteArray();
+}
+
+qint64 Archive::cacheSize() const
+{
+    QMutexLocker locker(&m_lock); Q_UNUSED(locker)
+    return m_cacheSize;
+}
+
+void Archive::inflateAsync(InflateTask &task)
+{
+    task.ok = inflateRaw(task.compressed, task.entry, task.uncompressed);
+    task.compressed.clear();
+}
+
+bool Archive::inflateRaw(const QByteArray &compressed, const Entry &entry, QByteArray &uncompressed)
+{
+    if (entry.method == 0) {
+        uncompressed = compressed;
+        return true;
+    }
+    uncompressed.resize(entry.uncompressedSize);
+    if (entry.uncompressedSize == 0)
+        return true;
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    /* ZIP 内の Deflate ストリームはヘッダを持たないため負の windowBits を渡す */
+    if (inflateInit2(&stream, -MAX_WBITS) != Z_OK)
+        return false;
+    stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(compressed.constData()));
+    stream.avail_in = compressed.size();
+    stream.next_out = reinterpret_cast<Bytef *>(uncompressed.data());
+    stream.avail_out = uncompressed.size();
+    int err = inflate(&stream, Z_FINISH);
+    inflateEnd(&stream);
+    return err == Z_STREAM_END && stream.total_out == entry.uncompressedSize;
+}
+
+bool Archive::readRaw(const Entry &entry, QByteArray &compressed) const
+{
+    int err = unzGoToFilePos64(m_file, &entry.position);
+    if (err != UNZ_OK) {
+        m_error = kGoToFilePosError;
+        return false;
+    }
+    int method = 0, level = 0;
+    err = unzOpenCurrentFile2(m_file, &method, &level, 1);
+    if (err != UNZ_OK) {
+        m_error = kOpenCurrentFileError;
+        return false;
+    }
+    compressed.resize(entry.compressedSize);
+    if (entry.compressedSize > 0) {
+        err = unzReadCurrentFile(m_file, compressed.data(), entry.compressedSize);
+        if (err < 0) {
+            unzCloseCurrentFile(m_file);
+            m_error = kReadCurrentFileError;
+            return false;
+        }
+    }
+    err = unzCloseCurrentFile(m_file);
+    if (err != UNZ_OK) {
+        m_error = kCloseCurrentFileError;
+        return false;
+    }
+    return true;
+}
+
+void Archive::addCache(const QString &name, const QByteArray &bytes) const
+{
+    if (m_entries.contains(name))
+        m_cacheSize -= m_entries.value(name).size();
+    m_entries.insert(name, bytes);
+    m_recentlyUsed.removeOne(name);
+    m_recentlyUsed.append(name);
+    m_cacheSize += bytes.size();
+    /* 上限を超えた場合は最も参照されていないエントリから追い出す (追い出したエントリは data で再展開される) */
+    if (m_maxCacheSize > 0) {
+        while (m_cacheSize > m_maxCacheSize && m_recentlyUsed.size() > 1) {
+            const QString &key = m_recentlyUsed.takeFirst();
+            m_cacheSize -= m_entries.value(key).size();
+            m_entries.remove(key);
+        }
+    }
 }
 
 }
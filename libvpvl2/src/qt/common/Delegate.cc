@@ -38,6 +38,7 @@
 #include "vpvl2/qt/CString.h"
 #include "vpvl2/qt/DDSTexture.h"
 #include "vpvl2/qt/Delegate.h"
+#include "vpvl2/qt/TextureDiskCache.h"
 #include "vpvl2/qt/Util.h"
 
 #include <vpvl2/vpvl2.h>
@@ -149,6 +150,53 @@ QImage Delegate::loadImageAsync(const QString &path)
     }
 }
 
+QImage Delegate::decodeImageAsync(const QString &path, QByteArray bytes)
+{
+    const bool isFile = bytes.isNull() && !path.startsWith(":");
+    if (bytes.isNull()) {
+        QFile file(path);
+        if (!file.open(QFile::ReadOnly)) {
+            qWarning("Cannot open file %s: %s", qPrintable(path), qPrintable(file.errorString()));
+            return QImage();
+        }
+        bytes = file.readAll();
+    }
+    /* 別のモデルが同じ内容のテクスチャを持っている場合はデコードを省略する */
+    const QByteArray &key = QCryptographicHash::hash(bytes, QCryptographicHash::Md5);
+    QImage image;
+    {
+        QMutexLocker locker(&m_decodedImagesLock); Q_UNUSED(locker)
+        if (const QImage *cached = m_decodedImages.object(key))
+            image = *cached;
+    }
+    if (!image.isNull()) {
+        if (m_textureDiskCache && isFile)
+            m_textureDiskCache->store(path, key, image);
+        return image;
+    }
+    const QString &suffix = QFileInfo(path).suffix().toLower();
+    const char *format = (suffix == "sph" || suffix == "spa") ? "bmp" : 0;
+    if (image.loadFromData(bytes, format)) {
+        /* GL_RGBA のバイト順に一度だけ変換する (rgbSwapped と convertToGLFormat の二重コピーを避ける) */
+        image = image.convertToFormat(QImage::Format_ARGB32).rgbSwapped();
+    }
+    else if (suffix == "tga" && bytes.length() > 18) {
+        /* loadTGA は既に RGBA の並びで展開するため、dataPtr が解放される前に複製するだけでよい */
+        ByteArrayPtr ptr;
+        image = loadTGA(bytes, ptr).copy();
+    }
+    if (image.isNull()) {
+        qWarning("Loading texture %s cannot decode, ignored.", qPrintable(path));
+        return image;
+    }
+    /* ミップマップの生成も含めてワーカースレッドで行う */
+    if (m_textureDiskCache && isFile)
+        m_textureDiskCache->store(path, key, image);
+    QMutexLocker locker(&m_decodedImagesLock); Q_UNUSED(locker)
+    m_decodedImages.insert(key, new QImage(image), image.byteCount());
+    return image;
+}
+
 QImage Delegate::loadTGA(const QString &path, QScopedArrayPointer<uint8_t> &dataPtr)
 {
     QFile file(path);
@@ -250,15 +298,27 @@ Delegate::Delegate(const QHash<QString, QString> &settings, Scene *scene, QGLWid
       m_scene(scene),
       m_context(context),
       m_archive(0),
-      m_msaaSamples(0)
+      m_textureDiskCache(0),
+      m_msaaSamples(0),
+      m_enableAsyncTexture(m_settings.value("enable.async.texture", "false") == "true")
 {
     for (int i = 0; i < 4; i++)
         m_previousFrameBufferPtrs.insert(i, 0);
+    /* デコード済みのテクスチャはバイト数をコストとして保持する */
+    m_decodedImages.setMaxCost(m_settings.value("texture.cache.size", "67108864").toInt());
+    const QString &textureCacheDir = m_settings.value("dir.cache.texture");
+    if (!textureCacheDir.isEmpty())
+        m_textureDiskCache = new TextureDiskCache(QDir(textureCacheDir));
     m_timer.start();
 }
 
 Delegate::~Delegate()
 {
+    foreach (const PendingTexture &pending, m_pendingTextures)
+        pending.future.waitForFinished();
+    m_pendingTextures.clear();
+    delete m_textureDiskCache;
+    m_textureDiskCache = 0;
     setScenePtr(0);
     qDeleteAll(m_renderTargets);
     m_renderTargets.clear();
@@ -363,6 +423,52 @@ void Delegate::uploadAnimatedTexture(float offset, float speed, float seek, void
 }
 
 void Delegate::getMatrix(float value[], const IModel *model, int flags) const
+{
+    /*
+     * カメラとライトの行列が更新されるまで (model, flags) の組で結果を再利用する。
+     * モデルの位置や親ボーンなどが変わった場合に備えて行列の元になった状態も比較する
+     */
+    Scalar state[MatrixCache::kStateSize];
+    getMatrixCacheState(model, m_scene ? m_scene->light() : 0, state);
+    const MatrixCacheKey key(model, flags);
+    QHash<MatrixCacheKey, MatrixCache>::iterator it = m_matrixCache.find(key);
+    if (it == m_matrixCache.end() || memcmp(it.value().state, state, sizeof(state)) != 0) {
+        MatrixCache cache;
+        getMatrixInternal(cache.value, model, flags);
+        memcpy(cache.state, state, sizeof(state));
+        it = m_matrixCache.insert(key, cache);
+    }
+    memcpy(value, it.value().value, sizeof(it.value().value));
+}
+
+void Delegate::getMatrices(float *values, const IModel *model, const int *flags, int nflags) const
+{
+    for (int i = 0; i < nflags; i++)
+        getMatrix(values + i * 16, model, flags[i]);
+}
+
+void Delegate::getMatrixCacheState(const IModel *model, const ILight *light, Scalar *state)
+{
+    memset(state, 0, sizeof(Scalar) * MatrixCache::kStateSize);
+    if (model) {
+        const Vector3 &position = model->position();
+        const Quaternion &rotation = model->rotation();
+        for (int i = 0; i < 3; i++)
+            state[i] = position[i];
+        for (int i = 0; i < 4; i++)
+            state[i + 3] = rotation[i];
+        state[7] = model->scaleFactor();
+        if (const IBone *bone = model->parentBone())
+            bone->worldTransform().getOpenGLMatrix(&state[8]);
+    }
+    if (light) {
+        const Vector3 &direction = light->direction();
+        for (int i = 0; i < 3; i++)
+            state[i + 24] = direction[i];
+    }
+}
+
+void Delegate::getMatrixInternal(float value[], const IModel *model, int flags) const
 {
     QMatrix4x4 m;
     if (flags & IRenderDelegate::kShadowMatrix) {
@@ -605,6 +711,36 @@ IString *Delegate::toUnicode(const uint8_t *value) const
     return new(std::nothrow) CString(s);
 }
 
+int Delegate::uploadPendingTextures(qint64 budget)
+{
+    qint64 uploaded = 0;
+    QMutableListIterator<PendingTexture> it(m_pendingTextures);
+    while (it.hasNext()) {
+        const PendingTexture &pending = it.next();
+        if (!pending.future.isFinished())
+            continue;
+        const QImage &image = pending.future.result();
+        /* 転送前にモデルが削除されてテクスチャも破棄されている場合は何もしない */
+        if (!image.isNull() && glIsTexture(pending.textureID)) {
+            uploadDecodedImage(pending.textureID, image, pending.mipmap);
+            uploaded += image.byteCount();
+            qDebug("Uploaded a texture asynchronously (ID=%d, width=%d, height=%d): \"%s\"",
+                   pending.textureID, image.width(), image.height(), qPrintable(pending.path));
+        }
+        it.remove();
+        if (budget > 0 && uploaded >= budget)
+            break;
+    }
+    return m_pendingTextures.size();
+}
+
+void Delegate::waitForPendingTextures()
+{
+    foreach (const PendingTexture &pending, m_pendingTextures)
+        pending.future.waitForFinished();
+    uploadPendingTextures(0);
+}
+
 void Delegate::setArchive(Archive *value)
 {
     delete m_archive;
@@ -633,6 +769,7 @@ void Delegate::updateMatrices(const QSizeF &size)
     m_cameraProjectionMatrix.setToIdentity();
     m_cameraProjectionMatrix.perspective(camera->fov(), size.width() / size.height(), camera->znear(), camera->zfar());
     m_viewport = size;
+    invalidateMatrixCache();
 }
 
 void Delegate::getCameraMatrices(QMatrix4x4 &world, QMatrix4x4 &view, QMatrix4x4 &projection)
@@ -645,6 +782,7 @@ void Delegate::getCameraMatrices(QMatrix4x4 &world, QMatrix4x4 &view, QMatrix4x4
 void Delegate::setCameraModelMatrix(const QMatrix4x4 &value)
 {
     m_cameraModelMatrix = value;
+    invalidateMatrixCache();
 }
 
 void Delegate::getLightMatrices(QMatrix4x4 &world, QMatrix4x4 &view, QMatrix4x4 &projection)
@@ -659,6 +797,12 @@ void Delegate::setLightMatrices(const QMatrix4x4 &world, const QMatrix4x4 &view,
     m_lightWorldMatrix = world;
     m_lightViewMatrix = view;
     m_lightProjectionMatrix = projection;
+    invalidateMatrixCache();
+}
+
+void Delegate::invalidateMatrixCache()
+{
+    m_matrixCache.clear();
 }
 
 void Delegate::setMousePosition(const Vector3 &value, bool pressed, MousePositionType type)
@@ -753,6 +897,12 @@ void Delegate::setEffectOwner(const IEffect *effect, IModel *model)
 
 void Delegate::removeModel(IModel *model)
 {
+    QMutableHashIterator<MatrixCacheKey, MatrixCache> it0(m_matrixCache);
+    while (it0.hasNext()) {
+        it0.next();
+        if (it0.key().first == model)
+            it0.remove();
+    }
     QMutableHashIterator<const QString, IModel *> it(m_filename2Models);
     while (it.hasNext()) {
         it.next();
@@ -1107,6 +1257,7 @@ void Delegate::setTextureID(const TextureCache &cache, bool isToon, Texture &out
 {
     output.width = cache.width;
     output.height = cache.height;
+    output.opaque = cache.opaque;
     *const_cast<GLuint *>(static_cast<const GLuint *>(output.object)) = cache.id;
     if (!isToon) {
         GLuint textureID = *static_cast<const GLuint *>(output.object);
@@ -1121,6 +1272,64 @@ void Delegate::addTextureCache(PrivateContext *context, const QString &path, con
         context->textureCache.insert(path, texture);
 }
 
+bool Delegate::uploadTextureAsync(const QString &path, const QFileInfo &info, bool mipmap, Texture &texture, void *context)
+{
+    QByteArray bytes;
+    if (m_archive) {
+        bytes = m_archive->data(path);
+    }
+    else if (info.isDir()) {
+        return false;
+    }
+    else if (!info.exists()) {
+        qWarning("Cannot loading inexist \"%s\"", qPrintable(path));
+        return false;
+    }
+    GLuint textureID = 0;
+    size_t width = 0, height = 0;
+    bool opaque = false;
+    if (!m_archive && m_textureDiskCache && m_textureDiskCache->load(path, mipmap, textureID, width, height, opaque)) {
+        TextureCache cache(width, height, textureID);
+        cache.opaque = opaque;
+        m_texture2Paths.insert(textureID, path);
+        setTextureID(cache, false, texture);
+        addTextureCache(static_cast<PrivateContext *>(context), path, cache);
+        return true;
+    }
+    /* 先に 1x1 の白いテクスチャを割り当てておき、デコードが完了した時点で uploadPendingTextures で差し替える */
+    static const uint8_t kPlaceholderPixel[] = { 0xff, 0xff, 0xff, 0xff };
+    glGenTextures(1, &textureID);
+    glBindTexture(GL_TEXTURE_2D, textureID);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, kPlaceholderPixel);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    PendingTexture pending;
+    pending.future = QtConcurrent::run(this, &Delegate::decodeImageAsync, path, bytes);
+    pending.path = path;
+    pending.textureID = textureID;
+    pending.mipmap = mipmap;
+    m_pendingTextures.append(pending);
+    TextureCache cache(1, 1, textureID);
+    m_texture2Paths.insert(textureID, path);
+    setTextureID(cache, false, texture);
+    addTextureCache(static_cast<PrivateContext *>(context), path, cache);
+    return true;
+}
+
+void Delegate::uploadDecodedImage(GLuint textureID, const QImage &image, bool mipmap)
+{
+    /* decodeImageAsync で既に GL_RGBA のバイト順になっているため、そのまま転送する */
+    glBindTexture(GL_TEXTURE_2D, textureID);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, image.width(), image.height(), 0,
+                 GL_RGBA, GL_UNSIGNED_BYTE, image.constBits());
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, mipmap ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+    if (mipmap)
+        glGenerateMipmap(GL_TEXTURE_2D);
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
 bool Delegate::uploadTextureInternal(const QString &path,
                                      Texture &texture,
                                      bool isToon,
@@ -1137,6 +1346,13 @@ bool Delegate::uploadTextureInternal(const QString &path,
         ok = true;
         return true;
     }
+#ifndef VPVL2_LINK_DEVIL
+    /* トゥーンテクスチャはシステムのものに差し替える必要があるため、読み込みの成否が分かる同期読み込みにする */
+    if (m_enableAsyncTexture && texture.async && !isToon && !path.endsWith(".dds")) {
+        ok = uploadTextureAsync(path, info, mipmap, texture, context);
+        return true;
+    }
+#endif
     /*
      * ZIP 圧縮からの読み込み (ただしシステムが提供する toon テクスチャは除く)
      * Archive が持つ仮想ファイルシステム上にあるため、キャッシュより後、物理ファイル上より先に検索しないといけない
@@ -1166,6 +1382,8 @@ bool Delegate::uploadTextureInternal(const QString &path,
         GLuint textureID = ilutGLBindTexImage();
         size_t width = ilGetInteger(IL_IMAGE_WIDTH);
         size_t height = ilGetInteger(IL_IMAGE_HEIGHT);
+        /* DevIL 経由ではアルファの有無を調べないため、不透明とはみなさない */
+        const bool opaque = false;
         ilBindImage(0);
         ilDeleteImages(1, &imageID);
 #else
@@ -1185,8 +1403,10 @@ bool Delegate::uploadTextureInternal(const QString &path,
         }
         GLuint textureID = m_context->bindTexture(QGLWidget::convertToGLFormat(image), GL_TEXTURE_2D, GL_RGBA, textureBindOptions(mipmap));
         size_t width = image.width(), height = image.height();
+        const bool opaque = TextureDiskCache::isOpaqueImage(image);
 #endif
         TextureCache cache(width, height, textureID);
+        cache.opaque = opaque;
         m_texture2Paths.insert(textureID, path);
         setTextureID(cache, isToon, texture);
         addTextureCache(privateContext, path, cache);
@@ -1268,11 +1488,48 @@ bool Delegate::uploadTextureInternal(const QString &path,
             return true; /* skip */
         }
     }
+    else if (m_textureDiskCache && !path.startsWith(":")) {
+        /* キャッシュがない場合はデコードしてキャッシュに保存した後に改めてキャッシュから読み込む */
+        GLuint textureID = 0;
+        size_t width = 0, height = 0;
+        bool opaque = false;
+        bool loaded = m_textureDiskCache->load(path, mipmap, textureID, width, height, opaque);
+        if (!loaded) {
+            const QImage &image = decodeImageAsync(path, QByteArray());
+            if (!image.isNull())
+                loaded = m_textureDiskCache->load(path, mipmap, textureID, width, height, opaque);
+            /* キャッシュへの保存に失敗して読み込めない場合はデコードした画像をそのまま転送する */
+            if (!loaded && !image.isNull()) {
+                glGenTextures(1, &textureID);
+                uploadDecodedImage(textureID, image, mipmap);
+                width = image.width();
+                height = image.height();
+                opaque = TextureDiskCache::isOpaqueImage(image);
+                loaded = true;
+            }
+        }
+        if (loaded) {
+            TextureCache cache(width, height, textureID);
+            cache.opaque = opaque;
+            m_texture2Paths.insert(textureID, path);
+            setTextureID(cache, isToon, texture);
+            addTextureCache(privateContext, path, cache);
+            qDebug("Loaded a cached texture (ID=%d, width=%d, height=%d): \"%s\"",
+                   textureID, int(width), int(height), qPrintable(path));
+            ok = true;
+        }
+        else {
+            qWarning("Loading texture %s cannot decode, ignored.", qPrintable(path));
+            ok = false;
+        }
+        return true;
+    }
     else {
         const QFuture<QImage> &future = QtConcurrent::run(&Delegate::loadImageAsync, path);
         const QImage &image = future.result();
         GLuint textureID = m_context->bindTexture(image, GL_TEXTURE_2D, GL_RGBA, textureBindOptions(mipmap));
         TextureCache cache(image.width(), image.height(), textureID);
+        cache.opaque = TextureDiskCache::isOpaqueImage(image);
         m_texture2Paths.insert(textureID, path);
         setTextureID(cache, isToon, texture);
         addTextureCache(privateContext, path, cache);
@@ -0,0 +1,226 @@
+/* ----------------------------------------------------------------- */
+/*                                                                   */
+/*  Copyright (c) 2010-2012  hkrn                                    */
+/*                                                                   */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/* - Redistributions of source code must retain the above copyright  */
+/*   notice, this list of conditions and the following disclaimer.   */
+/* - Redistributions in binary form must reproduce the above         */
+/*   copyright notice, this list of conditions and the following     */
+/*   disclaimer in the documentation and/or other materials provided */
+/*   with the distribution.                                          */
+/* - Neither the name of the MMDAI project team nor the names of     */
+/*   its contributors may be used to endorse or promote products     */
+/*   derived from this software without specific prior written       */
+/*   permission.                                                     */
+/*                                                                   */
+/* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND            */
+/* CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,       */
+/* INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF          */
+/* MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE          */
+/* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS */
+/* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,          */
+/* EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED   */
+/* TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,     */
+/* DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON */
+/* ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,   */
+/* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY    */
+/* OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE           */
+/* POSSIBILITY OF SUCH DAMAGE.                                       */
+/* ----------------------------------------------------------------- */
+
+#include "vpvl2/qt/TextureDiskCache.h"
+
+#include <QtCore/QtCore>
+#include <cstddef>
+
+namespace
+{
+static const uint8_t kMagic[] = { 'V', 'T', 'C', ' ' };
+static const uint32_t kVersion = 2;
+static const uint32_t kFlagOpaque = 0x1;
+static const size_t kBytesPerPixel = 4;
+}
+
+namespace vpvl2
+{
+namespace qt
+{
+
+TextureDiskCache::TextureDiskCache(const QDir &dir)
+    : m_dir(dir)
+{
+    if (!m_dir.exists())
+        m_dir.mkpath(".");
+}
+
+TextureDiskCache::~TextureDiskCache()
+{
+}
+
+bool TextureDiskCache::load(const QString &path, bool mipmap, GLuint &textureID, size_t &width, size_t &height, bool &opaque) const
+{
+    QFile file(cacheFilePath(path));
+    if (!file.open(QFile::ReadOnly) || file.size() < qint64(sizeof(Header)))
+        return false;
+    uchar *ptr = file.map(0, file.size());
+    if (!ptr)
+        return false;
+    const Header &header = *reinterpret_cast<const Header *>(ptr);
+    const QFileInfo info(path);
+    const int64_t modified = info.lastModified().toMSecsSinceEpoch();
+    bool valid = memcmp(header.magic, kMagic, sizeof(kMagic)) == 0
+            && header.version == kVersion
+            && header.size == info.size()
+            && header.mipmapCount > 0;
+    bool touched = false;
+    /* 更新日時が異なる場合でも内容が同一であれば有効とする */
+    if (valid && header.modified != modified) {
+        QFile source(path);
+        valid = source.open(QFile::ReadOnly)
+                && QCryptographicHash::hash(source.readAll(), QCryptographicHash::Md5)
+                == QByteArray(reinterpret_cast<const char *>(header.hash), sizeof(header.hash));
+        touched = valid;
+    }
+    size_t total = sizeof(Header);
+    if (valid) {
+        for (uint32_t i = 0; i < header.mipmapCount; i++)
+            total += levelSize(header.width, header.height, i);
+        valid = qint64(total) <= file.size();
+    }
+    if (!valid) {
+        file.unmap(ptr);
+        return false;
+    }
+    const uint32_t nlevels = mipmap ? header.mipmapCount : 1;
+    const uint8_t *data = ptr + sizeof(Header);
+    glGenTextures(1, &textureID);
+    glBindTexture(GL_TEXTURE_2D, textureID);
+    for (uint32_t i = 0; i < nlevels; i++) {
+        const GLsizei w = btMax(header.width >> i, uint32_t(1)), h = btMax(header.height >> i, uint32_t(1));
+        glTexImage2D(GL_TEXTURE_2D, i, GL_RGBA, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
+        data += levelSize(header.width, header.height, i);
+    }
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, nlevels - 1);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, nlevels > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    width = header.width;
+    height = header.height;
+    opaque = (header.flags & kFlagOpaque) != 0;
+    file.unmap(ptr);
+    /* 次回以降に MD5 を計算し直さないようにキャッシュに記録された更新日時を書き換える */
+    if (touched) {
+        file.close();
+        if (file.open(QFile::ReadWrite) && file.seek(offsetof(Header, modified)))
+            file.write(reinterpret_cast<const char *>(&modified), sizeof(modified));
+    }
+    return true;
+}
+
+bool TextureDiskCache::store(const QString &path, const QByteArray &hash, const QImage &image) const
+{
+    const QFileInfo info(path);
+    if (image.isNull() || image.format() != QImage::Format_ARGB32 || !info.exists())
+        return false;
+    Header header;
+    memcpy(header.magic, kMagic, sizeof(header.magic));
+    header.version = kVersion;
+    header.width = image.width();
+    header.height = image.height();
+    header.mipmapCount = 1;
+    while ((header.width >> header.mipmapCount) > 0 || (header.height >> header.mipmapCount) > 0)
+        header.mipmapCount++;
+    header.flags = isOpaqueImage(image) ? kFlagOpaque : 0;
+    header.modified = info.lastModified().toMSecsSinceEpoch();
+    header.size = info.size();
+    memset(header.hash, 0, sizeof(header.hash));
+    memcpy(header.hash, hash.constData(), qMin(hash.size(), int(sizeof(header.hash))));
+    size_t total = 0;
+    for (uint32_t i = 0; i < header.mipmapCount; i++)
+        total += levelSize(header.width, header.height, i);
+    /* 全てのミップマップを連続した領域に並べる (QImage の行は 4 バイト境界のため詰め直す必要はない) */
+    QByteArray bytes(int(total), 0);
+    uint8_t *ptr = reinterpret_cast<uint8_t *>(bytes.data());
+    memcpy(ptr, image.constBits(), levelSize(header.width, header.height, 0));
+    for (uint32_t i = 1; i < header.mipmapCount; i++) {
+        const size_t size = levelSize(header.width, header.height, i - 1);
+        downsample(ptr, btMax(header.width >> (i - 1), uint32_t(1)), btMax(header.height >> (i - 1), uint32_t(1)), ptr + size);
+        ptr += size;
+    }
+    /* 書き込み途中のキャッシュを読まないように一時ファイルに書いてから置き換える */
+    const QString &filename = cacheFilePath(path);
+    QTemporaryFile temp(filename);
+    temp.setAutoRemove(false);
+    if (!temp.open())
+        return false;
+    bool ret = temp.write(reinterpret_cast<const char *>(&header), sizeof(header)) == sizeof(header)
+            && temp.write(bytes) == bytes.size();
+    temp.close();
+    if (ret) {
+        QFile::remove(filename);
+        ret = QFile::rename(temp.fileName(), filename);
+    }
+    if (!ret)
+        QFile::remove(temp.fileName());
+    return ret;
+}
+
+void TextureDiskCache::clear()
+{
+    foreach (const QString &filename, m_dir.entryList(QStringList() << "*.vtc", QDir::Files))
+        QFile::remove(m_dir.absoluteFilePath(filename));
+}
+
+bool TextureDiskCache::isOpaqueImage(const QImage &image)
+{
+    if (!image.hasAlphaChannel())
+        return true;
+    /* RGBA の並びに変換済みの画像でもアルファの位置は変わらないため qAlpha で判定できる */
+    const QImage &argb = image.format() == QImage::Format_ARGB32 ? image : image.convertToFormat(QImage::Format_ARGB32);
+    const int width = argb.width(), height = argb.height();
+    for (int y = 0; y < height; y++) {
+        const QRgb *line = reinterpret_cast<const QRgb *>(argb.constScanLine(y));
+        for (int x = 0; x < width; x++) {
+            if (qAlpha(line[x]) != 0xff)
+                return false;
+        }
+    }
+    return true;
+}
+
+size_t TextureDiskCache::levelSize(uint32_t width, uint32_t height, uint32_t level)
+{
+    return btMax(width >> level, uint32_t(1)) * btMax(height >> level, uint32_t(1)) * kBytesPerPixel;
+}
+
+void TextureDiskCache::downsample(const uint8_t *src, uint32_t width, uint32_t height, uint8_t *dst)
+{
+    const uint32_t w = btMax(width >> 1, uint32_t(1)), h = btMax(height >> 1, uint32_t(1));
+    for (uint32_t y = 0; y < h; y++) {
+        const uint32_t y0 = btMin(y * 2, height - 1), y1 = btMin(y * 2 + 1, height - 1);
+        for (uint32_t x = 0; x < w; x++) {
+            const uint32_t x0 = btMin(x * 2, width - 1), x1 = btMin(x * 2 + 1, width - 1);
+            const uint8_t *p00 = src + (y0 * width + x0) * kBytesPerPixel;
+            const uint8_t *p01 = src + (y0 * width + x1) * kBytesPerPixel;
+            const uint8_t *p10 = src + (y1 * width + x0) * kBytesPerPixel;
+            const uint8_t *p11 = src + (y1 * width + x1) * kBytesPerPixel;
+            for (size_t c = 0; c < kBytesPerPixel; c++)
+                *dst++ = uint8_t((p00[c] + p01[c] + p10[c] + p11[c] + 2) >> 2);
+        }
+    }
+}
+
+const QString TextureDiskCache::cacheFilePath(const QString &path) const
+{
+    const QByteArray &key = QCryptographicHash::hash(QFileInfo(path).absoluteFilePath().toUtf8(), QCryptographicHash::Md5);
+    return m_dir.absoluteFilePath(QString::fromAscii(key.toHex()) + ".vtc");
+}
+
+}
+}
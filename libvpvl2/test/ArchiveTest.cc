@@ -95,3 +95,35 @@ TEST(ArchiveTest, UncompressWithReplaceIfNotMatch)
     ASSERT_STREQ("foo\n", archive.data("/path/to/foo.txt").constData());
     ASSERT_STREQ("bar\n", archive.data("/path/to/bar.txt").constData());
 }
+
+TEST(ArchiveTest, UncompressLazily)
+{
+    Archive archive;
+    QStringList entries, extractEntries;
+    UncompressArchive(archive, entries);
+    archive.setLazyUncompress(true);
+    extractEntries << "foo.txt" << "path/to/entry.txt";
+    ASSERT_TRUE(archive.uncompress(extractEntries));
+    ASSERT_EQ(0, archive.cacheSize());
+    ASSERT_STREQ("foo\n", archive.data("foo.txt").constData());
+    ASSERT_EQ(4, archive.cacheSize());
+    ASSERT_TRUE(archive.data("bar.txt").isEmpty());
+    archive.replaceFilePath("path/to", "/PATH/TO/");
+    ASSERT_STREQ("entry.txt\n", archive.data("/PATH/TO/entry.txt").constData());
+}
+
+TEST(ArchiveTest, EvictLeastRecentlyUsedEntries)
+{
+    Archive archive;
+    QStringList entries, extractEntries;
+    UncompressArchive(archive, entries);
+    archive.setMaxCacheSize(8);
+    extractEntries << "foo.txt" << "bar.txt" << "baz.txt";
+    ASSERT_TRUE(archive.uncompress(extractEntries));
+    ASSERT_GE(8, archive.cacheSize());
+    /* evicted entries should be uncompressed again on demand */
+    ASSERT_STREQ("foo\n", archive.data("foo.txt").constData());
+    ASSERT_STREQ("bar\n", archive.data("bar.txt").constData());
+    ASSERT_STREQ("baz\n", archive.data("baz.txt").constData());
+    ASSERT_GE(8, archive.cacheSize());
+}
@@ -1,19 +1,28 @@
 #ifndef COMMON_H
 #define COMMON_H
 
+#ifndef VPVL2_TEST_NO_QT
 #include <QtCore/QtCore>
+#endif
 #include <gtest/gtest.h>
 #include <gmock/gmock.h>
 #include <tr1/tuple>
+#include <vector>
 #include <vpvl2/vpvl2.h>
 #include <vpvl2/internal/util.h>
+#include <vpvl2/extensions/Encoding.h>
+#include <vpvl2/extensions/String.h>
+#ifndef VPVL2_TEST_NO_QT
 #include <vpvl2/qt/CString.h>
 #include <vpvl2/qt/Encoding.h>
+#endif
 
 using namespace ::testing;
 using namespace std::tr1;
 using namespace vpvl2;
+#ifndef VPVL2_TEST_NO_QT
 using namespace vpvl2::qt;
+#endif
 
 namespace vpvl2 {
 
@@ -56,6 +65,15 @@ inline std::ostream& operator <<(std::ostream &os, const QuadWord &value)
 
 namespace {
 
+/* Qt を使う構成では従来通り Qt の実装で、使わない構成では extensions の実装でテストする */
+#ifdef VPVL2_TEST_NO_QT
+typedef vpvl2::extensions::Encoding TestEncoding;
+typedef vpvl2::extensions::String TestString;
+#else
+typedef vpvl2::qt::Encoding TestEncoding;
+typedef vpvl2::qt::CString TestString;
+#endif
+
 static const float kIdentity4x4[] = {
     1, 0, 0, 0,
     0, 1, 0, 0,
@@ -65,6 +83,70 @@ static const float kIdentity4x4[] = {
 
 static const float kEpsilon = 0.000001;
 
+/* Qt を使わないテストでも QScopedPointer と同じように所有権を扱うための最小限のスマートポインタ */
+template<typename T>
+class ScopedPointer
+{
+public:
+    explicit ScopedPointer(T *ptr = 0) : m_ptr(ptr) {}
+    ~ScopedPointer() { delete m_ptr; }
+
+    T *data() const { return m_ptr; }
+    T *take() {
+        T *ptr = m_ptr;
+        m_ptr = 0;
+        return ptr;
+    }
+    void reset(T *ptr = 0) {
+        if (ptr != m_ptr) {
+            delete m_ptr;
+            m_ptr = ptr;
+        }
+    }
+    T *operator->() const { return m_ptr; }
+    T &operator*() const { return *m_ptr; }
+
+private:
+    T *m_ptr;
+
+    VPVL2_DISABLE_COPY_AND_ASSIGN(ScopedPointer)
+};
+
+/* QDataStream を使わずにリトルエンディアンのバイト列を組み立てるための補助クラス */
+class ByteStream
+{
+public:
+    ByteStream() {}
+
+    void writeRawData(const char *data, size_t size) {
+        m_bytes.insert(m_bytes.end(), data, data + size);
+    }
+    ByteStream &operator<<(uint8_t value) {
+        m_bytes.push_back(value);
+        return *this;
+    }
+    ByteStream &operator<<(uint16_t value) {
+        for (int i = 0; i < 2; i++)
+            m_bytes.push_back(uint8_t((value >> (i * 8)) & 0xff));
+        return *this;
+    }
+    ByteStream &operator<<(uint32_t value) {
+        for (int i = 0; i < 4; i++)
+            m_bytes.push_back(uint8_t((value >> (i * 8)) & 0xff));
+        return *this;
+    }
+    ByteStream &operator<<(float value) {
+        uint32_t bits;
+        vpvl2::internal::copyBytes(reinterpret_cast<uint8_t *>(&bits), reinterpret_cast<const uint8_t *>(&value), sizeof(bits));
+        return *this << bits;
+    }
+    const uint8_t *data() const { return &m_bytes[0]; }
+    size_t size() const { return m_bytes.size(); }
+
+private:
+    std::vector<uint8_t> m_bytes;
+};
+
 static inline AssertionResult testVector(const Vector3 &expected, const Vector3 &actual)
 {
     if (!btEqual(expected.x() - actual.x(), kEpsilon))
@@ -0,0 +1,143 @@
+#include "Common.h"
+
+#include "vpvl2/extensions/Encoding.h"
+#include "vpvl2/extensions/String.h"
+
+#define TO_STR_C(s) reinterpret_cast<const char *>(s)
+
+namespace {
+
+/* 東京特許許可局局長 */
+static const char kSourceInUTF8[] = "\xe6\x9d\xb1\xe4\xba\xac\xe7\x89\xb9\xe8\xa8\xb1\xe8\xa8\xb1\xe5\x8f\xaf"
+                                    "\xe5\xb1\x80\xe5\xb1\x80\xe9\x95\xb7";
+static const char kSourceInShiftJIS[] = "\x93\x8c\x8b\x9e\x93\xc1\x8b\x96\x8b\x96\x89\xc2\x8b\xc7\x8b\xc7\x92\xb7";
+
+class ExtensionsConvertTest : public TestWithParam<IString::Codec> {};
+
+}
+
+TEST(ExtensionsStringTest, Compare)
+{
+    extensions::String c("This is a test.");
+    extensions::String head("This"), middle(" is "), tail("test."), other("foo"), empty("");
+    ASSERT_TRUE(c.startsWith(&head));
+    ASSERT_FALSE(c.startsWith(&middle));
+    ASSERT_FALSE(c.startsWith(&tail));
+    ASSERT_TRUE(c.contains(&head));
+    ASSERT_TRUE(c.contains(&middle));
+    ASSERT_TRUE(c.contains(&tail));
+    ASSERT_FALSE(c.contains(&other));
+    ASSERT_TRUE(c.contains(&empty));
+    ASSERT_FALSE(c.endsWith(&head));
+    ASSERT_FALSE(c.endsWith(&middle));
+    ASSERT_TRUE(c.endsWith(&tail));
+    ASSERT_FALSE(head.startsWith(&c));
+    ASSERT_FALSE(head.contains(&c));
+    ASSERT_FALSE(head.endsWith(&c));
+}
+
+TEST(ExtensionsStringTest, Clone)
+{
+    extensions::String c("This is a test."), s("This is a test."), t("This is a test");
+    IString *c2 = c.clone();
+    ASSERT_TRUE(c2->equals(&s));
+    ASSERT_FALSE(c2->equals(&t));
+    ASSERT_TRUE(c2 != &s);
+    delete c2;
+}
+
+TEST(ExtensionsStringTest, ToHashString)
+{
+    Hash<HashString, int> hash;
+    const char key[] = "key";
+    int value = 42;
+    hash.insert(key, value);
+    extensions::String c("key");
+    const int *ptr = hash.find(c.toHashString());
+    ASSERT_TRUE(ptr);
+    ASSERT_EQ(42, *ptr);
+}
+
+TEST(ExtensionsStringTest, ToByteArrayAndLength)
+{
+    const char str[] = "This is a test.";
+    extensions::String c(str), s(reinterpret_cast<const uint8_t *>(str), 4);
+    ASSERT_STREQ(str, TO_STR_C(c.toByteArray()));
+    ASSERT_EQ(sizeof(str) - 1, c.length());
+    ASSERT_STREQ("This", TO_STR_C(s.toByteArray()));
+    ASSERT_EQ(size_t(4), s.length());
+    ASSERT_EQ(sizeof(kSourceInUTF8) - 1, extensions::String(kSourceInUTF8).length());
+}
+
+TEST_P(ExtensionsConvertTest, RoundTrip)
+{
+    extensions::Encoding encoding;
+    const IString::Codec codec = GetParam();
+    const extensions::String source(kSourceInUTF8);
+    uint8_t *bytes = encoding.toByteArray(&source, codec);
+    size_t size = codec == IString::kUTF16 ? (sizeof(kSourceInUTF8) - 1) / 3 * 2 : strlen(TO_STR_C(bytes));
+    IString *result = encoding.toString(bytes, size, codec);
+    ASSERT_TRUE(result);
+    ASSERT_TRUE(result->equals(&source));
+    ASSERT_STREQ(kSourceInUTF8, TO_STR_C(result->toByteArray()));
+    delete result;
+    encoding.disposeByteArray(bytes);
+}
+
+TEST(ExtensionsEncodingTest, ConvertShiftJIS)
+{
+    extensions::Encoding encoding;
+    const extensions::String source(kSourceInUTF8);
+    uint8_t *bytes = encoding.toByteArray(&source, IString::kShiftJIS);
+    ASSERT_STREQ(kSourceInShiftJIS, TO_STR_C(bytes));
+    encoding.disposeByteArray(bytes);
+    /* 固定長の名前の領域を想定し、終端文字がない場合でも maxlen までしか読まない */
+    IString *result = encoding.toString(reinterpret_cast<const uint8_t *>(kSourceInShiftJIS), IString::kShiftJIS, 4);
+    ASSERT_STREQ("\xe6\x9d\xb1\xe4\xba\xac", TO_STR_C(result->toByteArray()));
+    delete result;
+}
+
+TEST(ExtensionsEncodingTest, ConvertTruncatedShiftJIS)
+{
+    extensions::Encoding encoding;
+    /* 固定長の領域で文字の途中で切れた場合は、切れた文字のみが取り除かれる */
+    IString *result = encoding.toString(reinterpret_cast<const uint8_t *>(kSourceInShiftJIS), 5, IString::kShiftJIS);
+    ASSERT_TRUE(result);
+    ASSERT_STREQ("\xe6\x9d\xb1\xe4\xba\xac", TO_STR_C(result->toByteArray()));
+    delete result;
+    /* 不正なバイトを含む場合も変換できた部分を返す */
+    static const uint8_t kInvalid[] = { 0x93, 0x8c, 0xff, 0x8b, 0x9e };
+    result = encoding.toString(kInvalid, sizeof(kInvalid), IString::kShiftJIS);
+    ASSERT_TRUE(result);
+    ASSERT_STREQ("\xe6\x9d\xb1\xe4\xba\xac", TO_STR_C(result->toByteArray()));
+    delete result;
+}
+
+TEST(ExtensionsEncodingTest, StringConstant)
+{
+    extensions::Encoding encoding;
+    ASSERT_STREQ("左", TO_STR_C(encoding.stringConstant(IEncoding::kLeft)->toByteArray()));
+    ASSERT_STREQ("右", TO_STR_C(encoding.stringConstant(IEncoding::kRight)->toByteArray()));
+    ASSERT_STREQ("指", TO_STR_C(encoding.stringConstant(IEncoding::kFinger)->toByteArray()));
+    ASSERT_STREQ("ひじ", TO_STR_C(encoding.stringConstant(IEncoding::kElbow)->toByteArray()));
+    ASSERT_STREQ("腕", TO_STR_C(encoding.stringConstant(IEncoding::kArm)->toByteArray()));
+    ASSERT_STREQ("手首", TO_STR_C(encoding.stringConstant(IEncoding::kWrist)->toByteArray()));
+    ASSERT_STREQ("センター", TO_STR_C(encoding.stringConstant(IEncoding::kCenter)->toByteArray()));
+    ASSERT_STREQ("", TO_STR_C(encoding.stringConstant(static_cast<IEncoding::ConstantType>(-1))->toByteArray()));
+}
+
+TEST(ExtensionsEncodingTest, ConvertNull)
+{
+    extensions::Encoding encoding;
+    IString *s = encoding.toString(0, IString::kUTF8, 0);
+    ASSERT_TRUE(s);
+    ASSERT_EQ(size_t(0), s->length());
+    ASSERT_EQ(0, s->toByteArray()[0]);
+    delete s;
+    uint8_t *result = encoding.toByteArray(0, IString::kUTF8);
+    ASSERT_TRUE(result);
+    ASSERT_EQ(0, result[0]);
+    encoding.disposeByteArray(result);
+}
+
+INSTANTIATE_TEST_CASE_P(ExtensionsEncodingInstance, ExtensionsConvertTest, Values(IString::kShiftJIS, IString::kUTF8, IString::kUTF16));
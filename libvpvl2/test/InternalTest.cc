@@ -243,6 +243,22 @@ TEST(InternalTest, WriteNotNullString)
     ASSERT_EQ(0, qstrncmp(reinterpret_cast<const char *>(str.toByteArray()), reinterpret_cast<const char *>(ptr), length));
 }
 
+TEST(InternalTest, CopyString)
+{
+    const uint8_t source[] = "Hello";
+    uint8_t dest[8];
+    memset(dest, 0xff, sizeof(dest));
+    vpvl2::internal::copyString(dest, source, sizeof(dest));
+    ASSERT_STREQ("Hello", reinterpret_cast<const char *>(dest));
+    ASSERT_EQ(0, dest[sizeof(dest) - 1]);
+    vpvl2::internal::copyString(dest, source, 4);
+    ASSERT_EQ(0, memcmp("Hell", dest, 4));
+    ASSERT_EQ('o', dest[4]);
+    vpvl2::internal::copyString(dest, 0, sizeof(dest));
+    ASSERT_EQ(0, dest[0]);
+    ASSERT_EQ(0, dest[sizeof(dest) - 1]);
+}
+
 TEST(InternalTest, EstimateSize)
 {
     CString str("Hello World");
@@ -63,7 +63,7 @@ static void CompareCameraInterpolationMatrix(const QuadWord p[], const mvd::Came
 
 TEST(MVDMotionTest, ParseEmpty)
 {
-    Encoding encoding;
+    TestEncoding encoding;
     MockIModel model;
     mvd::Motion motion(&model, &encoding);
     mvd::Motion::DataInfo info;
@@ -72,6 +72,7 @@ TEST(MVDMotionTest, ParseEmpty)
     ASSERT_EQ(mvd::Motion::kInvalidHeaderError, motion.error());
 }
 
+#ifndef VPVL2_TEST_NO_QT
 TEST(MVDMotionTest, ParseModelMotion)
 {
     QFile file("motion.mvd");
@@ -110,11 +111,12 @@ TEST(MVDMotionTest, ParseCameraMotion)
         ASSERT_EQ(mvd::Motion::kNoError, motion.error());
     }
 }
+#endif
 
 TEST(MVDMotionTest, SaveBoneKeyframe)
 {
-    Encoding encoding;
-    CString str("This is test.");
+    TestEncoding encoding;
+    TestString str("This is test.");
     mvd::NameListSection nameList(&encoding);
     mvd::BoneKeyframe frame(&nameList), newFrame(&nameList);
     Vector3 pos(1, 2, 3);
@@ -135,9 +137,9 @@ TEST(MVDMotionTest, SaveBoneKeyframe)
     frame.setInterpolationParameter(mvd::BoneKeyframe::kZ, pz);
     frame.setInterpolationParameter(mvd::BoneKeyframe::kRotation, pr);
     // write a bone frame to data and read it
-    QScopedArrayPointer<uint8_t> ptr(new uint8_t[frame.estimateSize()]);
-    frame.write(ptr.data());
-    newFrame.read(ptr.data());
+    std::vector<uint8_t> ptr(frame.estimateSize());
+    frame.write(&ptr[0]);
+    newFrame.read(&ptr[0]);
     // compare read bone frame
     ASSERT_EQ(0, nameList.key(&str));
     ASSERT_EQ(frame.timeIndex(), newFrame.timeIndex());
@@ -146,7 +148,7 @@ TEST(MVDMotionTest, SaveBoneKeyframe)
     ASSERT_TRUE(testVector(rot, newFrame.rotation()));
     CompareBoneInterpolationMatrix(p, frame);
     // cloned bone frame shold be copied with deep
-    QScopedPointer<IBoneKeyframe> cloned(frame.clone());
+    ScopedPointer<IBoneKeyframe> cloned(frame.clone());
     // ASSERT_TRUE(cloned->name()->equals(frame.name()));
     ASSERT_EQ(frame.layerIndex(), cloned->layerIndex());
     ASSERT_EQ(frame.timeIndex(), cloned->timeIndex());
@@ -180,9 +182,9 @@ TEST(MVDMotionTest, SaveCameraKeyframe)
     frame.setInterpolationParameter(mvd::CameraKeyframe::kDistance, pd);
     frame.setInterpolationParameter(mvd::CameraKeyframe::kFov, pf);
     // write a camera frame to data and read it
-    QScopedArrayPointer<uint8_t> ptr(new uint8_t[frame.estimateSize()]);
-    frame.write(ptr.data());
-    newFrame.read(ptr.data());
+    std::vector<uint8_t> ptr(frame.estimateSize());
+    frame.write(&ptr[0]);
+    newFrame.read(&ptr[0]);
     ASSERT_EQ(frame.timeIndex(), newFrame.timeIndex());
     ASSERT_EQ(frame.layerIndex(), newFrame.layerIndex());
     ASSERT_TRUE(testVector(frame.position(), newFrame.position()));
@@ -195,7 +197,7 @@ TEST(MVDMotionTest, SaveCameraKeyframe)
     ASSERT_FLOAT_EQ(newFrame.fov(), frame.fov());
     CompareCameraInterpolationMatrix(p, frame);
     // cloned camera frame shold be copied with deep
-    QScopedPointer<ICameraKeyframe> cloned(frame.clone());
+    ScopedPointer<ICameraKeyframe> cloned(frame.clone());
     ASSERT_EQ(frame.timeIndex(), cloned->timeIndex());
     ASSERT_EQ(frame.layerIndex(), cloned->layerIndex());
     ASSERT_TRUE(testVector(frame.position(), cloned->position()));
@@ -210,8 +212,8 @@ TEST(MVDMotionTest, SaveCameraKeyframe)
 
 TEST(MVDMotionTest, SaveMorphKeyframe)
 {
-    Encoding encoding;
-    CString str("This is a test.");
+    TestEncoding encoding;
+    TestString str("This is a test.");
     mvd::NameListSection nameList(&encoding);
     mvd::MorphKeyframe frame(&nameList), newFrame(&nameList);
     // initialize the morph frame to be copied
@@ -219,15 +221,15 @@ TEST(MVDMotionTest, SaveMorphKeyframe)
     frame.setTimeIndex(42);
     frame.setWeight(0.5);
     // write a morph frame to data and read it
-    QScopedArrayPointer<uint8_t> ptr(new uint8_t[frame.estimateSize()]);
-    frame.write(ptr.data());
-    newFrame.read(ptr.data());
+    std::vector<uint8_t> ptr(frame.estimateSize());
+    frame.write(&ptr[0]);
+    newFrame.read(&ptr[0]);
     // compare read morph frame
     ASSERT_EQ(0, nameList.key(&str));
     ASSERT_EQ(frame.timeIndex(), newFrame.timeIndex());
     ASSERT_EQ(frame.weight(), newFrame.weight());
     // cloned morph frame shold be copied with deep
-    QScopedPointer<IMorphKeyframe> cloned(frame.clone());
+    ScopedPointer<IMorphKeyframe> cloned(frame.clone());
     // ASSERT_TRUE(cloned->name()->equals(frame.name()));
     ASSERT_EQ(frame.timeIndex(), cloned->timeIndex());
     ASSERT_EQ(frame.weight(), cloned->weight());
@@ -251,13 +253,14 @@ TEST(MVDMotionTest, SaveLightKeyframe)
     ASSERT_TRUE(newFrame.color() == frame.color());
     ASSERT_TRUE(newFrame.direction() == frame.direction());
     // cloned morph frame shold be copied with deep
-    QScopedPointer<ILightKeyframe> cloned(frame.clone());
+    ScopedPointer<ILightKeyframe> cloned(frame.clone());
     ASSERT_EQ(frame.timeIndex(), cloned->timeIndex());
     ASSERT_TRUE(cloned->color() == frame.color());
     ASSERT_TRUE(cloned->direction() == frame.direction());
 }
 */
 
+#ifndef VPVL2_TEST_NO_QT
 ACTION_P(FindBone, bones)
 {
     MockIBone *bone = new MockIBone();
@@ -323,10 +326,11 @@ TEST(MVDMotionTest, SaveCameraMotion)
         ASSERT_EQ(motion.countKeyframes(IKeyframe::kCamera), motion2.countKeyframes(IKeyframe::kCamera));
     }
 }
+#endif
 
 TEST(MVDMotionTest, BoneInterpolation)
 {
-    Encoding encoding;
+    TestEncoding encoding;
     mvd::NameListSection nameList(&encoding);
     mvd::BoneKeyframe frame(&nameList);
     QuadWord n;
@@ -368,15 +372,15 @@ TEST(MVDMotionTest, CameraInterpolation)
 
 TEST(MVDMotionTest, AddAndRemoveBoneKeyframes)
 {
-    Encoding encoding;
-    CString name("bone");
+    TestEncoding encoding;
+    TestString name("bone");
     MockIModel model;
     MockIBone bone;
     mvd::Motion motion(&model, &encoding);
     ASSERT_EQ(0, motion.countKeyframes(IKeyframe::kBone));
     // mock bone
     EXPECT_CALL(model, findBone(_)).Times(AtLeast(1)).WillRepeatedly(Return(&bone));
-    QScopedPointer<IBoneKeyframe> keyframePtr(new mvd::BoneKeyframe(motion.nameListSection()));
+    ScopedPointer<IBoneKeyframe> keyframePtr(new mvd::BoneKeyframe(motion.nameListSection()));
     keyframePtr->setTimeIndex(42);
     keyframePtr->setName(&name);
     {
@@ -415,11 +419,11 @@ TEST(MVDMotionTest, AddAndRemoveBoneKeyframes)
 
 TEST(MVDMotionTest, AddAndRemoveCameraKeyframes)
 {
-    Encoding encoding;
+    TestEncoding encoding;
     Model model(&encoding);
     mvd::Motion motion(&model, &encoding);
     ASSERT_EQ(0, motion.countKeyframes(IKeyframe::kCamera));
-    QScopedPointer<ICameraKeyframe> keyframePtr(new mvd::CameraKeyframe());
+    ScopedPointer<ICameraKeyframe> keyframePtr(new mvd::CameraKeyframe());
     keyframePtr->setTimeIndex(42);
     keyframePtr->setDistance(42);
     {
@@ -459,11 +463,11 @@ TEST(MVDMotionTest, AddAndRemoveCameraKeyframes)
 /*
 TEST(MVDMotionTest, AddAndRemoveLightKeyframes)
 {
-    Encoding encoding;
+    TestEncoding encoding;
     Model model(&encoding);
     mvd::Motion motion(&model, &encoding);
     ASSERT_EQ(0, motion.countKeyframes(IKeyframe::kLight));
-    QScopedPointer<ILightKeyframe> frame(new mvd::LightKeyframe());
+    ScopedPointer<ILightKeyframe> frame(new mvd::LightKeyframe());
     frame->setTimeIndex(42);
     frame->setColor(Vector3(1, 0, 0));
     {
@@ -481,7 +485,7 @@ TEST(MVDMotionTest, AddAndRemoveLightKeyframes)
         // find a light keyframe with timeIndex
         ASSERT_EQ(frame.take(), motion.findLightKeyframe(42, 0));
     }
-    QScopedPointer<ILightKeyframe> frame2(new mvd::LightKeyframe());
+    ScopedPointer<ILightKeyframe> frame2(new mvd::LightKeyframe());
     frame2->setTimeIndex(42);
     frame2->setColor(Vector3(0, 0, 1));
     {
@@ -507,15 +511,15 @@ TEST(MVDMotionTest, AddAndRemoveLightKeyframes)
 
 TEST(MVDMotionTest, AddAndRemoveMorphKeyframes)
 {
-    Encoding encoding;
-    CString name("morph");
+    TestEncoding encoding;
+    TestString name("morph");
     MockIModel model;
     MockIMorph morph;
     mvd::Motion motion(&model, &encoding);
     ASSERT_EQ(0, motion.countKeyframes(IKeyframe::kMorph));
     // mock morph
     EXPECT_CALL(model, findMorph(_)).Times(AtLeast(1)).WillRepeatedly(Return(&morph));
-    QScopedPointer<IMorphKeyframe> keyframePtr(new mvd::MorphKeyframe(motion.nameListSection()));
+    ScopedPointer<IMorphKeyframe> keyframePtr(new mvd::MorphKeyframe(motion.nameListSection()));
     keyframePtr->setTimeIndex(42);
     keyframePtr->setName(&name);
     {
@@ -554,7 +558,7 @@ TEST(MVDMotionTest, AddAndRemoveMorphKeyframes)
 TEST(MVDMotionTest, AddAndRemoveNullKeyframe)
 {
     /* should happen nothing */
-    Encoding encoding;
+    TestEncoding encoding;
     MockIModel model;
     IKeyframe *nullKeyframe = 0;
     mvd::Motion motion(&model, &encoding);
@@ -1,22 +1,85 @@
 #include "Common.h"
 
+#include <algorithm>
+
 #include <btBulletDynamicsCommon.h>
 
-#include "vpvl2/pmd/Model.h"
 #include "vpvl2/pmx/Bone.h"
+#include "vpvl2/pmx/DrawList.h"
 #include "vpvl2/pmx/Joint.h"
 #include "vpvl2/pmx/Label.h"
 #include "vpvl2/pmx/Material.h"
+#include "vpvl2/pmx/MaterialParameterBuffer.h"
 #include "vpvl2/pmx/Model.h"
 #include "vpvl2/pmx/Morph.h"
 #include "vpvl2/pmx/RigidBody.h"
 #include "vpvl2/pmx/Vertex.h"
+#include "vpvl2/pmx/Writer.h"
+#include "mock/Model.h"
+#include "mock/Motion.h"
+
+#ifndef VPVL2_TEST_NO_QT
+#include "vpvl2/pmd/Model.h"
+#endif
 
 using namespace vpvl2::pmx;
 
 namespace
 {
 
+struct GetBonesAction {
+    GetBonesAction(IBone *value) : bone(value) {}
+    void operator()(Array<IBone *> &value) const { value.add(bone); }
+    IBone *bone;
+};
+
+struct GetMorphsAction {
+    GetMorphsAction(IMorph *value) : morph(value) {}
+    void operator()(Array<IMorph *> &value) const { value.add(morph); }
+    IMorph *morph;
+};
+
+struct SeekMotionAction {
+    SeekMotionAction(IBone *b, IMorph *m, const Vector3 &p, float w) : bone(b), morph(m), position(p), weight(w) {}
+    void operator()(const IKeyframe::TimeIndex & /* timeIndex */) const {
+        bone->setPosition(position);
+        morph->setWeight(weight);
+    }
+    IBone *bone;
+    IMorph *morph;
+    Vector3 position;
+    float weight;
+};
+
+struct SeekTimeIndexAction {
+    SeekTimeIndexAction(IBone *value) : bone(value) {}
+    void operator()(const IKeyframe::TimeIndex &timeIndex) const {
+        bone->setPosition(Vector3(Scalar(timeIndex), 0, 0));
+    }
+    IBone *bone;
+};
+
+struct PlayMotionAction {
+    PlayMotionAction(IBone *b, IKeyframe::TimeIndex *t) : bone(b), timeIndex(t) {}
+    void seek(const IKeyframe::TimeIndex &value) const {
+        *timeIndex = value;
+        bone->setPosition(Vector3(Scalar(value), 0, 0));
+    }
+    void advance(const IKeyframe::TimeIndex &delta) const {
+        seek(*timeIndex + delta);
+    }
+    IBone *bone;
+    IKeyframe::TimeIndex *timeIndex;
+};
+
+static void SetupBlendMotion(MockIMotion &motion, IBone *bone, IMorph *morph, const Vector3 &position, float weight)
+{
+    const SeekMotionAction action(bone, morph, position, weight);
+    EXPECT_CALL(motion, countKeyframes(_)).Times(AnyNumber()).WillRepeatedly(Return(0));
+    EXPECT_CALL(motion, seek(_)).Times(AnyNumber()).WillRepeatedly(Invoke(action));
+    EXPECT_CALL(motion, advance(_)).Times(AnyNumber()).WillRepeatedly(Invoke(action));
+}
+
 static void SetVertex(Vertex &vertex, Vertex::Type type, const Array<Bone *> &bones)
 {
     vertex.setOrigin(Vector3(0.01, 0.02, 0.03));
@@ -68,6 +131,93 @@ static void CompareVertex(const Vertex &expected, const Vertex &vertex2, const A
         ASSERT_FLOAT_EQ(vertex2.weight(0), 0.2f);
 }
 
+static void WriteGridText(ByteStream &stream, const char *value)
+{
+    const uint32_t length = uint32_t(strlen(value));
+    stream << length;
+    stream.writeRawData(value, length);
+}
+
+/*
+ * ncolumns x nrows の格子状の頂点を持つ PMX 2.0 (UTF-8) のモデルを組み立てる。
+ * 材質は1つ、ボーンはセンターとその子の2つで、全ての頂点が子のボーンに BDEF1 で従う。
+ * shuffle が真の場合は三角形の順番を固定の系列の乱数で並べ替える。
+ * テクスチャは全て同じパスで ntextures 個持ち、材質は最後のテクスチャと先頭のスフィアテクスチャを使う
+ */
+static void BuildGridModel(int ncolumns, int nrows, bool shuffle, int ntextures, ByteStream &stream)
+{
+    const uint32_t kNone = uint32_t(-1);
+    stream.writeRawData("PMX ", 4);
+    stream << 2.0f << uint8_t(8);
+    /* UTF-8, 追加 UV 無し, 各インデックスは 4 バイト */
+    stream << uint8_t(1) << uint8_t(0) << uint8_t(4) << uint8_t(4) << uint8_t(4) << uint8_t(4) << uint8_t(4) << uint8_t(4);
+    WriteGridText(stream, "grid");
+    WriteGridText(stream, "grid");
+    WriteGridText(stream, "");
+    WriteGridText(stream, "");
+    stream << uint32_t(ncolumns * nrows);
+    for (int row = 0; row < nrows; row++) {
+        for (int column = 0; column < ncolumns; column++) {
+            const float u = float(column) / (ncolumns - 1), v = float(row) / (nrows - 1);
+            stream << u - 0.5f << v - 0.5f << 0.0f;
+            stream << 0.0f << 0.0f << -1.0f;
+            stream << u << v;
+            stream << uint8_t(0) << uint32_t(1);
+            stream << 1.0f;
+        }
+    }
+    std::vector<uint32_t> triangles;
+    for (int row = 0; row < nrows - 1; row++) {
+        for (int column = 0; column < ncolumns - 1; column++) {
+            const uint32_t i = row * ncolumns + column;
+            const uint32_t quad[] = { i, i + 1, i + ncolumns, i + 1, i + ncolumns + 1, i + ncolumns };
+            triangles.insert(triangles.end(), quad, quad + 6);
+        }
+    }
+    const int ntriangles = int(triangles.size() / 3);
+    if (shuffle) {
+        uint32_t seed = 12345;
+        for (int i = ntriangles - 1; i > 0; i--) {
+            seed = seed * 1103515245 + 12345;
+            const int j = int((seed >> 8) % uint32_t(i + 1));
+            for (int k = 0; k < 3; k++)
+                std::swap(triangles[i * 3 + k], triangles[j * 3 + k]);
+        }
+    }
+    stream << uint32_t(triangles.size());
+    for (size_t i = 0; i < triangles.size(); i++)
+        stream << triangles[i];
+    /* textures */
+    stream << uint32_t(ntextures);
+    for (int i = 0; i < ntextures; i++)
+        WriteGridText(stream, "texture.png");
+    /* materials */
+    stream << uint32_t(1);
+    WriteGridText(stream, "material");
+    WriteGridText(stream, "material");
+    stream << 1.0f << 1.0f << 1.0f << 1.0f;
+    stream << 0.0f << 0.0f << 0.0f << 1.0f;
+    stream << 0.5f << 0.5f << 0.5f;
+    stream << uint8_t(0);
+    stream << 0.0f << 0.0f << 0.0f << 1.0f << 1.0f;
+    stream << (ntextures > 0 ? uint32_t(ntextures - 1) : kNone) << (ntextures > 1 ? uint32_t(0) : kNone) << uint8_t(0);
+    stream << uint8_t(1) << uint8_t(0);
+    WriteGridText(stream, "");
+    stream << uint32_t(triangles.size());
+    /* bones (回転、移動、表示及び操作が可能なボーン) */
+    stream << uint32_t(2);
+    WriteGridText(stream, "center");
+    WriteGridText(stream, "center");
+    stream << 0.0f << 0.0f << 0.0f << kNone << uint32_t(0) << uint16_t(0x1e);
+    stream << 0.0f << 1.0f << 0.0f;
+    WriteGridText(stream, "grid");
+    WriteGridText(stream, "grid");
+    stream << 0.0f << 0.0f << 0.0f << uint32_t(0) << uint32_t(0) << uint16_t(0x1e);
+    stream << 0.0f << 1.0f << 0.0f;
+    /* morphs, labels, rigid bodies and joints */
+    stream << uint32_t(0) << uint32_t(0) << uint32_t(0) << uint32_t(0);
+}
+
 class FragmentTest : public TestWithParam<size_t> {};
 
 class FragmentWithUVTest : public TestWithParam< tuple<size_t, pmx::Morph::Type > > {};
@@ -77,10 +227,10 @@ class FragmentWithUVTest : public TestWithParam< tuple<size_t, pmx::Morph::Type
 TEST_P(FragmentTest, ReadWriteBone)
 {
     size_t indexSize = GetParam();
-    Encoding encoding;
+    TestEncoding encoding;
     Bone bone, bone2, parent;
     Model::DataInfo info;
-    CString name("Japanese"), englishName("English");
+    TestString name("Japanese"), englishName("English");
     info.encoding = &encoding;
     info.codec = IString::kUTF8;
     info.boneIndexSize = indexSize;
@@ -111,9 +261,9 @@ TEST_P(FragmentTest, ReadWriteBone)
     bone.setTransformedByExternalParentEnable(true);
     // write constructed bone and read it
     size_t size = bone.estimateSize(info), read;
-    QScopedArrayPointer<uint8_t> data(new uint8_t[size]);
-    bone.write(data.data(), info);
-    bone2.read(data.data(), info, read);
+    std::vector<uint8_t> data(size);
+    bone.write(&data[0], info);
+    bone2.read(&data[0], info, read);
     // compare read bone
     ASSERT_EQ(size, read);
     ASSERT_TRUE(bone2.name()->equals(bone.name()));
@@ -148,11 +298,11 @@ TEST_P(FragmentTest, ReadWriteBone)
 TEST_P(FragmentTest, ReadWriteJoint)
 {
     size_t indexSize = GetParam();
-    Encoding encoding;
+    TestEncoding encoding;
     Joint joint, joint2;
     RigidBody body, body2;
     Model::DataInfo info;
-    CString name("Japanese"), englishName("English");
+    TestString name("Japanese"), englishName("English");
     info.encoding = &encoding;
     info.codec = IString::kUTF8;
     info.rigidBodyIndexSize = indexSize;
@@ -173,9 +323,9 @@ TEST_P(FragmentTest, ReadWriteJoint)
     joint.setRotationStiffness(Vector3(0.71, 0.72, 0.73));
     // write constructed joint and read it
     size_t size = joint.estimateSize(info), read;
-    QScopedArrayPointer<uint8_t> data(new uint8_t[size]);
-    joint.write(data.data(), info);
-    joint2.read(data.data(), info, read);
+    std::vector<uint8_t> data(size);
+    joint.write(&data[0], info);
+    joint2.read(&data[0], info, read);
     ASSERT_EQ(size, read);
     // compare read joint
     ASSERT_TRUE(joint2.name()->equals(joint.name()));
@@ -195,10 +345,10 @@ TEST_P(FragmentTest, ReadWriteJoint)
 TEST_P(FragmentTest, ReadWriteMaterial)
 {
     size_t indexSize = GetParam();
-    Encoding encoding;
+    TestEncoding encoding;
     Material material, material2;
     Model::DataInfo info;
-    CString name("Japanese"), englishName("English");
+    TestString name("Japanese"), englishName("English");
     info.encoding = &encoding;
     info.codec = IString::kUTF8;
     info.textureIndexSize = indexSize;
@@ -219,9 +369,9 @@ TEST_P(FragmentTest, ReadWriteMaterial)
     material.setFlags(5);
     // write contructed material and read it
     size_t size = material.estimateSize(info), read;
-    QScopedArrayPointer<uint8_t> data(new uint8_t[size]);
-    material.write(data.data(), info);
-    material2.read(data.data(), info, read);
+    std::vector<uint8_t> data(size);
+    material.write(&data[0], info);
+    material2.read(&data[0], info, read);
     // compare read material
     ASSERT_EQ(size, read);
     ASSERT_TRUE(material2.name()->equals(material.name()));
@@ -242,11 +392,11 @@ TEST_P(FragmentTest, ReadWriteMaterial)
 TEST_P(FragmentTest, ReadWriteBoneMorph)
 {
     size_t indexSize = GetParam();
-    Encoding encoding;
+    TestEncoding encoding;
     Morph morph, morph2;
-    QScopedPointer<Morph::Bone> bone1(new Morph::Bone()), bone2(new Morph::Bone());
+    ScopedPointer<Morph::Bone> bone1(new Morph::Bone()), bone2(new Morph::Bone());
     Model::DataInfo info;
-    CString name("Japanese"), englishName("English");
+    TestString name("Japanese"), englishName("English");
     info.boneIndexSize = indexSize;
     info.encoding = &encoding;
     info.codec = IString::kUTF8;
@@ -265,9 +415,9 @@ TEST_P(FragmentTest, ReadWriteBoneMorph)
     morph.setCategory(IMorph::kEyeblow);
     morph.setType(pmx::Morph::kBone);
     size_t size = morph.estimateSize(info), read;
-    QScopedArrayPointer<uint8_t> data(new uint8_t[size]);
-    morph.write(data.data(), info);
-    morph2.read(data.data(), info, read);
+    std::vector<uint8_t> data(size);
+    morph.write(&data[0], info);
+    morph2.read(&data[0], info, read);
     ASSERT_EQ(size, read);
     ASSERT_TRUE(morph2.name()->equals(morph.name()));
     ASSERT_TRUE(morph2.englishName()->equals(morph.englishName()));
@@ -289,11 +439,11 @@ TEST_P(FragmentTest, ReadWriteBoneMorph)
 TEST_P(FragmentTest, ReadWriteGroupMorph)
 {
     size_t indexSize = GetParam();
-    Encoding encoding;
+    TestEncoding encoding;
     Morph morph, morph2;
-    QScopedPointer<Morph::Group> group1(new Morph::Group()), group2(new Morph::Group());
+    ScopedPointer<Morph::Group> group1(new Morph::Group()), group2(new Morph::Group());
     Model::DataInfo info;
-    CString name("Japanese"), englishName("English");
+    TestString name("Japanese"), englishName("English");
     info.morphIndexSize = indexSize;
     info.encoding = &encoding;
     info.codec = IString::kUTF8;
@@ -310,9 +460,9 @@ TEST_P(FragmentTest, ReadWriteGroupMorph)
     morph.setCategory(IMorph::kEye);
     morph.setType(pmx::Morph::kGroup);
     size_t size = morph.estimateSize(info), read;
-    QScopedArrayPointer<uint8_t> data(new uint8_t[size]);
-    morph.write(data.data(), info);
-    morph2.read(data.data(), info, read);
+    std::vector<uint8_t> data(size);
+    morph.write(&data[0], info);
+    morph2.read(&data[0], info, read);
     ASSERT_EQ(size, read);
     ASSERT_TRUE(morph2.name()->equals(morph.name()));
     ASSERT_TRUE(morph2.englishName()->equals(morph.englishName()));
@@ -332,11 +482,11 @@ TEST_P(FragmentTest, ReadWriteGroupMorph)
 TEST_P(FragmentTest, ReadWriteMaterialMorph)
 {
     size_t indexSize = GetParam();
-    Encoding encoding;
+    TestEncoding encoding;
     Morph morph, morph2;
-    QScopedPointer<Morph::Material> material1(new Morph::Material()), material2(new Morph::Material());
+    ScopedPointer<Morph::Material> material1(new Morph::Material()), material2(new Morph::Material());
     Model::DataInfo info;
-    CString name("Japanese"), englishName("English");
+    TestString name("Japanese"), englishName("English");
     info.materialIndexSize = indexSize;
     info.encoding = &encoding;
     info.codec = IString::kUTF8;
@@ -371,9 +521,9 @@ TEST_P(FragmentTest, ReadWriteMaterialMorph)
     morph.setCategory(IMorph::kLip);
     morph.setType(pmx::Morph::kMaterial);
     size_t size = morph.estimateSize(info), read;
-    QScopedArrayPointer<uint8_t> data(new uint8_t[size]);
-    morph.write(data.data(), info);
-    morph2.read(data.data(), info, read);
+    std::vector<uint8_t> data(size);
+    morph.write(&data[0], info);
+    morph2.read(&data[0], info, read);
     ASSERT_EQ(size, read);
     ASSERT_TRUE(morph2.name()->equals(morph.name()));
     ASSERT_TRUE(morph2.englishName()->equals(morph.englishName()));
@@ -412,11 +562,11 @@ TEST_P(FragmentTest, ReadWriteMaterialMorph)
 TEST_P(FragmentTest, ReadWriteRigidBody)
 {
     size_t indexSize = GetParam();
-    Encoding encoding;
+    TestEncoding encoding;
     RigidBody body, body2;
     Bone bone;
     Model::DataInfo info;
-    CString name("Japanese"), englishName("English");
+    TestString name("Japanese"), englishName("English");
     info.encoding = &encoding;
     info.codec = IString::kUTF8;
     info.boneIndexSize = indexSize;
@@ -437,9 +587,9 @@ TEST_P(FragmentTest, ReadWriteRigidBody)
     body.setSize(Vector3(0.71, 0.72, 0.73));
     body.setType(5);
     size_t size = body.estimateSize(info), read;
-    QScopedArrayPointer<uint8_t> data(new uint8_t[size]);
-    body.write(data.data(), info);
-    body2.read(data.data(), info, read);
+    std::vector<uint8_t> data(size);
+    body.write(&data[0], info);
+    body2.read(&data[0], info, read);
     ASSERT_EQ(size, read);
     ASSERT_TRUE(body2.name()->equals(body.name()));
     ASSERT_TRUE(body2.englishName()->equals(body.englishName()));
@@ -460,11 +610,11 @@ TEST_P(FragmentTest, ReadWriteRigidBody)
 TEST_P(FragmentTest, ReadWriteVertexMorph)
 {
     size_t indexSize = GetParam();
-    Encoding encoding;
+    TestEncoding encoding;
     Morph morph, morph2;
-    QScopedPointer<Morph::Vertex> vertex1(new Morph::Vertex()), vertex2(new Morph::Vertex());
+    ScopedPointer<Morph::Vertex> vertex1(new Morph::Vertex()), vertex2(new Morph::Vertex());
     Model::DataInfo info;
-    CString name("Japanese"), englishName("English");
+    TestString name("Japanese"), englishName("English");
     info.vertexIndexSize = indexSize;
     info.encoding = &encoding;
     info.codec = IString::kUTF8;
@@ -481,9 +631,9 @@ TEST_P(FragmentTest, ReadWriteVertexMorph)
     morph.setCategory(IMorph::kOther);
     morph.setType(pmx::Morph::kVertex);
     size_t size = morph.estimateSize(info), read;
-    QScopedArrayPointer<uint8_t> data(new uint8_t[size]);
-    morph.write(data.data(), info);
-    morph2.read(data.data(), info, read);
+    std::vector<uint8_t> data(size);
+    morph.write(&data[0], info);
+    morph2.read(&data[0], info, read);
     ASSERT_EQ(size, read);
     ASSERT_TRUE(morph2.name()->equals(morph.name()));
     ASSERT_TRUE(morph2.englishName()->equals(morph.englishName()));
@@ -513,9 +663,9 @@ TEST_P(FragmentTest, ReadWriteVertexBdef1)
     info.additionalUVSize = indexSize;
     info.boneIndexSize = indexSize;
     size_t size = vertex.estimateSize(info), read;
-    QScopedArrayPointer<uint8_t> data(new uint8_t[size]);
-    vertex.write(data.data(), info);
-    vertex2.read(data.data(), info, read);
+    std::vector<uint8_t> data(size);
+    vertex.write(&data[0], info);
+    vertex2.read(&data[0], info, read);
     ASSERT_EQ(size, read);
     CompareVertex(vertex, vertex2, bones);
 }
@@ -535,9 +685,9 @@ TEST_P(FragmentTest, ReadWriteVertexBdef2)
     info.additionalUVSize = indexSize;
     info.boneIndexSize = indexSize;
     size_t size = vertex.estimateSize(info), read;
-    QScopedArrayPointer<uint8_t> data(new uint8_t[size]);
-    vertex.write(data.data(), info);
-    vertex2.read(data.data(), info, read);
+    std::vector<uint8_t> data(size);
+    vertex.write(&data[0], info);
+    vertex2.read(&data[0], info, read);
     ASSERT_EQ(size, read);
     CompareVertex(vertex, vertex2, bones);
 }
@@ -584,9 +734,9 @@ TEST_P(FragmentTest, ReadWriteVertexSdef)
     info.additionalUVSize = indexSize;
     info.boneIndexSize = indexSize;
     size_t size = vertex.estimateSize(info), read;
-    QScopedArrayPointer<uint8_t> data(new uint8_t[size]);
-    vertex.write(data.data(), info);
-    vertex2.read(data.data(), info, read);
+    std::vector<uint8_t> data(size);
+    vertex.write(&data[0], info);
+    vertex2.read(&data[0], info, read);
     ASSERT_EQ(size, read);
     CompareVertex(vertex, vertex2, bones);
 }
@@ -595,11 +745,11 @@ TEST_P(FragmentWithUVTest, ReadWriteUVMorph)
 {
     size_t indexSize = get<0>(GetParam());
     pmx::Morph::Type type = get<1>(GetParam());
-    Encoding encoding;
+    TestEncoding encoding;
     Morph morph, morph2;
-    QScopedPointer<Morph::UV> uv1(new Morph::UV()), uv2(new Morph::UV());
+    ScopedPointer<Morph::UV> uv1(new Morph::UV()), uv2(new Morph::UV());
     Model::DataInfo info;
-    CString name("Japanese"), englishName("English");
+    TestString name("Japanese"), englishName("English");
     info.vertexIndexSize = indexSize;
     info.encoding = &encoding;
     info.codec = IString::kUTF8;
@@ -616,9 +766,9 @@ TEST_P(FragmentWithUVTest, ReadWriteUVMorph)
     morph.setCategory(IMorph::kOther);
     morph.setType(type);
     size_t size = morph.estimateSize(info), read;
-    QScopedArrayPointer<uint8_t> data(new uint8_t[size]);
-    morph.write(data.data(), info);
-    morph2.read(data.data(), info, read);
+    std::vector<uint8_t> data(size);
+    morph.write(&data[0], info);
+    morph2.read(&data[0], info, read);
     ASSERT_EQ(size, read);
     ASSERT_TRUE(morph2.name()->equals(morph.name()));
     ASSERT_TRUE(morph2.englishName()->equals(morph.englishName()));
@@ -661,6 +811,261 @@ TEST(BoneTest, DefaultFlags)
     ASSERT_FALSE(bone.isTransformedByExternalParent());
 }
 
+TEST(PoseTest, SaveAndRestore)
+{
+    Bone bone1, bone2;
+    Morph morph1, morph2;
+    Array<IBone *> bones;
+    Array<IMorph *> morphs;
+    bones.add(&bone1);
+    bones.add(&bone2);
+    morphs.add(&morph1);
+    morphs.add(&morph2);
+    morph1.setType(IMorph::kVertex);
+    morph2.setType(IMorph::kVertex);
+    bone1.setPosition(Vector3(1, 2, 3));
+    bone2.setRotation(Quaternion(0.1, 0.2, 0.3, 0.4));
+    morph1.setWeight(0.5);
+    Pose pose;
+    pose.save(bones, morphs);
+    ASSERT_EQ(2, pose.countBones());
+    ASSERT_EQ(2, pose.countMorphs());
+    /* 変化がなければ何も書き込まない */
+    ASSERT_EQ(0, pose.restoreBones(bones));
+    ASSERT_FALSE(pose.hasChangedMorphs(morphs));
+    bone2.setPosition(Vector3(4, 5, 6));
+    morph2.setWeight(1.0);
+    /* 変化したボーンとモーフのみ数えられる */
+    ASSERT_EQ(1, pose.restoreBones(bones));
+    ASSERT_TRUE(pose.hasChangedMorphs(morphs));
+    ASSERT_EQ(1, pose.restoreMorphs(morphs));
+    ASSERT_TRUE(testVector(Vector3(1, 2, 3), bone1.position()));
+    ASSERT_TRUE(testVector(kZeroV3, bone2.position()));
+    ASSERT_TRUE(testVector(Quaternion(0.1, 0.2, 0.3, 0.4), bone2.rotation()));
+    ASSERT_FLOAT_EQ(0.5, morph1.weight());
+    ASSERT_FLOAT_EQ(0.0, morph2.weight());
+}
+
+TEST(PoseTest, RestoreGroupMorph)
+{
+    Vertex vertex;
+    Morph vertexMorph, groupMorph;
+    Morph::Vertex *v = new Morph::Vertex();
+    v->index = 0;
+    v->position.setValue(4, 8, 12);
+    vertexMorph.setType(IMorph::kVertex);
+    vertexMorph.addVertexMorph(v);
+    Morph::Group *group = new Morph::Group();
+    group->index = 0;
+    group->weight = 0.5;
+    groupMorph.setType(IMorph::kGroup);
+    groupMorph.addGroupMorph(group);
+    Array<Morph *> morphs;
+    morphs.add(&vertexMorph);
+    morphs.add(&groupMorph);
+    Array<Vertex *> vertices;
+    vertices.add(&vertex);
+    ASSERT_TRUE(Morph::loadMorphs(morphs, Array<Bone *>(), Array<Material *>(), vertices));
+    ASSERT_TRUE(vertexMorph.hasParent());
+    Array<IMorph *> imorphs;
+    imorphs.add(&vertexMorph);
+    imorphs.add(&groupMorph);
+    groupMorph.setWeight(1.0);
+    ASSERT_TRUE(testVector(Vector3(2, 4, 6), vertex.delta()));
+    Pose pose;
+    pose.save(Array<IBone *>(), imorphs);
+    vertex.reset();
+    groupMorph.setWeight(0);
+    vertex.reset();
+    /* 子のモーフはグループモーフ経由でのみ適用されるため、移動量は一度だけ加算される */
+    ASSERT_EQ(2, pose.restoreMorphs(imorphs));
+    ASSERT_FLOAT_EQ(1.0, groupMorph.weight());
+    ASSERT_FLOAT_EQ(0.5, vertexMorph.weight());
+    ASSERT_TRUE(testVector(Vector3(2, 4, 6), vertex.delta()));
+}
+
+TEST(PoseTest, CompactAndDiff)
+{
+    Bone bone1, bone2, bone3;
+    Morph morph1, morph2;
+    Array<IBone *> bones;
+    Array<IMorph *> morphs;
+    bones.add(&bone1);
+    bones.add(&bone2);
+    bones.add(&bone3);
+    morphs.add(&morph1);
+    morphs.add(&morph2);
+    morph1.setType(IMorph::kVertex);
+    morph2.setType(IMorph::kVertex);
+    Pose oldPose, newPose, delta;
+    oldPose.save(bones, morphs);
+    bone3.setPosition(Vector3(1, 2, 3));
+    morph1.setWeight(0.25);
+    newPose.save(bones, morphs);
+    /* 現在の状態と同じ要素は取り除かれる */
+    ASSERT_TRUE(oldPose.compact(bones, morphs));
+    ASSERT_EQ(1, oldPose.countBones());
+    ASSERT_EQ(1, oldPose.countMorphs());
+    ASSERT_LT(oldPose.estimateSize(), newPose.estimateSize());
+    /* 差分のみを適用しても元の状態に戻せる */
+    ASSERT_EQ(1, oldPose.restoreBones(bones));
+    ASSERT_EQ(1, oldPose.restoreMorphs(morphs));
+    ASSERT_TRUE(testVector(kZeroV3, bone3.position()));
+    ASSERT_FLOAT_EQ(0.0, morph1.weight());
+    newPose.diff(oldPose, delta);
+    ASSERT_EQ(1, delta.countBones());
+    ASSERT_EQ(1, delta.countMorphs());
+    ASSERT_EQ(1, delta.restoreBones(bones));
+    ASSERT_EQ(1, delta.restoreMorphs(morphs));
+    ASSERT_TRUE(testVector(Vector3(1, 2, 3), bone3.position()));
+    ASSERT_FLOAT_EQ(0.25, morph1.weight());
+    ASSERT_FALSE(newPose.compact(bones, morphs));
+    ASSERT_TRUE(newPose.isEmpty());
+}
+
+TEST(MotionBlenderTest, BlendLayers)
+{
+    Bone bone;
+    Vertex vertex;
+    Morph morph;
+    Morph::Vertex *v = new Morph::Vertex();
+    v->index = 0;
+    v->position.setValue(1, 2, 3);
+    morph.setType(IMorph::kVertex);
+    morph.addVertexMorph(v);
+    Array<Morph *> morphs;
+    morphs.add(&morph);
+    Array<Vertex *> vertices;
+    vertices.add(&vertex);
+    ASSERT_TRUE(Morph::loadMorphs(morphs, Array<Bone *>(), Array<Material *>(), vertices));
+    MockIModel model;
+    EXPECT_CALL(model, getBones(_)).Times(1).WillOnce(Invoke(GetBonesAction(&bone)));
+    EXPECT_CALL(model, getMorphs(_)).Times(1).WillOnce(Invoke(GetMorphsAction(&morph)));
+    EXPECT_CALL(model, resetVertices()).Times(AnyNumber()).WillRepeatedly(Invoke(&vertex, &Vertex::reset));
+    MockIMotion motion1, motion2;
+    SetupBlendMotion(motion1, &bone, &morph, Vector3(2, 0, 0), 0.2);
+    SetupBlendMotion(motion2, &bone, &morph, Vector3(0, 4, 0), 0.6);
+    MotionBlender blender(&model);
+    ASSERT_EQ(0, blender.addLayer(&motion1, MotionBlender::kOverrideBlend));
+    ASSERT_EQ(1, blender.addLayer(&motion2, MotionBlender::kOverrideBlend));
+    ASSERT_EQ(2, blender.countLayers());
+    /* キーフレームを持たないのでマスクが 0 となり初期状態のまま */
+    blender.seek(0);
+    ASSERT_TRUE(testVector(kZeroV3, bone.position()));
+    ASSERT_FLOAT_EQ(0.0, morph.weight());
+    ASSERT_TRUE(testVector(kZeroV3, vertex.delta()));
+    blender.setLayerBoneMask(0, &bone, 1);
+    blender.setLayerMorphMask(0, &morph, 1);
+    blender.setLayerBoneMask(1, &bone, 1);
+    blender.setLayerMorphMask(1, &morph, 1);
+    /* 上書き合成は重みで線形補間される */
+    blender.setLayerWeight(1, 0.5);
+    blender.seek(0);
+    ASSERT_TRUE(testVector(Vector3(1, 2, 0), bone.position()));
+    ASSERT_FLOAT_EQ(0.4, morph.weight());
+    /* 各レイヤーを取り出した際の移動量は取り除かれ、合成した重みの分だけが残る */
+    ASSERT_TRUE(testVector(Vector3(0.4, 0.8, 1.2), vertex.delta()));
+    /* 加算合成は下のレイヤーの結果に足し込まれる */
+    blender.setLayerBlendMode(1, MotionBlender::kAdditiveBlend);
+    blender.setLayerWeight(1, 1);
+    blender.seek(0);
+    ASSERT_TRUE(testVector(Vector3(2, 4, 0), bone.position()));
+    ASSERT_FLOAT_EQ(0.8, morph.weight());
+    ASSERT_TRUE(testVector(Vector3(0.8, 1.6, 2.4), vertex.delta()));
+    /* フェードは advance で進めた時間に応じて重みが変わる */
+    blender.fadeLayer(1, 0, 10);
+    blender.advance(5);
+    ASSERT_FLOAT_EQ(0.5, blender.layerWeight(1));
+    blender.advance(10);
+    ASSERT_FLOAT_EQ(0.0, blender.layerWeight(1));
+    ASSERT_TRUE(testVector(Vector3(2, 0, 0), bone.position()));
+    ASSERT_FLOAT_EQ(0.2, morph.weight());
+    blender.removeLayer(0);
+    ASSERT_EQ(1, blender.countLayers());
+    ASSERT_EQ(&motion2, blender.layerMotion(0));
+}
+
+TEST(PoseCacheTest, SeekAndEvict)
+{
+    Bone bone;
+    MockIModel model;
+    EXPECT_CALL(model, getBones(_)).Times(1).WillOnce(Invoke(GetBonesAction(&bone)));
+    EXPECT_CALL(model, getMorphs(_)).Times(1);
+    const IKeyframe::TimeIndex maxTimeIndex = 100;
+    MockIMotion motion;
+    EXPECT_CALL(motion, parentModel()).Times(AnyNumber()).WillRepeatedly(Return(&model));
+    EXPECT_CALL(motion, countKeyframes(_)).Times(AnyNumber()).WillRepeatedly(Return(1));
+    EXPECT_CALL(motion, maxTimeIndex()).Times(AnyNumber()).WillRepeatedly(ReturnRef(maxTimeIndex));
+    /* キャッシュに当たった場合はモーションを seek しない */
+    EXPECT_CALL(motion, seek(_)).Times(4).WillRepeatedly(Invoke(SeekTimeIndexAction(&bone)));
+    Array<IMotion *> motions;
+    motions.add(&motion);
+    PoseCache cache(&model);
+    ASSERT_FALSE(cache.seek(1, motions));
+    ASSERT_FALSE(cache.seek(2, motions));
+    ASSERT_EQ(2, cache.countEntries());
+    ASSERT_TRUE(cache.seek(1.0001, motions));
+    ASSERT_TRUE(testVector(Vector3(1, 0, 0), bone.position()));
+    ASSERT_EQ(1, cache.countHits());
+    ASSERT_EQ(2, cache.countMisses());
+    /* 最も長く使われていない 2 のみが追い出される */
+    cache.setCapacity(1);
+    ASSERT_EQ(1, cache.countEntries());
+    ASSERT_TRUE(cache.seek(1, motions));
+    ASSERT_FALSE(cache.seek(2, motions));
+    ASSERT_TRUE(testVector(Vector3(2, 0, 0), bone.position()));
+    /* モーションの組み合わせが変わると破棄される */
+    motions.clear();
+    ASSERT_FALSE(cache.seek(2, motions));
+    cache.setCapacity(0);
+    ASSERT_EQ(0, cache.countEntries());
+    motions.add(&motion);
+    ASSERT_FALSE(cache.seek(3, motions));
+    ASSERT_EQ(0, cache.countEntries());
+}
+
+TEST(PoseCacheTest, SynchronizeAfterHit)
+{
+    Bone bone;
+    MockIModel model;
+    EXPECT_CALL(model, getBones(_)).Times(1).WillOnce(Invoke(GetBonesAction(&bone)));
+    EXPECT_CALL(model, getMorphs(_)).Times(1);
+    const IKeyframe::TimeIndex maxTimeIndex = 100;
+    IKeyframe::TimeIndex currentTimeIndex = 0;
+    const PlayMotionAction action(&bone, &currentTimeIndex);
+    MockIMotion motion;
+    EXPECT_CALL(motion, parentModel()).Times(AnyNumber()).WillRepeatedly(Return(&model));
+    EXPECT_CALL(motion, countKeyframes(_)).Times(AnyNumber()).WillRepeatedly(Return(1));
+    EXPECT_CALL(motion, maxTimeIndex()).Times(AnyNumber()).WillRepeatedly(ReturnRef(maxTimeIndex));
+    EXPECT_CALL(motion, seek(_)).Times(AnyNumber()).WillRepeatedly(Invoke(&action, &PlayMotionAction::seek));
+    EXPECT_CALL(motion, advance(_)).Times(AnyNumber()).WillRepeatedly(Invoke(&action, &PlayMotionAction::advance));
+    Array<IMotion *> motions;
+    motions.add(&motion);
+    PoseCache cache(&model);
+    ASSERT_FALSE(cache.seek(1, motions));
+    ASSERT_FALSE(cache.seek(5, motions));
+    /* キャッシュに当たった場合は姿勢のみ書き戻され、モーションの時間は 5 のまま */
+    ASSERT_TRUE(cache.seek(1, motions));
+    ASSERT_TRUE(testVector(Vector3(1, 0, 0), bone.position()));
+    ASSERT_FLOAT_EQ(5, currentTimeIndex);
+    /* advance の前に同期すると当たった時間から進められる */
+    ASSERT_TRUE(cache.synchronize(motions));
+    ASSERT_FLOAT_EQ(1, currentTimeIndex);
+    motion.advance(2);
+    ASSERT_TRUE(testVector(Vector3(3, 0, 0), bone.position()));
+    ASSERT_FALSE(cache.synchronize(motions));
+    ASSERT_FLOAT_EQ(3, currentTimeIndex);
+    /* キャッシュに当たらなかった場合はモーションが seek されるため同期は不要 */
+    ASSERT_FALSE(cache.seek(7, motions));
+    ASSERT_FALSE(cache.synchronize(motions));
+    ASSERT_TRUE(cache.seek(5, motions));
+    ASSERT_TRUE(cache.synchronize(motions));
+    motion.advance(1);
+    ASSERT_TRUE(testVector(Vector3(6, 0, 0), bone.position()));
+    ASSERT_EQ(2, cache.countHits());
+    ASSERT_EQ(3, cache.countMisses());
+}
+
 TEST(VertexTest, Boundary)
 {
     Vertex vertex;
@@ -680,6 +1085,118 @@ TEST(VertexTest, Boundary)
     delete bone;
 }
 
+TEST(MorphTest, CompileVertices)
+{
+    static const int kIndices[] = { 2, 0, 2, 5 };
+    static const Vector3 kPositions[] = { Vector3(1, 2, 3), Vector3(4, 5, 6), Vector3(1, 1, 1), Vector3(9, 9, 9) };
+    Morph morph;
+    morph.setType(IMorph::kVertex);
+    for (int i = 0; i < 4; i++) {
+        Morph::Vertex *vertex = new Morph::Vertex();
+        vertex->index = kIndices[i];
+        vertex->position = kPositions[i];
+        morph.addVertexMorph(vertex);
+    }
+    Vector3 deltas[3];
+    for (int i = 0; i < 3; i++)
+        deltas[i].setZero();
+    /* 範囲外の頂点 (5) は除外され、重複する頂点 (2) は1つにまとめられる */
+    morph.compileVertices(deltas, 3);
+    ASSERT_EQ(2, morph.countCompiledVertices());
+    morph.setWeight(0.5);
+    ASSERT_TRUE(deltas[0] == Vector3(2, 2.5, 3));
+    ASSERT_TRUE(deltas[1] == kZeroV3);
+    ASSERT_TRUE(deltas[2] == Vector3(1, 1.5, 2));
+    morph.addVertexMorph(new Morph::Vertex());
+    ASSERT_EQ(0, morph.countCompiledVertices());
+}
+
+TEST(MorphTest, ReleaseCompiledVertices)
+{
+    static const int kIndices[] = { 2, 0, 1 };
+    TestEncoding encoding;
+    TestString name("vertex");
+    Model::DataInfo info;
+    info.vertexIndexSize = 4;
+    info.encoding = &encoding;
+    info.codec = IString::kUTF8;
+    Morph morph;
+    morph.setName(&name);
+    morph.setEnglishName(&name);
+    morph.setType(IMorph::kVertex);
+    for (int i = 0; i < 3; i++) {
+        Morph::Vertex *vertex = new Morph::Vertex();
+        vertex->index = kIndices[i];
+        vertex->position.setValue(i + 1, 0, 0);
+        morph.addVertexMorph(vertex);
+    }
+    const size_t size = morph.estimateSize(info);
+    std::vector<uint8_t> before(size), after(size);
+    morph.write(&before[0], info);
+    Vector3 deltas[3];
+    for (int i = 0; i < 3; i++)
+        deltas[i].setZero();
+    /* 重複の無い頂点モーフは変換後に Morph::Vertex を解放しても同じ内容を書き出す */
+    morph.compileVertices(deltas, 3);
+    ASSERT_EQ(3, morph.countCompiledVertices());
+    ASSERT_EQ(size, morph.estimateSize(info));
+    morph.write(&after[0], info);
+    ASSERT_EQ(before, after);
+    morph.setWeight(1);
+    ASSERT_TRUE(deltas[0] == Vector3(2, 0, 0));
+    ASSERT_TRUE(deltas[2] == Vector3(1, 0, 0));
+    /* vertices は元の順番で作り直し、変換後の適用方法はそのまま使う */
+    const Array<Morph::Vertex *> &vertices = morph.vertices();
+    ASSERT_EQ(3, vertices.count());
+    for (int i = 0; i < 3; i++) {
+        ASSERT_EQ(uint32_t(kIndices[i]), vertices[i]->index);
+        ASSERT_TRUE(vertices[i]->position == Vector3(i + 1, 0, 0));
+    }
+    ASSERT_EQ(3, morph.countCompiledVertices());
+}
+
+TEST(MorphTest, CompileGroups)
+{
+    Morph vertexMorph, inner, outer, cyclic1, cyclic2;
+    Morph::Vertex *vertex = new Morph::Vertex();
+    vertex->index = 0;
+    vertex->position.setValue(4, 8, 12);
+    vertexMorph.setType(IMorph::kVertex);
+    vertexMorph.addVertexMorph(vertex);
+    Vector3 deltas[1];
+    deltas[0].setZero();
+    vertexMorph.compileVertices(deltas, 1);
+    Morph *groups[] = { &inner, &outer, &cyclic1, &cyclic2 };
+    Morph *targets[] = { &vertexMorph, &inner, &cyclic2, &cyclic1 };
+    const float weights[] = { 0.5, 1.0, 1.0, 1.0 };
+    for (int i = 0; i < 4; i++) {
+        Morph::Group *group = new Morph::Group();
+        group->morph = targets[i];
+        group->weight = weights[i];
+        groups[i]->setType(IMorph::kGroup);
+        groups[i]->addGroupMorph(group);
+    }
+    Morph::Group *direct = new Morph::Group();
+    direct->morph = &vertexMorph;
+    direct->weight = 0.25;
+    outer.addGroupMorph(direct);
+    Array<Morph *> morphs;
+    morphs.add(&vertexMorph);
+    morphs.add(&outer);
+    morphs.add(&inner);
+    morphs.add(&cyclic1);
+    morphs.add(&cyclic2);
+    /* cyclic1 と cyclic2 は互いを参照しているため1つの参照が取り除かれる */
+    ASSERT_EQ(1, Morph::compileGroups(morphs));
+    /* inner を経由する経路と直接の経路は重みを合算した1つの組にまとめられる */
+    ASSERT_EQ(1, outer.countFlattenedMorphs());
+    ASSERT_EQ(0, cyclic1.countFlattenedMorphs() + cyclic2.countFlattenedMorphs());
+    outer.setWeight(1.0);
+    ASSERT_TRUE(deltas[0] == Vector3(3, 6, 9));
+    cyclic1.setWeight(1.0);
+    ASSERT_TRUE(deltas[0] == Vector3(3, 6, 9));
+}
+
 TEST(MaterialTest, MergeAmbientColor)
 {
     Material material;
@@ -1043,15 +1560,209 @@ TEST(MaterialTest, MergeEdgeSize)
     ASSERT_FLOAT_EQ(material.edgeSize(), 1.4f);
 }
 
+TEST(MaterialTest, CompileDrawList)
+{
+    TestString texture("texture.png");
+    const Color opaqueA(1, 0, 0, 1), opaqueB(0, 1, 0, 1);
+    Material materials[5];
+    const int nindices[] = { 6, 3, 3, 3, 3 };
+    Array<Material *> materialRefs;
+    Array<Morph *> morphRefs;
+    Array<IString *> textures;
+    Array<bool> opaqueTextures;
+    textures.add(&texture);
+    for (int i = 0; i < 5; i++) {
+        materials[i].setIndices(nindices[i]);
+        materials[i].setDiffuse(opaqueA);
+        materials[i].setMainTextureIndex(-1);
+        materials[i].setSphereTextureIndex(-1);
+        materials[i].setToonTextureIndex(-1);
+        materialRefs.add(&materials[i]);
+    }
+    /* material 1 is textured so it may be translucent, material 3 differs in diffuse */
+    materials[1].setMainTextureIndex(0);
+    materials[3].setDiffuse(opaqueB);
+    ASSERT_TRUE(Material::loadMaterials(materialRefs, textures, 18));
+    DrawList drawList;
+    drawList.compile(materialRefs, morphRefs, opaqueTextures, false);
+    ASSERT_EQ(5, drawList.countBatches());
+    ASSERT_FALSE(drawList.isReordered());
+    drawList.compile(materialRefs, morphRefs, opaqueTextures, true);
+    /* 0, 2 and 4 are merged, 3 follows and the textured material keeps its place at the end */
+    ASSERT_EQ(5, drawList.countMaterials());
+    ASSERT_EQ(3, drawList.countBatches());
+    ASSERT_TRUE(drawList.isReordered());
+    ASSERT_EQ(0, drawList.batchAt(0).materialIndex);
+    ASSERT_EQ(3, drawList.batchAt(0).nmaterials);
+    ASSERT_EQ(0, drawList.batchAt(0).indexOffset);
+    ASSERT_EQ(12, drawList.batchAt(0).nindices);
+    ASSERT_EQ(3, drawList.batchAt(1).materialIndex);
+    ASSERT_EQ(12, drawList.batchAt(1).indexOffset);
+    ASSERT_EQ(1, drawList.batchAt(2).materialIndex);
+    ASSERT_EQ(15, drawList.batchAt(2).indexOffset);
+    uint16_t source[18], dest[18];
+    for (int i = 0; i < 18; i++)
+        source[i] = uint16_t(i);
+    drawList.reorderIndices(reinterpret_cast<const uint8_t *>(source), reinterpret_cast<uint8_t *>(dest), sizeof(source[0]));
+    const uint16_t expected[] = { 0, 1, 2, 3, 4, 5, 9, 10, 11, 15, 16, 17, 12, 13, 14, 6, 7, 8 };
+    for (int i = 0; i < 18; i++)
+        ASSERT_EQ(expected[i], dest[i]);
+    /* a material morph targeting material 2 keeps it out of any batch */
+    Morph morph;
+    Morph::Material *morphMaterial = new Morph::Material();
+    morphMaterial->index = 2;
+    morph.setType(IMorph::kMaterial);
+    morph.addMaterialMorph(morphMaterial);
+    morphRefs.add(&morph);
+    drawList.compile(materialRefs, morphRefs, opaqueTextures, true);
+    ASSERT_EQ(4, drawList.countBatches());
+    ASSERT_EQ(2, drawList.batchAt(0).nmaterials);
+    ASSERT_EQ(2, drawList.batchAt(3).materialIndex);
+    ASSERT_EQ(1, drawList.batchAt(3).nmaterials);
+}
+
+TEST(MaterialTest, CompileDrawListWithOpaqueTextures)
+{
+    TestString textureA("textureA.png"), textureB("textureB.png");
+    const Color opaque(1, 0, 0, 1);
+    Material materials[5];
+    const int textureIndices[] = { 0, 1, 0, -1, 1 };
+    Array<Material *> materialRefs;
+    Array<Morph *> morphRefs;
+    Array<IString *> textures;
+    Array<bool> opaqueTextures;
+    textures.add(&textureA);
+    textures.add(&textureB);
+    for (int i = 0; i < 5; i++) {
+        materials[i].setIndices(3);
+        materials[i].setDiffuse(opaque);
+        materials[i].setMainTextureIndex(textureIndices[i]);
+        materials[i].setSphereTextureIndex(-1);
+        materials[i].setToonTextureIndex(-1);
+        materialRefs.add(&materials[i]);
+        opaqueTextures.add(textureIndices[i] >= 0);
+    }
+    ASSERT_TRUE(Material::loadMaterials(materialRefs, textures, 15));
+    DrawList drawList;
+    /* textured materials are sorted by texture and merged: (0, 2), (1, 4) and 3 */
+    drawList.compile(materialRefs, morphRefs, opaqueTextures, true);
+    ASSERT_EQ(5, drawList.countMaterials());
+    ASSERT_EQ(3, drawList.countBatches());
+    ASSERT_TRUE(drawList.isReordered());
+    ASSERT_EQ(0, drawList.batchAt(0).materialIndex);
+    ASSERT_EQ(2, drawList.batchAt(0).nmaterials);
+    ASSERT_EQ(1, drawList.batchAt(1).materialIndex);
+    ASSERT_EQ(2, drawList.batchAt(1).nmaterials);
+    ASSERT_EQ(6, drawList.batchAt(1).indexOffset);
+    ASSERT_EQ(3, drawList.batchAt(2).materialIndex);
+    ASSERT_EQ(12, drawList.batchAt(2).indexOffset);
+    uint16_t source[15], dest[15];
+    for (int i = 0; i < 15; i++)
+        source[i] = uint16_t(i);
+    drawList.reorderIndices(reinterpret_cast<const uint8_t *>(source), reinterpret_cast<uint8_t *>(dest), sizeof(source[0]));
+    const uint16_t expected[] = { 0, 1, 2, 6, 7, 8, 3, 4, 5, 12, 13, 14, 9, 10, 11 };
+    for (int i = 0; i < 15; i++)
+        ASSERT_EQ(expected[i], dest[i]);
+    /* a translucent model draws each material in the original order from the reordered buffer */
+    const int expectedOffsets[] = { 0, 6, 3, 12, 9 };
+    for (int i = 0; i < 5; i++) {
+        const DrawList::Batch &batch = drawList.materialBatchAt(i);
+        ASSERT_EQ(i, batch.materialIndex);
+        ASSERT_EQ(1, batch.nmaterials);
+        ASSERT_EQ(expectedOffsets[i], batch.indexOffset);
+        ASSERT_EQ(3, batch.nindices);
+        ASSERT_EQ(uint16_t(i * 3), dest[batch.indexOffset]);
+    }
+    /* a texture with alpha keeps material 4 at its place after the opaque materials */
+    opaqueTextures[4] = false;
+    drawList.compile(materialRefs, morphRefs, opaqueTextures, true);
+    ASSERT_EQ(4, drawList.countBatches());
+    ASSERT_EQ(1, drawList.batchAt(1).nmaterials);
+    ASSERT_EQ(3, drawList.batchAt(2).materialIndex);
+    ASSERT_EQ(4, drawList.batchAt(3).materialIndex);
+    /* without the information from the delegate no textured material is reordered */
+    opaqueTextures.clear();
+    drawList.compile(materialRefs, morphRefs, opaqueTextures, true);
+    ASSERT_EQ(5, drawList.countBatches());
+    ASSERT_EQ(3, drawList.batchAt(0).materialIndex);
+}
+
+TEST(MaterialTest, AccumulateParameterBuffer)
+{
+    TestString texture("texture.png");
+    Material materials[2];
+    Array<Material *> materialRefs;
+    Array<IString *> textures;
+    textures.add(&texture);
+    for (int i = 0; i < 2; i++) {
+        materials[i].setIndices(3);
+        materials[i].setAmbient(Color(0.8, 0.8, 0.8, 1.0));
+        materials[i].setDiffuse(Color(0.8, 0.8, 0.8, 0.8));
+        materials[i].setShininess(0.5);
+        materials[i].setEdgeSize(1.0);
+        materialRefs.add(&materials[i]);
+    }
+    ASSERT_TRUE(Material::loadMaterials(materialRefs, textures, 6));
+    MaterialParameterBuffer buffer;
+    buffer.compile(materialRefs);
+    ASSERT_EQ(2, buffer.count());
+    ASSERT_FALSE(buffer.isDirty());
+    Morph::Material modulate, add;
+    modulate.materials = new Array<Material *>();
+    modulate.materials->add(&materials[0]);
+    modulate.ambient.setValue(0.0, 0.0, 0.0);
+    modulate.diffuse.setValue(0.0, 0.0, 0.0, 0.0);
+    modulate.specular.setValue(1.0, 1.0, 1.0);
+    modulate.edgeColor.setValue(1.0, 1.0, 1.0, 1.0);
+    modulate.textureWeight.setValue(1.0, 1.0, 1.0, 1.0);
+    modulate.sphereTextureWeight.setValue(1.0, 1.0, 1.0, 1.0);
+    modulate.toonTextureWeight.setValue(1.0, 1.0, 1.0, 1.0);
+    modulate.shininess = 1.0;
+    modulate.edgeSize = 0.0;
+    modulate.operation = 0;
+    add.materials = new Array<Material *>();
+    add.materials->add(&materials[0]);
+    add.ambient.setValue(0.2, 0.2, 0.2);
+    add.diffuse.setValue(0.2, 0.2, 0.2, 0.0);
+    add.specular.setZero();
+    add.edgeColor.setZero();
+    add.textureWeight.setZero();
+    add.sphereTextureWeight.setZero();
+    add.toonTextureWeight.setZero();
+    add.shininess = 0.5;
+    add.edgeSize = 0.0;
+    add.operation = 1;
+    /* both morphs target material 0 and are combined instead of overwriting each other */
+    buffer.accumulate(&modulate, 0.5);
+    buffer.accumulate(&add, 0.5);
+    ASSERT_TRUE(buffer.isDirty());
+    buffer.update();
+    ASSERT_FALSE(buffer.isDirty());
+    const MaterialParameterBuffer::Parameter &morphed = buffer.at(0);
+    ASSERT_TRUE(testVector(Color(0.5, 0.5, 0.5, 1.0), morphed.ambient));
+    ASSERT_TRUE(testVector(Color(0.5, 0.5, 0.5, 0.4), morphed.diffuse));
+    ASSERT_FLOAT_EQ(0.75f, morphed.shininess);
+    ASSERT_FLOAT_EQ(0.5f, morphed.edgeSize);
+    ASSERT_TRUE(testVector(Color(0.8, 0.8, 0.8, 0.8), buffer.at(1).diffuse));
+    ASSERT_TRUE(testVector(Color(0.8, 0.8, 0.8, 1.0), materials[0].ambient()));
+    buffer.reset();
+    ASSERT_TRUE(buffer.isDirty());
+    buffer.update();
+    ASSERT_TRUE(testVector(Color(0.8, 0.8, 0.8, 1.0), buffer.at(0).ambient));
+    ASSERT_TRUE(testVector(Color(0.8, 0.8, 0.8, 0.8), buffer.at(0).diffuse));
+    ASSERT_FLOAT_EQ(0.5f, buffer.at(0).shininess);
+}
+
 TEST(ModelTest, ParseEmpty)
 {
-    Encoding encoding;
+    TestEncoding encoding;
     Model model(&encoding);
     Model::DataInfo info;
     ASSERT_FALSE(model.preparse(reinterpret_cast<const uint8_t *>(""), 0, info));
     ASSERT_EQ(Model::kInvalidHeaderError, model.error());
 }
 
+#ifndef VPVL2_TEST_NO_QT
 TEST(ModelTest, ParseRealPMD)
 {
     QFile file("miku.pmd");
@@ -1083,3 +1794,237 @@ TEST(ModelTest, ParseRealPMX)
         // skip
     }
 }
+#endif
+
+TEST(ModelTest, PackedStrideLayout)
+{
+    const size_t dynamicSize = Model::packedStrideSize(Model::kVertexStride);
+    ASSERT_LT(dynamicSize, Model::strideSize(Model::kVertexStride));
+    ASSERT_EQ(Model::kDynamicStream, Model::packedStreamType(Model::kVertexStride));
+    ASSERT_EQ(Model::kDynamicStream, Model::packedStreamType(Model::kNormalStride));
+    ASSERT_EQ(Model::kDynamicStream, Model::packedStreamType(Model::kEdgeVertexStride));
+    ASSERT_EQ(Model::kStaticStream, Model::packedStreamType(Model::kBoneIndexStride));
+    ASSERT_EQ(Model::kStaticStream, Model::packedStreamType(Model::kEdgeSizeStride));
+    ASSERT_EQ(Model::kUVA1Stream, Model::packedStreamType(Model::kUVA1Stride));
+    ASSERT_LT(Model::packedStrideOffset(Model::kEdgeVertexStride), dynamicSize);
+    ASSERT_LT(Model::packedStrideOffset(Model::kEdgeSizeStride), Model::packedStrideSize(Model::kEdgeSizeStride));
+    TestEncoding encoding;
+    Model model(&encoding);
+    model.setPackedVertexEnable(true);
+    ASSERT_TRUE(model.isPackedVertexEnabled());
+    ASSERT_EQ(static_cast<const void *>(0), model.packedUVA1Ptr());
+    model.setPackedVertexEnable(false);
+    ASSERT_FALSE(model.isPackedVertexEnabled());
+}
+
+TEST(ModelTest, OptimizeIndices)
+{
+    TestEncoding encoding;
+    pmx::Model empty(&encoding);
+    ASSERT_FLOAT_EQ(0, empty.averageCacheMissRatio(32));
+    /* 三角形の順番を乱した格子は並べ替えで ACMR が大きく下がる */
+    ByteStream stream;
+    BuildGridModel(100, 100, true, 0, stream);
+    pmx::Model model(&encoding);
+    ASSERT_TRUE(model.load(stream.data(), stream.size()));
+    ASSERT_EQ(sizeof(uint16_t), model.indexStrideSize());
+    const int nindices = model.indices().count();
+    std::vector<int> before, after;
+    for (int i = 0; i < nindices; i++)
+        before.push_back(model.indices()[i]);
+    const Scalar acmr = model.averageCacheMissRatio(32);
+    ASSERT_GT(acmr, 2.9f);
+    model.optimizeIndices();
+    for (int i = 0; i < nindices; i++)
+        after.push_back(model.indices()[i]);
+    ASSERT_NE(before, after);
+    std::sort(before.begin(), before.end());
+    std::sort(after.begin(), after.end());
+    ASSERT_EQ(before, after);
+    ASSERT_LT(model.averageCacheMissRatio(32), 0.75f);
+    /* 既に整列している格子は悪化させない */
+    ByteStream stream2;
+    BuildGridModel(100, 100, false, 0, stream2);
+    pmx::Model model2(&encoding);
+    ASSERT_TRUE(model2.load(stream2.data(), stream2.size()));
+    const Scalar acmr2 = model2.averageCacheMissRatio(32);
+    model2.optimizeIndices();
+    ASSERT_LE(model2.averageCacheMissRatio(32), acmr2);
+}
+
+TEST(ModelTest, BoneBoundingBox)
+{
+    static const float kIdentity[] = { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1 };
+    static const float kTranslated[] = { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 1000, 0, 0, 1 };
+    TestEncoding encoding;
+    pmx::Model empty(&encoding);
+    ASSERT_TRUE(empty.isInsideFrustum(kIdentity));
+    /* 格子の頂点は全て子のボーンに従うため、そのボーンを動かすと境界ボックスも移動する */
+    ByteStream stream;
+    BuildGridModel(8, 8, false, 0, stream);
+    pmx::Model grid(&encoding);
+    ASSERT_TRUE(grid.load(stream.data(), stream.size()));
+    Vector3 min, max;
+    grid.getBoundingBox(min, max);
+    ASSERT_TRUE(testVector(Vector3(-0.5, -0.5, 0), min));
+    ASSERT_TRUE(testVector(Vector3(0.5, 0.5, 0), max));
+    ASSERT_TRUE(grid.isInsideFrustum(kIdentity));
+    grid.bones()[1]->setPosition(Vector3(1000, 0, 0));
+    grid.performUpdateBones();
+    grid.getBoundingBox(min, max);
+    ASSERT_TRUE(testVector(Vector3(999.5, -0.5, 0), min));
+    ASSERT_TRUE(testVector(Vector3(1000.5, 0.5, 0), max));
+    ASSERT_FALSE(grid.isInsideFrustum(kIdentity));
+    /* 真上に持ち上げたモデルは視錐台の外でも、真下に投影した影は視錐台の中にある */
+    static const float kShadow[] = { 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1 };
+    grid.bones()[1]->setPosition(Vector3(0, 1000, 0));
+    grid.performUpdateBones();
+    ASSERT_FALSE(grid.isInsideFrustum(kIdentity));
+    ASSERT_TRUE(grid.isInsideFrustum(kShadow));
+    grid.bones()[1]->setPosition(kZeroV3);
+    grid.performUpdateBones();
+    ASSERT_TRUE(grid.isInsideFrustum(kIdentity));
+#ifndef VPVL2_TEST_NO_QT
+    QFile file("miku.pmx");
+    if (file.open(QFile::ReadOnly)) {
+        const QByteArray &bytes = file.readAll();
+        pmx::Model model(&encoding);
+        ASSERT_TRUE(model.load(reinterpret_cast<const uint8_t *>(bytes.constData()), bytes.size()));
+        Vector3 min, max;
+        model.getBoundingBox(min, max);
+        /* 初期姿勢では全ての頂点がボーン毎の境界の合成に含まれる */
+        const Array<Vertex *> &vertices = model.vertices();
+        const int nvertices = vertices.count();
+        for (int i = 0; i < nvertices; i++) {
+            const Vector3 &origin = vertices[i]->origin();
+            ASSERT_LE(min.x(), origin.x());
+            ASSERT_LE(min.y(), origin.y());
+            ASSERT_LE(min.z(), origin.z());
+            ASSERT_GE(max.x(), origin.x());
+            ASSERT_GE(max.y(), origin.y());
+            ASSERT_GE(max.z(), origin.z());
+        }
+        ASSERT_FALSE(model.isInsideFrustum(kTranslated));
+    }
+    else {
+        // skip
+    }
+#endif
+}
+
+TEST(ModelTest, HasSameSource)
+{
+    TestEncoding encoding;
+    Model source(&encoding), model(&encoding), model2(&encoding), other(&encoding);
+    ASSERT_FALSE(model.hasSameSource(&model2));
+    const size_t size = source.estimateSize();
+    std::vector<uint8_t> bytes(size);
+    source.save(&bytes[0]);
+    ASSERT_TRUE(model.load(&bytes[0], size));
+    ASSERT_TRUE(model2.load(&bytes[0], size));
+    ASSERT_TRUE(model.hasSameSource(&model2));
+    ASSERT_FALSE(model.hasSameSource(0));
+    TestString name("other");
+    source.setName(&name);
+    const size_t otherSize = source.estimateSize();
+    std::vector<uint8_t> otherBytes(otherSize);
+    source.save(&otherBytes[0]);
+    ASSERT_TRUE(other.load(&otherBytes[0], otherSize));
+    ASSERT_FALSE(model.hasSameSource(&other));
+    /* 索引を並べ替えたモデルとは共有しない */
+    model2.optimizeIndices();
+    ASSERT_FALSE(model.hasSameSource(&model2));
+    /* 大きさとハッシュが一致しても共有する内容が異なれば共有しない */
+    ByteStream stream;
+    BuildGridModel(4, 4, false, 0, stream);
+    Model grid(&encoding), grid2(&encoding);
+    ASSERT_TRUE(grid.load(stream.data(), stream.size()));
+    ASSERT_TRUE(grid2.load(stream.data(), stream.size()));
+    ASSERT_TRUE(grid.hasSameSource(&grid2));
+    grid2.vertices()[5]->setEdgeSize(2.0f);
+    ASSERT_FALSE(grid.hasSameSource(&grid2));
+    grid2.vertices()[5]->setEdgeSize(1.0f);
+    ASSERT_TRUE(grid.hasSameSource(&grid2));
+    grid2.materials()[0]->setFlags(0x1);
+    ASSERT_FALSE(grid.hasSameSource(&grid2));
+}
+
+TEST(ModelTest, SaveWithTextureDeduplication)
+{
+    TestEncoding encoding;
+    ByteStream stream;
+    BuildGridModel(2, 2, false, 3, stream);
+    Model model(&encoding), model2(&encoding);
+    ASSERT_TRUE(model.load(stream.data(), stream.size()));
+    const Model &source = model;
+    Writer writer(&source);
+    writer.setTextureDeduplicationEnable(true);
+    const size_t size = writer.estimateSize();
+    std::vector<uint8_t> bytes(size);
+    Writer::MemorySink sink(&bytes[0], size);
+    ASSERT_TRUE(writer.write(&sink));
+    ASSERT_EQ(size, sink.written());
+    /* 書き出したテーブルの番号に変換されるが、元のモデルの材質は変わらない */
+    const Material *material = model.materials()[0];
+    ASSERT_EQ(2, material->textureIndex());
+    ASSERT_EQ(0, material->sphereTextureIndex());
+    ASSERT_TRUE(model2.load(&bytes[0], size));
+    ASSERT_EQ(1, model2.textures().count());
+    const Material *material2 = model2.materials()[0];
+    ASSERT_EQ(0, material2->textureIndex());
+    ASSERT_EQ(0, material2->sphereTextureIndex());
+    ASSERT_TRUE(material2->mainTexture()->equals(material->mainTexture()));
+}
+
+TEST(ModelTest, SaveEmpty)
+{
+    TestEncoding encoding;
+    Model model(&encoding), model2(&encoding);
+    Writer writer(&model);
+    const size_t size = writer.estimateSize();
+    ASSERT_EQ(size, model.estimateSize());
+    std::vector<uint8_t> bytes(size);
+    Writer::MemorySink sink(&bytes[0], size);
+    ASSERT_TRUE(writer.write(&sink));
+    ASSERT_EQ(size, sink.written());
+    ASSERT_TRUE(model2.load(&bytes[0], size));
+    ASSERT_EQ(0, model2.vertices().count());
+    Writer::MemorySink shortSink(&bytes[0], size - 1);
+    ASSERT_FALSE(writer.write(&shortSink));
+}
+
+#ifndef VPVL2_TEST_NO_QT
+TEST(ModelTest, SaveRealPMX)
+{
+    QFile file("miku.pmx");
+    if (file.open(QFile::ReadOnly)) {
+        const QByteArray &bytes = file.readAll();
+        Encoding encoding;
+        Model model(&encoding), model2(&encoding);
+        ASSERT_TRUE(model.load(reinterpret_cast<const uint8_t *>(bytes.constData()), bytes.size()));
+        Writer writer(&model);
+        writer.setIndexSizeNarrowingEnable(true);
+        writer.setTextureDeduplicationEnable(true);
+        /* 要素がチャンクをまたぐ場合も正しく書き出せることを確認するため小さくする */
+        writer.setChunkSize(16);
+        const size_t size = writer.estimateSize();
+        QScopedArrayPointer<uint8_t> data(new uint8_t[size]);
+        Writer::MemorySink sink(data.data(), size);
+        ASSERT_TRUE(writer.write(&sink));
+        ASSERT_EQ(size, sink.written());
+        ASSERT_TRUE(model2.load(data.data(), size));
+        ASSERT_EQ(model.vertices().count(), model2.vertices().count());
+        ASSERT_EQ(model.indices().count(), model2.indices().count());
+        ASSERT_EQ(model.materials().count(), model2.materials().count());
+        ASSERT_EQ(model.bones().count(), model2.bones().count());
+        ASSERT_EQ(model.morphs().count(), model2.morphs().count());
+        ASSERT_EQ(model.labels().count(), model2.labels().count());
+        ASSERT_EQ(model.rigidBodies().count(), model2.rigidBodies().count());
+        ASSERT_EQ(model.joints().count(), model2.joints().count());
+        ASSERT_LE(model2.textures().count(), model.textures().count());
+    }
+    else {
+        // skip
+    }
+}
+#endif
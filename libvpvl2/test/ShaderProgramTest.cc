@@ -0,0 +1,200 @@
+#include "Common.h"
+#include "mock/RenderDelegate.h"
+
+#include <algorithm>
+#include <string>
+
+/* シムに置き換える前に OpenGL の宣言を読み込んでおく (EngineCommon.h と同じ順番) */
+#ifdef VPVL2_LINK_QT
+#include <QtOpenGL/QtOpenGL>
+#endif
+#if defined(VPVL2_ENABLE_GLES2)
+#include <GLES2/gl2.h>
+#elif defined(VPVL2_BUILD_IOS)
+#include <OpenGLES/ES2/gl.h>
+#elif defined(__APPLE__)
+#include <OpenGL/gl.h>
+#else
+#include <GL/gl.h>
+#endif
+
+namespace
+{
+
+/*
+ * EngineCommon.h が発行する OpenGL の呼び出しを記録する薄いシム。
+ * シェーダプログラムのクラスは実物をそのまま使い、OpenGL の関数だけを差し替える
+ */
+struct GLShim
+{
+    static GLuint createProgram() { return 1; }
+    static void deleteProgram(GLuint /* program */) {}
+    static GLuint createShader(GLenum /* type */) { return 1; }
+    static void shaderSource(GLuint, GLsizei, const char **, const GLint *) {}
+    static void compileShader(GLuint /* shader */) {}
+    static void attachShader(GLuint /* program */, GLuint /* shader */) {}
+    static void deleteShader(GLuint /* shader */) {}
+    static void getShaderInfoLog(GLuint, GLsizei, GLsizei *, char *) {}
+    static void getProgramInfoLog(GLuint, GLsizei, GLsizei *, char *) {}
+    static void linkProgram(GLuint /* program */) {}
+    static void validateProgram(GLuint /* program */) {}
+    static void getShaderiv(GLuint /* shader */, GLenum /* name */, GLint *value) { *value = GL_TRUE; }
+    static void getProgramiv(GLuint /* program */, GLenum /* name */, GLint *value) { *value = GL_TRUE; }
+    static GLint getAttribLocation(GLuint /* program */, const char * /* name */) { return -1; }
+    static GLint getUniformLocation(GLuint /* program */, const char *name) {
+        if (missingUniform == name)
+            return -1;
+        /* リンクし直しても同じ位置を返す */
+        const std::vector<std::string>::const_iterator it = std::find(uniforms.begin(), uniforms.end(), name);
+        if (it != uniforms.end())
+            return GLint(it - uniforms.begin());
+        uniforms.push_back(name);
+        return GLint(uniforms.size() - 1);
+    }
+    static void enableVertexAttribArray(GLuint /* index */) {}
+    static void vertexAttribPointer(GLuint, GLint, GLenum, GLboolean, GLsizei, const GLvoid *) {}
+    static void bindBuffer(GLenum /* target */, GLuint /* buffer */) {}
+    static void useProgram(GLuint /* program */) { record("glUseProgram"); }
+    static void uniform1i(GLint location, GLint /* value */) { record("glUniform1i", location); }
+    static void uniform1f(GLint location, GLfloat /* value */) { record("glUniform1f", location); }
+    static void uniform2fv(GLint location, GLsizei, const GLfloat *) { record("glUniform2fv", location); }
+    static void uniform3fv(GLint location, GLsizei, const GLfloat *) { record("glUniform3fv", location); }
+    static void uniform4fv(GLint location, GLsizei, const GLfloat *) { record("glUniform4fv", location); }
+    static void uniformMatrix3fv(GLint location, GLsizei, GLboolean, const GLfloat *) { record("glUniformMatrix3fv", location); }
+    static void uniformMatrix4fv(GLint location, GLsizei, GLboolean, const GLfloat *) { record("glUniformMatrix4fv", location); }
+    static void activeTexture(GLenum /* unit */) { record("glActiveTexture"); }
+    static void bindTexture(GLenum /* target */, GLuint /* texture */) { record("glBindTexture"); }
+    static void enable(GLenum cap) { record(cap == GL_CULL_FACE ? "glEnable(GL_CULL_FACE)" : "glEnable"); }
+    static void disable(GLenum cap) { record(cap == GL_CULL_FACE ? "glDisable(GL_CULL_FACE)" : "glDisable"); }
+    static void cullFace(GLenum /* mode */) { record("glCullFace"); }
+
+    static void record(const std::string &name) {
+        calls.push_back(name);
+    }
+    static void record(const std::string &name, GLint location) {
+        /* 記録を読みやすくするためにユニフォームの位置を名前に戻す */
+        calls.push_back(name + "(" + uniforms.at(location) + ")");
+    }
+    static void reset() {
+        uniforms.clear();
+        calls.clear();
+        missingUniform.clear();
+    }
+
+    static std::vector<std::string> uniforms;
+    static std::vector<std::string> calls;
+    static std::string missingUniform;
+};
+
+std::vector<std::string> GLShim::uniforms;
+std::vector<std::string> GLShim::calls;
+std::string GLShim::missingUniform;
+
+}
+
+#define glCreateProgram GLShim::createProgram
+#define glDeleteProgram GLShim::deleteProgram
+#define glCreateShader GLShim::createShader
+#define glShaderSource GLShim::shaderSource
+#define glCompileShader GLShim::compileShader
+#define glAttachShader GLShim::attachShader
+#define glDeleteShader GLShim::deleteShader
+#define glGetShaderInfoLog GLShim::getShaderInfoLog
+#define glGetProgramInfoLog GLShim::getProgramInfoLog
+#define glLinkProgram GLShim::linkProgram
+#define glValidateProgram GLShim::validateProgram
+#define glGetShaderiv GLShim::getShaderiv
+#define glGetProgramiv GLShim::getProgramiv
+#define glGetAttribLocation GLShim::getAttribLocation
+#define glGetUniformLocation GLShim::getUniformLocation
+#define glEnableVertexAttribArray GLShim::enableVertexAttribArray
+#define glVertexAttribPointer GLShim::vertexAttribPointer
+#define glBindBuffer GLShim::bindBuffer
+#define glUseProgram GLShim::useProgram
+#define glUniform1i GLShim::uniform1i
+#define glUniform1f GLShim::uniform1f
+#define glUniform2fv GLShim::uniform2fv
+#define glUniform3fv GLShim::uniform3fv
+#define glUniform4fv GLShim::uniform4fv
+#define glUniformMatrix3fv GLShim::uniformMatrix3fv
+#define glUniformMatrix4fv GLShim::uniformMatrix4fv
+#define glActiveTexture GLShim::activeTexture
+#define glBindTexture GLShim::bindTexture
+#define glEnable GLShim::enable
+#define glDisable GLShim::disable
+#define glCullFace GLShim::cullFace
+
+#include "../src/engine/gl2/EngineCommon.h"
+
+namespace
+{
+
+class ShaderProgramTest : public Test {
+protected:
+    void SetUp() {
+#ifdef VPVL2_LINK_QT
+        /* QGLFunctions の初期化にはカレントのコンテキストが必要 */
+        m_widget.makeCurrent();
+#endif
+        GLShim::reset();
+        EXPECT_CALL(m_delegate, log(_, _, _, _)).Times(AnyNumber());
+    }
+
+#ifdef VPVL2_LINK_QT
+    QGLWidget m_widget;
+#endif
+    MockIRenderDelegate m_delegate;
+};
+
+}
+
+TEST_F(ShaderProgramTest, ElideRedundantCalls)
+{
+    /* 見つからなかったユニフォーム (-1) への呼び出しは発行しない */
+    GLShim::missingUniform = "opacity";
+    gl2::ObjectProgram program(&m_delegate);
+    ASSERT_TRUE(program.linkProgram(0));
+    program.bind();
+    GLShim::calls.clear();
+    program.resetStateCounters();
+    /* two materials sharing everything but the light color */
+    const Vector3 color(1, 0.5, 0.25), color2(1, 0.5, 0);
+    for (int i = 0; i < 2; i++) {
+        program.setLightColor(i == 0 ? color : color2);
+        program.setMainTexture(42);
+        program.setOpacity(1);
+        program.setCullFaceEnable(false);
+    }
+    const char *const expected[] = {
+        "glUniform3fv(lightColor)",
+        "glActiveTexture",
+        "glBindTexture",
+        "glUniform1i(mainTexture)",
+        "glUniform1i(hasMainTexture)",
+        "glDisable(GL_CULL_FACE)",
+        "glUniform3fv(lightColor)"
+    };
+    ASSERT_EQ(std::vector<std::string>(expected, expected + sizeof(expected) / sizeof(expected[0])), GLShim::calls);
+    ASSERT_EQ(6, program.stateCache().countIssuedCalls());
+    ASSERT_EQ(6, program.stateCache().countElidedCalls());
+    /* a new pass forgets texture and cull state but keeps uniforms of the program */
+    program.bind();
+    GLShim::calls.clear();
+    program.setLightColor(color2);
+    program.setMainTexture(42);
+    program.setCullFaceEnable(false);
+    const char *const expected2[] = {
+        "glActiveTexture",
+        "glBindTexture",
+        "glDisable(GL_CULL_FACE)"
+    };
+    ASSERT_EQ(std::vector<std::string>(expected2, expected2 + sizeof(expected2) / sizeof(expected2[0])), GLShim::calls);
+    /* relinking the program forgets uniforms */
+    ASSERT_TRUE(program.linkProgram(0));
+    GLShim::calls.clear();
+    program.setLightColor(color2);
+    ASSERT_EQ(size_t(1), GLShim::calls.size());
+    program.resetStateCounters();
+    ASSERT_EQ(0, program.stateCache().countIssuedCalls());
+    ASSERT_EQ(0, program.stateCache().countElidedCalls());
+}
@@ -0,0 +1,142 @@
+#include "Common.h"
+#include "vpvl2/qt/TextureDiskCache.h"
+
+#include <utime.h>
+
+namespace {
+
+class TextureDiskCacheTest : public Test {
+protected:
+    void SetUp() {
+        m_widget.makeCurrent();
+        m_cacheDir = QDir(QDir::temp().absoluteFilePath("vpvl2_test_texture_cache"));
+        m_sourcePath = QDir::temp().absoluteFilePath("vpvl2_test_texture_source.bin");
+        writeSource("0123456789abcdef");
+    }
+    void TearDown() {
+        TextureDiskCache(m_cacheDir).clear();
+        QFile::remove(m_sourcePath);
+    }
+
+    void writeSource(const QByteArray &bytes) {
+        QFile file(m_sourcePath);
+        ASSERT_TRUE(file.open(QFile::WriteOnly | QFile::Truncate));
+        ASSERT_EQ(qint64(bytes.size()), file.write(bytes));
+    }
+    void setSourceModified(time_t value) {
+        struct utimbuf times;
+        times.actime = value;
+        times.modtime = value;
+        ASSERT_EQ(0, utime(QFile::encodeName(m_sourcePath).constData(), &times));
+    }
+    QByteArray sourceHash() const {
+        QFile file(m_sourcePath);
+        file.open(QFile::ReadOnly);
+        return QCryptographicHash::hash(file.readAll(), QCryptographicHash::Md5);
+    }
+    static QImage createImage(int width, int height) {
+        QImage image(width, height, QImage::Format_ARGB32);
+        image.fill(0xff336699);
+        return image;
+    }
+    bool loadTexture(const TextureDiskCache &cache, bool mipmap, size_t &width, size_t &height) const {
+        bool opaque = false;
+        return loadTexture(cache, mipmap, width, height, opaque);
+    }
+    bool loadTexture(const TextureDiskCache &cache, bool mipmap, size_t &width, size_t &height, bool &opaque) const {
+        GLuint textureID = 0;
+        bool ok = cache.load(m_sourcePath, mipmap, textureID, width, height, opaque);
+        if (ok)
+            glDeleteTextures(1, &textureID);
+        return ok && textureID != 0;
+    }
+
+    QGLWidget m_widget;
+    QDir m_cacheDir;
+    QString m_sourcePath;
+};
+
+}
+
+TEST_F(TextureDiskCacheTest, StoreAndLoad)
+{
+    TextureDiskCache cache(m_cacheDir);
+    size_t width = 0, height = 0;
+    /* 保存する前は読み込めない */
+    ASSERT_FALSE(loadTexture(cache, false, width, height));
+    ASSERT_TRUE(cache.store(m_sourcePath, sourceHash(), createImage(8, 4)));
+    ASSERT_TRUE(loadTexture(cache, false, width, height));
+    ASSERT_EQ(size_t(8), width);
+    ASSERT_EQ(size_t(4), height);
+    width = height = 0;
+    ASSERT_TRUE(loadTexture(cache, true, width, height));
+    ASSERT_EQ(size_t(8), width);
+    ASSERT_EQ(size_t(4), height);
+}
+
+TEST_F(TextureDiskCacheTest, RejectUnsupportedImage)
+{
+    TextureDiskCache cache(m_cacheDir);
+    ASSERT_FALSE(cache.store(m_sourcePath, sourceHash(), QImage()));
+    ASSERT_FALSE(cache.store(m_sourcePath, sourceHash(), createImage(4, 4).convertToFormat(QImage::Format_RGB888)));
+    ASSERT_FALSE(cache.store(QDir::temp().absoluteFilePath("vpvl2_test_texture_inexist.bin"), sourceHash(), createImage(4, 4)));
+}
+
+TEST_F(TextureDiskCacheTest, InvalidateChangedSource)
+{
+    TextureDiskCache cache(m_cacheDir);
+    size_t width = 0, height = 0;
+    setSourceModified(1000000000);
+    ASSERT_TRUE(cache.store(m_sourcePath, sourceHash(), createImage(4, 4)));
+    /* サイズが異なる */
+    writeSource("0123456789abcdef0123");
+    ASSERT_FALSE(loadTexture(cache, false, width, height));
+    /* サイズは同じだが更新日時と内容が異なる */
+    writeSource("fedcba9876543210");
+    setSourceModified(1000000100);
+    ASSERT_FALSE(loadTexture(cache, false, width, height));
+    /* キャッシュを削除した後は読み込めない */
+    writeSource("0123456789abcdef");
+    ASSERT_TRUE(cache.store(m_sourcePath, sourceHash(), createImage(4, 4)));
+    cache.clear();
+    ASSERT_FALSE(loadTexture(cache, false, width, height));
+}
+
+TEST_F(TextureDiskCacheTest, UpdateModifiedWhenContentMatches)
+{
+    TextureDiskCache cache(m_cacheDir);
+    size_t width = 0, height = 0;
+    setSourceModified(1000000000);
+    ASSERT_TRUE(cache.store(m_sourcePath, sourceHash(), createImage(4, 4)));
+    /* 内容が同じであれば更新日時が異なっても有効 */
+    setSourceModified(1000000100);
+    ASSERT_TRUE(loadTexture(cache, false, width, height));
+    /*
+     * 読み込み時に更新日時が書き換えられていれば、同じ更新日時を持つソースは MD5 を比較せずに有効とみなされる。
+     * 書き換えられていなければ内容が異なるため無効になる
+     */
+    writeSource("fedcba9876543210");
+    setSourceModified(1000000100);
+    ASSERT_TRUE(loadTexture(cache, false, width, height));
+    /* 更新日時も内容も異なる場合は無効 */
+    setSourceModified(1000000200);
+    ASSERT_FALSE(loadTexture(cache, false, width, height));
+}
+
+TEST_F(TextureDiskCacheTest, StoreOpacity)
+{
+    TextureDiskCache cache(m_cacheDir);
+    size_t width = 0, height = 0;
+    bool opaque = false;
+    QImage image = createImage(4, 4);
+    ASSERT_TRUE(TextureDiskCache::isOpaqueImage(image));
+    ASSERT_TRUE(cache.store(m_sourcePath, sourceHash(), image));
+    ASSERT_TRUE(loadTexture(cache, false, width, height, opaque));
+    ASSERT_TRUE(opaque);
+    /* 一画素でも半透明であれば不透明とはみなさない */
+    image.setPixel(3, 3, 0x80336699);
+    ASSERT_FALSE(TextureDiskCache::isOpaqueImage(image));
+    ASSERT_TRUE(cache.store(m_sourcePath, sourceHash(), image));
+    ASSERT_TRUE(loadTexture(cache, false, width, height, opaque));
+    ASSERT_FALSE(opaque);
+}
@@ -10,6 +10,7 @@
 #include "vpvl2/vmd/MorphAnimation.h"
 #include "vpvl2/vmd/MorphKeyframe.h"
 #include "vpvl2/vmd/Motion.h"
+#include "vpvl2/vmd/NameTable.h"
 
 #include "mock/Bone.h"
 #include "mock/Model.h"
@@ -64,7 +65,7 @@ static void CompareCameraInterpolationMatrix(const QuadWord p[], const vmd::Came
 
 TEST(VMDMotionTest, ParseEmpty)
 {
-    Encoding encoding;
+    TestEncoding encoding;
     Model model(&encoding);
     vmd::Motion motion(&model, &encoding);
     vmd::Motion::DataInfo info;
@@ -73,6 +74,7 @@ TEST(VMDMotionTest, ParseEmpty)
     ASSERT_EQ(vmd::Motion::kInvalidHeaderError, motion.error());
 }
 
+#ifndef VPVL2_TEST_NO_QT
 TEST(VMDMotionTest, ParseFile)
 {
     QFile file("motion.vmd");
@@ -114,11 +116,12 @@ TEST(VMDMotionTest, ParseCamera)
         ASSERT_EQ(vmd::Motion::kNoError, motion.error());
     }
 }
+#endif
 
 TEST(VMDMotionTest, SaveBoneKeyframe)
 {
-    Encoding encoding;
-    CString str(kTestString);
+    TestEncoding encoding;
+    TestString str(kTestString);
     vmd::BoneKeyframe frame(&encoding), newFrame(&encoding);
     Vector3 pos(1, 2, 3);
     Quaternion rot(4, 5, 6, 7);
@@ -147,7 +150,7 @@ TEST(VMDMotionTest, SaveBoneKeyframe)
     ASSERT_TRUE(newFrame.rotation() == rot);
     CompareBoneInterpolationMatrix(p, frame);
     // cloned bone frame shold be copied with deep
-    QScopedPointer<IBoneKeyframe> cloned(frame.clone());
+    ScopedPointer<IBoneKeyframe> cloned(frame.clone());
     ASSERT_TRUE(cloned->name()->equals(frame.name()));
     ASSERT_EQ(frame.timeIndex(), cloned->timeIndex());
     ASSERT_TRUE(cloned->position() == pos);
@@ -186,20 +189,20 @@ TEST(VMDMotionTest, SaveCameraKeyframe)
     ASSERT_TRUE(newFrame.position() == frame.position());
     // compare read camera frame
     // for radian and degree calculation
-    ASSERT_TRUE(qFuzzyCompare(newFrame.angle().x(), frame.angle().x()));
-    ASSERT_TRUE(qFuzzyCompare(newFrame.angle().y(), frame.angle().y()));
-    ASSERT_TRUE(qFuzzyCompare(newFrame.angle().z(), frame.angle().z()));
+    ASSERT_FLOAT_EQ(newFrame.angle().x(), frame.angle().x());
+    ASSERT_FLOAT_EQ(newFrame.angle().y(), frame.angle().y());
+    ASSERT_FLOAT_EQ(newFrame.angle().z(), frame.angle().z());
     ASSERT_TRUE(newFrame.distance() == frame.distance());
     ASSERT_TRUE(newFrame.fov() == frame.fov());
     CompareCameraInterpolationMatrix(p, frame);
     // cloned camera frame shold be copied with deep
-    QScopedPointer<ICameraKeyframe> cloned(frame.clone());
+    ScopedPointer<ICameraKeyframe> cloned(frame.clone());
     ASSERT_EQ(frame.timeIndex(), cloned->timeIndex());
     ASSERT_TRUE(cloned->position() == frame.position());
     // for radian and degree calculation
-    ASSERT_TRUE(qFuzzyCompare(cloned->angle().x(), frame.angle().x()));
-    ASSERT_TRUE(qFuzzyCompare(cloned->angle().y(), frame.angle().y()));
-    ASSERT_TRUE(qFuzzyCompare(cloned->angle().z(), frame.angle().z()));
+    ASSERT_FLOAT_EQ(cloned->angle().x(), frame.angle().x());
+    ASSERT_FLOAT_EQ(cloned->angle().y(), frame.angle().y());
+    ASSERT_FLOAT_EQ(cloned->angle().z(), frame.angle().z());
     ASSERT_TRUE(cloned->distance() == frame.distance());
     ASSERT_TRUE(cloned->fov() == frame.fov());
     CompareCameraInterpolationMatrix(p, *static_cast<vmd::CameraKeyframe *>(cloned.data()));
@@ -207,8 +210,8 @@ TEST(VMDMotionTest, SaveCameraKeyframe)
 
 TEST(VMDMotionTest, SaveMorphKeyframe)
 {
-    Encoding encoding;
-    CString str(kTestString);
+    TestEncoding encoding;
+    TestString str(kTestString);
     vmd::MorphKeyframe frame(&encoding), newFrame(&encoding);
     // initialize the morph frame to be copied
     frame.setName(&str);
@@ -223,7 +226,7 @@ TEST(VMDMotionTest, SaveMorphKeyframe)
     ASSERT_EQ(frame.timeIndex(), newFrame.timeIndex());
     ASSERT_EQ(frame.weight(), newFrame.weight());
     // cloned morph frame shold be copied with deep
-    QScopedPointer<IMorphKeyframe> cloned(frame.clone());
+    ScopedPointer<IMorphKeyframe> cloned(frame.clone());
     ASSERT_TRUE(cloned->name()->equals(frame.name()));
     ASSERT_EQ(frame.timeIndex(), cloned->timeIndex());
     ASSERT_EQ(frame.weight(), cloned->weight());
@@ -246,12 +249,13 @@ TEST(VMDMotionTest, SaveLightKeyframe)
     ASSERT_TRUE(newFrame.color() == frame.color());
     ASSERT_TRUE(newFrame.direction() == frame.direction());
     // cloned morph frame shold be copied with deep
-    QScopedPointer<ILightKeyframe> cloned(frame.clone());
+    ScopedPointer<ILightKeyframe> cloned(frame.clone());
     ASSERT_EQ(frame.timeIndex(), cloned->timeIndex());
     ASSERT_TRUE(cloned->color() == frame.color());
     ASSERT_TRUE(cloned->direction() == frame.direction());
 }
 
+#ifndef VPVL2_TEST_NO_QT
 TEST(VMDMotionTest, SaveMotion)
 {
     QFile file("motion.vmd");
@@ -290,25 +294,23 @@ TEST(VMDMotionTest, CloneMotion)
         ASSERT_STREQ(bytes2.constData(), bytes3.constData());
     }
 }
+#endif
 
 TEST(VMDMotionTest, ParseBoneKeyframe)
 {
-    QByteArray bytes;
-    QDataStream stream(&bytes, QIODevice::WriteOnly);
-    stream.setFloatingPointPrecision(QDataStream::SinglePrecision);
-    stream.setByteOrder(QDataStream::LittleEndian);
+    ByteStream stream;
     stream.writeRawData(kTestString, vmd::BoneKeyframe::kNameSize);
-    stream << quint32(1)                   // frame index
+    stream << uint32_t(1)                  // frame index
            << 2.0f << 3.0f << 4.0f         // position
            << 5.0f << 6.0f << 7.0f << 8.0f // rotation
               ;
     for (int i = 0; i < vmd::BoneKeyframe::kTableSize; i++)
-        stream << quint8(0);
-    ASSERT_EQ(vmd::BoneKeyframe::strideSize(), size_t(bytes.size()));
-    Encoding encoding;
+        stream << uint8_t(0);
+    ASSERT_EQ(vmd::BoneKeyframe::strideSize(), stream.size());
+    TestEncoding encoding;
     vmd::BoneKeyframe frame(&encoding);
-    CString str(kTestString);
-    frame.read(reinterpret_cast<const uint8_t *>(bytes.constData()));
+    TestString str(kTestString);
+    frame.read(stream.data());
     ASSERT_TRUE(frame.name()->equals(&str));
     ASSERT_EQ(IKeyframe::TimeIndex(1.0), frame.timeIndex());
 #ifdef VPVL2_COORDINATE_OPENGL
@@ -322,23 +324,20 @@ TEST(VMDMotionTest, ParseBoneKeyframe)
 
 TEST(VMDMotionTest, ParseCameraKeyframe)
 {
-    QByteArray bytes;
-    QDataStream stream(&bytes, QIODevice::WriteOnly);
-    stream.setFloatingPointPrecision(QDataStream::SinglePrecision);
-    stream.setByteOrder(QDataStream::LittleEndian);
-    stream << quint32(1)           // frame index
+    ByteStream stream;
+    stream << uint32_t(1)          // frame index
            << 1.0f                 // distance
            << 2.0f << 3.0f << 4.0f // position
            << 5.0f << 6.0f << 7.0f // angle
               ;
     for (int i = 0; i < vmd::CameraKeyframe::kTableSize; i++)
-        stream << quint8(0);
-    stream << quint32(8)           // view angle (fovy)
-           << quint8(1)            // no perspective
+        stream << uint8_t(0);
+    stream << uint32_t(8)          // view angle (fovy)
+           << uint8_t(1)           // no perspective
               ;
-    ASSERT_EQ(vmd::CameraKeyframe::strideSize(), size_t(bytes.size()));
+    ASSERT_EQ(vmd::CameraKeyframe::strideSize(), stream.size());
     vmd::CameraKeyframe frame;
-    frame.read(reinterpret_cast<const uint8_t *>(bytes.constData()));
+    frame.read(stream.data());
     ASSERT_EQ(IKeyframe::TimeIndex(1.0), frame.timeIndex());
 #ifdef VPVL2_COORDINATE_OPENGL
     ASSERT_EQ(-1.0f, frame.distance());
@@ -355,37 +354,56 @@ TEST(VMDMotionTest, ParseCameraKeyframe)
 
 TEST(VMDMotionTest, ParseMorphKeyframe)
 {
-    QByteArray bytes;
-    QDataStream stream(&bytes, QIODevice::WriteOnly);
-    stream.setFloatingPointPrecision(QDataStream::SinglePrecision);
-    stream.setByteOrder(QDataStream::LittleEndian);
+    ByteStream stream;
     stream.writeRawData(kTestString, vmd::MorphKeyframe::kNameSize);
-    stream << quint32(1) // frame index
+    stream << uint32_t(1) // frame index
            << 0.5f       // weight
               ;
-    ASSERT_EQ(vmd::MorphKeyframe::strideSize(), size_t(bytes.size()));
-    Encoding encoding;
+    ASSERT_EQ(vmd::MorphKeyframe::strideSize(), stream.size());
+    TestEncoding encoding;
     vmd::MorphKeyframe frame(&encoding);
-    CString str(kTestString);
-    frame.read(reinterpret_cast<const uint8_t *>(bytes.constData()));
+    TestString str(kTestString);
+    frame.read(stream.data());
     ASSERT_TRUE(frame.name()->equals(&str));
     ASSERT_EQ(IKeyframe::TimeIndex(1.0), frame.timeIndex());
     ASSERT_EQ(IMorph::WeightPrecision(0.5), frame.weight());
 }
 
+TEST(VMDMotionTest, InternKeyframeName)
+{
+    ByteStream stream;
+    stream.writeRawData(kTestString, vmd::MorphKeyframe::kNameSize);
+    stream << uint32_t(1) // frame index
+           << 0.5f       // weight
+              ;
+    TestEncoding encoding;
+    vmd::NameTable table(&encoding);
+    vmd::MorphKeyframe frame1(&encoding), frame2(&encoding);
+    TestString str(kTestString);
+    const uint8_t *ptr = stream.data();
+    frame1.read(ptr, &table);
+    frame2.read(ptr, &table);
+    ASSERT_TRUE(frame1.name()->equals(&str));
+    /* same raw name should share one interned string */
+    ASSERT_EQ(frame1.name(), frame2.name());
+    ASSERT_EQ(1, table.count());
+    /* setName copies the name and must not touch the interned one */
+    TestString str2("foo");
+    frame2.setName(&str2);
+    ASSERT_TRUE(frame2.name()->equals(&str2));
+    ASSERT_TRUE(frame1.name()->equals(&str));
+}
+
 TEST(VMDMotionTest, ParseLightKeyframe)
 {
-    QByteArray bytes;
-    QDataStream stream(&bytes, QIODevice::WriteOnly);
-    stream.setFloatingPointPrecision(QDataStream::SinglePrecision);
-    stream.setByteOrder(QDataStream::LittleEndian);
-    stream << quint32(1)           // frame index
+    ByteStream stream;
+    stream << uint32_t(1)          // frame index
            << 0.2f << 0.3f << 0.4f // color
            << 0.5f << 0.6f << 0.7f // direction
               ;
-    ASSERT_EQ(vmd::LightKeyframe::strideSize(), size_t(bytes.size()));
+    ASSERT_EQ(vmd::LightKeyframe::strideSize(), stream.size());
     vmd::LightKeyframe frame;
-    frame.read(reinterpret_cast<const uint8_t *>(bytes.constData()));
+    frame.read(stream.data());
     ASSERT_EQ(IKeyframe::TimeIndex(1.0), frame.timeIndex());
     ASSERT_TRUE(frame.color() == Vector3(0.2f, 0.3f, 0.4f));
 #ifdef VPVL2_COORDINATE_OPENGL
@@ -397,7 +415,7 @@ TEST(VMDMotionTest, ParseLightKeyframe)
 
 TEST(VMDMotionTest, BoneInterpolation)
 {
-    Encoding encoding;
+    TestEncoding encoding;
     vmd::BoneKeyframe frame(&encoding);
     QuadWord n;
     frame.getInterpolationParameter(vmd::BoneKeyframe::kX, n);
@@ -438,20 +456,20 @@ TEST(VMDMotionTest, CameraInterpolation)
 
 TEST(VMDMotionTest, AddAndRemoveBoneKeyframes)
 {
-    Encoding encoding;
-    CString name("bone");
+    TestEncoding encoding;
+    TestString name("bone");
     MockIModel model;
     MockIBone bone;
     vmd::Motion motion(&model, &encoding);
     ASSERT_EQ(0, motion.countKeyframes(IKeyframe::kBone));
     // mock bone
     EXPECT_CALL(model, findBone(_)).Times(AtLeast(1)).WillRepeatedly(Return(&bone));
-    QScopedPointer<IBoneKeyframe> keyframePtr(new vmd::BoneKeyframe(&encoding));
+    ScopedPointer<IBoneKeyframe> keyframePtr(new vmd::BoneKeyframe(&encoding));
     keyframePtr->setTimeIndex(42);
     keyframePtr->setName(&name);
     {
         // The frame that the layer index is not zero should not be added
-        QScopedPointer<IBoneKeyframe> frame42(new vmd::BoneKeyframe(&encoding));
+        ScopedPointer<IBoneKeyframe> frame42(new vmd::BoneKeyframe(&encoding));
         frame42->setLayerIndex(42);
         motion.addKeyframe(frame42.data());
         motion.update(IKeyframe::kBone);
@@ -496,16 +514,16 @@ TEST(VMDMotionTest, AddAndRemoveBoneKeyframes)
 
 TEST(VMDMotionTest, AddAndRemoveCameraKeyframes)
 {
-    Encoding encoding;
+    TestEncoding encoding;
     Model model(&encoding);
     vmd::Motion motion(&model, &encoding);
     ASSERT_EQ(0, motion.countKeyframes(IKeyframe::kCamera));
-    QScopedPointer<ICameraKeyframe> keyframePtr(new vmd::CameraKeyframe());
+    ScopedPointer<ICameraKeyframe> keyframePtr(new vmd::CameraKeyframe());
     keyframePtr->setTimeIndex(42);
     keyframePtr->setDistance(42);
     {
         // The frame that the layer index is not zero should not be added
-        QScopedPointer<ICameraKeyframe> frame42(new vmd::CameraKeyframe());
+        ScopedPointer<ICameraKeyframe> frame42(new vmd::CameraKeyframe());
         frame42->setLayerIndex(42);
         motion.addKeyframe(frame42.data());
         motion.update(IKeyframe::kCamera);
@@ -550,16 +568,16 @@ TEST(VMDMotionTest, AddAndRemoveCameraKeyframes)
 
 TEST(VMDMotionTest, AddAndRemoveLightKeyframes)
 {
-    Encoding encoding;
+    TestEncoding encoding;
     Model model(&encoding);
     vmd::Motion motion(&model, &encoding);
     ASSERT_EQ(0, motion.countKeyframes(IKeyframe::kLight));
-    QScopedPointer<ILightKeyframe> keyframePtr(new vmd::LightKeyframe());
+    ScopedPointer<ILightKeyframe> keyframePtr(new vmd::LightKeyframe());
     keyframePtr->setTimeIndex(42);
     keyframePtr->setColor(Vector3(1, 0, 0));
     {
         // The frame that the layer index is not zero should not be added
-        QScopedPointer<ILightKeyframe> frame42(new vmd::LightKeyframe());
+        ScopedPointer<ILightKeyframe> frame42(new vmd::LightKeyframe());
         frame42->setLayerIndex(42);
         motion.addKeyframe(frame42.data());
         motion.update(IKeyframe::kLight);
@@ -604,20 +622,20 @@ TEST(VMDMotionTest, AddAndRemoveLightKeyframes)
 
 TEST(VMDMotionTest, AddAndRemoveMorphKeyframes)
 {
-    Encoding encoding;
-    CString name("morph");
+    TestEncoding encoding;
+    TestString name("morph");
     MockIModel model;
     MockIMorph morph;
     vmd::Motion motion(&model, &encoding);
     ASSERT_EQ(0, motion.countKeyframes(IKeyframe::kMorph));
     // mock morph
     EXPECT_CALL(model, findMorph(_)).Times(AtLeast(1)).WillRepeatedly(Return(&morph));
-    QScopedPointer<IMorphKeyframe> keyframePtr(new vmd::MorphKeyframe(&encoding));
+    ScopedPointer<IMorphKeyframe> keyframePtr(new vmd::MorphKeyframe(&encoding));
     keyframePtr->setTimeIndex(42);
     keyframePtr->setName(&name);
     {
         // The frame that the layer index is not zero should not be added
-        QScopedPointer<IMorphKeyframe> frame42(new vmd::MorphKeyframe(&encoding));
+        ScopedPointer<IMorphKeyframe> frame42(new vmd::MorphKeyframe(&encoding));
         frame42->setLayerIndex(42);
         motion.addKeyframe(frame42.data());
         motion.update(IKeyframe::kMorph);
@@ -662,7 +680,7 @@ TEST(VMDMotionTest, AddAndRemoveMorphKeyframes)
 TEST(VMDMotionTest, AddAndRemoveNullKeyframe)
 {
     /* should happen nothing */
-    Encoding encoding;
+    TestEncoding encoding;
     MockIModel model;
     IKeyframe *nullKeyframe = 0;
     vmd::Motion motion(&model, &encoding);
@@ -1,5 +1,7 @@
+#ifndef VPVL2_TEST_NO_QT
 #include <QtGui/QApplication>
 #include <QtOpenGL/QtOpenGL>
+#endif
 #include <gtest/gtest.h>
 #include <gmock/gmock.h>
 
@@ -7,12 +9,14 @@ using namespace ::testing;
 
 int main(int argc, char *argv[])
 {
+#ifndef VPVL2_TEST_NO_QT
     QApplication a(argc, argv); Q_UNUSED(a);
     QTextCodec::setCodecForCStrings(QTextCodec::codecForName("UTF-8"));
     QGLWidget widget;
     widget.show();
     widget.update();
     widget.hide();
+#endif
     InitGoogleTest(&argc, argv);
     InitGoogleMock(&argc, argv);
 
@@ -44,6 +44,10 @@ class MockIModel : public IModel {
       void(Array<IMorph *> &value));
   MOCK_CONST_METHOD1(getLabels,
       void(Array<ILabel *> &value));
+  MOCK_CONST_METHOD1(savePose,
+      void(Pose &value));
+  MOCK_METHOD1(restorePose,
+      int(const Pose &value));
   MOCK_CONST_METHOD2(getBoundingBox,
       void(Vector3 &min, Vector3 &max));
   MOCK_CONST_METHOD2(getBoundingSphere,
@@ -16,8 +16,12 @@ class MockIMotion : public IMotion {
       void(IModel *model));
   MOCK_METHOD1(seek,
       void(const IKeyframe::TimeIndex &timeIndex));
+  MOCK_METHOD2(seekScene,
+      void(const IKeyframe::TimeIndex &timeIndex, Scene *scene));
   MOCK_METHOD1(advance,
-      void(const IKeyframe::TimeIndex &delta));
+      void(const IKeyframe::TimeIndex &deltaTimeIndex));
+  MOCK_METHOD2(advanceScene,
+      void(const IKeyframe::TimeIndex &deltaTimeIndex, Scene *scene));
   MOCK_METHOD0(reset,
       void());
   MOCK_CONST_METHOD0(maxTimeIndex,
@@ -28,36 +32,42 @@ class MockIMotion : public IMotion {
       void(IKeyframe *value));
   MOCK_CONST_METHOD1(countKeyframes,
       int(IKeyframe::Type value));
-  MOCK_CONST_METHOD2(findBoneKeyframe,
-      IBoneKeyframe*(const IKeyframe::TimeIndex &timeIndex, const IString *name));
+  MOCK_CONST_METHOD2(countLayers,
+      IKeyframe::LayerIndex(const IString *name, IKeyframe::Type type));
+  MOCK_METHOD4(getKeyframes,
+      void(const IKeyframe::TimeIndex &timeIndex, const IKeyframe::LayerIndex &layerIndex, IKeyframe::Type type, Array<IKeyframe *> &keyframes));
+  MOCK_CONST_METHOD3(findBoneKeyframe,
+      IBoneKeyframe*(const IKeyframe::TimeIndex &timeIndex, const IString *name, const IKeyframe::LayerIndex &layerIndex));
   MOCK_CONST_METHOD1(findBoneKeyframeAt,
       IBoneKeyframe*(int index));
-  MOCK_CONST_METHOD1(findCameraKeyframe,
-      ICameraKeyframe*(const IKeyframe::TimeIndex &timeIndex));
+  MOCK_CONST_METHOD2(findCameraKeyframe,
+      ICameraKeyframe*(const IKeyframe::TimeIndex &timeIndex, const IKeyframe::LayerIndex &layerIndex));
   MOCK_CONST_METHOD1(findCameraKeyframeAt,
       ICameraKeyframe*(int index));
-  MOCK_CONST_METHOD1(findLightKeyframe,
-      ILightKeyframe*(const IKeyframe::TimeIndex &timeIndex));
+  MOCK_CONST_METHOD2(findLightKeyframe,
+      ILightKeyframe*(const IKeyframe::TimeIndex &timeIndex, const IKeyframe::LayerIndex &layerIndex));
   MOCK_CONST_METHOD1(findLightKeyframeAt,
       ILightKeyframe*(int index));
-  MOCK_CONST_METHOD2(findMorphKeyframe,
-      IMorphKeyframe*(const IKeyframe::TimeIndex &timeIndex, const IString *name));
+  MOCK_CONST_METHOD3(findMorphKeyframe,
+      IMorphKeyframe*(const IKeyframe::TimeIndex &timeIndex, const IString *name, const IKeyframe::LayerIndex &layerIndex));
   MOCK_CONST_METHOD1(findMorphKeyframeAt,
       IMorphKeyframe*(int index));
   MOCK_METHOD1(replaceKeyframe,
       void(IKeyframe *value));
   MOCK_METHOD1(deleteKeyframe,
       void(IKeyframe *&value));
-  MOCK_METHOD2(deleteKeyframes,
-      void(const IKeyframe::TimeIndex &timeIndex, IKeyframe::Type type));
   MOCK_METHOD1(update,
       void(IKeyframe::Type type));
+  MOCK_CONST_METHOD0(clone,
+      IMotion*());
   MOCK_CONST_METHOD0(isNullFrameEnabled,
       bool());
   MOCK_METHOD1(setNullFrameEnable,
       void(bool value));
   MOCK_CONST_METHOD0(name,
       const IString*());
+  MOCK_CONST_METHOD0(type,
+      Type());
 };
 
 }  // namespace vpvl2
@@ -12,6 +12,8 @@ class MockIRenderDelegate : public IRenderDelegate {
       bool(const IString *name, const IString *dir, int flags, Texture &texture, void *context));
   MOCK_CONST_METHOD3(getMatrix,
       void(float value[16], const IModel *model, int flags));
+  MOCK_CONST_METHOD4(getMatrices,
+      void(float *values, const IModel *model, const int *flags, int nflags));
   MOCK_METHOD4(log,
       void(void *context, LogLevel level, const char *format, va_list ap));
   MOCK_METHOD2(loadShaderSource,
@@ -51,7 +51,11 @@ SOURCES += main.cc \
     StringTest.cc \
     EncodingTest.cc \
     ArchiveTest.cc \
-    FactoryTest.cc
+    FactoryTest.cc \
+    TextureDiskCacheTest.cc \
+    ShaderProgramTest.cc \
+    ../src/extensions/Encoding.cc \
+    ../src/extensions/String.cc
 
 RESOURCES += \
     fixtures.qrc